@@ -0,0 +1,54 @@
+#include "bench.h"
+#include "utils/assembler.h"
+
+const number ALU_INSTRUCTIONS = 50000000;
+
+// A tight counting loop made of flag setting ADDS/SUBS/CMP instructions,
+// where only the final CMP feeds the branch. r1 starts at zero, so the loop
+// runs for 2^32 iterations
+static RP2040 *loadALULoop(number address) {
+  RP2040 *mcu = new RP2040();
+  const uint16_t loop[] = {
+      (uint16_t)opcodeADDS2(0, 1),          // adds r0, #1
+      (uint16_t)opcodeSUBSreg(2, 0, 1),     // subs r2, r0, r1
+      (uint16_t)opcodeADDSreg(3, 3, 2),     // adds r3, r3, r2
+      (uint16_t)opcodeADDS1(4, 3, 7),       // adds r4, r3, #7
+      (uint16_t)opcodeSUBS1(5, 4, 3),       // subs r5, r4, #3
+      (uint16_t)opcodeSUBS2(1, 1),          // subs r1, #1
+      0x2900,                               // cmp r1, #0
+      0xd1f7,                               // bne.n loop
+  };
+  for (number i = 0; i < sizeof(loop) / sizeof(loop[0]); i++) {
+    mcu->writeUint16(address + 2 * i, loop[i]);
+  }
+  mcu->core0.setPC(address);
+  return mcu;
+}
+
+static void benchALULoop(const string &name, number address) {
+  RP2040 *mcu = loadALULoop(address);
+  double seconds = measureSilently([&]() -> void {
+    for (number i = 0; i < ALU_INSTRUCTIONS; i++) {
+      mcu->core0.executeInstruction();
+    }
+  });
+  reportMIPS(name + " (step)", ALU_INSTRUCTIONS, seconds);
+  delete mcu;
+
+  mcu = loadALULoop(address);
+  number instructions = 0;
+  seconds = measureSilently([&]() -> void {
+    while (instructions < ALU_INSTRUCTIONS) {
+      instructions += mcu->core0.executeBlock();
+    }
+  });
+  reportMIPS(name + " (blocks)", instructions, seconds);
+  reportBlockCache(mcu->core0.blockCache.stats);
+  delete mcu;
+}
+
+void benchALU() {
+  benchALULoop("ALU loop", FLASH_START_ADDRESS);
+  // SRAM isn't predecoded, every instruction is fetched and decoded again
+  benchALULoop("ALU loop in SRAM", RAM_START_ADDRESS);
+}
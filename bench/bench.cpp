@@ -0,0 +1,64 @@
+#include "bench.h"
+#include "bootrom.h"
+#include "intelhex.h"
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+RP2040 *loadFirmware(const string &path) {
+  ifstream input_file(path);
+  if (!input_file.is_open()) {
+    cerr << "Could not open the file - '" << path << "'" << endl;
+    exit(EXIT_FAILURE);
+  }
+  const string hexFile((std::istreambuf_iterator<char>(input_file)),
+                       std::istreambuf_iterator<char>());
+  RP2040 *mcu = new RP2040();
+  mcu->loadBootrom(bootromB1, BOOT_ROM_B1_SIZE);
+  loadHex(hexFile, mcu->flash, 0x10000000);
+  mcu->uart[0]->onTransmit = [](const uint8_t *data, number size) -> void {};
+  mcu->core0.setPC(0x10000000);
+  return mcu;
+}
+
+double measureSilently(function<void()> body) {
+  fflush(stdout);
+  fflush(stderr);
+  const int savedStdout = dup(STDOUT_FILENO);
+  const int savedStderr = dup(STDERR_FILENO);
+  const int devNull = open("/dev/null", O_WRONLY);
+  dup2(devNull, STDOUT_FILENO);
+  dup2(devNull, STDERR_FILENO);
+  close(devNull);
+
+  const auto start = chrono::steady_clock::now();
+  body();
+  const auto end = chrono::steady_clock::now();
+
+  fflush(stdout);
+  fflush(stderr);
+  dup2(savedStdout, STDOUT_FILENO);
+  dup2(savedStderr, STDERR_FILENO);
+  close(savedStdout);
+  close(savedStderr);
+  return chrono::duration<double>(end - start).count();
+}
+
+void reportMIPS(const string &name, number instructions, double seconds) {
+  printf("%-32s %12lu instructions %8.3f s %8.2f MIPS\n", name.c_str(),
+         instructions, seconds, instructions / seconds / 1e6);
+}
+
+void reportBlockCache(const BlockCacheStats &stats) {
+  const number total = stats.blockInstructions + stats.steppedInstructions;
+  printf("  block cache: %lu hits, %lu misses, %lu invalidations, "
+         "%.2f%% of instructions in blocks\n",
+         stats.hits, stats.misses, stats.invalidations,
+         total ? 100.0 * stats.blockInstructions / total : 0.0);
+  printf("  jit: %lu compiled blocks, %.2f%% of instructions native\n",
+         stats.compiledBlocks,
+         total ? 100.0 * stats.nativeInstructions / total : 0.0);
+}
@@ -0,0 +1,29 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include "rp2040.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+
+typedef uint64_t number;
+
+using namespace std;
+
+// Creates an RP2040 with the bootrom and the given firmware loaded
+RP2040 *loadFirmware(const string &path);
+
+// Runs `body` with stdout and stderr redirected to /dev/null and returns
+// the elapsed wall-clock time in seconds
+double measureSilently(function<void()> body);
+
+void reportMIPS(const string &name, number instructions, double seconds);
+void reportBlockCache(const BlockCacheStats &stats);
+
+void benchFirmware(const string &examplesDir);
+void benchALU();
+void benchMemory();
+void benchDualCore();
+void benchInterrupts();
+
+#endif
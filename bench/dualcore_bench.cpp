@@ -0,0 +1,73 @@
+#include "bench.h"
+#include "utils/assembler.h"
+
+// Both cores run the same loop from flash, with r6 pointing at the SIO and
+// r7 at a counter in SRAM. Each core stops the emulator with a BKPT after
+// `iterations` iterations.
+static RP2040 *loadStressLoop(const vector<uint16_t> &loop,
+                              number iterations) {
+  RP2040 *mcu = new RP2040();
+  for (number i = 0; i < loop.size(); i++) {
+    mcu->flash16[i] = loop[i];
+  }
+  for (CortexM0Core *core : mcu->cores) {
+    core->setPC(FLASH_START_ADDRESS);
+    core->registers[1] = iterations;
+    core->registers[6] = SIO_START_ADDRESS;
+    core->registers[7] = RAM_START_ADDRESS;
+  }
+  return mcu;
+}
+
+static void benchStressLoop(const string &name, const vector<uint16_t> &loop,
+                            number iterations) {
+  RP2040 *mcu = loadStressLoop(loop, iterations);
+  number instructions = 0;
+  double seconds =
+      measureSilently([&]() -> void { instructions = mcu->execute(); });
+  reportMIPS(name + " (cores)", instructions, seconds);
+  delete mcu;
+
+  // Threads, named after the number of instructions between two barriers
+  for (number quantum : {1000, 10000, 100000}) {
+    mcu = loadStressLoop(loop, iterations);
+    mcu->threaded = true;
+    mcu->quantum = quantum;
+    seconds =
+        measureSilently([&]() -> void { instructions = mcu->execute(); });
+    reportMIPS(name + " (threads/" + to_string(quantum) + ")", instructions,
+               seconds);
+    delete mcu;
+  }
+}
+
+void benchDualCore() {
+  // Independent work on both cores
+  benchStressLoop("2-core ALU",
+                  {
+                      (uint16_t)opcodeADDS2(0, 1),      // adds r0, #1
+                      (uint16_t)opcodeSUBSreg(2, 0, 1), // subs r2, r0, r1
+                      (uint16_t)opcodeADDSreg(3, 3, 2), // adds r3, r3, r2
+                      (uint16_t)opcodeADDS1(4, 3, 7),   // adds r4, r3, #7
+                      (uint16_t)opcodeSUBS1(5, 4, 3),   // subs r5, r4, #3
+                      (uint16_t)opcodeSUBS2(1, 1),      // subs r1, #1
+                      0xd1f8,                           // bne.n loop
+                      0xbe00,                           // bkpt 0
+                  },
+                  40000000);
+  // Both cores increment a shared counter under SIO spinlock 0
+  benchStressLoop("2-core spinlock",
+                  {
+                      0x6830,                      // ldr r0, [r6]
+                      0x2800,                      // cmp r0, #0
+                      0xd0fc,                      // beq.n loop
+                      0x683a,                      // ldr r2, [r7]
+                      (uint16_t)opcodeADDS2(2, 1), // adds r2, #1
+                      0x603a,                      // str r2, [r7]
+                      0x6030,                      // str r0, [r6]
+                      (uint16_t)opcodeSUBS2(1, 1), // subs r1, #1
+                      0xd1f6,                      // bne.n loop
+                      0xbe00,                      // bkpt 0
+                  },
+                  4000000);
+}
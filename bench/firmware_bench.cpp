@@ -0,0 +1,44 @@
+#include "bench.h"
+
+const number FIRMWARE_INSTRUCTIONS = 20000000;
+
+static void benchExample(const string &examplesDir, const string &name) {
+  RP2040 *mcu = loadFirmware(examplesDir + "/" + name);
+  double seconds = measureSilently([&]() -> void {
+    for (number i = 0; i < FIRMWARE_INSTRUCTIONS; i++) {
+      mcu->core0.executeInstruction();
+    }
+  });
+  reportMIPS(name + " (step)", FIRMWARE_INSTRUCTIONS, seconds);
+  delete mcu;
+
+  mcu = loadFirmware(examplesDir + "/" + name);
+  number instructions = 0;
+  seconds = measureSilently([&]() -> void {
+    while (instructions < FIRMWARE_INSTRUCTIONS) {
+      instructions += mcu->core0.executeBlock();
+    }
+  });
+  reportMIPS(name + " (blocks)", instructions, seconds);
+  reportBlockCache(mcu->core0.blockCache.stats);
+  delete mcu;
+
+  // Both cores, with core 1 waiting in the bootrom for something to run
+  mcu = loadFirmware(examplesDir + "/" + name);
+  instructions = 0;
+  seconds = measureSilently([&]() -> void {
+    // Until the firmware stops at its breakpoint
+    number count = 1;
+    while (instructions < FIRMWARE_INSTRUCTIONS && count > 0) {
+      count = mcu->executeCores();
+      instructions += count;
+    }
+  });
+  reportMIPS(name + " (cores)", instructions, seconds);
+  delete mcu;
+}
+
+void benchFirmware(const string &examplesDir) {
+  benchExample(examplesDir, "hello_uart.hex");
+  benchExample(examplesDir, "blink.hex");
+}
@@ -0,0 +1,41 @@
+#include "bench.h"
+#include "utils/assembler.h"
+
+const number INTERRUPT_INSTRUCTIONS = 10000000;
+const number IRQ0_HANDLER = 0x10000100;
+const number INTERRUPT_LOOP = 0x10000200;
+
+// Thread mode keeps setting interrupt 0 pending through NVIC_ISPR, and its
+// handler clears it again, so an exception is taken and returned from every
+// five instructions
+static RP2040 *loadInterruptLoop() {
+  RP2040 *mcu = new RP2040();
+  mcu->writeUint32(PPB_BASE + OFFSET_VTOR, FLASH_START_ADDRESS);
+  mcu->writeUint32(FLASH_START_ADDRESS + 16 * 4, IRQ0_HANDLER | 1);
+  mcu->writeUint16(IRQ0_HANDLER, 0x6011);                  // str r1, [r2]
+  mcu->writeUint16(IRQ0_HANDLER + 2, opcodeBX(14));        // bx lr
+  mcu->writeUint16(INTERRUPT_LOOP, 0x6001);                // str r1, [r0]
+  mcu->writeUint16(INTERRUPT_LOOP + 2, opcodeADDS2(3, 1)); // adds r3, #1
+  mcu->writeUint16(INTERRUPT_LOOP + 4, 0xe7fc);            // b.n loop
+  mcu->writeUint32(PPB_BASE + OFFSET_NVIC_ISER, 1);
+  mcu->core0.registers[0] = PPB_BASE + OFFSET_NVIC_ISPR;
+  mcu->core0.registers[1] = 1;
+  mcu->core0.registers[2] = PPB_BASE + OFFSET_NVIC_ICPR;
+  mcu->core0.setSP(RAM_START_ADDRESS + 0x1000);
+  mcu->core0.setPC(INTERRUPT_LOOP);
+  return mcu;
+}
+
+void benchInterrupts() {
+  RP2040 *mcu = loadInterruptLoop();
+  number instructions = 0;
+  double seconds = measureSilently([&]() -> void {
+    while (instructions < INTERRUPT_INSTRUCTIONS) {
+      instructions += mcu->core0.executeBlock();
+    }
+  });
+  reportMIPS("interrupt loop (blocks)", instructions, seconds);
+  printf("  %lu interrupts, %.2f M/s\n", (number)mcu->core0.registers[3],
+         mcu->core0.registers[3] / seconds / 1e6);
+  delete mcu;
+}
@@ -0,0 +1,12 @@
+#include "bench.h"
+#include <string>
+
+int main(int argc, char *argv[]) {
+  const string examplesDir = argc > 1 ? argv[1] : EXAMPLES_DIR;
+  benchFirmware(examplesDir);
+  benchALU();
+  benchMemory();
+  benchDualCore();
+  benchInterrupts();
+  return EXIT_SUCCESS;
+}
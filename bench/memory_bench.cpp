@@ -0,0 +1,79 @@
+#include "bench.h"
+#include "utils/assembler.h"
+#include <vector>
+
+const number MEMORY_INSTRUCTIONS = 20000000;
+
+// Loads `loop` into flash with r8 pointing at a source buffer and r9 at a
+// destination buffer in SRAM
+static RP2040 *loadLoop(const vector<uint16_t> &loop) {
+  RP2040 *mcu = new RP2040();
+  for (number i = 0; i < loop.size(); i++) {
+    mcu->flash16[i] = loop[i];
+  }
+  mcu->core0.registers[8] = RAM_START_ADDRESS;
+  mcu->core0.registers[9] = RAM_START_ADDRESS + 0x10000;
+  mcu->core0.setPC(FLASH_START_ADDRESS);
+  return mcu;
+}
+
+static void benchLoop(const string &name, const vector<uint16_t> &loop) {
+  RP2040 *mcu = loadLoop(loop);
+  double seconds = measureSilently([&]() -> void {
+    for (number i = 0; i < MEMORY_INSTRUCTIONS; i++) {
+      mcu->core0.executeInstruction();
+    }
+  });
+  reportMIPS(name + " (step)", MEMORY_INSTRUCTIONS, seconds);
+  delete mcu;
+
+  mcu = loadLoop(loop);
+  number instructions = 0;
+  seconds = measureSilently([&]() -> void {
+    while (instructions < MEMORY_INSTRUCTIONS) {
+      instructions += mcu->core0.executeBlock();
+    }
+  });
+  reportMIPS(name + " (blocks)", instructions, seconds);
+  reportBlockCache(mcu->core0.blockCache.stats);
+  delete mcu;
+}
+
+void benchMemory() {
+  // Copies 1 KiB with LDMIA/STMIA over and over
+  benchLoop("memcpy loop", {
+      (uint16_t)opcodeMOVS(2, 64),    // movs r2, #64
+      (uint16_t)opcodeMOV(0, 8),      // mov r0, r8
+      (uint16_t)opcodeMOV(1, 9),      // mov r1, r9
+      (uint16_t)opcodeLDMIA(0, 0xf0), // ldmia r0!, {r4-r7}
+      (uint16_t)opcodeSTMIA(1, 0xf0), // stmia r1!, {r4-r7}
+      (uint16_t)opcodeSUBS2(2, 1),    // subs r2, #1
+      0xd1fb,                         // bne.n ldmia
+      0xe7f7,                         // b.n movs
+  });
+
+  // Copies 128 bytes one byte at a time, like string handling code does
+  benchLoop("byte copy loop", {
+      (uint16_t)opcodeMOVS(2, 128),   // movs r2, #128
+      (uint16_t)opcodeMOV(0, 8),      // mov r0, r8
+      (uint16_t)opcodeMOV(1, 9),      // mov r1, r9
+      (uint16_t)opcodeLDRB(3, 0, 0),  // ldrb r3, [r0]
+      (uint16_t)opcodeSTRB(3, 1, 0),  // strb r3, [r1]
+      (uint16_t)opcodeADDS2(0, 1),    // adds r0, #1
+      (uint16_t)opcodeADDS2(1, 1),    // adds r1, #1
+      (uint16_t)opcodeSUBS2(2, 1),    // subs r2, #1
+      0xd1f9,                         // bne.n ldrb
+      0xe7f5,                         // b.n movs
+  });
+
+  // Fills 256 bytes with halfword stores
+  benchLoop("halfword fill loop", {
+      (uint16_t)opcodeMOVS(2, 128),   // movs r2, #128
+      (uint16_t)opcodeMOV(1, 9),      // mov r1, r9
+      (uint16_t)opcodeSTRH(2, 1, 0),  // strh r2, [r1]
+      (uint16_t)opcodeADDS2(1, 2),    // adds r1, #2
+      (uint16_t)opcodeSUBS2(2, 1),    // subs r2, #1
+      0xd1fb,                         // bne.n strh
+      0xe7f8,                         // b.n movs
+  });
+}
@@ -0,0 +1,42 @@
+#include "blockcache.h"
+
+BlockCache::~BlockCache() {
+  for (Block *block : this->slots) {
+    delete block;
+  }
+}
+
+void BlockCache::insert(Block *block) {
+  Block *&slot = this->slots[(block->address >> 1) & (BLOCK_CACHE_SLOTS - 1)];
+  if (slot == NULL) {
+    this->blockCount++;
+  }
+  // Blocks are only replaced between two blocks, never while running
+  delete slot;
+  slot = block;
+  this->stats.misses++;
+}
+
+void BlockCache::invalidate(number address) {
+  if (this->blockCount == 0) {
+    return;
+  }
+  // Invalid blocks are kept until their slot is reused, since the write may
+  // come from the block that is currently running
+  for (Block *block : this->slots) {
+    if (block != NULL && block->valid && block->address < address + 4 &&
+        block->endAddress > address) {
+      block->valid = false;
+      this->stats.invalidations++;
+    }
+  }
+}
+
+void BlockCache::invalidateAll() {
+  for (Block *block : this->slots) {
+    if (block != NULL && block->valid) {
+      block->valid = false;
+      this->stats.invalidations++;
+    }
+  }
+}
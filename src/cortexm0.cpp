@@ -0,0 +1,1889 @@
+#include "cortexm0.h"
+#include "rp2040.h"
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+static const DecodeEntry *buildDecodeTable();
+
+number CortexM0Core::signExtend8(number value) { return (char)value; }
+number CortexM0Core::signExtend16(number value) { return (short)value; }
+
+void CortexM0Core::onBreak(number code) {
+  // TODO: raise HardFault exception
+  // cerr << "Breakpoint! 0x" << hex << code << endl;
+  this->rp2040->stop();
+  breakCount += 1;
+}
+
+number CortexM0Core::getBreakCount() { return this->breakCount; }
+
+CortexM0Core::CortexM0Core(RP2040 *rp2040, number id)
+    : rp2040(rp2040), id(id), bootromCache(0, BOOT_ROM_B1_SIZE * 4),
+      flashCache(FLASH_START_ADDRESS, FLASH_SIZE) {
+  // The decode table is shared by all instances and built only once
+  static const DecodeEntry *decodeTable = buildDecodeTable();
+  this->decodeTable = decodeTable;
+#ifdef RP2040_JIT
+  this->jitVerify = getenv("RP2040_JIT_VERIFY") != NULL;
+#endif
+}
+
+void CortexM0Core::reset() {
+  this->setSP(this->rp2040->bootrom[0]);
+  this->setPC(this->rp2040->bootrom[1] & 0xFFFFFFFE);
+  this->waiting = false;
+  this->bootromCache.invalidateAll();
+  this->flashCache.invalidateAll();
+  this->blockCache.invalidateAll();
+}
+
+number CortexM0Core::getSP() { return this->registers[13]; }
+
+void CortexM0Core::setSP(number value) { this->registers[13] = value; }
+
+number CortexM0Core::getLR() { return this->registers[14]; }
+
+void CortexM0Core::setLR(number value) { this->registers[14] = value; }
+
+number CortexM0Core::getPC() { return this->registers[15]; }
+
+void CortexM0Core::setPC(number value) { this->registers[15] = value; }
+
+number CortexM0Core::getAPSR() {
+  const ConditionFlags &flags = this->flags;
+  return ((flags.getN() ? 0x80000000 : 0) | (flags.getZ() ? 0x40000000 : 0) |
+          (flags.getC() ? 0x20000000 : 0) | (flags.getV() ? 0x10000000 : 0));
+}
+
+void CortexM0Core::setAPSR(number value) {
+  this->flags.setAll(!!(value & 0x80000000), !!(value & 0x40000000),
+                     !!(value & 0x20000000), !!(value & 0x10000000));
+}
+
+number CortexM0Core::getxPSR() {
+  return this->getAPSR() | this->IPSR | (1 << 24);
+}
+
+void CortexM0Core::setxPSR(number value) {
+  this->setAPSR(value);
+  this->IPSR = value & 0x3f;
+}
+
+// AddWithCarry() of the ARM pseudocode; subtraction is x + ~y + 1
+number CortexM0Core::addWithCarry(number x, number y, bool carryIn) {
+  const uint32_t result = x + y + carryIn;
+  this->flags.setAdd(result, x, y, carryIn);
+  return result;
+}
+
+bool CortexM0Core::checkCondition(number cond) { // Evaluate base condition.
+  const ConditionFlags &flags = this->flags;
+  bool result = false;
+  switch (cond >> 1) {
+  case 0b000:
+    result = flags.getZ();
+    break;
+  case 0b001:
+    result = flags.getC();
+    break;
+  case 0b010:
+    result = flags.getN();
+    break;
+  case 0b011:
+    result = flags.getV();
+    break;
+  case 0b100:
+    result = flags.getC() && !flags.getZ();
+    break;
+  case 0b101:
+    result = flags.getN() == flags.getV();
+    break;
+  case 0b110:
+    result = flags.getN() == flags.getV() && !flags.getZ();
+    break;
+  case 0b111:
+    result = true;
+    break;
+  }
+  return cond & 0b1 && cond != 0b1111 ? !result : result;
+}
+
+number CortexM0Core::readUint32(number address) {
+  return this->rp2040->readUint32(address);
+}
+
+number CortexM0Core::readUint16(number address) {
+  return this->rp2040->readUint16(address);
+}
+
+number CortexM0Core::readUint8(number address) {
+  return this->rp2040->readUint8(address);
+}
+
+void CortexM0Core::writeUint32(number address, number value) {
+  this->rp2040->writeUint32(address, value);
+}
+
+void CortexM0Core::writeUint16(number address, number value) {
+  this->rp2040->writeUint16(address, value);
+}
+
+void CortexM0Core::writeUint8(number address, number value) {
+  this->rp2040->writeUint8(address, value);
+}
+
+bool CortexM0Core::resolveFetchRegion(number address) {
+  if (address < BOOT_ROM_B1_SIZE * 4) {
+    this->fetchMemory = (const uint8_t *)this->rp2040->bootrom;
+    this->fetchStart = 0;
+    this->fetchEnd = BOOT_ROM_B1_SIZE * 4;
+  } else if (address >= FLASH_START_ADDRESS &&
+             address < FLASH_START_ADDRESS + FLASH_SIZE) {
+    this->fetchMemory = this->rp2040->flash;
+    this->fetchStart = FLASH_START_ADDRESS;
+    this->fetchEnd = FLASH_START_ADDRESS + FLASH_SIZE;
+  } else if (address >= RAM_START_ADDRESS &&
+             address < RAM_START_ADDRESS + SRAM_SIZE) {
+    this->fetchMemory = this->rp2040->sram;
+    this->fetchStart = RAM_START_ADDRESS;
+    this->fetchEnd = RAM_START_ADDRESS + SRAM_SIZE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+number CortexM0Core::fetchUint16(number address) {
+  address &= 0xfffffffe;
+  // The region only changes when the PC leaves it
+  if (address - this->fetchStart >= this->fetchEnd - this->fetchStart &&
+      !this->resolveFetchRegion(address)) {
+    return this->readUint16(address);
+  }
+  return loadLittleEndian<uint16_t>(this->fetchMemory +
+                                    (address - this->fetchStart));
+}
+
+void CortexM0Core::invalidateCode(number address) {
+  this->bootromCache.invalidate(address);
+  this->flashCache.invalidate(address);
+  this->blockCache.invalidate(address);
+}
+
+void CortexM0Core::switchStack(STACK_POINTER_BANK stack) {
+  if (this->SPSEL != stack) {
+    const number temp = this->getSP();
+    this->setSP(this->bankedSP);
+    this->bankedSP = temp;
+    this->SPSEL = stack;
+  }
+}
+
+number CortexM0Core::getSPprocess() {
+  return this->SPSEL == SP_PROCESS ? this->getSP() : this->bankedSP;
+}
+
+void CortexM0Core::setSPprocess(number value) {
+  if (this->SPSEL == SP_PROCESS) {
+    this->setSP(value);
+  } else {
+    this->bankedSP = (uint32_t)value;
+  }
+}
+
+number CortexM0Core::getSPmain() {
+  return this->SPSEL == SP_MAIN ? this->getSP() : this->bankedSP;
+}
+
+void CortexM0Core::setSPmain(number value) {
+  if (this->SPSEL == SP_MAIN) {
+    this->setSP(value);
+  } else {
+    this->bankedSP = (uint32_t)value;
+  }
+}
+
+uint8_t *CortexM0Core::exceptionFrameMemory(number address) {
+  if (address >= RAM_START_ADDRESS &&
+      address + 4 * EXCEPTION_FRAME_WORDS <= RAM_START_ADDRESS + SRAM_SIZE) {
+    return this->rp2040->sram + (address - RAM_START_ADDRESS);
+  }
+  return NULL;
+}
+
+void CortexM0Core::writeExceptionFrame(number address, const uint32_t *frame) {
+  uint8_t *memory = this->exceptionFrameMemory(address);
+  if (memory != NULL) {
+    for (number i = 0; i < EXCEPTION_FRAME_WORDS; i++) {
+      storeLittleEndian<uint32_t>(memory + 4 * i, frame[i]);
+    }
+    return;
+  }
+  for (number i = 0; i < EXCEPTION_FRAME_WORDS; i++) {
+    this->writeUint32(address + 4 * i, frame[i]);
+  }
+}
+
+void CortexM0Core::readExceptionFrame(number address, uint32_t *frame) {
+  const uint8_t *memory = this->exceptionFrameMemory(address);
+  if (memory != NULL) {
+    for (number i = 0; i < EXCEPTION_FRAME_WORDS; i++) {
+      frame[i] = loadLittleEndian<uint32_t>(memory + 4 * i);
+    }
+    return;
+  }
+  for (number i = 0; i < EXCEPTION_FRAME_WORDS; i++) {
+    frame[i] = this->readUint32(address + 4 * i);
+  }
+}
+
+number CortexM0Core::readVector(number exceptionNumber) {
+  if (this->VTOR != this->vectorTableAddress) {
+    // The table has to fit in one page to be read from host memory. It
+    // always does with the 256 byte alignment VTOR requires.
+    this->vectorTableAddress = this->VTOR;
+    this->vectorTable = NULL;
+    if ((this->VTOR & MEMORY_PAGE_MASK) + VECTOR_TABLE_SIZE <=
+        MEMORY_PAGE_SIZE) {
+      const MemoryPage &page = this->rp2040->memoryMap.lookup(this->VTOR);
+      if (page.read != NULL) {
+        this->vectorTable = page.read + (this->VTOR & MEMORY_PAGE_MASK);
+      }
+    }
+  }
+  if (this->vectorTable != NULL) {
+    return loadLittleEndian<uint32_t>(this->vectorTable + 4 * exceptionNumber);
+  }
+  return this->readUint32(this->VTOR + 4 * exceptionNumber);
+}
+
+void CortexM0Core::exceptionEntry(number exceptionNumber) {
+  // PushStack:
+  number framePtr = 0;
+  number framePtrAlign = 0;
+  if (this->SPSEL && this->currentMode == MODE_THREAD) {
+    framePtrAlign = this->getSPprocess() & 0b100 ? 1 : 0;
+    this->setSPprocess((this->getSPprocess() - 0x20) & ~0b100);
+    framePtr = this->getSPprocess();
+  } else {
+    framePtrAlign = this->getSPmain() & 0b100 ? 1 : 0;
+    this->setSPmain((this->getSPmain() - 0x20) & ~0b100);
+    framePtr = this->getSPmain();
+  }
+  /* only the stack locations, not the store order, are architected */
+  const uint32_t frame[EXCEPTION_FRAME_WORDS] = {
+      this->registers[0],
+      this->registers[1],
+      this->registers[2],
+      this->registers[3],
+      this->registers[12],
+      (uint32_t)this->getLR(),
+      (uint32_t)this->getPC() & ~1, // ReturnAddress(ExceptionType);
+      (uint32_t)((this->getxPSR() & ~(1 << 9)) | (framePtrAlign << 9)),
+  };
+  this->writeExceptionFrame(framePtr, frame);
+  if (this->currentMode == MODE_HANDLER) {
+    this->setLR(0xfffffff1);
+  } else {
+    if (!this->SPSEL) {
+      this->setLR(0xfffffff9);
+    } else {
+      this->setLR(0xfffffffd);
+    }
+  }
+  // ExceptionTaken:
+  this->currentMode = MODE_HANDLER; // Enter Handler Mode, now Privileged
+  this->IPSR = exceptionNumber;
+  this->switchStack(SP_MAIN);
+  // SetEventRegister(); // See WFE instruction for details
+  // Bit 0 of the vector is the Thumb bit, not part of the address
+  this->setPC(this->readVector(exceptionNumber) & ~1);
+  this->advanceCycles(EXCEPTION_ENTRY_CYCLES);
+}
+
+void CortexM0Core::exceptionReturn(number excReturn) {
+  number framePtr = this->getSPmain();
+  switch (excReturn & 0xf) {
+  case 0b0001: // Return to Handler
+    this->currentMode = MODE_HANDLER;
+    this->switchStack(SP_MAIN);
+    break;
+  case 0b1001: // Return to Thread using Main stack
+    this->currentMode = MODE_THREAD;
+    this->switchStack(SP_MAIN);
+    break;
+  case 0b1101: // Return to Thread using Process stack
+    framePtr = this->getSPprocess();
+    this->currentMode = MODE_THREAD;
+    this->switchStack(SP_PROCESS);
+    break;
+    // Assigning CurrentMode to Mode_Thread causes a drop in privilege
+    // if CONTROL.nPRIV is set to 1
+  }
+
+  // PopStack:
+  // Stack accesses are performed as Unprivileged accesses if
+  // CONTROL<0>=='1' && EXC_RETURN<3>=='1' Privileged otherwise
+  uint32_t frame[EXCEPTION_FRAME_WORDS];
+  this->readExceptionFrame(framePtr, frame);
+  this->registers[0] = frame[0];
+  this->registers[1] = frame[1];
+  this->registers[2] = frame[2];
+  this->registers[3] = frame[3];
+  this->registers[12] = frame[4];
+  this->setLR(frame[5]);
+  this->setPC(frame[6]);
+  const number psr = frame[7];
+
+  const number framePtrAlign = psr & (1 << 9) ? 0b100 : 0;
+
+  switch (excReturn & 0xf) {
+  case 0b0001: // Returning to Handler mode
+    this->setSPmain((this->getSPmain() + 0x20) | framePtrAlign);
+  case 0b1001: // Returning to Thread mode using Main stack
+    this->setSPmain((this->getSPmain() + 0x20) | framePtrAlign);
+  case 0b1101: // Returning to Thread mode using Process stack
+    this->setSPprocess((this->getSPprocess() + 0x20) | framePtrAlign);
+  }
+
+  this->setAPSR(psr & 0xf0000000);
+  const number forceThread = this->currentMode == MODE_THREAD && this->nPRIV;
+  this->IPSR = forceThread ? 0 : psr & 0x3f;
+  this->advanceCycles(EXCEPTION_RETURN_CYCLES);
+  // Thumb bit should always be one! EPSR<24> = psr<24>; // Load valid EPSR bits
+  // from memory SetEventRegister(); // See WFE instruction for more details if
+  // CurrentMode == Mode_Thread && SCR.SLEEPONEXIT == '1' then SleepOnExit(); //
+  // IMPLEMENTATION DEFINED
+}
+
+void CortexM0Core::setInterrupt(number irq, bool value) {
+  if (value) {
+    this->nvic.pendingInterrupts |= 1 << irq;
+    this->interruptsUpdated = true;
+    // Waking up without an event is allowed, WFE is always used in a loop
+    this->waiting = false;
+  } else {
+    this->nvic.pendingInterrupts &= ~(1 << irq);
+  }
+}
+
+void CortexM0Core::checkForInterrupts() {
+  // Cleared first, so an interrupt the other core raises meanwhile is seen
+  // by the next check
+  this->interruptsUpdated = false;
+  const number executionPriority =
+      this->PM ? 0 : this->nvic.executionPriority(this->IPSR);
+  const number exception = this->nvic.takeException(executionPriority);
+  if (exception) {
+    this->exceptionEntry(exception);
+    // Another exception may still preempt this one
+    this->interruptsUpdated = true;
+  }
+}
+
+number CortexM0Core::readSpecialRegister(number sysm) {
+  switch (sysm) {
+  case SYSM_APSR:
+    return this->getAPSR();
+
+  case SYSM_XPSR:
+    return this->getxPSR();
+
+  case SYSM_IPSR:
+    return this->IPSR;
+
+  case SYSM_PRIMASK:
+    return this->PM ? 1 : 0;
+
+  case SYSM_MSP:
+    return this->getSPmain();
+
+  case SYSM_PSP:
+    return this->getSPprocess();
+
+  case SYSM_CONTROL:
+    return (this->SPSEL == SP_PROCESS ? 2 : 0) | (this->nPRIV ? 1 : 0);
+
+  default:
+    cout << "MRS with unimplemented SYSm value: 0x" << hex << sysm << endl;
+    return 0;
+  }
+}
+
+void CortexM0Core::writeSpecialRegister(number sysm, number value) {
+  switch (sysm) {
+  case SYSM_APSR:
+    this->setAPSR(value);
+    break;
+
+  case SYSM_XPSR:
+    this->setxPSR(value);
+    break;
+
+  case SYSM_IPSR:
+    this->IPSR = value;
+    break;
+
+  case SYSM_PRIMASK:
+    this->PM = !!(value & 1);
+    break;
+
+  case SYSM_MSP:
+    this->setSPmain(value);
+    break;
+
+  case SYSM_PSP:
+    this->setSPprocess(value);
+    break;
+
+  case SYSM_CONTROL:
+    this->nPRIV = !!(value & 1);
+    if (this->currentMode == MODE_THREAD) {
+      this->switchStack(value & 2 ? SP_PROCESS : SP_MAIN);
+    }
+    break;
+
+  default:
+    cout << "MSR with unimplemented SYSm value: 0x" << hex << sysm << endl;
+  }
+}
+
+void CortexM0Core::BXWritePC(number address) {
+  if (this->currentMode == MODE_HANDLER && (uint32_t)address >> 28 == 0b1111) {
+    this->exceptionReturn(address & 0x0fffffff);
+  } else {
+    this->setPC(address & ~1);
+  }
+}
+
+void CortexM0Core::sendEvent() {
+  for (CortexM0Core *core : this->rp2040->cores) {
+    core->eventRegister = true;
+    core->waiting = false;
+  }
+}
+
+void CortexM0Core::waitForEvent() {
+  if (this->eventRegister.exchange(false)) {
+    return;
+  }
+  this->waiting = true;
+  // Running on its own thread, the other core may have sent an event or
+  // raised an interrupt since the check above
+  if (this->eventRegister.exchange(false) || this->interruptsUpdated) {
+    this->waiting = false;
+  }
+}
+
+void CortexM0Core::waitForInterrupt() {
+  // Shares the sleep of WFE, so events wake it up too. WFI is allowed to
+  // return early, and firmware runs it in a loop.
+  this->waiting = true;
+  if (this->interruptsUpdated ||
+      (this->nvic.pendingInterrupts & this->nvic.enabledInterrupts)) {
+    this->waiting = false;
+  }
+}
+
+// ADCS
+static void executeADCS(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rdn = instr.Rd;
+  cpu->registers[Rdn] = cpu->addWithCarry(
+      cpu->registers[Rdn], cpu->registers[Rm], cpu->flags.getC());
+}
+
+// ADD (register = SP plus immediate)
+static void executeADDRegisterSPImmediate(CortexM0Core *cpu,
+                                          const Instruction &instr) {
+  const number imm8 = instr.imm;
+  const number Rd = instr.Rd;
+  cpu->registers[Rd] = cpu->getSP() + (imm8 << 2);
+}
+
+// ADD (SP plus immediate)
+static void executeADDSPImmediate(CortexM0Core *cpu, const Instruction &instr) {
+  const number imm32 = instr.imm << 2;
+  cpu->setSP(cpu->getSP() + imm32);
+}
+
+// ADDS (Encoding T1)
+static void executeADDSEncodingT1(CortexM0Core *cpu, const Instruction &instr) {
+  const number imm3 = instr.imm;
+  const number Rn = instr.Rn;
+  const number Rd = instr.Rd;
+  cpu->registers[Rd] = cpu->addWithCarry(cpu->registers[Rn], imm3, false);
+}
+
+// ADDS (Encoding T2)
+static void executeADDSEncodingT2(CortexM0Core *cpu, const Instruction &instr) {
+  const number imm8 = instr.imm;
+  const number Rdn = instr.Rd;
+  cpu->registers[Rdn] = cpu->addWithCarry(cpu->registers[Rdn], imm8, false);
+}
+
+// ADDS (register)
+static void executeADDSRegister(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rn = instr.Rn;
+  const number Rd = instr.Rd;
+  cpu->registers[Rd] =
+      cpu->addWithCarry(cpu->registers[Rn], cpu->registers[Rm], false);
+}
+
+// ADD (register)
+static void executeADDRegister(CortexM0Core *cpu, const Instruction &instr) {
+  const number regPC = 15;
+  const number Rm = instr.Rm;
+  const number Rdn = instr.Rd;
+  const number leftValue =
+      Rdn == regPC ? cpu->getPC() + 2 : cpu->registers[Rdn];
+  const number rightValue = cpu->registers[Rm];
+  const number result = leftValue + rightValue;
+  // The high register encoding never updates the flags
+  cpu->registers[Rdn] = Rdn == regPC ? result & ~0x1 : result;
+}
+
+// ADR
+static void executeADR(CortexM0Core *cpu, const Instruction &instr) {
+  const number imm8 = instr.imm;
+  const number Rd = instr.Rd;
+  const number opcodePC = cpu->getPC() - 2;
+  cpu->registers[Rd] = (opcodePC & 0xfffffffc) + 4 + (imm8 << 2);
+}
+
+// ANDS (Encoding T2)
+static void executeANDS(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rdn = instr.Rd;
+  const number result = cpu->registers[Rdn] & cpu->registers[Rm];
+  cpu->registers[Rdn] = result;
+  cpu->flags.setNZ(result);
+}
+
+// ASRS (immediate)
+static void executeASRSImmediate(CortexM0Core *cpu, const Instruction &instr) {
+  const number imm5 = instr.imm;
+  const number Rm = instr.Rm;
+  const number Rd = instr.Rd;
+  const number input = cpu->registers[Rm];
+  // An immediate of 0 encodes a shift by 32
+  const number result = (int)input >> (imm5 ? imm5 : 31);
+  cpu->registers[Rd] = result;
+  cpu->flags.setNZ(result);
+  cpu->flags.setC(((uint32_t)input >> (imm5 ? imm5 - 1 : 31)) & 0x1);
+}
+
+// ASRS (register)
+static void executeASRSRegister(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rdn = instr.Rd;
+  const number input = cpu->registers[Rdn];
+  const number shiftN = cpu->registers[Rm] & 0xff;
+  const number result = (int)input >> (shiftN < 32 ? shiftN : 31);
+  cpu->registers[Rdn] = result;
+  cpu->flags.setNZ(result);
+  if (shiftN) {
+    cpu->flags.setC(((uint32_t)input >> (shiftN < 32 ? shiftN - 1 : 31)) & 0x1);
+  }
+}
+
+// B (with cond)
+static void executeBConditional(CortexM0Core *cpu, const Instruction &instr) {
+  if (cpu->checkCondition(instr.cond)) {
+    cpu->setPC(cpu->getPC() + instr.imm + 2);
+    // Refilling the pipeline takes one more cycle than falling through
+    cpu->cycles++;
+  }
+}
+
+// B
+static void executeB(CortexM0Core *cpu, const Instruction &instr) {
+  cpu->setPC(cpu->getPC() + instr.imm + 2);
+}
+
+// BICS
+static void executeBICS(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rdn = instr.Rd;
+  const number result = (cpu->registers[Rdn] &= ~cpu->registers[Rm]);
+  cpu->flags.setNZ(result);
+}
+
+// BKPT
+static void executeBKPT(CortexM0Core *cpu, const Instruction &instr) {
+  const number imm8 = instr.imm;
+  cpu->onBreak(imm8);
+}
+
+// BL
+static void executeBL(CortexM0Core *cpu, const Instruction &instr) {
+  cpu->setLR((cpu->getPC() + 2) | 0x1);
+  cpu->setPC(cpu->getPC() + 2 + instr.imm);
+}
+
+// BLX
+static void executeBLX(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  cpu->setLR(cpu->getPC() | 0x1);
+  cpu->setPC(cpu->registers[Rm] & ~1);
+}
+
+// BX
+static void executeBX(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  cpu->BXWritePC(cpu->registers[Rm]);
+}
+
+// CMP immediate
+static void executeCMPImmediate(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rn = instr.Rn;
+  const number imm8 = instr.imm;
+  cpu->addWithCarry(cpu->registers[Rn], ~imm8, true);
+}
+
+// CMP (register)
+static void executeCMPRegister(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rn = instr.Rn;
+  cpu->addWithCarry(cpu->registers[Rn], ~cpu->registers[Rm], true);
+}
+
+// CMP (register) encoding T2
+static void executeCMPRegisterT2(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rn = instr.Rn;
+  cpu->addWithCarry(cpu->registers[Rn], ~cpu->registers[Rm], true);
+}
+
+// CPSID i
+static void executeCPSID(CortexM0Core *cpu, const Instruction &instr) {
+  cpu->PM = true;
+}
+
+// CPSIE i
+static void executeCPSIE(CortexM0Core *cpu, const Instruction &instr) {
+  cpu->PM = false;
+}
+
+// DMB SY
+static void executeDMB(CortexM0Core *cpu, const Instruction &instr) {
+  cpu->setPC(cpu->getPC() + 2);
+}
+
+// EORS
+static void executeEORS(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rdn = instr.Rd;
+  const number result = cpu->registers[Rm] ^ cpu->registers[Rdn];
+  cpu->registers[Rdn] = result;
+  cpu->flags.setNZ(result);
+}
+
+// LDMIA
+static void executeLDMIA(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rn = instr.Rn;
+  const number registers = instr.imm;
+  number address = cpu->registers[Rn];
+  for (number i = 0; i < 8; i++) {
+    if (registers & (1 << i)) {
+      cpu->registers[i] = cpu->readUint32(address);
+      address += 4;
+    }
+  }
+  // Write back
+  if (!(registers & (1 << Rn))) {
+    cpu->registers[Rn] = address;
+  }
+}
+
+// LDR (immediate)
+static void executeLDRImmediate(CortexM0Core *cpu, const Instruction &instr) {
+  const number imm5 = instr.imm << 2;
+  const number Rn = instr.Rn;
+  const number Rt = instr.Rd;
+  const number addr = cpu->registers[Rn] + imm5;
+  cpu->registers[Rt] = cpu->readUint32(addr);
+}
+
+// LDR (sp + immediate)
+static void executeLDRSPImmediate(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rt = instr.Rd;
+  const number imm8 = instr.imm;
+  const number addr = cpu->getSP() + (imm8 << 2);
+  cpu->registers[Rt] = cpu->readUint32(addr);
+}
+
+// LDR (literal)
+static void executeLDRLiteral(CortexM0Core *cpu, const Instruction &instr) {
+  const number imm8 = instr.imm << 2;
+  const number Rt = instr.Rd;
+  const number nextPC = cpu->getPC() + 2;
+  const number addr = (nextPC & 0xfffffffc) + imm8;
+  cpu->registers[Rt] = cpu->readUint32(addr);
+}
+
+// LDR (register)
+static void executeLDRRegister(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rn = instr.Rn;
+  const number Rt = instr.Rd;
+  const number addr = cpu->registers[Rm] + cpu->registers[Rn];
+  cpu->registers[Rt] = cpu->readUint32(addr);
+}
+
+// LDRB (immediate)
+static void executeLDRBImmediate(CortexM0Core *cpu, const Instruction &instr) {
+  const number imm5 = instr.imm;
+  const number Rn = instr.Rn;
+  const number Rt = instr.Rd;
+  const number addr = cpu->registers[Rn] + imm5;
+  cpu->registers[Rt] = cpu->readUint8(addr);
+}
+
+// LDRB (register)
+static void executeLDRBRegister(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rn = instr.Rn;
+  const number Rt = instr.Rd;
+  const number addr = cpu->registers[Rm] + cpu->registers[Rn];
+  cpu->registers[Rt] = cpu->readUint8(addr);
+}
+
+// LDRH (immediate)
+static void executeLDRHImmediate(CortexM0Core *cpu, const Instruction &instr) {
+  const number imm5 = instr.imm;
+  const number Rn = instr.Rn;
+  const number Rt = instr.Rd;
+  const number addr = cpu->registers[Rn] + (imm5 << 1);
+  cpu->registers[Rt] = cpu->readUint16(addr);
+}
+
+// LDRH (register)
+static void executeLDRHRegister(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rn = instr.Rn;
+  const number Rt = instr.Rd;
+  const number addr = cpu->registers[Rm] + cpu->registers[Rn];
+  cpu->registers[Rt] = cpu->readUint16(addr);
+}
+
+// LDRSB
+static void executeLDRSB(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rn = instr.Rn;
+  const number Rt = instr.Rd;
+  const number addr = cpu->registers[Rm] + cpu->registers[Rn];
+  cpu->registers[Rt] = cpu->signExtend8(cpu->readUint8(addr));
+}
+
+// LDRSH
+static void executeLDRSH(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rn = instr.Rn;
+  const number Rt = instr.Rd;
+  const number addr = cpu->registers[Rm] + cpu->registers[Rn];
+  cpu->registers[Rt] = cpu->signExtend16(cpu->readUint16(addr));
+}
+
+// LSLS (immediate)
+static void executeLSLSImmediate(CortexM0Core *cpu, const Instruction &instr) {
+  const number imm5 = instr.imm;
+  const number Rm = instr.Rm;
+  const number Rd = instr.Rd;
+  const number input = cpu->registers[Rm];
+  const number result = (uint32_t)(input << imm5);
+  cpu->registers[Rd] = result;
+  cpu->flags.setNZ(result);
+  if (imm5) {
+    cpu->flags.setC(input & (1 << (32 - imm5)));
+  }
+}
+
+// LSLS (register)
+static void executeLSLSRegister(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rdn = instr.Rd;
+  const number input = cpu->registers[Rdn];
+  const number shiftCount = cpu->registers[Rm] & 0xff;
+  const number result = shiftCount < 32 ? (uint32_t)(input << shiftCount) : 0;
+  cpu->registers[Rdn] = result;
+  cpu->flags.setNZ(result);
+  if (shiftCount) {
+    cpu->flags.setC(shiftCount <= 32 && ((input << shiftCount) & 0x100000000));
+  }
+}
+
+// LSRS (immediate)
+static void executeLSRSImmediate(CortexM0Core *cpu, const Instruction &instr) {
+  const number imm5 = instr.imm;
+  const number Rm = instr.Rm;
+  const number Rd = instr.Rd;
+  const number input = cpu->registers[Rm];
+  const number result = imm5 ? (uint32_t)input >> imm5 : 0;
+  cpu->registers[Rd] = result;
+  cpu->flags.setNZ(result);
+  cpu->flags.setC(((uint32_t)input >> (imm5 ? imm5 - 1 : 31)) & 0x1);
+}
+
+// LSRS (register)
+static void executeLSRSRegister(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rdn = instr.Rd;
+  const number shiftAmount = cpu->registers[Rm] & 0xff;
+  const number input = cpu->registers[Rdn];
+  const number result = shiftAmount < 32 ? input >> shiftAmount : 0;
+  cpu->registers[Rdn] = result;
+  cpu->flags.setNZ(result);
+  if (shiftAmount) {
+    cpu->flags.setC(shiftAmount <= 32 && ((input >> (shiftAmount - 1)) & 0x1));
+  }
+}
+
+// MOV
+static void executeMOV(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rd = instr.Rd;
+  cpu->registers[Rd] =
+      Rm == PC_REGISTER ? cpu->getPC() + 2 : cpu->registers[Rm];
+}
+
+// MOVS
+static void executeMOVS(CortexM0Core *cpu, const Instruction &instr) {
+  const number value = instr.imm;
+  const number Rd = instr.Rd;
+  cpu->registers[Rd] = value;
+  cpu->flags.setNZ(value);
+}
+
+// MRS
+static void executeMRS(CortexM0Core *cpu, const Instruction &instr) {
+  const number SYSm = instr.imm;
+  const number Rd = instr.Rd;
+  cpu->registers[Rd] = cpu->readSpecialRegister(SYSm);
+  cpu->setPC(cpu->getPC() + 2);
+}
+
+// MSR
+static void executeMSR(CortexM0Core *cpu, const Instruction &instr) {
+  const number SYSm = instr.imm;
+  const number Rn = instr.Rn;
+  cpu->writeSpecialRegister(SYSm, cpu->registers[Rn]);
+  cpu->setPC(cpu->getPC() + 2);
+}
+
+// MULS
+static void executeMULS(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rn = instr.Rn;
+  const number Rdm = instr.Rd;
+  const number result = (int)cpu->registers[Rn] * (int)cpu->registers[Rdm];
+  cpu->registers[Rdm] = result;
+  cpu->flags.setNZ(result);
+}
+
+// MVNS
+static void executeMVNS(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rd = instr.Rd;
+  const number result = ~cpu->registers[Rm];
+  cpu->registers[Rd] = result;
+  cpu->flags.setNZ(result);
+}
+
+// ORRS (Encoding T2)
+static void executeORRS(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rdn = instr.Rd;
+  const number result = cpu->registers[Rdn] | cpu->registers[Rm];
+  cpu->registers[Rdn] = result;
+  cpu->flags.setNZ(result);
+}
+
+// POP
+static void executePOP(CortexM0Core *cpu, const Instruction &instr) {
+  const number P = (instr.imm >> 8) & 1;
+  number address = cpu->getSP();
+  for (number i = 0; i <= 7; i++) {
+    if (instr.imm & (1 << i)) {
+      cpu->registers[i] = cpu->readUint32(address);
+      address += 4;
+    }
+  }
+  if (P) {
+    // SP is written back first, an exception return unstacks from it
+    const number pc = cpu->readUint32(address);
+    cpu->setSP(address + 4);
+    cpu->BXWritePC(pc);
+  } else {
+    cpu->setSP(address);
+  }
+}
+
+// PUSH
+static void executePUSH(CortexM0Core *cpu, const Instruction &instr) {
+  number bitCount = 0;
+  for (number i = 0; i <= 8; i++) {
+    if (instr.imm & (1 << i)) {
+      bitCount++;
+    }
+  }
+  number address = cpu->getSP() - 4 * bitCount;
+  for (number i = 0; i <= 7; i++) {
+    if (instr.imm & (1 << i)) {
+      cpu->writeUint32(address, cpu->registers[i]);
+      address += 4;
+    }
+  }
+  if (instr.imm & (1 << 8)) {
+    cpu->writeUint32(address, cpu->registers[14]);
+  }
+  cpu->setSP(cpu->getSP() - (4 * bitCount));
+}
+
+// REV
+static void executeREV(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rd = instr.Rd;
+  const number input = cpu->registers[Rm];
+  cpu->registers[Rd] =
+      ((input & 0xff) << 24) | (((input >> 8) & 0xff) << 16) |
+      (((input >> 16) & 0xff) << 8) | ((input >> 24) & 0xff);
+}
+
+// NEGS / RSBS
+static void executeRSBS(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rn = instr.Rn;
+  const number Rd = instr.Rd;
+  cpu->registers[Rd] = cpu->addWithCarry(~cpu->registers[Rn], 0, true);
+}
+
+// SBCS (Encoding T2)
+static void executeSBCS(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rdn = instr.Rd;
+  cpu->registers[Rdn] = cpu->addWithCarry(
+      cpu->registers[Rdn], ~cpu->registers[Rm], cpu->flags.getC());
+}
+
+// SEV
+static void executeSEV(CortexM0Core *cpu, const Instruction &instr) {
+  cpu->sendEvent();
+}
+
+// STMIA
+static void executeSTMIA(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rn = instr.Rn;
+  const number registers = instr.imm;
+  number address = cpu->registers[Rn];
+  for (number i = 0; i < 8; i++) {
+    if (registers & (1 << i)) {
+      cpu->writeUint32(address, cpu->registers[i]);
+      address += 4;
+    }
+  }
+  // Write back
+  if (!(registers & (1 << Rn))) {
+    cpu->registers[Rn] = address;
+  }
+}
+
+// STR (immediate)
+static void executeSTRImmediate(CortexM0Core *cpu, const Instruction &instr) {
+  const number imm5 = instr.imm << 2;
+  const number Rn = instr.Rn;
+  const number Rt = instr.Rd;
+  const number address = cpu->registers[Rn] + imm5;
+  cpu->writeUint32(address, cpu->registers[Rt]);
+}
+
+// STR (sp + immediate)
+static void executeSTRSPImmediate(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rt = instr.Rd;
+  const number imm8 = instr.imm;
+  const number address = cpu->getSP() + (imm8 << 2);
+  cpu->writeUint32(address, cpu->registers[Rt]);
+}
+
+// STR (register)
+static void executeSTRRegister(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rn = instr.Rn;
+  const number Rt = instr.Rd;
+  const number address = cpu->registers[Rm] + cpu->registers[Rn];
+  cpu->writeUint32(address, cpu->registers[Rt]);
+}
+
+// STRB (immediate)
+static void executeSTRBImmediate(CortexM0Core *cpu, const Instruction &instr) {
+  const number imm5 = instr.imm;
+  const number Rn = instr.Rn;
+  const number Rt = instr.Rd;
+  const number address = cpu->registers[Rn] + imm5;
+  cpu->writeUint8(address, cpu->registers[Rt]);
+}
+
+// STRB (register)
+static void executeSTRBRegister(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rn = instr.Rn;
+  const number Rt = instr.Rd;
+  const number addres = cpu->registers[Rm] + cpu->registers[Rn];
+  cpu->writeUint8(addres, cpu->registers[Rt]);
+}
+
+// STRH (immediate)
+static void executeSTRHImmediate(CortexM0Core *cpu, const Instruction &instr) {
+  const number imm5 = instr.imm << 1;
+  const number Rn = instr.Rn;
+  const number Rt = instr.Rd;
+  const number address = cpu->registers[Rn] + imm5;
+  cpu->writeUint16(address, cpu->registers[Rt]);
+}
+
+// STRH (register)
+static void executeSTRHRegister(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rn = instr.Rn;
+  const number Rt = instr.Rd;
+  const number addres = cpu->registers[Rm] + cpu->registers[Rn];
+  cpu->writeUint16(addres, cpu->registers[Rt]);
+}
+
+// SUB (SP minus immediate)
+static void executeSUBSPImmediate(CortexM0Core *cpu, const Instruction &instr) {
+  const number imm32 = instr.imm << 2;
+  cpu->setSP(cpu->getSP() - imm32);
+}
+
+// SUBS (Encoding T1)
+static void executeSUBSEncodingT1(CortexM0Core *cpu, const Instruction &instr) {
+  const number imm3 = instr.imm;
+  const number Rn = instr.Rn;
+  const number Rd = instr.Rd;
+  cpu->registers[Rd] = cpu->addWithCarry(cpu->registers[Rn], ~imm3, true);
+}
+
+// SUBS (Encoding T2)
+static void executeSUBSEncodingT2(CortexM0Core *cpu, const Instruction &instr) {
+  const number imm8 = instr.imm;
+  const number Rdn = instr.Rd;
+  cpu->registers[Rdn] = cpu->addWithCarry(cpu->registers[Rdn], ~imm8, true);
+}
+
+// SUBS (register)
+static void executeSUBSRegister(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rn = instr.Rn;
+  const number Rd = instr.Rd;
+  cpu->registers[Rd] =
+      cpu->addWithCarry(cpu->registers[Rn], ~cpu->registers[Rm], true);
+}
+
+// SVC
+static void executeSVC(CortexM0Core *cpu, const Instruction &instr) {
+  cpu->nvic.pendingSVCall = true;
+  cpu->interruptsUpdated = true;
+}
+
+// SXTB
+static void executeSXTB(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rd = instr.Rd;
+  cpu->registers[Rd] = cpu->signExtend8(cpu->registers[Rm]);
+}
+
+// TST
+static void executeTST(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rn = instr.Rn;
+  const number result = cpu->registers[Rn] & cpu->registers[Rm];
+  cpu->flags.setNZ(result);
+}
+
+// UDF
+static void executeUDF(CortexM0Core *cpu, const Instruction &instr) {
+  const number imm8 = instr.imm;
+  cpu->onBreak(imm8);
+}
+
+// UXTB
+static void executeUXTB(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rd = instr.Rd;
+  cpu->registers[Rd] = cpu->registers[Rm] & 0xff;
+}
+
+// UXTH
+static void executeUXTH(CortexM0Core *cpu, const Instruction &instr) {
+  const number Rm = instr.Rm;
+  const number Rd = instr.Rd;
+  cpu->registers[Rd] = cpu->registers[Rm] & 0xffff;
+}
+
+// WFE
+static void executeWFE(CortexM0Core *cpu, const Instruction &instr) {
+  cpu->waitForEvent();
+}
+
+// WFI
+static void executeWFI(CortexM0Core *cpu, const Instruction &instr) {
+  cpu->waitForInterrupt();
+}
+
+static void executeUnimplemented(CortexM0Core *cpu, const Instruction &instr) {
+  const number opcodePC = cpu->getPC() - 2;
+  cout << "Warning: Instruction at 0x" << hex << opcodePC
+       << " is not implemented yet!" << endl;
+  cout << "Opcode: 0x" << hex << instr.opcode << " (0x" << hex
+       << cpu->readUint16(cpu->getPC()) << ")" << endl;
+}
+
+// Only used to fill the decode table, the order of the checks matters
+static DecodeEntry decodeOpcode(number opcode) {
+  if (opcode >> 6 == 0b0100000101) {
+    return {executeADCS, FORMAT_RDN_RM};
+  }
+  if (opcode >> 11 == 0b10101) {
+    return {executeADDRegisterSPImmediate, FORMAT_RD_IMM8};
+  }
+  if (opcode >> 7 == 0b101100000) {
+    return {executeADDSPImmediate, FORMAT_IMM7};
+  }
+  if (opcode >> 9 == 0b0001110) {
+    return {executeADDSEncodingT1, FORMAT_RD_RN_IMM3};
+  }
+  if (opcode >> 11 == 0b00110) {
+    return {executeADDSEncodingT2, FORMAT_RD_IMM8};
+  }
+  if (opcode >> 9 == 0b0001100) {
+    return {executeADDSRegister, FORMAT_RD_RN_RM};
+  }
+  if (opcode >> 8 == 0b01000100) {
+    return {executeADDRegister, FORMAT_HIGH_REGISTERS};
+  }
+  if (opcode >> 11 == 0b10100) {
+    return {executeADR, FORMAT_RD_IMM8};
+  }
+  if (opcode >> 6 == 0b0100000000) {
+    return {executeANDS, FORMAT_RDN_RM};
+  }
+  if (opcode >> 11 == 0b00010) {
+    return {executeASRSImmediate, FORMAT_RD_RM_IMM5};
+  }
+  if (opcode >> 6 == 0b0100000100) {
+    return {executeASRSRegister, FORMAT_RDN_RM};
+  }
+  if (opcode >> 12 == 0b1101 && ((opcode >> 9) & 0x7) != 0b111) {
+    return {executeBConditional, FORMAT_BRANCH_CONDITIONAL};
+  }
+  if (opcode >> 11 == 0b11100) {
+    return {executeB, FORMAT_BRANCH};
+  }
+  if (opcode >> 6 == 0b0100001110) {
+    return {executeBICS, FORMAT_RDN_RM};
+  }
+  if (opcode >> 8 == 0b10111110) {
+    return {executeBKPT, FORMAT_IMM8};
+  }
+  if (opcode >> 11 == 0b11110) {
+    return {NULL, FORMAT_THUMB32};
+  }
+  if (opcode >> 7 == 0b010001111 && (opcode & 0x7) == 0) {
+    return {executeBLX, FORMAT_HIGH_REGISTERS};
+  }
+  if (opcode >> 7 == 0b010001110 && (opcode & 0x7) == 0) {
+    return {executeBX, FORMAT_HIGH_REGISTERS};
+  }
+  if (opcode >> 11 == 0b00101) {
+    return {executeCMPImmediate, FORMAT_RN_IMM8};
+  }
+  if (opcode >> 6 == 0b0100001010) {
+    return {executeCMPRegister, FORMAT_RN_RM};
+  }
+  if (opcode >> 8 == 0b01000101) {
+    return {executeCMPRegisterT2, FORMAT_HIGH_REGISTERS};
+  }
+  if (opcode == 0xb672) {
+    return {executeCPSID, FORMAT_NONE};
+  }
+  if (opcode == 0xb662) {
+    return {executeCPSIE, FORMAT_NONE};
+  }
+  if (opcode >> 6 == 0b0100000001) {
+    return {executeEORS, FORMAT_RDN_RM};
+  }
+  if (opcode >> 11 == 0b11001) {
+    return {executeLDMIA, FORMAT_RN_IMM8};
+  }
+  if (opcode >> 11 == 0b01101) {
+    return {executeLDRImmediate, FORMAT_RD_RN_IMM5};
+  }
+  if (opcode >> 11 == 0b10011) {
+    return {executeLDRSPImmediate, FORMAT_RD_IMM8};
+  }
+  if (opcode >> 11 == 0b01001) {
+    return {executeLDRLiteral, FORMAT_RD_IMM8};
+  }
+  if (opcode >> 9 == 0b0101100) {
+    return {executeLDRRegister, FORMAT_RD_RN_RM};
+  }
+  if (opcode >> 11 == 0b01111) {
+    return {executeLDRBImmediate, FORMAT_RD_RN_IMM5};
+  }
+  if (opcode >> 9 == 0b0101110) {
+    return {executeLDRBRegister, FORMAT_RD_RN_RM};
+  }
+  if (opcode >> 11 == 0b10001) {
+    return {executeLDRHImmediate, FORMAT_RD_RN_IMM5};
+  }
+  if (opcode >> 9 == 0b0101101) {
+    return {executeLDRHRegister, FORMAT_RD_RN_RM};
+  }
+  if (opcode >> 9 == 0b0101011) {
+    return {executeLDRSB, FORMAT_RD_RN_RM};
+  }
+  if (opcode >> 9 == 0b0101111) {
+    return {executeLDRSH, FORMAT_RD_RN_RM};
+  }
+  if (opcode >> 11 == 0b00000) {
+    return {executeLSLSImmediate, FORMAT_RD_RM_IMM5};
+  }
+  if (opcode >> 6 == 0b0100000010) {
+    return {executeLSLSRegister, FORMAT_RDN_RM};
+  }
+  if (opcode >> 11 == 0b00001) {
+    return {executeLSRSImmediate, FORMAT_RD_RM_IMM5};
+  }
+  if (opcode >> 6 == 0b0100000011) {
+    return {executeLSRSRegister, FORMAT_RDN_RM};
+  }
+  if (opcode >> 8 == 0b01000110) {
+    return {executeMOV, FORMAT_HIGH_REGISTERS};
+  }
+  if (opcode >> 11 == 0b00100) {
+    return {executeMOVS, FORMAT_RD_IMM8};
+  }
+  if (opcode >> 6 == 0b0100001101) {
+    return {executeMULS, FORMAT_RDN_RN};
+  }
+  if (opcode >> 6 == 0b0100001111) {
+    return {executeMVNS, FORMAT_RDN_RM};
+  }
+  if (opcode >> 6 == 0b0100001100) {
+    return {executeORRS, FORMAT_RDN_RM};
+  }
+  if (opcode >> 9 == 0b1011110) {
+    return {executePOP, FORMAT_REGISTER_LIST};
+  }
+  if (opcode >> 9 == 0b1011010) {
+    return {executePUSH, FORMAT_REGISTER_LIST};
+  }
+  if (opcode >> 6 == 0b1011101000) {
+    return {executeREV, FORMAT_RDN_RM};
+  }
+  if (opcode >> 6 == 0b0100001001) {
+    return {executeRSBS, FORMAT_RDN_RN};
+  }
+  if (opcode >> 6 == 0b0100000110) {
+    return {executeSBCS, FORMAT_RDN_RM};
+  }
+  if (opcode == 0b1011111101000000) {
+    return {executeSEV, FORMAT_NONE};
+  }
+  if (opcode >> 11 == 0b11000) {
+    return {executeSTMIA, FORMAT_RN_IMM8};
+  }
+  if (opcode >> 11 == 0b01100) {
+    return {executeSTRImmediate, FORMAT_RD_RN_IMM5};
+  }
+  if (opcode >> 11 == 0b10010) {
+    return {executeSTRSPImmediate, FORMAT_RD_IMM8};
+  }
+  if (opcode >> 9 == 0b0101000) {
+    return {executeSTRRegister, FORMAT_RD_RN_RM};
+  }
+  if (opcode >> 11 == 0b01110) {
+    return {executeSTRBImmediate, FORMAT_RD_RN_IMM5};
+  }
+  if (opcode >> 9 == 0b0101010) {
+    return {executeSTRBRegister, FORMAT_RD_RN_RM};
+  }
+  if (opcode >> 11 == 0b10000) {
+    return {executeSTRHImmediate, FORMAT_RD_RN_IMM5};
+  }
+  if (opcode >> 9 == 0b0101001) {
+    return {executeSTRHRegister, FORMAT_RD_RN_RM};
+  }
+  if (opcode >> 7 == 0b101100001) {
+    return {executeSUBSPImmediate, FORMAT_IMM7};
+  }
+  if (opcode >> 9 == 0b0001111) {
+    return {executeSUBSEncodingT1, FORMAT_RD_RN_IMM3};
+  }
+  if (opcode >> 11 == 0b00111) {
+    return {executeSUBSEncodingT2, FORMAT_RD_IMM8};
+  }
+  if (opcode >> 9 == 0b0001101) {
+    return {executeSUBSRegister, FORMAT_RD_RN_RM};
+  }
+  if (opcode >> 8 == 0b11011111) {
+    return {executeSVC, FORMAT_IMM8};
+  }
+  if (opcode >> 6 == 0b1011001001) {
+    return {executeSXTB, FORMAT_RDN_RM};
+  }
+  if (opcode >> 6 == 0b0100001000) {
+    return {executeTST, FORMAT_RN_RM};
+  }
+  if (opcode >> 8 == 0b11011110) {
+    return {executeUDF, FORMAT_IMM8};
+  }
+  if (opcode >> 6 == 0b1011001011) {
+    return {executeUXTB, FORMAT_RDN_RM};
+  }
+  if (opcode >> 6 == 0b1011001010) {
+    return {executeUXTH, FORMAT_RDN_RM};
+  }
+  if (opcode == 0b1011111100100000) {
+    return {executeWFE, FORMAT_NONE};
+  }
+  if (opcode == 0b1011111100110000) {
+    return {executeWFI, FORMAT_NONE};
+  }
+  return {executeUnimplemented, FORMAT_NONE};
+}
+
+// Cycles of a 16-bit instruction, from the Cortex-M0+ instruction timings.
+// The RP2040 has the single-cycle multiplier, and the bus adds no wait
+// states to the loads and stores.
+static uint8_t instructionCycles(InstructionHandler handler, number opcode) {
+  if (handler == executeLDMIA || handler == executeSTMIA) {
+    return 1 + popcount(opcode & 0xff);
+  }
+  if (handler == executePUSH) {
+    return 1 + popcount(opcode & 0x1ff);
+  }
+  if (handler == executePOP) {
+    // Popping the PC also refills the pipeline
+    return popcount(opcode & 0x1ff) + (opcode & 0x100 ? 3 : 1);
+  }
+  if (handler == executeADDRegister || handler == executeMOV) {
+    const bool writesPC = (opcode & 0x87) == 0x87;
+    return writesPC ? 2 : 1;
+  }
+  if (handler == executeB || handler == executeBX || handler == executeBLX ||
+      handler == executeWFE || handler == executeWFI) {
+    return 2;
+  }
+  for (InstructionHandler memoryAccess :
+       {executeLDRImmediate, executeLDRSPImmediate, executeLDRLiteral,
+        executeLDRRegister, executeLDRBImmediate, executeLDRBRegister,
+        executeLDRHImmediate, executeLDRHRegister, executeLDRSB, executeLDRSH,
+        executeSTRImmediate, executeSTRSPImmediate, executeSTRRegister,
+        executeSTRBImmediate, executeSTRBRegister, executeSTRHImmediate,
+        executeSTRHRegister}) {
+    if (handler == memoryAccess) {
+      return 2;
+    }
+  }
+  return 1;
+}
+
+static const DecodeEntry *buildDecodeTable() {
+  static DecodeEntry decodeTable[DECODE_TABLE_SIZE];
+  for (number opcode = 0; opcode < DECODE_TABLE_SIZE; opcode++) {
+    decodeTable[opcode] = decodeOpcode(opcode);
+    decodeTable[opcode].cycles =
+        instructionCycles(decodeTable[opcode].handler, opcode);
+  }
+  return decodeTable;
+}
+
+// BL, DMB, MRS and MSR share the 0b11110 prefix of the 32-bit encodings
+static void decodeThumb32(Instruction &instr) {
+  const number opcode = instr.opcode;
+  const number opcode2 = instr.opcode2;
+  if (opcode2 >> 14 == 0b11 && ((opcode2 >> 12) & 0x1) == 1) {
+    const number imm11 = opcode2 & 0x7ff;
+    const number J2 = (opcode2 >> 11) & 0x1;
+    const number J1 = (opcode2 >> 13) & 0x1;
+    const number imm10 = opcode & 0x3ff;
+    const number S = (opcode >> 10) & 0x1;
+    const number I1 = 1 - (S ^ J1);
+    const number I2 = 1 - (S ^ J2);
+    instr.handler = executeBL;
+    instr.cycles = 3;
+    instr.imm = ((S ? 0b11111111 : 0) << 24) |
+                ((I1 << 23) | (I2 << 22) | (imm10 << 12) | (imm11 << 1));
+  } else if (opcode == 0xf3bf && (opcode2 & 0xfff0) == 0x8f50) {
+    instr.handler = executeDMB;
+    instr.cycles = 3;
+  } else if (opcode == 0b1111001111101111 && opcode2 >> 12 == 0b1000) {
+    instr.handler = executeMRS;
+    instr.cycles = 3;
+    instr.Rd = (opcode2 >> 8) & 0xf;
+    instr.imm = opcode2 & 0xff;
+  } else if (opcode >> 4 == 0b111100111000 && opcode2 >> 8 == 0b10001000) {
+    instr.handler = executeMSR;
+    instr.cycles = 3;
+    instr.Rn = opcode & 0xf;
+    instr.imm = opcode2 & 0xff;
+  } else {
+    instr.handler = executeUnimplemented;
+  }
+}
+
+void CortexM0Core::decodeInstruction(number address, Instruction &instr) {
+  // ARM Thumb instruction encoding - 16 bits / 2 bytes
+  const number opcode = this->fetchUint16(address);
+  const DecodeEntry &entry = this->decodeTable[opcode];
+  instr = {entry.handler, (uint16_t)opcode, 0, 0, 0, 0, 0, 0, 2, entry.cycles};
+  switch (entry.format) {
+  case FORMAT_NONE:
+    break;
+  case FORMAT_RDN_RM:
+    instr.Rd = opcode & 0x7;
+    instr.Rm = (opcode >> 3) & 0x7;
+    break;
+  case FORMAT_RDN_RN:
+    instr.Rd = opcode & 0x7;
+    instr.Rn = (opcode >> 3) & 0x7;
+    break;
+  case FORMAT_RN_RM:
+    instr.Rn = opcode & 0x7;
+    instr.Rm = (opcode >> 3) & 0x7;
+    break;
+  case FORMAT_RD_RN_RM:
+    instr.Rd = opcode & 0x7;
+    instr.Rn = (opcode >> 3) & 0x7;
+    instr.Rm = (opcode >> 6) & 0x7;
+    break;
+  case FORMAT_RD_RN_IMM3:
+    instr.Rd = opcode & 0x7;
+    instr.Rn = (opcode >> 3) & 0x7;
+    instr.imm = (opcode >> 6) & 0x7;
+    break;
+  case FORMAT_RD_RN_IMM5:
+    instr.Rd = opcode & 0x7;
+    instr.Rn = (opcode >> 3) & 0x7;
+    instr.imm = (opcode >> 6) & 0x1f;
+    break;
+  case FORMAT_RD_RM_IMM5:
+    instr.Rd = opcode & 0x7;
+    instr.Rm = (opcode >> 3) & 0x7;
+    instr.imm = (opcode >> 6) & 0x1f;
+    break;
+  case FORMAT_RD_IMM8:
+    instr.Rd = (opcode >> 8) & 0x7;
+    instr.imm = opcode & 0xff;
+    break;
+  case FORMAT_RN_IMM8:
+    instr.Rn = (opcode >> 8) & 0x7;
+    instr.imm = opcode & 0xff;
+    break;
+  case FORMAT_HIGH_REGISTERS:
+    instr.Rd = ((opcode >> 4) & 0x8) | (opcode & 0x7);
+    instr.Rn = instr.Rd;
+    instr.Rm = (opcode >> 3) & 0xf;
+    break;
+  case FORMAT_IMM7:
+    instr.imm = opcode & 0x7f;
+    break;
+  case FORMAT_IMM8:
+    instr.imm = opcode & 0xff;
+    break;
+  case FORMAT_REGISTER_LIST:
+    instr.imm = opcode & 0x1ff;
+    break;
+  case FORMAT_BRANCH_CONDITIONAL:
+    instr.cond = (opcode >> 8) & 0xf;
+    instr.imm = (int8_t)(opcode & 0xff) * 2;
+    break;
+  case FORMAT_BRANCH:
+    instr.imm = opcode & 0x400 ? ((opcode & 0x7ff) << 1) - 0x1000
+                               : (opcode & 0x7ff) << 1;
+    break;
+  case FORMAT_THUMB32:
+    instr.opcode2 = this->fetchUint16(address + 2);
+    instr.size = 4;
+    decodeThumb32(instr);
+    break;
+  }
+}
+
+void CortexM0Core::advanceCycles(number cycles) {
+  this->cycles += cycles;
+  if (this->cycles >= this->eventDeadline.load(memory_order_relaxed)) {
+    this->rp2040->runScheduledEvents();
+  }
+}
+
+void CortexM0Core::executeInstruction() {
+  this->rp2040->setCurrentCore(this);
+  if (this->interruptsUpdated) {
+    this->checkForInterrupts();
+  }
+  const number address = this->getPC();
+  Instruction *instr = this->flashCache.lookup(address);
+  if (instr == NULL) {
+    instr = this->bootromCache.lookup(address);
+  }
+  Instruction uncached;
+  if (instr == NULL) {
+    instr = &uncached;
+    this->decodeInstruction(address, *instr);
+  } else if (instr->handler == NULL) {
+    this->decodeInstruction(address, *instr);
+  }
+  this->dispatchInstruction(address, *instr);
+}
+
+void CortexM0Core::dispatchInstruction(number address, Instruction &instr) {
+  // Copied, as a store to flash invalidates the cached instruction
+  const number cycles = instr.cycles;
+#ifdef RP2040_JIT
+  if (this->jitVerify) {
+    this->verifyInstruction(address, instr);
+    this->advanceCycles(cycles);
+    return;
+  }
+#endif
+  this->setPC(address + 2);
+  instr.handler(this, instr);
+  this->advanceCycles(cycles);
+}
+
+// Whether execution can continue with the next instruction in memory
+static bool endsBlock(const Instruction &instr) {
+  const InstructionHandler handler = instr.handler;
+  if (handler == executeADDRegister || handler == executeMOV) {
+    return instr.Rd == PC_REGISTER;
+  }
+  if (handler == executePOP) {
+    return instr.imm & (1 << 8);
+  }
+  return handler == executeB || handler == executeBConditional ||
+         handler == executeBL || handler == executeBLX ||
+         handler == executeBX || handler == executeSVC ||
+         handler == executeBKPT || handler == executeUDF ||
+         handler == executeWFE || handler == executeWFI ||
+         handler == executeUnimplemented;
+}
+
+// Only code in the bootrom and flash is translated, since these are the
+// only regions whose writes invalidate the block cache
+static bool isTranslatable(number address) {
+  return address < BOOT_ROM_B1_SIZE * 4 ||
+         (address >= FLASH_START_ADDRESS &&
+          address < FLASH_START_ADDRESS + FLASH_SIZE);
+}
+
+#ifdef RP2040_JIT
+static const struct {
+  InstructionHandler handler;
+  JIT_OPERATION operation;
+} jitOperations[] = {
+    {executeADCS, JIT_ADCS},
+    {executeADDRegisterSPImmediate, JIT_ADD_REGISTER_SP_IMMEDIATE},
+    {executeADDSPImmediate, JIT_ADD_SP_IMMEDIATE},
+    {executeADDSEncodingT1, JIT_ADDS_ENCODING_T1},
+    {executeADDSEncodingT2, JIT_ADDS_ENCODING_T2},
+    {executeADDSRegister, JIT_ADDS_REGISTER},
+    {executeADDRegister, JIT_ADD_REGISTER},
+    {executeADR, JIT_ADR},
+    {executeANDS, JIT_ANDS},
+    {executeASRSImmediate, JIT_ASRS_IMMEDIATE},
+    {executeBConditional, JIT_B_CONDITIONAL},
+    {executeB, JIT_B},
+    {executeBICS, JIT_BICS},
+    {executeBL, JIT_BL},
+    {executeCMPImmediate, JIT_CMP_IMMEDIATE},
+    {executeCMPRegister, JIT_CMP_REGISTER},
+    {executeCMPRegisterT2, JIT_CMP_REGISTER_T2},
+    {executeEORS, JIT_EORS},
+    {executeLDRImmediate, JIT_LDR_IMMEDIATE},
+    {executeLDRSPImmediate, JIT_LDR_SP_IMMEDIATE},
+    {executeLDRLiteral, JIT_LDR_LITERAL},
+    {executeLDRRegister, JIT_LDR_REGISTER},
+    {executeLDRBImmediate, JIT_LDRB_IMMEDIATE},
+    {executeLDRBRegister, JIT_LDRB_REGISTER},
+    {executeLDRHImmediate, JIT_LDRH_IMMEDIATE},
+    {executeLDRHRegister, JIT_LDRH_REGISTER},
+    {executeLDRSB, JIT_LDRSB},
+    {executeLDRSH, JIT_LDRSH},
+    {executeLSLSImmediate, JIT_LSLS_IMMEDIATE},
+    {executeLSRSImmediate, JIT_LSRS_IMMEDIATE},
+    {executeMOV, JIT_MOV},
+    {executeMOVS, JIT_MOVS},
+    {executeMULS, JIT_MULS},
+    {executeMVNS, JIT_MVNS},
+    {executeORRS, JIT_ORRS},
+    {executeREV, JIT_REV},
+    {executeRSBS, JIT_RSBS},
+    {executeSBCS, JIT_SBCS},
+    {executeSTRImmediate, JIT_STR_IMMEDIATE},
+    {executeSTRSPImmediate, JIT_STR_SP_IMMEDIATE},
+    {executeSTRRegister, JIT_STR_REGISTER},
+    {executeSTRBImmediate, JIT_STRB_IMMEDIATE},
+    {executeSTRBRegister, JIT_STRB_REGISTER},
+    {executeSTRHImmediate, JIT_STRH_IMMEDIATE},
+    {executeSTRHRegister, JIT_STRH_REGISTER},
+    {executeSUBSPImmediate, JIT_SUB_SP_IMMEDIATE},
+    {executeSUBSEncodingT1, JIT_SUBS_ENCODING_T1},
+    {executeSUBSEncodingT2, JIT_SUBS_ENCODING_T2},
+    {executeSUBSRegister, JIT_SUBS_REGISTER},
+    {executeSXTB, JIT_SXTB},
+    {executeTST, JIT_TST},
+    {executeUXTB, JIT_UXTB},
+    {executeUXTH, JIT_UXTH},
+};
+
+static JIT_OPERATION jitOperation(const Instruction &instr) {
+  for (const auto &entry : jitOperations) {
+    if (entry.handler == instr.handler) {
+      return entry.operation;
+    }
+  }
+  return JIT_UNSUPPORTED;
+}
+
+void CortexM0Core::compileBlock(Block *block) {
+  vector<JIT_OPERATION> operations;
+  for (const Instruction &instr : block->instructions) {
+    operations.push_back(jitOperation(instr));
+  }
+  block->native = this->jit.compile(this, block, operations);
+  if (block->native != NULL) {
+    this->blockCache.stats.compiledBlocks++;
+  }
+}
+
+// The address and size of the load or store of the compiled instruction at
+// `pc`, 0 for the other instructions
+static number jitAccess(CortexM0Core *cpu, JIT_OPERATION operation,
+                        const Instruction &instr, number pc,
+                        number *address) {
+  const uint32_t Rn = cpu->registers[instr.Rn];
+  const uint32_t Rm = cpu->registers[instr.Rm];
+  switch (operation) {
+  case JIT_LDR_IMMEDIATE:
+  case JIT_STR_IMMEDIATE:
+    *address = (uint32_t)(Rn + (instr.imm << 2));
+    return 4;
+  case JIT_LDR_SP_IMMEDIATE:
+  case JIT_STR_SP_IMMEDIATE:
+    *address = (uint32_t)(cpu->getSP() + (instr.imm << 2));
+    return 4;
+  case JIT_LDR_LITERAL:
+    *address = ((pc + 4) & 0xfffffffc) + (instr.imm << 2);
+    return 4;
+  case JIT_LDR_REGISTER:
+  case JIT_STR_REGISTER:
+    *address = (uint32_t)(Rn + Rm);
+    return 4;
+  case JIT_LDRB_IMMEDIATE:
+  case JIT_STRB_IMMEDIATE:
+    *address = (uint32_t)(Rn + instr.imm);
+    return 1;
+  case JIT_LDRB_REGISTER:
+  case JIT_STRB_REGISTER:
+  case JIT_LDRSB:
+    *address = (uint32_t)(Rn + Rm);
+    return 1;
+  case JIT_LDRH_IMMEDIATE:
+  case JIT_STRH_IMMEDIATE:
+    *address = (uint32_t)(Rn + (instr.imm << 1));
+    return 2;
+  case JIT_LDRH_REGISTER:
+  case JIT_STRH_REGISTER:
+  case JIT_LDRSH:
+    *address = (uint32_t)(Rn + Rm);
+    return 2;
+  default:
+    return 0;
+  }
+}
+
+static bool jitStores(JIT_OPERATION operation) {
+  return operation == JIT_STR_IMMEDIATE || operation == JIT_STR_SP_IMMEDIATE ||
+         operation == JIT_STR_REGISTER || operation == JIT_STRB_IMMEDIATE ||
+         operation == JIT_STRB_REGISTER || operation == JIT_STRH_IMMEDIATE ||
+         operation == JIT_STRH_REGISTER;
+}
+
+// Runs `instr` as a one instruction native block first, then restores the
+// state and runs it through the interpreter. Instructions accessing the
+// peripherals or storing to flash only run through the interpreter, as
+// their accesses can't be repeated. `instr` is a copy since a store to
+// flash invalidates the cached one.
+void CortexM0Core::verifyInstruction(number address, Instruction instr) {
+  const JIT_OPERATION operation = jitOperation(instr);
+  // The host memory the instruction stores to, if any
+  uint8_t none[4];
+  uint8_t *stored = none;
+  number storeSize = 0;
+  number access = 0;
+  const number size = jitAccess(this, operation, instr, address, &access);
+  if (size != 0) {
+    const MemoryPage &first = this->rp2040->memoryMap.lookup(access);
+    const MemoryPage &last =
+        this->rp2040->memoryMap.lookup(access + size - 1);
+    const bool store = jitStores(operation);
+    if ((store ? first.write : first.read) == NULL ||
+        (store ? last.write : last.read) == NULL) {
+      this->setPC(address + 2);
+      instr.handler(this, instr);
+      return;
+    }
+    if (store) {
+      stored = first.write + (access & MEMORY_PAGE_MASK);
+      storeSize = size;
+    }
+  }
+  Block block{address, address + instr.size, true, {instr}};
+  // Only the code of the instruction verified is kept
+  this->verifyJit.reset();
+  NativeBlock native = this->verifyJit.compile(this, &block, {operation});
+  if (native == NULL) {
+    this->setPC(address + 2);
+    instr.handler(this, instr);
+    return;
+  }
+  uint32_t registers[16];
+  this->flags.evaluate();
+  const ConditionFlags flags = this->flags;
+  uint8_t memory[4];
+  memcpy(memory, stored, storeSize);
+  memcpy(registers, this->registers, sizeof(registers));
+
+  this->nativeCycles = 0;
+  const bool completed = (native(this) & 0xff) != 0;
+  uint32_t nativeRegisters[16];
+  const bool nativeFlags[4] = {this->N, this->Z, this->C, this->V};
+  uint8_t nativeMemory[4];
+  memcpy(nativeMemory, stored, storeSize);
+  memcpy(nativeRegisters, this->registers, sizeof(registers));
+
+  memcpy(this->registers, registers, sizeof(registers));
+  this->flags = flags;
+  memcpy(stored, memory, storeSize);
+  this->setPC(address + 2);
+  instr.handler(this, instr);
+  if (!completed) {
+    // The native code left the instruction to the interpreter
+    return;
+  }
+
+  const bool interpreterFlags[4] = {this->N, this->Z, this->C, this->V};
+  bool matches = memcmp(nativeRegisters, this->registers,
+                        sizeof(registers)) == 0 &&
+                 memcmp(nativeMemory, stored, storeSize) == 0;
+  for (number i = 0; i < 4; i++) {
+    matches = matches && nativeFlags[i] == interpreterFlags[i];
+  }
+  if (!matches) {
+    cerr << "[JIT] opcode 0x" << hex << instr.opcode << " at 0x" << address
+         << " differs from the interpreter" << endl;
+    for (number i = 0; i < 16; i++) {
+      if (nativeRegisters[i] != this->registers[i]) {
+        cerr << "  r" << dec << i << ": native 0x" << hex
+             << nativeRegisters[i] << ", interpreter 0x" << this->registers[i]
+             << endl;
+      }
+    }
+    const char *names = "NZCV";
+    for (number i = 0; i < 4; i++) {
+      if (nativeFlags[i] != interpreterFlags[i]) {
+        cerr << "  " << names[i] << ": native " << nativeFlags[i]
+             << ", interpreter " << interpreterFlags[i] << endl;
+      }
+    }
+    throw new runtime_error("JIT and interpreter results differ");
+  }
+}
+#endif
+
+Block *CortexM0Core::translateBlock(number address) {
+  Block *block = new Block{address, address, true, {}};
+  Instruction instr;
+  while (block->instructions.size() < MAX_BLOCK_INSTRUCTIONS &&
+         isTranslatable(block->endAddress)) {
+    this->decodeInstruction(block->endAddress, instr);
+    block->instructions.push_back(instr);
+    block->endAddress += instr.size;
+    block->cycles += instr.cycles;
+    if (endsBlock(instr)) {
+      break;
+    }
+  }
+  block->takenCycles = block->cycles;
+  if (!block->instructions.empty() &&
+      block->instructions.back().handler == executeBConditional) {
+    block->takenCycles++;
+  }
+  this->blockCache.insert(block);
+  return block;
+}
+
+number CortexM0Core::executeBlock() {
+  this->rp2040->setCurrentCore(this);
+  if (this->interruptsUpdated) {
+    this->checkForInterrupts();
+  }
+  const number address = this->getPC();
+  if (!isTranslatable(address)) {
+    // Code in SRAM isn't cached, it is decoded each time it runs
+    Instruction instr;
+    this->decodeInstruction(address, instr);
+    this->dispatchInstruction(address, instr);
+    this->blockCache.stats.steppedInstructions++;
+    return 1;
+  }
+  Block *block = this->blockCache.lookup(address);
+  if (block == NULL) {
+    block = this->translateBlock(address);
+  }
+  number first = 0;
+  number count = 0;
+#ifdef RP2040_JIT
+  if (block->native != NULL) {
+    // Native code keeps the flags as bools
+    this->flags.evaluate();
+    this->nativeCycles = 0;
+    const uint64_t result = block->native(this);
+    const number iterations = result >> 8;
+    first = result & 0xff;
+    count = iterations * block->instructions.size() + first;
+    // Each iteration ended with the branch back to the block taken
+    number cycles = iterations * block->takenCycles;
+    for (number i = 0; i < first; i++) {
+      cycles += block->instructions[i].cycles;
+    }
+    if (first == block->instructions.size() &&
+        this->getPC() != block->endAddress) {
+      cycles += block->takenCycles - block->cycles;
+    }
+    this->advanceCycles(cycles - this->nativeCycles);
+    this->blockCache.stats.nativeInstructions += count;
+  } else if (++block->executionCount == JIT_THRESHOLD) {
+    this->compileBlock(block);
+  }
+#endif
+  // Each handler finds the PC pointing past its first halfword, the 32-bit
+  // ones skip the second halfword themselves. The clock advances after each
+  // instruction, as the peripherals they access read it.
+  for (number i = first; i < block->instructions.size(); i++) {
+    const Instruction &instr = block->instructions[i];
+    this->registers[PC_REGISTER] += 2;
+    instr.handler(this, instr);
+    this->advanceCycles(instr.cycles);
+  }
+  count += block->instructions.size() - first;
+  this->blockCache.stats.blockInstructions += count;
+  return count;
+}
+
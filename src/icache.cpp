@@ -0,0 +1,50 @@
+#include "icache.h"
+
+InstructionCache::InstructionCache(number baseAddress, number size) {
+  this->baseAddress = baseAddress;
+  this->size = size;
+  this->pages.assign(size >> ICACHE_PAGE_SHIFT, NULL);
+}
+
+InstructionCache::~InstructionCache() {
+  for (Instruction *page : this->pages) {
+    delete[] page;
+  }
+}
+
+Instruction *InstructionCache::allocatePage(number pageIndex) {
+  this->pages[pageIndex] = new Instruction[ICACHE_PAGE_ENTRIES]();
+  return this->pages[pageIndex];
+}
+
+void InstructionCache::invalidatePage(number pageIndex) {
+  Instruction *page = this->pages[pageIndex];
+  if (page == NULL) {
+    return;
+  }
+  // Only the handlers are cleared: a handler that writes to its own page
+  // keeps reading valid operand fields until it returns.
+  for (number index = 0; index < ICACHE_PAGE_ENTRIES; index++) {
+    page[index].handler = NULL;
+  }
+}
+
+void InstructionCache::invalidate(number address) {
+  const number offset = address - this->baseAddress;
+  if (offset >= this->size) {
+    return;
+  }
+  const number pageIndex = offset >> ICACHE_PAGE_SHIFT;
+  this->invalidatePage(pageIndex);
+  // A 32-bit instruction may start in the last halfword of the previous page
+  if ((offset & (ICACHE_PAGE_SIZE - 1)) < 4 && pageIndex > 0 &&
+      this->pages[pageIndex - 1] != NULL) {
+    this->pages[pageIndex - 1][ICACHE_PAGE_ENTRIES - 1].handler = NULL;
+  }
+}
+
+void InstructionCache::invalidateAll() {
+  for (number pageIndex = 0; pageIndex < this->pages.size(); pageIndex++) {
+    this->invalidatePage(pageIndex);
+  }
+}
@@ -0,0 +1,78 @@
+#ifndef __BLOCK_CACHE_H__
+#define __BLOCK_CACHE_H__
+
+#include "icache.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+typedef uint64_t number;
+
+using namespace std;
+
+const number BLOCK_CACHE_SLOTS = 16384;
+// Longest straight-line run translated into a single block
+const number MAX_BLOCK_INSTRUCTIONS = 64;
+
+// Native code of a block, see jit.h. Returns the loop iterations it ran,
+// shifted left by 8, or'ed with the index of the first instruction it left
+// to the interpreter.
+typedef uint64_t (*NativeBlock)(CortexM0Core *cpu);
+
+// Straight-line Thumb code from `address` up to (and including) the first
+// instruction that may change the PC, translated once
+struct Block {
+  number address;
+  number endAddress;
+  bool valid;
+  vector<Instruction> instructions;
+  // Cycles of one run through the block, and of one ending with its
+  // conditional branch taken
+  number cycles = 0;
+  number takenCycles = 0;
+  // Number of times the block ran, to find the hot ones
+  uint32_t executionCount = 0;
+  NativeBlock native = NULL;
+};
+
+struct BlockCacheStats {
+  number hits = 0;
+  number misses = 0;
+  number invalidations = 0;
+  // Instructions executed from cached blocks
+  number blockInstructions = 0;
+  // Instructions executed one at a time, e.g. from SRAM
+  number steppedInstructions = 0;
+  // Blocks compiled to native code and the instructions they executed
+  number compiledBlocks = 0;
+  number nativeInstructions = 0;
+};
+
+// Direct-mapped cache of translated blocks, indexed by their start address
+class BlockCache {
+private:
+  Block *slots[BLOCK_CACHE_SLOTS] = {NULL};
+  number blockCount = 0;
+
+public:
+  BlockCacheStats stats;
+
+  ~BlockCache();
+
+  Block *lookup(number address) {
+    Block *block = this->slots[(address >> 1) & (BLOCK_CACHE_SLOTS - 1)];
+    if (block != NULL && block->address == address && block->valid) {
+      this->stats.hits++;
+      return block;
+    }
+    return NULL;
+  }
+
+  // Takes ownership of `block`, evicting the block in the same slot
+  void insert(Block *block);
+  // Invalidates the blocks overlapping the word at `address`
+  void invalidate(number address);
+  void invalidateAll();
+};
+
+#endif
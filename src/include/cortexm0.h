@@ -0,0 +1,245 @@
+#ifndef __CORTEXM0_H__
+#define __CORTEXM0_H__
+
+#include "blockcache.h"
+#include "bootrom.h"
+#include "flags.h"
+#include "icache.h"
+#include "jit.h"
+#include "nvic.h"
+#include "scheduler.h"
+#include <atomic>
+#include <cstdint>
+
+typedef uint64_t number;
+
+using namespace std;
+
+class RP2040;
+
+const number SYSM_APSR = 0;
+const number SYSM_IAPSR = 1;
+const number SYSM_EAPSR = 2;
+const number SYSM_XPSR = 3;
+const number SYSM_IPSR = 5;
+const number SYSM_EPSR = 6;
+const number SYSM_IEPSR = 7;
+const number SYSM_MSP = 8;
+const number SYSM_PSP = 9;
+const number SYSM_PRIMASK = 16;
+const number SYSM_CONTROL = 20;
+
+enum EXECUTION_MODE { MODE_THREAD, MODE_HANDLER };
+
+const number PC_REGISTER = 15;
+
+enum STACK_POINTER_BANK { SP_MAIN, SP_PROCESS };
+
+// Operand layouts of the Thumb encodings, used to fill an Instruction
+enum OPERAND_FORMAT {
+  FORMAT_NONE,
+  FORMAT_RDN_RM,             // Rd = [2:0], Rm = [5:3]
+  FORMAT_RDN_RN,             // Rd = [2:0], Rn = [5:3]
+  FORMAT_RN_RM,              // Rn = [2:0], Rm = [5:3]
+  FORMAT_RD_RN_RM,           // Rd = [2:0], Rn = [5:3], Rm = [8:6]
+  FORMAT_RD_RN_IMM3,         // Rd = [2:0], Rn = [5:3], imm = [8:6]
+  FORMAT_RD_RN_IMM5,         // Rd = [2:0], Rn = [5:3], imm = [10:6]
+  FORMAT_RD_RM_IMM5,         // Rd = [2:0], Rm = [5:3], imm = [10:6]
+  FORMAT_RD_IMM8,            // Rd = [10:8], imm = [7:0]
+  FORMAT_RN_IMM8,            // Rn = [10:8], imm = [7:0]
+  FORMAT_HIGH_REGISTERS,     // Rd = Rn = [7]:[2:0], Rm = [6:3]
+  FORMAT_IMM7,               // imm = [6:0]
+  FORMAT_IMM8,               // imm = [7:0]
+  FORMAT_REGISTER_LIST,      // imm = [8:0]
+  FORMAT_BRANCH_CONDITIONAL, // cond = [11:8], imm = offset
+  FORMAT_BRANCH,             // imm = offset
+  FORMAT_THUMB32,            // resolved together with the second halfword
+};
+
+// r0-r3, r12, LR, the return address and xPSR
+const number EXCEPTION_FRAME_WORDS = 8;
+// The 16 system exception vectors and those of the 32 external interrupts
+const number VECTOR_TABLE_SIZE = 4 * (16 + 32);
+// Cycles the Cortex-M0+ takes to stack the frame and fetch the vector.
+// Returning unstacks the same eight words and is counted the same.
+const number EXCEPTION_ENTRY_CYCLES = 15;
+const number EXCEPTION_RETURN_CYCLES = 15;
+
+// Every 16-bit Thumb halfword maps to one of these entries
+struct DecodeEntry {
+  InstructionHandler handler;
+  OPERAND_FORMAT format;
+  // Cortex-M0+ execution time, see instructionCycles()
+  uint8_t cycles;
+};
+const number DECODE_TABLE_SIZE = 0x10000;
+
+// One of the two Cortex-M0+ cores: its registers, exception state and NVIC,
+// and the decoded code it runs. Both cores share the bus of the RP2040.
+class CortexM0Core {
+private:
+  number bankedSP = 0;
+
+  const DecodeEntry *decodeTable;
+
+  Block *translateBlock(number address);
+  // Runs the instruction at `address`, already decoded into `instr`
+  void dispatchInstruction(number address, Instruction &instr);
+
+  // Host memory of the region instructions were last fetched from, covering
+  // [fetchStart, fetchEnd) of the address space
+  const uint8_t *fetchMemory = NULL;
+  number fetchStart = 0;
+  number fetchEnd = 0;
+  bool resolveFetchRegion(number address);
+#ifdef RP2040_JIT
+  void compileBlock(Block *block);
+  void verifyInstruction(number address, Instruction instr);
+#endif
+
+  // Host memory of the exception frame at `address`, NULL unless the whole
+  // frame is in SRAM
+  uint8_t *exceptionFrameMemory(number address);
+  void writeExceptionFrame(number address, const uint32_t *frame);
+  void readExceptionFrame(number address, uint32_t *frame);
+
+  // Host memory of the vector table VTOR pointed to when it was last used,
+  // NULL if the table can't be read directly
+  number vectorTableAddress = ~(number)0;
+  const uint8_t *vectorTable = NULL;
+  number readVector(number exceptionNumber);
+
+  number breakCount = 0;
+
+  EXECUTION_MODE currentMode = MODE_THREAD;
+
+public:
+  RP2040 *rp2040;
+  // The CPUID the core reads from the SIO
+  const number id;
+
+  uint32_t registers[16] = {
+      0x00,
+  };
+
+  // Code running from the bootrom and flash is decoded only once. Writes
+  // through writeUint32() invalidate it, direct writes to `bootrom` or
+  // `flash` after the code has run need invalidateAll().
+  InstructionCache bootromCache;
+  InstructionCache flashCache;
+  BlockCache blockCache;
+#ifdef RP2040_JIT
+  JitCompiler jit;
+  // Cycles of the running native block its loads and stores already added
+  // to `cycles`
+  number nativeCycles = 0;
+  // Differential testing: executeInstruction() also runs each instruction
+  // through the JIT and fails if the results differ. Enabled by setting
+  // RP2040_JIT_VERIFY in the environment.
+  bool jitVerify = false;
+  // Compiles the instructions verified, one at a time
+  JitCompiler verifyJit;
+#endif
+
+  // APSR fields. The instruction handlers go through `flags` directly; N, Z,
+  // C and V read and write it like plain bools.
+  ConditionFlags flags;
+  FlagReference N{this->flags, FLAG_NEGATIVE};
+  FlagReference C{this->flags, FLAG_CARRY};
+  FlagReference Z{this->flags, FLAG_ZERO};
+  FlagReference V{this->flags, FLAG_OVERFLOW};
+
+  // PRIMASK fields
+  bool PM = false;
+
+  // CONTROL fields
+  STACK_POINTER_BANK SPSEL = SP_MAIN;
+  bool nPRIV = false;
+
+  number IPSR = 0;
+  NVIC nvic;
+  // Set when an exception may have become ready to take, checked before the
+  // next instruction. Atomic, as the other core raises SIO interrupts and
+  // events from its own thread when RP2040::threaded is set.
+  atomic<bool> interruptsUpdated = false;
+
+  // Set by SEV on either core, cleared by WFE
+  atomic<bool> eventRegister = false;
+  // Sleeping in WFE until an event or an interrupt arrives
+  atomic<bool> waiting = false;
+
+  // Simulated clk_sys cycles the core ran for, or slept through in WFE
+  number cycles = 0;
+  // Cycle at which the scheduler has an event due. Only core 0 runs the
+  // events, the deadline of core 1 stays NO_DEADLINE. Atomic, as core 1
+  // schedules events from its own thread when RP2040::threaded is set.
+  atomic<number> eventDeadline = NO_DEADLINE;
+
+  // M0Plus built-in registers
+  number VTOR = 0;
+  number SCR = 0;
+
+  number signExtend8(number value);
+  number signExtend16(number value);
+
+  // Debugging
+  void onBreak(number code);
+  uint64_t getBreakCount();
+
+  CortexM0Core(RP2040 *rp2040, number id);
+  void reset();
+
+  number getSP();
+  void setSP(number value);
+  number getLR();
+  void setLR(number value);
+  number getPC();
+  void setPC(number value);
+
+  number getAPSR();
+  void setAPSR(number value);
+  number getxPSR();
+  void setxPSR(number value);
+
+  number addWithCarry(number x, number y, bool carryIn);
+  bool checkCondition(number cond);
+  // Bus accesses, through the RP2040
+  number readUint32(number address);
+  number readUint16(number address);
+  number readUint8(number address);
+  void writeUint32(number address, number value);
+  void writeUint16(number address, number value);
+  void writeUint8(number address, number value);
+  // Instruction fetch: reads straight from the bootrom, flash or SRAM
+  // without going through the bus
+  number fetchUint16(number address);
+  // Drops the code decoded from the word at `address`
+  void invalidateCode(number address);
+
+  void switchStack(STACK_POINTER_BANK stack);
+  number getSPprocess();
+  void setSPprocess(number value);
+  number getSPmain();
+  void setSPmain(number value);
+  void exceptionEntry(number exceptionNumber);
+  void exceptionReturn(number excReturn);
+  void setInterrupt(number irq, bool value);
+  void checkForInterrupts();
+  number readSpecialRegister(number sysm);
+  void writeSpecialRegister(number sysm, number value);
+  void BXWritePC(number address);
+
+  // Sets the event register of both cores, waking them from WFE
+  void sendEvent();
+  void waitForEvent();
+  // Sleeps until an interrupt is pending, even one masked by PRIMASK
+  void waitForInterrupt();
+
+  void decodeInstruction(number address, Instruction &instr);
+  void executeInstruction();
+  number executeBlock();
+  // Lets `cycles` pass on the clock of the core
+  void advanceCycles(number cycles);
+};
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef __FLAGS_H__
+#define __FLAGS_H__
+
+#include <cstdint>
+
+enum APSR_FLAG {
+  FLAG_NEGATIVE,
+  FLAG_ZERO,
+  FLAG_CARRY,
+  FLAG_OVERFLOW,
+};
+
+// The APSR condition flags, evaluated lazily. Most flag setting instructions
+// are followed by another one before anything reads the flags, so they only
+// record their result (and the operands of an addition); N, Z, C and V are
+// worked out when a condition, the APSR or an exception frame needs them.
+class ConditionFlags {
+public:
+  // The flags as bools. N and Z are only valid when `lazyNZ` is false, C and
+  // V only when `lazyCV` is false. The JIT reads and writes these directly.
+  bool negative = false;
+  bool zero = false;
+  bool carry = false;
+  bool overflow = false;
+
+  // N and Z come from `result`
+  bool lazyNZ = false;
+  // C and V come from `x + y + carryIn`
+  bool lazyCV = false;
+  uint32_t result = 0;
+  uint32_t x = 0;
+  uint32_t y = 0;
+  bool carryIn = false;
+
+  inline void setNZ(uint32_t result) {
+    this->result = result;
+    this->lazyNZ = true;
+  }
+
+  // Sets N and Z from `result` and C and V from the AddWithCarry() that
+  // produced it
+  inline void setAdd(uint32_t result, uint32_t x, uint32_t y, bool carryIn) {
+    this->result = result;
+    this->x = x;
+    this->y = y;
+    this->carryIn = carryIn;
+    this->lazyNZ = true;
+    this->lazyCV = true;
+  }
+
+  inline bool getN() const {
+    return this->lazyNZ ? this->result >> 31 : this->negative;
+  }
+
+  inline bool getZ() const {
+    return this->lazyNZ ? this->result == 0 : this->zero;
+  }
+
+  inline bool getC() const {
+    if (this->lazyCV) {
+      return ((uint64_t)this->x + this->y + this->carryIn) >> 32;
+    }
+    return this->carry;
+  }
+
+  inline bool getV() const {
+    if (this->lazyCV) {
+      const uint32_t sum = this->x + this->y + this->carryIn;
+      return ((this->x ^ sum) & (this->y ^ sum)) >> 31;
+    }
+    return this->overflow;
+  }
+
+  inline void setN(bool value) {
+    this->evaluateNZ();
+    this->negative = value;
+  }
+
+  inline void setZ(bool value) {
+    this->evaluateNZ();
+    this->zero = value;
+  }
+
+  inline void setC(bool value) {
+    this->evaluateCV();
+    this->carry = value;
+  }
+
+  inline void setV(bool value) {
+    this->evaluateCV();
+    this->overflow = value;
+  }
+
+  inline void setAll(bool negative, bool zero, bool carry, bool overflow) {
+    this->negative = negative;
+    this->zero = zero;
+    this->carry = carry;
+    this->overflow = overflow;
+    this->lazyNZ = false;
+    this->lazyCV = false;
+  }
+
+  // Stores all four flags as bools
+  inline void evaluate() {
+    this->evaluateNZ();
+    this->evaluateCV();
+  }
+
+  bool get(APSR_FLAG flag) const {
+    switch (flag) {
+    case FLAG_NEGATIVE:
+      return this->getN();
+    case FLAG_ZERO:
+      return this->getZ();
+    case FLAG_CARRY:
+      return this->getC();
+    default:
+      return this->getV();
+    }
+  }
+
+  void set(APSR_FLAG flag, bool value) {
+    switch (flag) {
+    case FLAG_NEGATIVE:
+      this->setN(value);
+      break;
+    case FLAG_ZERO:
+      this->setZ(value);
+      break;
+    case FLAG_CARRY:
+      this->setC(value);
+      break;
+    default:
+      this->setV(value);
+      break;
+    }
+  }
+
+private:
+  inline void evaluateNZ() {
+    if (this->lazyNZ) {
+      this->negative = this->getN();
+      this->zero = this->getZ();
+      this->lazyNZ = false;
+    }
+  }
+
+  inline void evaluateCV() {
+    if (this->lazyCV) {
+      this->carry = this->getC();
+      this->overflow = this->getV();
+      this->lazyCV = false;
+    }
+  }
+};
+
+// Reads and writes one of the condition flags as if it were a plain bool
+class FlagReference {
+private:
+  ConditionFlags &flags;
+  const APSR_FLAG flag;
+
+public:
+  FlagReference(ConditionFlags &flags, APSR_FLAG flag)
+      : flags(flags), flag(flag) {}
+
+  operator bool() const { return this->flags.get(this->flag); }
+
+  FlagReference &operator=(bool value) {
+    this->flags.set(this->flag, value);
+    return *this;
+  }
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef __ICACHE_H__
+#define __ICACHE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+typedef uint64_t number;
+
+using namespace std;
+
+class CortexM0Core;
+struct Instruction;
+
+typedef void (*InstructionHandler)(CortexM0Core *cpu,
+                                   const Instruction &instr);
+
+// A Thumb instruction with its operand fields already extracted.
+// `Rd` also holds Rdn, Rdm and Rt, `imm` holds immediates, register lists
+// and sign-extended branch offsets.
+struct Instruction {
+  InstructionHandler handler;
+  uint16_t opcode;
+  uint16_t opcode2;
+  uint8_t Rd;
+  uint8_t Rn;
+  uint8_t Rm;
+  uint8_t cond;
+  uint32_t imm;
+  // Size of the encoding in bytes
+  uint8_t size;
+  // Execution time, with conditional branches counted as not taken
+  uint8_t cycles;
+};
+
+const number ICACHE_PAGE_SHIFT = 12;
+const number ICACHE_PAGE_SIZE = 1 << ICACHE_PAGE_SHIFT;
+const number ICACHE_PAGE_ENTRIES = ICACHE_PAGE_SIZE / 2;
+
+// Predecoded instructions of a memory region, one entry per halfword.
+// Pages are allocated the first time code runs from them.
+class InstructionCache {
+private:
+  number baseAddress;
+  number size;
+  vector<Instruction *> pages;
+
+  Instruction *allocatePage(number pageIndex);
+  void invalidatePage(number pageIndex);
+
+public:
+  InstructionCache(number baseAddress, number size);
+  ~InstructionCache();
+
+  // Returns the cache entry for `address`, or NULL when the address is
+  // outside of the cached region. Entries with a NULL handler still need
+  // to be decoded.
+  Instruction *lookup(number address) {
+    const number offset = address - this->baseAddress;
+    if (offset >= this->size) {
+      return NULL;
+    }
+    Instruction *page = this->pages[offset >> ICACHE_PAGE_SHIFT];
+    if (page == NULL) {
+      page = this->allocatePage(offset >> ICACHE_PAGE_SHIFT);
+    }
+    return &page[(offset & (ICACHE_PAGE_SIZE - 1)) >> 1];
+  }
+
+  void invalidate(number address);
+  void invalidateAll();
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef __JIT_H__
+#define __JIT_H__
+
+#include "blockcache.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+typedef uint64_t number;
+
+using namespace std;
+
+class CortexM0Core;
+
+// Instructions the JIT can compile. The native code of a block stops at the
+// first instruction it can't compile and leaves the rest to the interpreter.
+enum JIT_OPERATION {
+  JIT_UNSUPPORTED,
+  JIT_ADCS,
+  JIT_ADD_REGISTER_SP_IMMEDIATE,
+  JIT_ADD_SP_IMMEDIATE,
+  JIT_ADDS_ENCODING_T1,
+  JIT_ADDS_ENCODING_T2,
+  JIT_ADDS_REGISTER,
+  JIT_ADD_REGISTER,
+  JIT_ADR,
+  JIT_ANDS,
+  JIT_ASRS_IMMEDIATE,
+  JIT_B_CONDITIONAL,
+  JIT_B,
+  JIT_BICS,
+  JIT_BL,
+  JIT_CMP_IMMEDIATE,
+  JIT_CMP_REGISTER,
+  JIT_CMP_REGISTER_T2,
+  JIT_EORS,
+  JIT_LDR_IMMEDIATE,
+  JIT_LDR_SP_IMMEDIATE,
+  JIT_LDR_LITERAL,
+  JIT_LDR_REGISTER,
+  JIT_LDRB_IMMEDIATE,
+  JIT_LDRB_REGISTER,
+  JIT_LDRH_IMMEDIATE,
+  JIT_LDRH_REGISTER,
+  JIT_LDRSB,
+  JIT_LDRSH,
+  JIT_LSLS_IMMEDIATE,
+  JIT_LSRS_IMMEDIATE,
+  JIT_MOV,
+  JIT_MOVS,
+  JIT_MULS,
+  JIT_MVNS,
+  JIT_ORRS,
+  JIT_REV,
+  JIT_RSBS,
+  JIT_SBCS,
+  JIT_STR_IMMEDIATE,
+  JIT_STR_SP_IMMEDIATE,
+  JIT_STR_REGISTER,
+  JIT_STRB_IMMEDIATE,
+  JIT_STRB_REGISTER,
+  JIT_STRH_IMMEDIATE,
+  JIT_STRH_REGISTER,
+  JIT_SUB_SP_IMMEDIATE,
+  JIT_SUBS_ENCODING_T1,
+  JIT_SUBS_ENCODING_T2,
+  JIT_SUBS_REGISTER,
+  JIT_SXTB,
+  JIT_TST,
+  JIT_UXTB,
+  JIT_UXTH,
+};
+
+// Blocks are compiled once they have run this many times
+const uint32_t JIT_THRESHOLD = 64;
+// A block branching back to itself loops at most this many times in native
+// code before returning to the dispatcher
+const uint32_t JIT_LOOP_ITERATIONS = 1024;
+const size_t JIT_CODE_SIZE = 32 * 1024 * 1024;
+
+// Translates hot blocks from Thumb to x86-64. Guest r0-r7 and the APSR flags
+// are kept in host registers while a block runs; loads and stores go
+// straight to SRAM and flash and call back into the core for anything else.
+class JitCompiler {
+private:
+  uint8_t *code = NULL;
+  size_t codeUsed = 0;
+
+public:
+  ~JitCompiler();
+
+  // Returns NULL if the first instruction can't be compiled or the code
+  // buffer is full. The code stays valid as long as the JitCompiler lives.
+  NativeBlock compile(CortexM0Core *cpu, Block *block,
+                      const vector<JIT_OPERATION> &operations);
+  // Drops the code compiled so far, reusing the buffer for the next blocks
+  void reset() { this->codeUsed = 0; }
+};
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef __LOG_SINK_H__
+#define __LOG_SINK_H__
+
+#include "utils/spscqueue.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+typedef uint64_t number;
+
+using namespace std;
+
+// An access to a register that no peripheral implements
+struct LogRecord {
+  number cycles;
+  uint32_t offset;
+  uint32_t value;
+  uint16_t peripheral;
+  bool write;
+};
+
+// Records each core can have waiting for the log thread
+const number LOG_QUEUE_SIZE = 4096;
+// Accesses printed for each register, the summary counts the others
+const number LOG_LINES_PER_REGISTER = 4;
+// Lines printed per second of host time at most
+const number LOG_LINES_PER_SECOND = 100;
+
+// Where the peripherals log the accesses to the registers they don't
+// implement. Logging an access only appends a record to the queue of the
+// core making it; a thread of its own formats and prints the records, each
+// register a few times and at a limited rate. printSummary() then lists
+// every register accessed.
+class LogSink {
+private:
+  struct RegisterStats {
+    number reads = 0;
+    number writes = 0;
+    number lastValue = 0;
+    number printed = 0;
+  };
+
+  // One queue per core, so that each has a single producer even while the
+  // cores run on their own threads
+  SPSCQueue<LogRecord, LOG_QUEUE_SIZE> queues[2];
+  atomic<number> dropped = 0;
+
+  // Held while draining the queues, and by what the log thread reads
+  mutex drainMutex;
+  vector<string> names;
+  map<pair<number, number>, RegisterStats> registers;
+  chrono::steady_clock::time_point secondStart;
+  number linesThisSecond = 0;
+  number suppressed = 0;
+
+  // Started by the first record
+  atomic<bool> started = false;
+  thread logger;
+  mutex wakeMutex;
+  condition_variable wake;
+  bool stopping = false;
+
+  void run();
+  void drain();
+  void print(ostream &lines, const LogRecord &record);
+
+public:
+  // Where the accesses are printed
+  ostream *output = &cout;
+
+  ~LogSink();
+
+  // Returns the id to log() the accesses of a peripheral with
+  number registerPeripheral(const string &name);
+  void log(number peripheral, number offset, number value, bool write,
+           number core, number cycles);
+  // Prints the records logged so far before it returns
+  void flush();
+  // Lists the registers accessed, with their number of reads and writes
+  void printSummary(ostream &summary);
+};
+
+#endif
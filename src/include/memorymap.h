@@ -0,0 +1,148 @@
+#ifndef __MEMORYMAP_H__
+#define __MEMORYMAP_H__
+
+#include "peripherals/peripheral.h"
+#include <cstdint>
+
+typedef uint64_t number;
+
+using namespace std;
+
+const number MEMORY_PAGE_SHIFT = 12;
+const number MEMORY_PAGE_SIZE = 1 << MEMORY_PAGE_SHIFT;
+const number MEMORY_PAGE_MASK = MEMORY_PAGE_SIZE - 1;
+const number MEMORY_PAGES = (number)1 << (32 - MEMORY_PAGE_SHIFT);
+
+// Narrow accesses a peripheral decodes itself. The bus turns the others
+// into accesses of the whole 32-bit register, like the APB bridge does.
+const uint8_t BUS_WIDTH_8 = 1 << 0;
+const uint8_t BUS_WIDTH_16 = 1 << 1;
+
+// Where a peripheral sits on the bus. `base` and `size` must be multiples
+// of the page size.
+struct PeripheralRegion {
+  number base;
+  number size;
+  // BUS_WIDTH_* flags
+  uint8_t widths = 0;
+  // Whether the peripheral can be accessed by both cores at once, without
+  // the lock the bus takes while they run on their own threads
+  bool threadSafe = false;
+};
+
+// The accesses of one type of peripheral, called on the page it is mapped
+// at without going through its vtable
+struct PeripheralHandlers {
+  number (*readUint32)(Peripheral *peripheral, number offset);
+  number (*readUint16)(Peripheral *peripheral, number offset);
+  number (*readUint8)(Peripheral *peripheral, number offset);
+  void (*writeUint32)(Peripheral *peripheral, number offset, number value);
+  void (*writeUint16)(Peripheral *peripheral, number offset, number value);
+  void (*writeUint8)(Peripheral *peripheral, number offset, number value);
+};
+
+// The handlers of peripherals of type T. The calls are direct for the
+// peripheral classes marked final.
+template <class T, bool bytes, bool halfwords> struct PeripheralCalls {
+  static number readUint32(Peripheral *peripheral, number offset) {
+    return static_cast<T *>(peripheral)->readUint32(offset);
+  }
+
+  static number readUint16(Peripheral *peripheral, number offset) {
+    if constexpr (halfwords) {
+      return static_cast<T *>(peripheral)->readUint16(offset);
+    }
+    return readLanes(readUint32(peripheral, offset & ~0x3), offset, 2);
+  }
+
+  static number readUint8(Peripheral *peripheral, number offset) {
+    if constexpr (bytes) {
+      return static_cast<T *>(peripheral)->readUint8(offset);
+    }
+    return readLanes(readUint32(peripheral, offset & ~0x3), offset, 1);
+  }
+
+  static void writeUint32(Peripheral *peripheral, number offset,
+                          number value) {
+    static_cast<T *>(peripheral)->writeUint32(offset, value);
+  }
+
+  static void writeUint16(Peripheral *peripheral, number offset,
+                          number value) {
+    if constexpr (halfwords) {
+      static_cast<T *>(peripheral)->writeUint16(offset, value);
+    } else {
+      writeUint32(peripheral, offset & ~0x3, replicateLanes(value, 2));
+    }
+  }
+
+  static void writeUint8(Peripheral *peripheral, number offset, number value) {
+    if constexpr (bytes) {
+      static_cast<T *>(peripheral)->writeUint8(offset, value);
+    } else {
+      writeUint32(peripheral, offset & ~0x3, replicateLanes(value, 1));
+    }
+  }
+
+  static constexpr PeripheralHandlers handlers = {
+      readUint32, readUint16, readUint8, writeUint32, writeUint16, writeUint8};
+};
+
+template <class T>
+const PeripheralHandlers *peripheralHandlers(uint8_t widths) {
+  switch (widths & (BUS_WIDTH_8 | BUS_WIDTH_16)) {
+  case BUS_WIDTH_8:
+    return &PeripheralCalls<T, true, false>::handlers;
+  case BUS_WIDTH_16:
+    return &PeripheralCalls<T, false, true>::handlers;
+  case BUS_WIDTH_8 | BUS_WIDTH_16:
+    return &PeripheralCalls<T, true, true>::handlers;
+  default:
+    return &PeripheralCalls<T, false, false>::handlers;
+  }
+}
+
+// What one 4 KiB page of the address space is backed by
+struct MemoryPage {
+  // Host memory of the page, NULL where reads or writes can't access it
+  // directly (writes to the bootrom and flash also invalidate decoded code)
+  uint8_t *read;
+  uint8_t *write;
+  Peripheral *peripheral;
+  const PeripheralHandlers *handlers;
+  // Offset of the page within the registers of `peripheral`
+  uint32_t peripheralOffset;
+  // Whether `peripheral` can be accessed by both cores at once, without the
+  // lock the bus takes while they run on their own threads
+  bool threadSafe;
+};
+
+// A flat page table over the 32-bit address space. The table is allocated
+// zeroed and only the entries of mapped pages are ever touched, so it takes
+// up address space rather than memory.
+class MemoryMap {
+private:
+  MemoryPage *pages;
+
+public:
+  MemoryMap();
+  ~MemoryMap();
+
+  const MemoryPage &lookup(number address) const {
+    return this->pages[(uint32_t)address >> MEMORY_PAGE_SHIFT];
+  }
+
+  // `address` and `size` must be multiples of the page size
+  void mapMemory(number address, number size, uint8_t *memory, bool writable);
+  // Maps a peripheral over what the region held before, such as the
+  // UnimplementedPeripheral of a block a board adds its own model of
+  template <class T>
+  void mapPeripheral(const PeripheralRegion &region, T *peripheral) {
+    this->mapPeripheral(region, peripheral,
+                        peripheralHandlers<T>(region.widths));
+  }
+  void mapPeripheral(const PeripheralRegion &region, Peripheral *peripheral,
+                     const PeripheralHandlers *handlers);
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef __NVIC_H__
+#define __NVIC_H__
+
+#include <atomic>
+#include <cstdint>
+
+#define INTERRUPT_PRIORITIES_SIZE 4
+
+typedef uint64_t number;
+
+using namespace std;
+
+const number EXC_RESET = 1;
+const number EXC_NMI = 2;
+const number EXC_HARDFAULT = 3;
+const number EXC_SVCALL = 11;
+const number EXC_PENDSV = 14;
+const number EXC_SYSTICK = 15;
+
+// Lowest possible exception priority
+const number LOWEST_PRIORITY = 4;
+
+// The NVIC and the system handler priorities of one core. Exceptions are
+// numbered as in IPSR, with external interrupt n being exception 16 + n.
+// Every priority level has a mask of the exceptions at that level, so the
+// exception to take is the lowest set bit of the first level with one
+// pending.
+class NVIC {
+private:
+  // System handler priority registers, set through setSHPR2/3()
+  number SHPR2 = 0;
+  number SHPR3 = 0;
+  // SVCall, PendSV and SysTick at each priority level
+  number systemPriorities[INTERRUPT_PRIORITIES_SIZE] = {
+      ((number)1 << EXC_SVCALL) | ((number)1 << EXC_PENDSV) |
+          ((number)1 << EXC_SYSTICK),
+      0x0, 0x0, 0x0};
+  void updateSystemPriorities();
+
+  // Priority of the exception last passed to executionPriority()
+  number activeException = 0;
+  number activePriority = LOWEST_PRIORITY;
+
+public:
+  // Atomic, as the other core raises SIO interrupts from its own thread when
+  // RP2040::threaded is set
+  atomic<number> pendingInterrupts = 0;
+  number enabledInterrupts = 0;
+  // External interrupts at each priority level. Written directly, the
+  // cached execution priority is only updated by setInterruptPriority().
+  number interruptPriorities[INTERRUPT_PRIORITIES_SIZE] = {0xffffffff, 0x0, 0x0,
+                                                           0x0};
+  number interruptNMIMask = 0;
+  bool pendingSVCall = false;
+  bool pendingPendSV = false;
+  bool pendingSysTick = false;
+
+  number getSHPR2() { return this->SHPR2; }
+  void setSHPR2(number value);
+  number getSHPR3() { return this->SHPR3; }
+  void setSHPR3(number value);
+
+  number getInterruptPriority(number irq);
+  void setInterruptPriority(number irq, number priority);
+
+  // Reset, NMI and HardFault have fixed negative priorities, returned as 0:
+  // nothing configurable preempts them either way
+  number exceptionPriority(number exception);
+  // Priority of the exception being handled, LOWEST_PRIORITY in Thread mode
+  number executionPriority(number ipsr) {
+    if (ipsr != this->activeException) {
+      this->activeException = ipsr;
+      this->activePriority = this->exceptionPriority(ipsr);
+    }
+    return this->activePriority;
+  }
+
+  // Returns the highest priority exception pending that preempts
+  // `executionPriority`, or 0 if there is none. Taking a system exception
+  // clears its pending bit; external interrupts stay pending until their
+  // source or ICPR clears them.
+  number takeException(number executionPriority);
+};
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef __DMA_H__
+#define __DMA_H__
+
+#include "peripheral.h"
+#include "scheduler.h"
+#include <cstdint>
+
+typedef uint64_t number;
+
+using namespace std;
+
+class RP2040;
+
+const number DMA_BASE = 0x50000000;
+
+const number DMA_CHANNELS = 12;
+// The registers of channel n are at n * DMA_CHANNEL_STRIDE, in four
+// aliases of DMA_ALIAS_STRIDE bytes whose last register triggers the channel
+const number DMA_CHANNEL_STRIDE = 0x40;
+const number DMA_ALIAS_STRIDE = 0x10;
+const number DMA_INTR = 0x400;
+const number DMA_INTE0 = 0x404;
+const number DMA_INTF0 = 0x408;
+const number DMA_INTS0 = 0x40c;
+const number DMA_INTE1 = 0x414;
+const number DMA_INTF1 = 0x418;
+const number DMA_INTS1 = 0x41c;
+const number DMA_TIMER0 = 0x420;
+const number DMA_MULTI_CHAN_TRIGGER = 0x430;
+const number DMA_SNIFF_CTRL = 0x434;
+const number DMA_SNIFF_DATA = 0x438;
+const number DMA_FIFO_LEVELS = 0x440;
+const number DMA_CHAN_ABORT = 0x444;
+const number DMA_N_CHANNELS = 0x448;
+// CHn_DBG_CTDREQ is at DMA_DBG_CTDREQ + n * DMA_CHANNEL_STRIDE
+const number DMA_DBG_CTDREQ = 0x800;
+const number DMA_DBG_TCR = 0x804;
+
+// CHn_CTRL fields
+const number DMA_CTRL_EN = 1 << 0;
+const number DMA_CTRL_DATA_SIZE_SHIFT = 2;
+const number DMA_CTRL_INCR_READ = 1 << 4;
+const number DMA_CTRL_INCR_WRITE = 1 << 5;
+const number DMA_CTRL_RING_SIZE_SHIFT = 6;
+const number DMA_CTRL_RING_SEL = 1 << 10;
+const number DMA_CTRL_CHAIN_TO_SHIFT = 11;
+const number DMA_CTRL_TREQ_SEL_SHIFT = 15;
+const number DMA_CTRL_IRQ_QUIET = 1 << 21;
+const number DMA_CTRL_BSWAP = 1 << 22;
+const number DMA_CTRL_BUSY = 1 << 24;
+
+// Transfer requests: the DREQs of the peripherals, then the pacing timers
+const number DREQ_PIO0_TX0 = 0;
+const number DREQ_PIO1_RX3 = 15;
+const number DREQ_UART0_TX = 20;
+const number DREQ_UART1_RX = 23;
+const number TREQ_TIMER0 = 0x3b;
+const number TREQ_PERMANENT = 0x3f;
+const number DMA_TIMERS = 4;
+
+const number DMA_IRQ_0 = 11;
+
+// Simulated time between two checks of the DREQs channels are waiting for
+const number DMA_POLL_CYCLES = CLK_SYS_FREQUENCY / 100000;
+
+struct DMAChannel {
+  number readAddr = 0;
+  number writeAddr = 0;
+  // TRANS_COUNT as written, reloaded by each trigger
+  number transCount = 0;
+  number ctrl = 0;
+
+  bool busy = false;
+  // Transfers left to do, and done since the trigger
+  number remaining = 0;
+  number transferred = 0;
+  // Cycle the channel was triggered at, and the one the transfers done so
+  // far end at, one per cycle
+  number startCycles = 0;
+  number busyUntil = 0;
+  // Scheduler id of the completion, or of the next check of the DREQ
+  number event = 0;
+};
+
+// The 12 channels of the DMA. Channels do their transfers as soon as their
+// transfer request allows them, and end once the cycles those transfers
+// take have passed. Transfers between SRAM and flash are done in bulk on
+// host memory; the others go through the peripherals one at a time.
+// The DREQs of the peripherals that aren't modelled are always asserted,
+// so that their transfers run unpaced rather than never.
+class RPDMA final : public LoggingPeripheral {
+private:
+  DMAChannel channels[DMA_CHANNELS];
+  number intr = 0;
+  number inte[2] = {0, 0};
+  number intf[2] = {0, 0};
+  number timers[DMA_TIMERS] = {0};
+  number sniffCtrl = 0;
+  number sniffData = 0;
+
+  void trigger(number channel);
+  void abort(number channel);
+  void run(number channel);
+  void complete(number channel);
+  number pacingTimer(const DMAChannel &ch);
+  // Transfers the transfer request of a channel allows at `cycles`
+  number requests(number channel, number cycles);
+  uint8_t *hostMemory(number address, number size, bool write);
+  bool copyMemory(DMAChannel &ch, number count);
+  void transfer(DMAChannel &ch);
+  number readBus(number address, number size);
+  void writeBus(number address, number size, number value);
+  number readChannel(number offset);
+  void writeChannel(number offset, number alias, number value);
+  void updateInterrupts();
+
+public:
+  RPDMA(RP2040 *rp2040, string name) : LoggingPeripheral(rp2040, name) {}
+
+  number readUint32(number offset);
+  void writeUint32(number offset, number value);
+};
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef __IOBANK0_H__
+#define __IOBANK0_H__
+
+#include "peripheral.h"
+#include "scheduler.h"
+#include "utils/ringbuffer.h"
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+typedef uint64_t number;
+
+using namespace std;
+
+class RP2040;
+
+const number GPIO_PINS = 30;
+const uint32_t GPIO_PINS_MASK = (1 << GPIO_PINS) - 1;
+
+// GPIOn_STATUS is at 8 * n and GPIOn_CTRL right after it
+const number IO_BANK0_GPIO_CTRL = 0x4;
+const number IO_BANK0_INTR0 = 0xf0;
+const number IO_BANK0_PROC0_INTE0 = 0x100;
+const number IO_BANK0_PROC0_INTF0 = 0x110;
+const number IO_BANK0_PROC0_INTS0 = 0x120;
+// Each of the PROC1 and DORMANT_WAKE interrupt registers follows the ones
+// before it at this stride
+const number IO_BANK0_INT_STRIDE = 0x30;
+const number IO_BANK0_INT_END = 0x190;
+
+// GPIOn_CTRL fields
+const number GPIO_CTRL_FUNCSEL_MASK = 0x1f;
+const number GPIO_CTRL_OUTOVER_SHIFT = 8;
+const number GPIO_CTRL_OEOVER_SHIFT = 12;
+const number GPIO_CTRL_INOVER_SHIFT = 16;
+const number GPIO_CTRL_IRQOVER_SHIFT = 28;
+
+const number GPIO_FUNC_SIO = 5;
+const number GPIO_FUNC_PIO0 = 6;
+const number GPIO_FUNC_PIO1 = 7;
+const number GPIO_FUNC_NULL = 0x1f;
+// Functions F0 to F9
+const number GPIO_FUNCTIONS = 10;
+
+// GPIOn_STATUS bits
+const number GPIO_STATUS_OUTTOPAD = 1 << 9;
+const number GPIO_STATUS_OETOPAD = 1 << 13;
+const number GPIO_STATUS_INFROMPAD = 1 << 17;
+const number GPIO_STATUS_IRQTOPROC = 1 << 26;
+
+// The interrupt events of each pin, in its 4 bits of the INTR, INTE, INTF
+// and INTS registers
+const number GPIO_IRQ_LEVEL_LOW = 1 << 0;
+const number GPIO_IRQ_LEVEL_HIGH = 1 << 1;
+const number GPIO_IRQ_EDGE_LOW = 1 << 2;
+const number GPIO_IRQ_EDGE_HIGH = 1 << 3;
+
+const number IO_IRQ_BANK0 = 13;
+
+// Levels of the pins at a point of the simulated time
+struct PinChange {
+  number cycles;
+  uint32_t values;
+  // The pins that changed since the previous record
+  uint32_t changed;
+};
+
+const number PIN_CHANGE_BUFFER_SIZE = 4096;
+
+// One of the OUTOVER, OEOVER, INOVER and IRQOVER fields of all the pins,
+// as masks that apply to all of them at once
+struct GPIOOverride {
+  uint32_t invert = 0;
+  uint32_t force = 0;
+  uint32_t high = 0;
+
+  void set(number pin, number mode);
+  uint32_t apply(uint32_t values) const {
+    return ((values ^ this->invert) & ~this->force) | this->high;
+  }
+};
+
+// The user bank of 30 GPIOs: their function select and overrides, the
+// levels at the pads, and the GPIO interrupts of both cores. Peripherals
+// such as SIO drive the pins set to their function, and the host drives
+// the pins no function drives through setInputs(). Subscribers get the
+// changes of the levels in batches, the same way RPUART delivers its
+// output.
+class RPIOBank0 final : public LoggingPeripheral {
+private:
+  number ctrl[GPIO_PINS];
+  // The pins set to each function, and what the function drives on them
+  uint32_t functionPins[GPIO_FUNCTIONS] = {0};
+  uint32_t functionOut[GPIO_FUNCTIONS] = {0};
+  uint32_t functionOE[GPIO_FUNCTIONS] = {0};
+  GPIOOverride outOverride;
+  GPIOOverride oeOverride;
+  GPIOOverride inOverride;
+  GPIOOverride irqOverride;
+
+  uint32_t externalInputs = 0;
+  uint32_t outputs = 0;
+  uint32_t outputEnables = 0;
+  uint32_t pads = 0;
+  uint32_t inputs = 0;
+  uint32_t irqInputs = 0;
+
+  // Latched edges, cleared by writing INTR
+  uint32_t edgesLow = 0;
+  uint32_t edgesHigh = 0;
+  // INTE and INTF of PROC0, PROC1 and DORMANT_WAKE, and the pins whose
+  // events INTE enables for each event and core
+  uint32_t inte[3][4] = {{0}};
+  uint32_t intf[3][4] = {{0}};
+  uint32_t enabledEvents[2][4] = {{0}};
+
+  RingBuffer<PinChange, PIN_CHANGE_BUFFER_SIZE> changes;
+  vector<pair<number, function<void(const PinChange *, number)>>> subscribers;
+  number nextSubscriberId = 1;
+  number flushEvent = 0;
+  number lastChangeCycles = 0;
+
+  void updateCtrl(number pin);
+  void updatePins(number cycles);
+  void recordChange(number cycles, uint32_t changed);
+  void updateEnabledEvents(number proc);
+  uint32_t events(number event);
+  number readIntr(number reg, number proc);
+  void updateInterrupts();
+
+public:
+  RPIOBank0(RP2040 *rp2040, string name);
+
+  // Called by the peripherals when what they drive changes, at the given
+  // cycle of the simulated time
+  void setFunctionOutputs(number function, uint32_t out, uint32_t oe,
+                          number cycles);
+  // Levels the host drives on the pins no function drives
+  void setInputs(uint32_t values);
+  // Levels at the pads
+  uint32_t getPins() { return this->pads; }
+  // Levels seen by the peripherals, which SIO reads as GPIO_IN
+  uint32_t getInputs() { return this->inputs; }
+
+  // Delivers the pin changes in batches, at least every `flushDelay`
+  // cycles of simulated time while the pins change. Returns the id to
+  // unsubscribe() with.
+  number subscribe(function<void(const PinChange *, number)> subscriber);
+  void unsubscribe(number id);
+  number flushDelay = CLK_SYS_FREQUENCY / 1000;
+  // Delivers the changes recorded so far
+  void flush();
+
+  number readUint32(number offset);
+  void writeUint32(number offset, number value);
+};
+
+#endif
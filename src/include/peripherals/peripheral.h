@@ -11,13 +11,49 @@ using namespace std;
 
 class RP2040;
 
+// The APB peripherals decode each register a second time at each of these
+// offsets, where writes flip, set or clear the bits written
+const number ATOMIC_XOR_OFFSET = 0x1000;
+const number ATOMIC_SET_OFFSET = 0x2000;
+const number ATOMIC_CLEAR_OFFSET = 0x3000;
+const number ATOMIC_ALIAS_MASK = 0x3000;
+
+// The value a write of `value` at `offset` leaves in a register that held
+// `current`, for the peripherals that implement the atomic aliases
+number atomicWriteValue(number offset, number current, number value);
+
+// The `size` bytes at `offset` of a 32-bit register holding `value`
+inline number readLanes(number value, number offset, number size) {
+  return (value >> ((offset & (4 - size)) * 8)) &
+         (((number)1 << (size * 8)) - 1);
+}
+
+// What a `size` byte write of `value` writes to the whole 32-bit register
+inline number replicateLanes(number value, number size) {
+  return size == 1 ? (value & 0xff) * 0x01010101 : (value & 0xffff) * 0x10001;
+}
+
 class Peripheral {
 public:
   virtual number readUint32(number offset) = 0;
   virtual void writeUint32(number offset, number value) = 0;
+
+  // Narrow accesses. By default reads return their lanes of the 32-bit
+  // register and writes replicate the value across all lanes, like the APB
+  // bridge does; peripherals with byte-wide registers can override them.
+  virtual number readUint16(number offset);
+  virtual number readUint8(number offset);
+  virtual void writeUint16(number offset, number value);
+  virtual void writeUint8(number offset, number value);
 };
 
+// A peripheral whose registers aren't implemented, or the fallback of one
+// for the registers it doesn't implement, which logs their accesses to
+// the LogSink of the RP2040
 class LoggingPeripheral : public Peripheral {
+private:
+  number logId;
+
 public:
   RP2040 *rp2040;
   string name;
@@ -28,7 +64,7 @@ public:
   void writeUint32(number offset, number value);
 };
 
-class UnimplementedPeripheral : public LoggingPeripheral {
+class UnimplementedPeripheral final : public LoggingPeripheral {
 public:
   UnimplementedPeripheral(RP2040 *rp2040, string name)
       : LoggingPeripheral(rp2040, name) {}
@@ -0,0 +1,262 @@
+#ifndef __PIO_H__
+#define __PIO_H__
+
+#include "peripheral.h"
+#include "scheduler.h"
+#include "utils/ringbuffer.h"
+#include <cstdint>
+
+typedef uint64_t number;
+
+using namespace std;
+
+class RP2040;
+
+const number PIO0_BASE = 0x50200000;
+const number PIO1_BASE = 0x50300000;
+
+const number PIO_CTRL = 0x000;
+const number PIO_FSTAT = 0x004;
+const number PIO_FDEBUG = 0x008;
+const number PIO_FLEVEL = 0x00c;
+const number PIO_TXF0 = 0x010;
+const number PIO_RXF0 = 0x020;
+const number PIO_IRQ = 0x030;
+const number PIO_IRQ_FORCE = 0x034;
+const number PIO_INPUT_SYNC_BYPASS = 0x038;
+const number PIO_DBG_PADOUT = 0x03c;
+const number PIO_DBG_PADOE = 0x040;
+const number PIO_DBG_CFGINFO = 0x044;
+const number PIO_INSTR_MEM0 = 0x048;
+const number PIO_INSTR_MEM31 = 0x0c4;
+// The registers of state machine n are at PIO_SM0_CLKDIV + n * PIO_SM_STRIDE
+const number PIO_SM0_CLKDIV = 0x0c8;
+const number PIO_SM_STRIDE = 0x18;
+const number PIO_SM_EXECCTRL = 0x04;
+const number PIO_SM_SHIFTCTRL = 0x08;
+const number PIO_SM_ADDR = 0x0c;
+const number PIO_SM_INSTR = 0x10;
+const number PIO_SM_PINCTRL = 0x14;
+const number PIO_INTR = 0x128;
+const number PIO_IRQ0_INTE = 0x12c;
+const number PIO_IRQ0_INTF = 0x130;
+const number PIO_IRQ0_INTS = 0x134;
+const number PIO_IRQ1_INTE = 0x138;
+const number PIO_IRQ1_INTF = 0x13c;
+const number PIO_IRQ1_INTS = 0x140;
+
+// CTRL fields
+const number PIO_CTRL_SM_ENABLE_MASK = 0xf;
+const number PIO_CTRL_SM_RESTART_SHIFT = 4;
+
+// FSTAT fields, and FDEBUG flags, one bit per state machine
+const number PIO_FSTAT_RXFULL_SHIFT = 0;
+const number PIO_FSTAT_RXEMPTY_SHIFT = 8;
+const number PIO_FSTAT_TXFULL_SHIFT = 16;
+const number PIO_FSTAT_TXEMPTY_SHIFT = 24;
+const number PIO_FDEBUG_RXSTALL_SHIFT = 0;
+const number PIO_FDEBUG_RXUNDER_SHIFT = 8;
+const number PIO_FDEBUG_TXOVER_SHIFT = 16;
+const number PIO_FDEBUG_TXSTALL_SHIFT = 24;
+
+// SMn_EXECCTRL fields
+const number PIO_EXECCTRL_EXEC_STALLED = 1 << 31;
+const number PIO_EXECCTRL_SIDE_EN = 1 << 30;
+const number PIO_EXECCTRL_SIDE_PINDIR = 1 << 29;
+const number PIO_EXECCTRL_JMP_PIN_SHIFT = 24;
+const number PIO_EXECCTRL_WRAP_TOP_SHIFT = 12;
+const number PIO_EXECCTRL_WRAP_BOTTOM_SHIFT = 7;
+const number PIO_EXECCTRL_STATUS_SEL = 1 << 4;
+
+// SMn_SHIFTCTRL fields
+const number PIO_SHIFTCTRL_FJOIN_RX = 1 << 31;
+const number PIO_SHIFTCTRL_FJOIN_TX = 1 << 30;
+const number PIO_SHIFTCTRL_PULL_THRESH_SHIFT = 25;
+const number PIO_SHIFTCTRL_PUSH_THRESH_SHIFT = 20;
+const number PIO_SHIFTCTRL_OUT_SHIFTDIR = 1 << 19;
+const number PIO_SHIFTCTRL_IN_SHIFTDIR = 1 << 18;
+const number PIO_SHIFTCTRL_AUTOPULL = 1 << 17;
+const number PIO_SHIFTCTRL_AUTOPUSH = 1 << 16;
+
+// SMn_PINCTRL fields
+const number PIO_PINCTRL_SIDESET_COUNT_SHIFT = 29;
+const number PIO_PINCTRL_SET_COUNT_SHIFT = 26;
+const number PIO_PINCTRL_OUT_COUNT_SHIFT = 20;
+const number PIO_PINCTRL_IN_BASE_SHIFT = 15;
+const number PIO_PINCTRL_SIDESET_BASE_SHIFT = 10;
+const number PIO_PINCTRL_SET_BASE_SHIFT = 5;
+
+const number PIO_SM_COUNT = 4;
+const number PIO_INSTRUCTIONS = 32;
+const number PIO_FIFO_DEPTH = 4;
+// Interrupt 0 of PIO n, its interrupt 1 follows
+const number PIO0_IRQ_0 = 7;
+const number PIO1_IRQ_0 = 9;
+
+// Simulated time between two catch-ups of the running state machines
+const number PIO_QUANTUM_CYCLES = CLK_SYS_FREQUENCY / 100000;
+
+enum PIOOpcode : uint8_t {
+  PIO_JMP,
+  PIO_WAIT,
+  PIO_IN,
+  PIO_OUT,
+  PIO_PUSH,
+  PIO_PULL,
+  PIO_MOV,
+  PIO_IRQ_SET,
+  PIO_SET,
+};
+
+// An instruction decoded for the side-set configuration of one state
+// machine
+struct PIOInstruction {
+  PIOOpcode opcode;
+  // Condition, source or destination
+  uint8_t target;
+  // Bit count, index, address or data
+  uint8_t operand;
+  // Polarity, MOV operation, IfFull/IfEmpty, or IRQ clear
+  uint8_t flags;
+  bool block;
+  uint8_t delay;
+  bool sideSet;
+  uint8_t sideSetValue;
+};
+
+class RPPIO;
+
+// What executing an instruction did to the program counter
+enum PIOResult {
+  // Stalled, to be executed again on the next cycle
+  PIO_STALL,
+  // Completed, the program counter moves on
+  PIO_NEXT,
+  // Completed and set the program counter
+  PIO_JUMPED,
+  // Changed some state but has yet to complete, like an IRQ that waits
+  PIO_RETRY,
+};
+
+class PIOStateMachine {
+public:
+  RPPIO *pio;
+  number index;
+
+  number clkdiv = 0x10000;
+  number execctrl = 0x1f000;
+  number shiftctrl = 0xc0000;
+  number pinctrl = 0x14000000;
+  // The instruction memory decoded with this state machine's side-set
+  // configuration and index
+  PIOInstruction decoded[PIO_INSTRUCTIONS];
+
+  // Simulated time of the next instruction and the clock divider, both in
+  // 1/256 clk_sys cycles
+  number time = 0;
+  number period = 256;
+  bool enabled = false;
+  // Stalled when it last ran, so it is skipped until something it may be
+  // waiting for changes
+  bool stalled = false;
+  // Stalled on a WAIT for a pin, which may change without PIO noticing
+  bool waitingForPin = false;
+
+  uint32_t pc = 0;
+  uint32_t x = 0;
+  uint32_t y = 0;
+  uint32_t isr = 0;
+  uint32_t osr = 0;
+  number isrCount = 0;
+  number osrCount = 32;
+  // An instruction from SMn_INSTR, OUT EXEC or MOV EXEC, which runs
+  // instead of the one at the program counter
+  bool pendingExec = false;
+  uint16_t execInstruction = 0;
+  PIOInstruction execDecoded;
+  // Set the flag of an IRQ wait and waits for it to be cleared
+  bool irqWaiting = false;
+
+  RingBuffer<uint32_t, 2 * PIO_FIFO_DEPTH> txFifo;
+  RingBuffer<uint32_t, 2 * PIO_FIFO_DEPTH> rxFifo;
+
+  void decodeAll();
+  PIOInstruction decode(uint16_t opcode);
+  void setClockDivider(number value);
+  void exec(uint16_t opcode);
+  number txDepth();
+  number rxDepth();
+  void restart();
+
+  // Runs the next instruction and its delay, returning false if it stalled
+  bool step();
+
+private:
+  PIOResult execute(const PIOInstruction &instr);
+  void advance();
+  number pushThreshold();
+  number pullThreshold();
+  uint32_t readPins();
+  void writePins(number base, number count, uint32_t values);
+  void writePinDirs(number base, number count, uint32_t values);
+  uint32_t readSource(number source);
+  void shiftIn(uint32_t value, number count);
+  uint32_t shiftOut(number count);
+};
+
+// A PIO block: four state machines sharing 32 instructions, 8 IRQ flags
+// and the GPIO outputs of the block's function. The state machines run in
+// batches, on a scheduler event while any of them may make progress on its
+// own, and before each access of the bus to the block so that the cores
+// see them up to date. A state machine that stalls costs nothing until
+// another one or a core lets it continue.
+class RPPIO final : public LoggingPeripheral {
+private:
+  number index;
+  number runEvent = 0;
+
+  number fdebug = 0;
+  number inputSyncBypass = 0;
+  number inte[2] = {0, 0};
+  number intf[2] = {0, 0};
+
+  void runUntil(number cycles);
+  void scheduleRun();
+  // Lets the stalled state machines retry after the cores changed a FIFO,
+  // an IRQ flag or a register
+  void wake();
+  number readCtrl();
+  number readIntr();
+  number readFifoStatus();
+  number readFifoLevels();
+
+public:
+  PIOStateMachine sm[PIO_SM_COUNT];
+  uint16_t instructions[PIO_INSTRUCTIONS] = {0};
+  number irqFlags = 0;
+  // What the block drives on the pins set to its function
+  uint32_t pinValues = 0;
+  uint32_t pinDirs = 0;
+  // Set when a state machine changed the IRQ flags or the pins, which the
+  // others may be waiting for
+  bool sharedStateChanged = false;
+
+  RPPIO(RP2040 *rp2040, string name, number index);
+
+  // Runs the state machines up to the time of the core accessing the bus
+  void run();
+  // The DREQ of the TX FIFO of state machine `request`, or of the RX FIFO
+  // of state machine `request - 4`
+  bool dreq(number request);
+  uint32_t readInputs();
+  void updatePins(number time);
+  void updateInterrupts();
+  void setDebugFlag(number shift, number sm) {
+    this->fdebug |= 1 << (shift + sm);
+  }
+
+  number readUint32(number offset);
+  void writeUint32(number offset, number value);
+};
+
+#endif
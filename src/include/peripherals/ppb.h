@@ -0,0 +1,34 @@
+#ifndef __PPB_H__
+#define __PPB_H__
+
+#include "peripheral.h"
+
+typedef uint64_t number;
+
+using namespace std;
+
+class RP2040;
+
+// ICSR bits
+const number ICSR_PENDSVSET = 1 << 28;
+const number ICSR_PENDSVCLR = 1 << 27;
+const number ICSR_PENDSTSET = 1 << 26;
+const number ICSR_PENDSTCLR = 1 << 25;
+const number ICSR_ISRPENDING = 1 << 22;
+
+// The Cortex-M0+ private peripheral bus: the NVIC, ICSR, VTOR, SCR and the
+// system handler priorities. Each core sees its own registers. Offsets are
+// relative to PPB_BASE.
+class RPPPB final : public LoggingPeripheral {
+private:
+  number readInterruptPriorities(number regIndex);
+  void writeInterruptPriorities(number regIndex, number value);
+
+public:
+  RPPPB(RP2040 *rp2040, string name) : LoggingPeripheral(rp2040, name) {}
+
+  number readUint32(number offset);
+  void writeUint32(number offset, number value);
+};
+
+#endif
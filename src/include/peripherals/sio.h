@@ -0,0 +1,115 @@
+#ifndef __SIO_H__
+#define __SIO_H__
+
+#include "peripheral.h"
+#include <atomic>
+
+typedef uint64_t number;
+
+using namespace std;
+
+class RP2040;
+
+const number SIO_CPUID_OFFSET = 0x000;
+const number SIO_GPIO_IN_OFFSET = 0x004;
+const number SIO_GPIO_OUT_OFFSET = 0x010;
+const number SIO_GPIO_OUT_SET_OFFSET = 0x014;
+const number SIO_GPIO_OUT_CLR_OFFSET = 0x018;
+const number SIO_GPIO_OUT_XOR_OFFSET = 0x01c;
+const number SIO_GPIO_OE_OFFSET = 0x020;
+const number SIO_GPIO_OE_SET_OFFSET = 0x024;
+const number SIO_GPIO_OE_CLR_OFFSET = 0x028;
+const number SIO_GPIO_OE_XOR_OFFSET = 0x02c;
+const number SIO_FIFO_ST_OFFSET = 0x050;
+const number SIO_FIFO_WR_OFFSET = 0x054;
+const number SIO_FIFO_RD_OFFSET = 0x058;
+const number SIO_SPINLOCK_ST_OFFSET = 0x05c;
+const number SIO_SPINLOCK0_OFFSET = 0x100;
+const number SIO_SPINLOCK31_OFFSET = 0x17c;
+
+// FIFO_ST bits
+const number SIO_FIFO_ST_VLD = 1 << 0;
+const number SIO_FIFO_ST_RDY = 1 << 1;
+const number SIO_FIFO_ST_WOF = 1 << 2;
+const number SIO_FIFO_ST_ROE = 1 << 3;
+
+const number SIO_FIFO_DEPTH = 8;
+const number SIO_IRQ_PROC0 = 15;
+const number SIO_IRQ_PROC1 = 16;
+
+// One direction of the inter-core FIFOs. Only one core pushes and only the
+// other one pops, so the two counters are all the synchronization it needs
+// when the cores run on their own threads.
+class SIOFifo {
+private:
+  uint32_t entries[SIO_FIFO_DEPTH] = {0};
+  atomic<uint32_t> pushed = 0;
+  atomic<uint32_t> popped = 0;
+
+public:
+  bool empty() const {
+    return this->pushed.load(memory_order_acquire) ==
+           this->popped.load(memory_order_acquire);
+  }
+
+  bool full() const {
+    return this->pushed.load(memory_order_acquire) -
+               this->popped.load(memory_order_acquire) >=
+           SIO_FIFO_DEPTH;
+  }
+
+  // Returns false if the FIFO is full
+  bool push(uint32_t value) {
+    const uint32_t tail = this->pushed.load(memory_order_relaxed);
+    if (tail - this->popped.load(memory_order_acquire) >= SIO_FIFO_DEPTH) {
+      return false;
+    }
+    this->entries[tail % SIO_FIFO_DEPTH] = value;
+    this->pushed.store(tail + 1, memory_order_release);
+    return true;
+  }
+
+  // Returns false if the FIFO is empty
+  bool pop(uint32_t &value) {
+    const uint32_t head = this->popped.load(memory_order_relaxed);
+    if (this->pushed.load(memory_order_acquire) == head) {
+      return false;
+    }
+    value = this->entries[head % SIO_FIFO_DEPTH];
+    this->popped.store(head + 1, memory_order_release);
+    return true;
+  }
+};
+
+// Single-cycle IO. The registers are the same for both cores, but CPUID and
+// the FIFO registers depend on the core accessing them. GPIO_OUT and
+// GPIO_OE drive the pins IO_BANK0 gives to SIO.
+class RPSIO final : public LoggingPeripheral {
+private:
+  // The FIFO each core reads from, written by the other core
+  SIOFifo fifo[2];
+  // WOF and ROE of each core
+  atomic<uint32_t> fifoErrors[2] = {0, 0};
+  atomic<uint32_t> spinlocks = 0;
+  // Shared by both cores, and updated with the peripherals locked
+  uint32_t gpioOut = 0;
+  uint32_t gpioOE = 0;
+
+  number readFifoStatus(number core);
+  bool fifoInterrupt(number core);
+  // Raises SIO_IRQ_PROCn while the FIFO of core n has data or an error
+  void updateFifoInterrupt(number core);
+  void writeGPIO(number offset, number value);
+
+public:
+  RPSIO(RP2040 *rp2040, string name) : LoggingPeripheral(rp2040, name) {}
+
+  number readUint32(number offset);
+  void writeUint32(number offset, number value);
+  // The same, for the DMA, which already holds the lock of the peripherals
+  // the GPIO registers take
+  number readUint32Locked(number offset);
+  void writeUint32Locked(number offset, number value);
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef __SSI_H__
+#define __SSI_H__
+
+#include "peripheral.h"
+
+typedef uint64_t number;
+
+using namespace std;
+
+class RP2040;
+
+const number SSI_SR_OFFSET = 0x00000028;
+const number SSI_DR0_OFFSET = 0x00000060;
+const number SSI_SR_BUSY_BITS = 0x00000001;
+const number SSI_SR_TFE_BITS = 0x00000004;
+
+// The XIP SSI, just enough of it for the boot stage 2 to program the flash
+class RPSSI final : public LoggingPeripheral {
+private:
+  number dr0 = 0;
+
+public:
+  RPSSI(RP2040 *rp2040, string name) : LoggingPeripheral(rp2040, name) {}
+
+  number readUint32(number offset);
+  void writeUint32(number offset, number value);
+};
+
+#endif
@@ -13,7 +13,7 @@ class RP2040;
 const number PROC0_NMI_MASK = 0;
 const number PROC1_NMI_MASK = 4;
 
-class RP2040SysCfg : public LoggingPeripheral {
+class RP2040SysCfg final : public LoggingPeripheral {
 public:
   RP2040SysCfg(RP2040 *rp2040, string name) : LoggingPeripheral(rp2040, name) {}
 
@@ -2,28 +2,71 @@
 #define __TIMER_H__
 
 #include "peripheral.h"
-#include <chrono>
+#include "scheduler.h"
 
 typedef uint64_t number;
 
 using namespace std;
-using namespace std::chrono;
 
 class RP2040;
 
+const number TIMEHW = 0x00;
+const number TIMELW = 0x04;
 const number TIMEHR = 0x08;
 const number TIMELR = 0x0c;
+const number ALARM0 = 0x10;
+const number ALARM3 = 0x1c;
+const number ARMED = 0x20;
 const number TIMERAWH = 0x24;
 const number TIMERAWL = 0x28;
+const number DBGPAUSE = 0x2c;
+const number PAUSE = 0x30;
+const number INTR = 0x34;
+const number INTE = 0x38;
+const number INTF = 0x3c;
+const number INTS = 0x40;
 
 const number ALARM_0 = 1 << 0;
 const number ALARM_1 = 1 << 1;
 const number ALARM_2 = 1 << 2;
 const number ALARM_3 = 1 << 3;
 
-class RPTimer : public LoggingPeripheral {
+const number TIMER_ALARMS = 4;
+// Alarm n raises TIMER_IRQ_0 + n on both cores
+const number TIMER_IRQ_0 = 0;
+// The timer ticks once per microsecond
+const number TIMER_TICK_CYCLES = CLK_SYS_FREQUENCY / 1000000;
+
+// The 64-bit microsecond counter, counting ticks of the simulated time, and
+// its four alarms. Armed alarms are events on the scheduler of the RP2040,
+// so waiting for one costs nothing until it fires.
+class RPTimer final : public LoggingPeripheral {
 private:
+  // The counter held `time` at tick `baseTick`, and kept it while paused
+  number time = 0;
+  number baseTick = 0;
+  bool paused = false;
   number latchedTimeHigh = 0;
+  number latchedTimeLow = 0;
+  number dbgPause = 0x7;
+
+  uint32_t alarms[TIMER_ALARMS] = {0};
+  number armed = 0;
+  // Scheduler ids of the armed alarms
+  number alarmEvents[TIMER_ALARMS] = {0};
+  number intr = 0;
+  number inte = 0;
+  number intf = 0;
+
+  // Ticks of the core accessing the timer
+  number currentTick();
+  number readTime();
+  void writeTime(number time);
+  void setPaused(bool paused);
+  void scheduleAlarm(number alarm);
+  void cancelAlarm(number alarm);
+  void fireAlarm(number alarm);
+  void updateInterrupts();
 
 public:
   RPTimer(RP2040 *rp2040, string name) : LoggingPeripheral(rp2040, name) {}
@@ -32,4 +75,4 @@ public:
   void writeUint32(number offset, number value);
 };
 
-#endif
\ No newline at end of file
+#endif
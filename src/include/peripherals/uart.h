@@ -2,6 +2,8 @@
 #define __UART_H__
 
 #include "peripheral.h"
+#include "scheduler.h"
+#include "utils/ringbuffer.h"
 #include <cstdint>
 #include <functional>
 
@@ -12,16 +14,103 @@ using namespace std;
 class RP2040;
 
 const number UARTDR = 0x0;
+const number UARTRSR = 0x4;
 const number UARTFR = 0x18;
+const number UARTIBRD = 0x24;
+const number UARTFBRD = 0x28;
+const number UARTLCR_H = 0x2c;
+const number UARTCR = 0x30;
+const number UARTIFLS = 0x34;
+const number UARTIMSC = 0x38;
+const number UARTRIS = 0x3c;
+const number UARTMIS = 0x40;
+const number UARTICR = 0x44;
+const number UARTDMACR = 0x48;
+
+// UARTFR bits
+const number UARTFR_BUSY = 1 << 3;
+const number UARTFR_RXFE = 1 << 4;
+const number UARTFR_TXFF = 1 << 5;
+const number UARTFR_RXFF = 1 << 6;
+const number UARTFR_TXFE = 1 << 7;
+
+const number UARTLCR_H_FEN = 1 << 4;
+
+const number UARTCR_UARTEN = 1 << 0;
+const number UARTCR_TXE = 1 << 8;
+const number UARTCR_RXE = 1 << 9;
+
+const number UARTDMACR_RXDMAE = 1 << 0;
+const number UARTDMACR_TXDMAE = 1 << 1;
+
+// Interrupt bits of UARTIMSC, UARTRIS, UARTMIS and UARTICR
+const number UART_RXI = 1 << 4;
+const number UART_TXI = 1 << 5;
+const number UART_RTI = 1 << 6;
+
+const number UART_FIFO_DEPTH = 32;
+const number UART0_IRQ = 20;
+const number UART1_IRQ = 21;
+
+// Bytes the host side of a UART buffers before it delivers them
+const number UART_HOST_BUFFER_SIZE = 4096;
+
+// A PL011 UART. Like the UART of rp2040js, it sends each byte as soon as
+// it is written: its TX FIFO never fills, and the bytes go to a buffer the
+// host side gets in batches. The host sends bytes to the RX FIFO with
+// receive().
+class RPUART final : public LoggingPeripheral {
+private:
+  number irq;
+  RingBuffer<uint8_t, UART_FIFO_DEPTH> rxFifo;
+  RingBuffer<uint8_t, UART_HOST_BUFFER_SIZE> hostBuffer;
+  // Scheduler id of the delivery of the current batch
+  number flushEvent = 0;
+
+  number ibrd = 0;
+  number fbrd = 0;
+  number lcrH = 0;
+  number cr = UARTCR_TXE | UARTCR_RXE;
+  number ifls = 0x12;
+  number imsc = 0;
+  // The receive timeout interrupt. The RX interrupt follows the level of
+  // the RX FIFO, and the TX interrupt is always raised.
+  number ris = 0;
+  number dmacr = 0;
+
+  number fifoDepth();
+  // RX FIFO level at which the RX interrupt triggers
+  number rxTriggerLevel();
+  bool enabled(number direction);
+  number rawInterrupts();
+  void transmit(uint8_t value);
+  void updateInterrupt();
 
-class RPUART : public LoggingPeripheral {
 public:
-  RPUART(RP2040 *rp2040, string name) : LoggingPeripheral(rp2040, name) {}
+  RPUART(RP2040 *rp2040, string name, number irq)
+      : LoggingPeripheral(rp2040, name), irq(irq) {}
+
+  // Gets the bytes the firmware sent, in batches. A batch ends after a
+  // newline when `lineBuffered` is set, after `batchSize` bytes, or
+  // `flushDelay` cycles of simulated time after its first byte, whichever
+  // comes first.
+  function<void(const uint8_t *data, number size)> onTransmit;
+  bool lineBuffered = true;
+  number batchSize = UART_HOST_BUFFER_SIZE;
+  number flushDelay = CLK_SYS_FREQUENCY / 100;
+  // Delivers the bytes buffered so far
+  void flush();
+
+  // Puts the bytes in the RX FIFO, returning how many fit, so that the host
+  // can send the rest once the firmware read some. The UART takes none
+  // while its receiver is disabled.
+  number receive(const uint8_t *data, number size);
 
-  function<void(number)> onByte;
+  // The DREQ of the transmitter or of the receiver, while DMACR enables it
+  bool dreq(bool transmit);
 
   number readUint32(number offset);
   void writeUint32(number offset, number value);
 };
 
-#endif
\ No newline at end of file
+#endif
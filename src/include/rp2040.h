@@ -2,19 +2,31 @@
 #define __RP2040_H__
 
 #include "bootrom.h"
+#include "cortexm0.h"
+#include "logsink.h"
+#include "memorymap.h"
+#include "peripherals/dma.h"
+#include "peripherals/iobank0.h"
 #include "peripherals/peripheral.h"
+#include "peripherals/pio.h"
+#include "peripherals/ppb.h"
+#include "peripherals/sio.h"
+#include "peripherals/ssi.h"
 #include "peripherals/syscfg.h"
 #include "peripherals/timer.h"
 #include "peripherals/uart.h"
+#include "scheduler.h"
 #include "utils/dataview.h"
+#include <atomic>
 #include <cstdint>
 #include <functional>
 #include <map>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #define SRAM_SIZE 264 * 1024
 #define FLASH_SIZE 16 * 1024 * 1024
-#define INTERRUPT_PRIORITIES_SIZE 4
 
 typedef uint64_t number;
 
@@ -25,19 +37,13 @@ const number FLASH_END_ADDRESS = 0x14000000;
 const number RAM_START_ADDRESS = 0x20000000;
 const number SIO_START_ADDRESS = 0xD0000000;
 
-const number SIO_CPUID_OFFSET = 0;
-
 const number XIP_SSI_BASE = 0x18000000;
-const number SSI_SR_OFFSET = 0x00000028;
-const number SSI_DR0_OFFSET = 0x00000060;
-const number SSI_SR_BUSY_BITS = 0x00000001;
-const number SSI_SR_TFE_BITS = 0x00000004;
-const number CLOCKS_BASE = 0x40008000;
-const number CLK_REF_SELECTED = 0x38;
-const number CLK_SYS_SELECTED = 0x44;
 
 const number USBCTRL_BASE = 0x50100000;
 
+// Address space each APB peripheral takes
+const number APB_PERIPHERAL_SIZE = 0x4000;
+
 const number PPB_BASE = 0xe0000000;
 const number OFFSET_NVIC_ISER = 0xe100; // Interrupt Set-Enable Register
 const number OFFSET_NVIC_ICER = 0xe180; // Interrupt Clear-Enable Register
@@ -46,52 +52,37 @@ const number OFFSET_NVIC_ICPR = 0xe280; // Interrupt Clear-Pending Register
 // Interrupt priority registers
 const uint16_t OFFSET_NVIC_IPRn[8] = {0xe400, 0xe404, 0xe408, 0xe40c,
                                       0xe410, 0xe414, 0xe418, 0xe41c};
+const number OFFSET_ICSR = 0xed04; // Interrupt Control and State Register
 const number OFFSET_VTOR = 0xed08;
+const number OFFSET_SCR = 0xed10; // System Control Register
 const number OFFSET_SHPR2 = 0xed1c;
 const number OFFSET_SHPR3 = 0xed20;
 
-const number EXC_RESET = 1;
-const number EXC_NMI = 2;
-const number EXC_HARDFAULT = 3;
-const number EXC_SVCALL = 11;
-const number EXC_PENDSV = 14;
-const number EXC_SYSTICK = 15;
-
-const number SYSM_APSR = 0;
-const number SYSM_IAPSR = 1;
-const number SYSM_EAPSR = 2;
-const number SYSM_XPSR = 3;
-const number SYSM_IPSR = 5;
-const number SYSM_EPSR = 6;
-const number SYSM_IEPSR = 7;
-const number SYSM_MSP = 8;
-const number SYSM_PSP = 9;
-const number SYSM_PRIMASK = 16;
-const number SYSM_CONTROL = 20;
-
-// Lowest possible exception priority
-const number LOWEST_PRIORITY = 4;
-
-enum EXECUTION_MODE { MODE_THREAD, MODE_HANDLER };
-
-const number PC_REGISTER = 15;
-
-enum STACK_POINTER_BANK { SP_MAIN, SP_PROCESS };
-
 class RP2040 {
 private:
-  number bankedSP = 0;
-
-  number dr0 = 0;
-  number VTOR = 0;
-
-  number signExtend8(number value);
-  number signExtend16(number value);
-
-  bool stopped = false;
-  number breakCount = 0;
-
-  EXECUTION_MODE currentMode = MODE_THREAD;
+  // The core accessing the bus on each thread, and the RP2040 it belongs to
+  struct BusMaster {
+    RP2040 *rp2040;
+    CortexM0Core *core;
+  };
+  static thread_local BusMaster busMaster;
+
+  atomic<bool> stopped = false;
+
+  // Set while executeThreaded() runs
+  bool threadsRunning = false;
+  // Serializes the accesses to the peripherals that aren't thread-safe
+  mutex peripheralMutex;
+  unique_lock<mutex> lockPeripheral(const MemoryPage &page);
+  // Code the other core wrote over while running on its own thread, dropped
+  // from the cache of each core at the next quantum boundary
+  vector<number> staleCode[2];
+  void invalidateCode(number address);
+  // Lets time pass while both cores are waiting for an event
+  void wakeWaitingCores();
+  // A core waiting for an event sleeps through the cycles the other core
+  // ran for
+  void synchronizeClocks();
 
 public:
   uint32_t bootrom[BOOT_ROM_B1_SIZE] = {
@@ -106,94 +97,58 @@ public:
   };
   uint16_t *flash16 = (uint16_t *)flash;
   DataView *flashView = new DataView(this->flash, FLASH_SIZE);
-  uint32_t registers[16] = {
-      0x00,
-  };
 
-  map<number, function<void(number, number)>> writeHooks;
-  map<number, function<number(number)>> readHooks;
-
-  RPUART *uart[2] = {new RPUART(this, "UART0"), new RPUART(this, "UART1")};
-
-  // APSR fields
-  bool N = false;
-  bool C = false;
-  bool Z = false;
-  bool V = false;
-
-  // PRIMASK fields
-  bool PM = false;
-
-  // CONTROL fields
-  STACK_POINTER_BANK SPSEL = SP_MAIN;
-  bool nPRIV = false;
-
-  number IPSR = 0;
-  number pendingInterrupts = 0;
-  number enabledInterrupts = 0;
-  bool pendingSVCall = false;
-  bool interruptsUpdated = false;
-  number interruptPriorities[INTERRUPT_PRIORITIES_SIZE] = {0xffffffff, 0x0, 0x0,
-                                                           0x0};
-  number interruptNMIMask = 0;
-
-  // M0Plus built-in registers
-  number SHPR2 = 0;
-  number SHPR3 = 0;
-
-  map<number, Peripheral *> peripherals = {
-      {0x40000, new UnimplementedPeripheral(this, "SYSINFO_BASE")},
-      {0x40004, new RP2040SysCfg(this, "SYSCFG")},
-      {0x40008, new UnimplementedPeripheral(this, "CLOCKS_BASE")},
-      {0x4000c, new UnimplementedPeripheral(this, "RESETS_BASE")},
-      {0x40010, new UnimplementedPeripheral(this, "PSM_BASE")},
-      {0x40014, new UnimplementedPeripheral(this, "IO_BANK0_BASE")},
-      {0x40018, new UnimplementedPeripheral(this, "IO_QSPI_BASE")},
-      {0x4001c, new UnimplementedPeripheral(this, "PADS_BANK0_BASE")},
-      {0x40020, new UnimplementedPeripheral(this, "PADS_QSPI_BASE")},
-      {0x40024, new UnimplementedPeripheral(this, "XOSC_BASE")},
-      {0x40028, new UnimplementedPeripheral(this, "PLL_SYS_BASE")},
-      {0x4002c, new UnimplementedPeripheral(this, "PLL_USB_BASE")},
-      {0x40030, new UnimplementedPeripheral(this, "BUSCTRL_BASE")},
-      {0x40034, this->uart[0]},
-      {0x40038, this->uart[1]},
-      {0x4003c, new UnimplementedPeripheral(this, "SPI0_BASE")},
-      {0x40040, new UnimplementedPeripheral(this, "SPI1_BASE")},
-      {0x40044, new UnimplementedPeripheral(this, "I2C0_BASE")},
-      {0x40048, new UnimplementedPeripheral(this, "I2C1_BASE")},
-      {0x4004c, new UnimplementedPeripheral(this, "ADC_BASE")},
-      {0x40050, new UnimplementedPeripheral(this, "PWM_BASE")},
-      {0x40054, new RPTimer(this, "TIMER_BASE")},
-      {0x40058, new UnimplementedPeripheral(this, "WATCHDOG_BASE")},
-      {0x4005c, new UnimplementedPeripheral(this, "RTC_BASE")},
-      {0x40060, new UnimplementedPeripheral(this, "ROSC_BASE")},
-      {0x40064, new UnimplementedPeripheral(this, "VREG_AND_CHIP_RESET_BASE")},
-      {0x4006c, new UnimplementedPeripheral(this, "TBMAN_BASE")},
-  };
-
-  // Debugging
-  void onBreak(number code);
-  uint64_t getBreakCount();
+  CortexM0Core core0{this, 0};
+  CortexM0Core core1{this, 1};
+  CortexM0Core *cores[2] = {&this->core0, &this->core1};
+  // The core whose instructions are accessing the bus, for the SIO and PPB
+  // registers that each core has its own copy of. Set for the calling thread
+  // by each instruction executed; core 0 on the threads that aren't running
+  // a core of this RP2040, such as the host's.
+  CortexM0Core *currentCore() {
+    return busMaster.rp2040 == this ? busMaster.core : &this->core0;
+  }
+  void setCurrentCore(CortexM0Core *core) { busMaster = {this, core}; }
+  // Instructions each core runs before the cores synchronize: before
+  // executeCores() switches to the other core, or before the threads of
+  // executeThreaded() wait for each other
+  number quantum = 1000;
+  // Whether execute() runs each core on its own host thread. Off by default,
+  // as only executeCores() interleaves the cores deterministically.
+  bool threaded = false;
+
+  // Events the peripherals scheduled, which run on the time of core 0
+  Scheduler scheduler;
+  // Where the peripherals log the accesses to registers they don't
+  // implement
+  LogSink logSink;
+
+  RPUART *uart[2] = {new RPUART(this, "UART0", UART0_IRQ),
+                     new RPUART(this, "UART1", UART1_IRQ)};
+  RPIOBank0 *ioBank0 = new RPIOBank0(this, "IO_BANK0");
+  RPPIO *pio[2] = {new RPPIO(this, "PIO0", 0), new RPPIO(this, "PIO1", 1)};
+  RPDMA *dma = new RPDMA(this, "DMA");
+  RPSIO *sio = new RPSIO(this, "SIO");
+
+  // Bootrom, flash, SRAM and the peripherals, set up by the constructor.
+  // Boards add the models of their own devices with mapPeripheral().
+  MemoryMap memoryMap;
 
   RP2040();
   void loadBootrom(const uint32_t *bootromData, number bootromSize);
   void reset();
 
-  number getSP();
-  void setSP(number value);
-  number getLR();
-  void setLR(number value);
-  number getPC();
-  void setPC(number value);
-
-  number getAPSR();
-  void setAPSR(number value);
-  number getxPSR();
-  void setxPSR(number value);
-
-  Peripheral *findPeripheral(number address);
+  // Runs `callback` once `delay` cycles have passed on the core accessing
+  // the bus. Returns the id to cancelEvent() it with.
+  number schedule(number delay, function<void()> callback);
+  void cancelEvent(number id);
+  // Locks the peripherals that aren't thread-safe while executeThreaded()
+  // runs, for the thread-safe ones that update them
+  unique_lock<mutex> lockPeripherals();
+  // Runs the events due by the time of core 0. They run with the
+  // peripherals locked, so they mustn't go through the bus themselves.
+  void runScheduledEvents();
 
-  bool checkCondition(number cond);
   number readUint32(number address);
   number readUint16(number address);
   number readUint8(number address);
@@ -201,22 +156,16 @@ public:
   void writeUint16(number address, number value);
   void writeUint8(number address, number value);
 
-  void switchStack(STACK_POINTER_BANK stack);
-  number getSPprocess();
-  void setSPprocess(number value);
-  number getSPmain();
-  void setSPmain(number value);
-  void exceptionEntry(number exceptionNumber);
-  void exceptionReturn(number excReturn);
-  number getSvCallPriority();
-  number exceptionPriority(number n);
-  void checkForInterrupts();
-  number readSpecialRegister(number sysm);
-  void writeSpecialRegister(number sysm, number value);
-  void BXWritePC(number address);
-
-  void executeInstruction();
-  void execute();
+  // Runs each core that isn't waiting for an event for about `quantum`
+  // instructions, or until stop(), after which it runs nothing until the
+  // next execute(). Returns the number of instructions executed.
+  number executeCores();
+  // Runs each core on its own host thread until stop(), synchronizing them
+  // every `quantum` instructions. Returns the number of instructions
+  // executed.
+  number executeThreaded();
+  // Runs the cores until stop(), on their own threads if `threaded` is set
+  number execute();
   void stop();
 };
 
@@ -0,0 +1,52 @@
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+typedef uint64_t number;
+
+using namespace std;
+
+// Frequency of clk_sys, whose cycles the scheduler counts. The SDK sets it
+// to 125 MHz at startup.
+const number CLK_SYS_FREQUENCY = 125000000;
+
+// Deadline of a scheduler without events
+const number NO_DEADLINE = ~(number)0;
+
+// The events the peripherals scheduled for later points of the simulated
+// time, which is counted in clk_sys cycles. The events are kept in a
+// min-heap on their deadline, so advancing the time only compares it to the
+// earliest deadline.
+class Scheduler {
+private:
+  struct Event {
+    number deadline;
+    // Increasing, so that events due at the same cycle run in the order
+    // they were scheduled in
+    number id;
+    function<void()> callback;
+  };
+  vector<Event> events;
+  number nextId = 1;
+  number nextDeadline = NO_DEADLINE;
+
+  static bool runsLater(const Event &a, const Event &b);
+  void updateNextDeadline();
+
+public:
+  // Runs `callback` once the time reaches `deadline`. Returns the id to
+  // cancel() it with.
+  number schedule(number deadline, function<void()> callback);
+  // Drops an event that hasn't run yet, ignoring ids that aren't scheduled
+  void cancel(number id);
+  number getNextDeadline() { return this->nextDeadline; }
+
+  // Runs the events due by `cycles`, in the order of their deadlines,
+  // including those they schedule themselves
+  void runDueEvents(number cycles);
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef __UART_BRIDGE_H__
+#define __UART_BRIDGE_H__
+
+#include "peripherals/uart.h"
+#include "scheduler.h"
+#include "utils/spscqueue.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+typedef uint64_t number;
+
+using namespace std;
+
+class RP2040;
+
+// Simulated time between two moves of the received bytes into the RX FIFO.
+// Filling the 32-entry FIFO every 10 us passes up to 3.2 MB/s.
+const number UART_BRIDGE_POLL_CYCLES = CLK_SYS_FREQUENCY / 100000;
+const number UART_BRIDGE_QUEUE_SIZE = 64 * 1024;
+// How long the destructor waits for the host to take each part of what the
+// firmware sent last, in milliseconds
+const int UART_BRIDGE_DRAIN_TIMEOUT = 100;
+
+// Connects a UART to a pseudo-terminal or to the client of a Unix domain
+// socket. A thread of its own does the host I/O, without blocking, and
+// passes the bytes through lock-free queues, so the emulation never waits
+// for the host. The bytes the host sends reach the RX FIFO on a periodic
+// event of the scheduler; what the firmware sends while the TX queue is
+// full is dropped, as on a serial line nobody listens to.
+class UARTBridge {
+private:
+  RP2040 *rp2040;
+  RPUART *uart;
+  // The pty master or the socket client, and the listening socket
+  int fd = -1;
+  int listenFd = -1;
+  // The pty slave, kept open so that the master doesn't hang up while no
+  // terminal has it open
+  int slaveFd = -1;
+  // Wakes the I/O thread up when there is something to send or to stop
+  int wakeFd = -1;
+  string socketPath;
+
+  SPSCQueue<uint8_t, UART_BRIDGE_QUEUE_SIZE> rxQueue;
+  SPSCQueue<uint8_t, UART_BRIDGE_QUEUE_SIZE> txQueue;
+  // Bytes read from rxQueue that the RX FIFO had no room for yet
+  uint8_t rxPending[UART_FIFO_DEPTH];
+  number rxPendingStart = 0;
+  number rxPendingEnd = 0;
+  number pollEvent = 0;
+
+  atomic<bool> stopping = false;
+  thread ioThread;
+
+  void openPty();
+  void openSocket(const string &path);
+  void closeFds();
+  void schedulePoll();
+  void pollReceived();
+  void transmit(const uint8_t *data, number size);
+  void wake();
+  void runIO();
+
+public:
+  // Bytes the firmware sent while the TX queue was full
+  atomic<number> droppedBytes = 0;
+  // Where the host can connect: the pty slave or the socket
+  string path;
+
+  // `target` is "pty", or "unix:" followed by the path of the socket to
+  // create. Takes over the onTransmit callback of `uart`.
+  UARTBridge(RP2040 *rp2040, RPUART *uart, const string &target);
+  ~UARTBridge();
+};
+
+#endif
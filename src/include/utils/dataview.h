@@ -1,34 +1,65 @@
 #ifndef __DATA_VIEW_H__
 #define __DATA_VIEW_H__
 
+#include <bit>
 #include <cstdint>
+#include <cstring>
 
-#define SWAP16(s) (((((s)&0xff) << 8) | (((s) >> 8) & 0xff)))
+// Little-endian loads and stores on emulated memory. Each one compiles to a
+// single host load or store (plus a byte swap on big-endian hosts).
+template <typename T> inline T loadLittleEndian(const uint8_t *memory) {
+  T value;
+  memcpy(&value, memory, sizeof(T));
+  if constexpr (std::endian::native == std::endian::big && sizeof(T) == 2) {
+    value = __builtin_bswap16(value);
+  } else if constexpr (std::endian::native == std::endian::big &&
+                       sizeof(T) == 4) {
+    value = __builtin_bswap32(value);
+  }
+  return value;
+}
 
-#define SWAP32(l)                                                              \
-  (((((l)&0xff000000) >> 24) | (((l)&0x00ff0000) >> 8) |                       \
-    (((l)&0x0000ff00) << 8) | (((l)&0x000000ff) << 24)))
-
-enum DATAVIEW_TYPE { UINT8_ARRAY, UINT16_ARRAY, UINT32_ARRAY };
+template <typename T> inline void storeLittleEndian(uint8_t *memory, T value) {
+  if constexpr (std::endian::native == std::endian::big && sizeof(T) == 2) {
+    value = __builtin_bswap16(value);
+  } else if constexpr (std::endian::native == std::endian::big &&
+                       sizeof(T) == 4) {
+    value = __builtin_bswap32(value);
+  }
+  memcpy(memory, &value, sizeof(T));
+}
 
+// Byte-addressed little-endian view of a memory buffer, after JavaScript's
+// DataView
 class DataView {
 private:
-  uint8_t *uint8Buffer;
-  uint16_t *uint16Buffer;
-  uint32_t *uint32Buffer;
+  uint8_t *buffer;
   uint64_t length;
-  DATAVIEW_TYPE type;
 
 public:
-  DataView(uint8_t buffer[], uint64_t length);
-  DataView(uint32_t buffer[], uint64_t length);
+  DataView(uint8_t buffer[], uint64_t length)
+      : buffer(buffer), length(length) {}
+  DataView(uint32_t buffer[], uint64_t length)
+      : buffer((uint8_t *)buffer), length(length * sizeof(uint32_t)) {}
 
-  uint8_t getUint8(uint64_t byteOffset);
-  void setUint8(uint64_t byteOffset, uint8_t value);
-  uint16_t getUint16(uint64_t byteOffset);
-  void setUint16(uint64_t byteOffset, uint16_t value);
-  uint32_t getUint32(uint64_t byteOffset);
-  void setUint32(uint64_t byteOffset, uint32_t value);
+  uint8_t getUint8(uint64_t byteOffset) {
+    return loadLittleEndian<uint8_t>(this->buffer + byteOffset);
+  }
+  void setUint8(uint64_t byteOffset, uint8_t value) {
+    storeLittleEndian<uint8_t>(this->buffer + byteOffset, value);
+  }
+  uint16_t getUint16(uint64_t byteOffset) {
+    return loadLittleEndian<uint16_t>(this->buffer + byteOffset);
+  }
+  void setUint16(uint64_t byteOffset, uint16_t value) {
+    storeLittleEndian<uint16_t>(this->buffer + byteOffset, value);
+  }
+  uint32_t getUint32(uint64_t byteOffset) {
+    return loadLittleEndian<uint32_t>(this->buffer + byteOffset);
+  }
+  void setUint32(uint64_t byteOffset, uint32_t value) {
+    storeLittleEndian<uint32_t>(this->buffer + byteOffset, value);
+  }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,56 @@
+#ifndef __RING_BUFFER_H__
+#define __RING_BUFFER_H__
+
+#include <cstdint>
+
+typedef uint64_t number;
+
+// A fixed-size FIFO queue. SIZE must be a power of two, so that the free
+// running counters wrap into the entries with a mask.
+template <typename T, number SIZE> class RingBuffer {
+  static_assert((SIZE & (SIZE - 1)) == 0, "SIZE must be a power of two");
+
+private:
+  T entries[SIZE] = {};
+  number pushed = 0;
+  number popped = 0;
+
+public:
+  number size() const { return this->pushed - this->popped; }
+  number capacity() const { return SIZE; }
+  bool empty() const { return this->pushed == this->popped; }
+  bool full() const { return this->size() >= SIZE; }
+  void clear() { this->popped = this->pushed; }
+
+  // Returns false if the buffer is full
+  bool push(T value) {
+    if (this->full()) {
+      return false;
+    }
+    this->entries[this->pushed++ & (SIZE - 1)] = value;
+    return true;
+  }
+
+  // Returns false if the buffer is empty
+  bool pop(T &value) {
+    if (this->empty()) {
+      return false;
+    }
+    value = this->entries[this->popped++ & (SIZE - 1)];
+    return true;
+  }
+
+  // Passes the whole content to `consumer` as at most two contiguous
+  // spans, oldest first, and empties the buffer
+  template <typename F> void drain(F consumer) {
+    while (!this->empty()) {
+      const number head = this->popped & (SIZE - 1);
+      const number count = head + this->size() > SIZE ? SIZE - head
+                                                      : this->size();
+      consumer(&this->entries[head], count);
+      this->popped += count;
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef __SPSC_QUEUE_H__
+#define __SPSC_QUEUE_H__
+
+#include <atomic>
+#include <cstdint>
+
+typedef uint64_t number;
+
+using namespace std;
+
+// A bounded queue between one producer thread and one consumer thread,
+// like the SIO FIFOs: each side only writes its own counter, so the two
+// counters are all the synchronization it needs. SIZE must be a power of
+// two.
+template <typename T, number SIZE> class SPSCQueue {
+  static_assert((SIZE & (SIZE - 1)) == 0, "SIZE must be a power of two");
+
+private:
+  T entries[SIZE] = {};
+  atomic<number> pushed = 0;
+  atomic<number> popped = 0;
+
+public:
+  // From either side, the size may be out of date by the time it returns
+  number size() const {
+    return this->pushed.load(memory_order_acquire) -
+           this->popped.load(memory_order_acquire);
+  }
+
+  // Called by the producer. Returns how many of the values fit.
+  number write(const T *values, number count) {
+    const number tail = this->pushed.load(memory_order_relaxed);
+    const number head = this->popped.load(memory_order_acquire);
+    const number space = SIZE - (tail - head);
+    if (count > space) {
+      count = space;
+    }
+    for (number i = 0; i < count; i++) {
+      this->entries[(tail + i) & (SIZE - 1)] = values[i];
+    }
+    this->pushed.store(tail + count, memory_order_release);
+    return count;
+  }
+
+  // Called by the consumer. Returns how many values it read.
+  number read(T *values, number count) {
+    const number head = this->popped.load(memory_order_relaxed);
+    const number available = this->pushed.load(memory_order_acquire) - head;
+    if (count > available) {
+      count = available;
+    }
+    for (number i = 0; i < count; i++) {
+      values[i] = this->entries[(head + i) & (SIZE - 1)];
+    }
+    this->popped.store(head + count, memory_order_release);
+    return count;
+  }
+};
+
+#endif
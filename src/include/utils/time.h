@@ -1,10 +0,0 @@
-#ifndef __TIME_H__
-#define __TIME_H__
-
-#include <cstdint>
-
-typedef uint64_t number;
-
-number getCurrentMicroseconds();
-
-#endif
\ No newline at end of file
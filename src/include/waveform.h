@@ -0,0 +1,61 @@
+#ifndef __WAVEFORM_H__
+#define __WAVEFORM_H__
+
+#include "peripherals/iobank0.h"
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef uint64_t number;
+
+using namespace std;
+
+class RP2040;
+
+// The file starts with WAVEFORM_MAGIC, then the clk_sys frequency, the
+// cycle recording started at and the pin levels then, as LEB128 numbers.
+// Each change follows as the cycles since the previous one, shifted left
+// by one bit, with bit 0 set when a single pin changed. That pin's number
+// comes next as one byte, or else the mask of the changed pins.
+const char WAVEFORM_MAGIC[8] = {'R', 'P', '2', '0', '4', '0', 'W', '1'};
+
+// Bytes encoded before they are handed to the writer thread
+const number WAVEFORM_CHUNK_SIZE = 64 * 1024;
+
+// Records the changes of the GPIO pins to a file. The emulation only
+// encodes them, a thread of its own writes them.
+class WaveformRecorder {
+private:
+  RP2040 *rp2040;
+  ofstream output;
+  number subscription;
+  number lastCycles;
+  vector<uint8_t> chunk;
+
+  // Chunks waiting for the writer thread
+  mutex pendingMutex;
+  condition_variable pendingReady;
+  vector<uint8_t> pending;
+  bool stopping = false;
+  thread writer;
+
+  void record(const PinChange *changes, number count);
+  void handOver();
+  void write();
+
+public:
+  WaveformRecorder(RP2040 *rp2040, const string &path);
+  // Writes the changes recorded so far before it returns
+  ~WaveformRecorder();
+};
+
+// Rewrites a recording as a Value Change Dump, with a 1 ns timescale and a
+// wire for each pin. Throws if `input` isn't a recording.
+void convertWaveformToVCD(istream &input, ostream &output);
+
+#endif
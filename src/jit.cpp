@@ -0,0 +1,1124 @@
+#ifdef RP2040_JIT
+
+#include "jit.h"
+#include "rp2040.h"
+#include <cstring>
+#include <sys/mman.h>
+
+// Host registers, numbered as in the x86-64 encodings. While a block runs rbx
+// points to the core, rbp counts the loop iterations and guest r0-r7 live
+// in r8-r15. rax, rcx, rdx, rsi and rdi are scratch registers.
+const int RAX = 0;
+const int RCX = 1;
+const int RDX = 2;
+const int RBX = 3;
+const int RSP = 4;
+const int RBP = 5;
+const int RSI = 6;
+const int RDI = 7;
+const int R12 = 12;
+const int R13 = 13;
+const int R14 = 14;
+const int R15 = 15;
+const int NO_INDEX = -1;
+
+// x86 condition codes, negated by flipping the lowest bit
+const uint8_t CC_O = 0x0;
+const uint8_t CC_B = 0x2;
+const uint8_t CC_AE = 0x3;
+const uint8_t CC_E = 0x4;
+const uint8_t CC_NE = 0x5;
+const uint8_t CC_A = 0x7;
+const uint8_t CC_S = 0x8;
+const uint8_t CC_GE = 0xd;
+const uint8_t CC_G = 0xf;
+
+// x86 opcodes, two byte ones including the 0x0f escape
+const uint32_t OP_ADD = 0x01;
+const uint32_t OP_OR = 0x09;
+const uint32_t OP_ADC = 0x11;
+const uint32_t OP_SBB = 0x19;
+const uint32_t OP_AND = 0x21;
+const uint32_t OP_SUB = 0x29;
+const uint32_t OP_XOR = 0x31;
+const uint32_t OP_CMP = 0x39;
+const uint32_t OP_TEST = 0x85;
+const uint32_t OP_MOV_STORE8 = 0x88;
+const uint32_t OP_MOV_STORE = 0x89;
+const uint32_t OP_MOV_LOAD8 = 0x8a;
+const uint32_t OP_MOV_LOAD = 0x8b;
+const uint32_t OP_LEA = 0x8d;
+const uint32_t OP_OR_LOAD8 = 0x0a;
+const uint32_t OP_XOR_LOAD8 = 0x32;
+const uint32_t OP_CMP_LOAD8 = 0x3a;
+const uint32_t OP_IMUL = 0x0faf;
+const uint32_t OP_MOVZX8 = 0x0fb6;
+const uint32_t OP_MOVZX16 = 0x0fb7;
+const uint32_t OP_MOVSX8 = 0x0fbe;
+const uint32_t OP_MOVSX16 = 0x0fbf;
+
+// Extensions of the 0x81 / 0x83 immediate group
+const int EXT_ADD = 0;
+const int EXT_SUB = 5;
+const int EXT_CMP = 7;
+
+// APSR flags
+const uint8_t FLAG_N = 1;
+const uint8_t FLAG_Z = 2;
+const uint8_t FLAG_C = 4;
+const uint8_t FLAG_V = 8;
+const uint8_t ALL_FLAGS = FLAG_N | FLAG_Z | FLAG_C | FLAG_V;
+
+static int hostRegister(number guest) { return 8 + guest; }
+
+// Slow paths of the loads and stores. `cycles` are those the block ran for
+// before the access, which the clock of the core catches up with first so
+// that the peripherals see the time the access happens at.
+static void jitCatchUp(CortexM0Core *cpu, uint32_t cycles) {
+  cpu->advanceCycles(cycles - cpu->nativeCycles);
+  cpu->nativeCycles = cycles;
+}
+static uint32_t jitReadUint32(CortexM0Core *cpu, uint32_t address,
+                              uint32_t cycles) {
+  jitCatchUp(cpu, cycles);
+  return cpu->readUint32(address);
+}
+static uint32_t jitReadUint16(CortexM0Core *cpu, uint32_t address,
+                              uint32_t cycles) {
+  jitCatchUp(cpu, cycles);
+  return cpu->readUint16(address);
+}
+static uint32_t jitReadUint8(CortexM0Core *cpu, uint32_t address,
+                             uint32_t cycles) {
+  jitCatchUp(cpu, cycles);
+  return cpu->readUint8(address);
+}
+static void jitWriteUint32(CortexM0Core *cpu, uint32_t address,
+                           uint32_t value, uint32_t cycles) {
+  jitCatchUp(cpu, cycles);
+  cpu->writeUint32(address, value);
+}
+static void jitWriteUint16(CortexM0Core *cpu, uint32_t address,
+                           uint32_t value, uint32_t cycles) {
+  jitCatchUp(cpu, cycles);
+  cpu->writeUint16(address, value);
+}
+static void jitWriteUint8(CortexM0Core *cpu, uint32_t address, uint32_t value,
+                          uint32_t cycles) {
+  jitCatchUp(cpu, cycles);
+  cpu->writeUint8(address, value);
+}
+
+class X86Emitter {
+public:
+  vector<uint8_t> code;
+
+  void byte(uint8_t value) { this->code.push_back(value); }
+
+  void dword(uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+      this->byte(value >> (8 * i));
+    }
+  }
+
+  void qword(uint64_t value) {
+    this->dword(value);
+    this->dword(value >> 32);
+  }
+
+  void opcode(uint32_t opcode) {
+    if (opcode > 0xff) {
+      this->byte(opcode >> 8);
+    }
+    this->byte(opcode);
+  }
+
+  // Only emitted when one of the registers is r8-r15 or for 64-bit operands
+  void rex(bool w, int reg, int index, int base) {
+    const uint8_t prefix = 0x40 | (w << 3) | ((reg >> 3) << 2) |
+                           ((index >> 3) << 1) | (base >> 3);
+    if (prefix != 0x40) {
+      this->byte(prefix);
+    }
+  }
+
+  // <opcode> between `reg` and the register `rm`
+  void registerOp(uint32_t opcode, int reg, int rm, bool w = false) {
+    this->rex(w, reg, 0, rm);
+    this->opcode(opcode);
+    this->byte(0xc0 | ((reg & 7) << 3) | (rm & 7));
+  }
+
+  // <opcode> between `reg` and [base + index + disp]
+  void memoryOp(uint32_t opcode, int reg, int base, int index, int32_t disp) {
+    this->rex(false, reg, index == NO_INDEX ? 0 : index, base);
+    this->opcode(opcode);
+    if (index == NO_INDEX && (base & 7) != RSP) {
+      this->byte(0x80 | ((reg & 7) << 3) | (base & 7));
+    } else {
+      this->byte(0x80 | ((reg & 7) << 3) | RSP);
+      this->byte((((index == NO_INDEX ? RSP : index) & 7) << 3) |
+                 (base & 7));
+    }
+    this->dword(disp);
+  }
+
+  // <ext> rm, imm32 from the 0x81 / 0x83 group
+  void immediateOp(int ext, int rm, uint32_t imm) {
+    this->rex(false, 0, 0, rm);
+    if ((int32_t)imm == (int8_t)imm) {
+      this->byte(0x83);
+      this->byte(0xc0 | (ext << 3) | (rm & 7));
+      this->byte(imm);
+    } else {
+      this->byte(0x81);
+      this->byte(0xc0 | (ext << 3) | (rm & 7));
+      this->dword(imm);
+    }
+  }
+
+  // reg = rm * imm
+  void imulImmediate(int reg, int rm, uint32_t imm) {
+    this->rex(false, reg, 0, rm);
+    this->byte(0x69);
+    this->byte(0xc0 | ((reg & 7) << 3) | (rm & 7));
+    this->dword(imm);
+  }
+
+  void movImmediate(int reg, uint32_t imm) {
+    this->rex(false, 0, 0, reg);
+    this->byte(0xb8 + (reg & 7));
+    this->dword(imm);
+  }
+
+  void movImmediate64(int reg, uint64_t imm) {
+    this->rex(true, 0, 0, reg);
+    this->byte(0xb8 + (reg & 7));
+    this->qword(imm);
+  }
+
+  // <opcode> r/m, imm where `ext` selects the operation
+  void shiftImmediate(int ext, int rm, uint8_t imm) {
+    this->rex(false, 0, 0, rm);
+    this->byte(0xc1);
+    this->byte(0xc0 | (ext << 3) | (rm & 7));
+    this->byte(imm);
+  }
+
+  void testImmediate(int rm, uint32_t imm) {
+    this->rex(false, 0, 0, rm);
+    this->byte(0xf7);
+    this->byte(0xc0 | (rm & 7));
+    this->dword(imm);
+  }
+
+  void cmpByteImmediate(int base, int32_t disp, uint8_t imm) {
+    this->memoryOp(0x80, EXT_CMP, base, NO_INDEX, disp);
+    this->byte(imm);
+  }
+
+  void movByteImmediate(int base, int32_t disp, uint8_t imm) {
+    this->memoryOp(0xc6, 0, base, NO_INDEX, disp);
+    this->byte(imm);
+  }
+
+  void setcc(uint8_t cc, int base, int32_t disp) {
+    this->memoryOp(0x0f90 | cc, 0, base, NO_INDEX, disp);
+  }
+
+  void push(int reg) {
+    this->rex(false, 0, 0, reg);
+    this->byte(0x50 + (reg & 7));
+  }
+
+  void pop(int reg) {
+    this->rex(false, 0, 0, reg);
+    this->byte(0x58 + (reg & 7));
+  }
+
+  void call(const void *function) {
+    this->movImmediate64(RAX, (uint64_t)function);
+    this->byte(0xff);
+    this->byte(0xd0);
+  }
+
+  // Jumps return the position of their displacement, for bind()
+  size_t jump(uint8_t cc) {
+    this->byte(0x0f);
+    this->byte(0x80 | cc);
+    this->dword(0);
+    return this->code.size() - 4;
+  }
+
+  size_t jump() {
+    this->byte(0xe9);
+    this->dword(0);
+    return this->code.size() - 4;
+  }
+
+  void jumpBack(size_t target) {
+    this->byte(0xe9);
+    this->dword(target - (this->code.size() + 4));
+  }
+
+  // Points the jump at `position` to the current end of the code
+  void bind(size_t position) {
+    const uint32_t displacement = this->code.size() - (position + 4);
+    memcpy(&this->code[position], &displacement, 4);
+  }
+};
+
+// Flags each operation writes and reads, for the liveness analysis
+static uint8_t flagsWritten(JIT_OPERATION operation, const Instruction &instr) {
+  switch (operation) {
+  case JIT_ADCS:
+  case JIT_ADDS_ENCODING_T1:
+  case JIT_ADDS_ENCODING_T2:
+  case JIT_ADDS_REGISTER:
+  case JIT_CMP_IMMEDIATE:
+  case JIT_CMP_REGISTER:
+  case JIT_CMP_REGISTER_T2:
+  case JIT_RSBS:
+  case JIT_SBCS:
+  case JIT_SUBS_ENCODING_T1:
+  case JIT_SUBS_ENCODING_T2:
+  case JIT_SUBS_REGISTER:
+    return ALL_FLAGS;
+  case JIT_LSLS_IMMEDIATE:
+    return instr.imm ? FLAG_N | FLAG_Z | FLAG_C : FLAG_N | FLAG_Z;
+  case JIT_ASRS_IMMEDIATE:
+  case JIT_LSRS_IMMEDIATE:
+    return FLAG_N | FLAG_Z | FLAG_C;
+  case JIT_ANDS:
+  case JIT_BICS:
+  case JIT_EORS:
+  case JIT_MOVS:
+  case JIT_MULS:
+  case JIT_MVNS:
+  case JIT_ORRS:
+  case JIT_TST:
+    return FLAG_N | FLAG_Z;
+  default:
+    return 0;
+  }
+}
+
+static uint8_t conditionFlags(number cond) {
+  static const uint8_t flags[8] = {FLAG_Z,          FLAG_C,
+                                   FLAG_N,          FLAG_V,
+                                   FLAG_C | FLAG_Z, FLAG_N | FLAG_V,
+                                   ALL_FLAGS & ~FLAG_C, 0};
+  return flags[cond >> 1];
+}
+
+static uint8_t flagsRead(JIT_OPERATION operation, const Instruction &instr) {
+  switch (operation) {
+  case JIT_ADCS:
+  case JIT_SBCS:
+    return FLAG_C;
+  case JIT_B_CONDITIONAL:
+    return conditionFlags(instr.cond);
+  default:
+    return 0;
+  }
+}
+
+// Whether `instr` ends up in Rd
+static bool writesRd(JIT_OPERATION operation) {
+  switch (operation) {
+  case JIT_B_CONDITIONAL:
+  case JIT_B:
+  case JIT_BL:
+  case JIT_CMP_IMMEDIATE:
+  case JIT_CMP_REGISTER:
+  case JIT_CMP_REGISTER_T2:
+  case JIT_TST:
+  case JIT_ADD_SP_IMMEDIATE:
+  case JIT_SUB_SP_IMMEDIATE:
+  case JIT_STR_IMMEDIATE:
+  case JIT_STR_SP_IMMEDIATE:
+  case JIT_STR_REGISTER:
+  case JIT_STRB_IMMEDIATE:
+  case JIT_STRB_REGISTER:
+  case JIT_STRH_IMMEDIATE:
+  case JIT_STRH_REGISTER:
+    return false;
+  default:
+    return true;
+  }
+}
+
+// Operand combinations left to the interpreter, mostly reads and writes of
+// the PC
+static bool isCompilable(JIT_OPERATION operation, const Instruction &instr) {
+  switch (operation) {
+  case JIT_UNSUPPORTED:
+    return false;
+  case JIT_MOV:
+    return instr.Rd != PC_REGISTER;
+  case JIT_ADD_REGISTER:
+    return instr.Rd != PC_REGISTER && instr.Rm != PC_REGISTER;
+  case JIT_CMP_REGISTER_T2:
+    return instr.Rn != PC_REGISTER && instr.Rm != PC_REGISTER;
+  case JIT_ASRS_IMMEDIATE:
+  case JIT_LSRS_IMMEDIATE:
+    return instr.imm != 0;
+  case JIT_B_CONDITIONAL:
+    return instr.cond < 0b1110;
+  default:
+    return true;
+  }
+}
+
+class BlockCompiler {
+private:
+  CortexM0Core *cpu;
+  Block *block;
+  const vector<JIT_OPERATION> &operations;
+  X86Emitter emitter;
+
+  // Compiled instructions, their addresses, the cycles of the block before
+  // them and the flags live after them
+  number count = 0;
+  vector<number> addresses;
+  vector<number> startCycles;
+  vector<uint8_t> liveFlags;
+  // Guest low registers the block touches and writes
+  uint8_t usedRegisters = 0;
+  uint8_t writtenRegisters = 0;
+
+  // Flags whose current value is only in the host EFLAGS. x86 subtractions
+  // leave the borrow in CF, the inverse of the ARM carry.
+  uint8_t hostFlags = 0;
+  bool carryInverted = false;
+
+  size_t loopHead = 0;
+
+  // The cores live inside the RP2040, so its SRAM and flash are in reach of
+  // a 32-bit displacement from rbx too
+  int32_t offsetOf(const void *field) {
+    return (const uint8_t *)field - (const uint8_t *)this->cpu;
+  }
+
+  int32_t registerOffset(number guest) {
+    return this->offsetOf(&this->cpu->registers[guest]);
+  }
+
+  int32_t flagOffset(uint8_t flag) {
+    switch (flag) {
+    case FLAG_N:
+      return this->offsetOf(&this->cpu->flags.negative);
+    case FLAG_Z:
+      return this->offsetOf(&this->cpu->flags.zero);
+    case FLAG_C:
+      return this->offsetOf(&this->cpu->flags.carry);
+    default:
+      return this->offsetOf(&this->cpu->flags.overflow);
+    }
+  }
+
+  uint8_t liveBefore(number index) {
+    const Instruction &instr = this->block->instructions[index];
+    const JIT_OPERATION operation = this->operations[index];
+    return (this->liveFlags[index] & ~flagsWritten(operation, instr)) |
+           flagsRead(operation, instr);
+  }
+
+  void analyze();
+  void loadGuest(int host, number guest, number pc);
+  void storeGuest(number guest, int host);
+  void loadRegisters(uint8_t mask);
+  void storeRegisters(uint8_t mask);
+  void materializeFlags(uint8_t mask);
+  void clobberFlags(number index);
+  void setHostFlags(uint8_t flags, bool carryInverted);
+  void emitExit(number resume, number pc);
+  void emitElapsedCycles(int host, number index);
+  void emitCall(const void *function, number index);
+  size_t emitRangeCheck(number start, number size, number accessSize);
+  void emitLoad(number index, number accessSize, bool isSigned);
+  void emitStore(number index, number accessSize);
+  void emitBranch(number index, number target, bool conditional);
+  void emitInstruction(number index);
+
+public:
+  BlockCompiler(CortexM0Core *cpu, Block *block,
+                const vector<JIT_OPERATION> &operations)
+      : cpu(cpu), block(block), operations(operations) {}
+
+  // Returns false if there is nothing to compile
+  bool compile();
+  const vector<uint8_t> &code() { return this->emitter.code; }
+};
+
+void BlockCompiler::analyze() {
+  number address = this->block->address;
+  number cycles = 0;
+  while (this->count < this->block->instructions.size() &&
+         isCompilable(this->operations[this->count],
+                      this->block->instructions[this->count])) {
+    const Instruction &instr = this->block->instructions[this->count];
+    this->addresses.push_back(address);
+    this->startCycles.push_back(cycles);
+    address += instr.size;
+    cycles += instr.cycles;
+    for (number reg : {instr.Rd, instr.Rn, instr.Rm}) {
+      if (reg < 8) {
+        this->usedRegisters |= 1 << reg;
+      }
+    }
+    if (instr.Rd < 8 && writesRd(this->operations[this->count])) {
+      this->writtenRegisters |= 1 << instr.Rd;
+    }
+    this->count++;
+  }
+  this->addresses.push_back(address);
+  // Every flag is live when the native code returns
+  this->liveFlags.resize(this->count);
+  uint8_t live = ALL_FLAGS;
+  for (number i = this->count; i-- > 0;) {
+    this->liveFlags[i] = live;
+    live = this->liveBefore(i);
+  }
+}
+
+// The PC reads as the address of the instruction plus 4
+void BlockCompiler::loadGuest(int host, number guest, number pc) {
+  if (guest < 8) {
+    this->emitter.registerOp(OP_MOV_STORE, hostRegister(guest), host);
+  } else if (guest == PC_REGISTER) {
+    this->emitter.movImmediate(host, pc + 4);
+  } else {
+    this->emitter.memoryOp(OP_MOV_LOAD, host, RBX, NO_INDEX,
+                           this->registerOffset(guest));
+  }
+}
+
+void BlockCompiler::storeGuest(number guest, int host) {
+  if (guest < 8) {
+    this->emitter.registerOp(OP_MOV_STORE, host, hostRegister(guest));
+  } else {
+    this->emitter.memoryOp(OP_MOV_STORE, host, RBX, NO_INDEX,
+                           this->registerOffset(guest));
+  }
+}
+
+void BlockCompiler::loadRegisters(uint8_t mask) {
+  for (number guest = 0; guest < 8; guest++) {
+    if (mask & (1 << guest)) {
+      this->emitter.memoryOp(OP_MOV_LOAD, hostRegister(guest), RBX, NO_INDEX,
+                             this->registerOffset(guest));
+    }
+  }
+}
+
+void BlockCompiler::storeRegisters(uint8_t mask) {
+  for (number guest = 0; guest < 8; guest++) {
+    if (mask & (1 << guest)) {
+      this->emitter.memoryOp(OP_MOV_STORE, hostRegister(guest), RBX, NO_INDEX,
+                             this->registerOffset(guest));
+    }
+  }
+}
+
+// Writes the flags in `mask` that only exist in EFLAGS back to the core
+void BlockCompiler::materializeFlags(uint8_t mask) {
+  const uint8_t flags = this->hostFlags & mask;
+  if (flags & FLAG_N) {
+    this->emitter.setcc(CC_S, RBX, this->flagOffset(FLAG_N));
+  }
+  if (flags & FLAG_Z) {
+    this->emitter.setcc(CC_E, RBX, this->flagOffset(FLAG_Z));
+  }
+  if (flags & FLAG_C) {
+    this->emitter.setcc(this->carryInverted ? CC_AE : CC_B, RBX,
+                        this->flagOffset(FLAG_C));
+  }
+  if (flags & FLAG_V) {
+    this->emitter.setcc(CC_O, RBX, this->flagOffset(FLAG_V));
+  }
+  this->hostFlags &= ~mask;
+}
+
+// Called before emitting host code that overwrites EFLAGS. Flags that
+// instruction `index` overwrites or that are never read again are dropped.
+void BlockCompiler::clobberFlags(number index) {
+  this->materializeFlags(this->liveBefore(index));
+  this->hostFlags = 0;
+}
+
+void BlockCompiler::setHostFlags(uint8_t flags, bool carryInverted) {
+  this->hostFlags = flags;
+  this->carryInverted = carryInverted;
+}
+
+// Leaves the native code with the PC at `pc`, `resume` being the index of
+// the first instruction the interpreter still has to run
+void BlockCompiler::emitExit(number resume, number pc) {
+  const uint8_t hostFlags = this->hostFlags;
+  this->materializeFlags(ALL_FLAGS);
+  this->hostFlags = hostFlags;
+  this->storeRegisters(this->writtenRegisters);
+  this->emitter.memoryOp(0xc7, 0, RBX, NO_INDEX,
+                         this->registerOffset(PC_REGISTER));
+  this->emitter.dword(pc);
+  // rax = (iterations << 8) | resume
+  this->emitter.registerOp(OP_MOV_STORE, RBP, RAX);
+  this->emitter.shiftImmediate(4, RAX, 8);
+  this->emitter.rex(true, 0, 0, RAX);
+  this->emitter.byte(0x83);
+  this->emitter.byte(0xc8);
+  this->emitter.byte(resume);
+  this->emitter.rex(true, 0, 0, RSP);
+  this->emitter.byte(0x83);
+  this->emitter.byte(0xc4);
+  this->emitter.byte(8);
+  for (int reg : {R15, R14, R13, R12, RBP, RBX}) {
+    this->emitter.pop(reg);
+  }
+  this->emitter.byte(0xc3);
+}
+
+// Leaves in `host` the cycles the block ran for before instruction `index`:
+// the iterations so far, each ending with the branch back taken, then the
+// instructions before it. Clobbers EFLAGS.
+void BlockCompiler::emitElapsedCycles(int host, number index) {
+  this->emitter.imulImmediate(host, RBP, this->block->takenCycles);
+  this->emitter.immediateOp(EXT_ADD, host, this->startCycles[index]);
+}
+
+// Calls function(cpu, esi, edx, ecx). The callee sees the guest registers
+// and the PC as the interpreter would leave them.
+void BlockCompiler::emitCall(const void *function, number index) {
+  this->storeRegisters(this->writtenRegisters);
+  this->emitter.memoryOp(0xc7, 0, RBX, NO_INDEX,
+                         this->registerOffset(PC_REGISTER));
+  this->emitter.dword(this->addresses[index] + 2);
+  this->emitter.registerOp(OP_MOV_STORE, RBX, RDI, true);
+  this->emitter.call(function);
+  // r8-r11 are caller-saved
+  this->loadRegisters(this->usedRegisters & 0x0f);
+}
+
+// Leaves the offset into [start, start + size) in ecx for the address in esi
+// and returns the jump taken when the access falls outside of it
+size_t BlockCompiler::emitRangeCheck(number start, number size,
+                                     number accessSize) {
+  this->emitter.memoryOp(OP_LEA, RCX, RSI, NO_INDEX, -(int32_t)start);
+  this->emitter.immediateOp(EXT_CMP, RCX, size - accessSize);
+  return this->emitter.jump(CC_A);
+}
+
+// Loads from the address in esi into eax
+void BlockCompiler::emitLoad(number index, number accessSize, bool isSigned) {
+  const uint32_t opcode = accessSize == 4   ? OP_MOV_LOAD
+                          : accessSize == 2 ? (isSigned ? OP_MOVSX16
+                                                        : OP_MOVZX16)
+                                            : (isSigned ? OP_MOVSX8
+                                                        : OP_MOVZX8);
+  vector<size_t> slowPath;
+  vector<size_t> done;
+  const struct {
+    number start;
+    number size;
+    const uint8_t *memory;
+  } regions[] = {{RAM_START_ADDRESS, SRAM_SIZE, this->cpu->rp2040->sram},
+                 {FLASH_START_ADDRESS, FLASH_SIZE, this->cpu->rp2040->flash}};
+  for (const auto &region : regions) {
+    const size_t outside =
+        this->emitRangeCheck(region.start, region.size, accessSize);
+    if (accessSize > 1) {
+      this->emitter.testImmediate(RCX, accessSize - 1);
+      slowPath.push_back(this->emitter.jump(CC_NE));
+    }
+    this->emitter.memoryOp(opcode, RAX, RBX, RCX,
+                           this->offsetOf(region.memory));
+    done.push_back(this->emitter.jump());
+    this->emitter.bind(outside);
+  }
+  for (size_t jump : slowPath) {
+    this->emitter.bind(jump);
+  }
+  if (accessSize == 4) {
+    // Unaligned word reads fault, let the interpreter raise the error
+    this->emitter.testImmediate(RSI, 3);
+    const size_t aligned = this->emitter.jump(CC_E);
+    this->emitExit(index, this->addresses[index]);
+    this->emitter.bind(aligned);
+  }
+  this->emitElapsedCycles(RDX, index);
+  this->emitCall(accessSize == 4   ? (const void *)jitReadUint32
+                 : accessSize == 2 ? (const void *)jitReadUint16
+                                   : (const void *)jitReadUint8,
+                 index);
+  if (isSigned) {
+    this->emitter.registerOp(accessSize == 2 ? OP_MOVSX16 : OP_MOVSX8, RAX,
+                             RAX);
+  }
+  for (size_t jump : done) {
+    this->emitter.bind(jump);
+  }
+}
+
+// Stores edx to the address in esi. Only SRAM is written directly, since
+// writes to the bootrom and flash have to invalidate the translated code.
+void BlockCompiler::emitStore(number index, number accessSize) {
+  const size_t outside =
+      this->emitRangeCheck(RAM_START_ADDRESS, SRAM_SIZE, accessSize);
+  size_t unaligned = 0;
+  if (accessSize > 1) {
+    this->emitter.testImmediate(RCX, accessSize - 1);
+    unaligned = this->emitter.jump(CC_NE);
+  }
+  if (accessSize == 2) {
+    this->emitter.byte(0x66);
+  }
+  this->emitter.memoryOp(accessSize == 1 ? OP_MOV_STORE8 : OP_MOV_STORE, RDX,
+                         RBX, RCX, this->offsetOf(this->cpu->rp2040->sram));
+  const size_t done = this->emitter.jump();
+  this->emitter.bind(outside);
+  if (accessSize > 1) {
+    this->emitter.bind(unaligned);
+  }
+  this->emitElapsedCycles(RCX, index);
+  this->emitCall(accessSize == 4   ? (const void *)jitWriteUint32
+                 : accessSize == 2 ? (const void *)jitWriteUint16
+                                   : (const void *)jitWriteUint8,
+                 index);
+  this->emitter.bind(done);
+}
+
+// Emits the exits of B, B<c> and BL. A block branching back to its start
+// keeps looping in native code.
+void BlockCompiler::emitBranch(number index, number target, bool conditional) {
+  size_t taken = 0;
+  if (conditional) {
+    const number cond = this->block->instructions[index].cond;
+    const uint8_t needed = conditionFlags(cond);
+    uint8_t cc = 0;
+    bool inHost = (this->hostFlags & needed) == needed;
+    switch (cond >> 1) {
+    case 0b000:
+      cc = CC_E;
+      break;
+    case 0b001:
+      cc = this->carryInverted ? CC_AE : CC_B;
+      break;
+    case 0b010:
+      cc = CC_S;
+      break;
+    case 0b011:
+      cc = CC_O;
+      break;
+    case 0b100:
+      // C && !Z has an x86 equivalent only with the inverted carry
+      cc = CC_A;
+      inHost = inHost && this->carryInverted;
+      break;
+    case 0b101:
+      cc = CC_GE;
+      break;
+    case 0b110:
+      cc = CC_G;
+      break;
+    }
+    if (!inHost) {
+      // Evaluate the condition from the flags in memory
+      this->materializeFlags(ALL_FLAGS);
+      const int32_t N = this->flagOffset(FLAG_N);
+      const int32_t Z = this->flagOffset(FLAG_Z);
+      const int32_t C = this->flagOffset(FLAG_C);
+      const int32_t V = this->flagOffset(FLAG_V);
+      switch (cond >> 1) {
+      case 0b000:
+      case 0b001:
+      case 0b010:
+      case 0b011:
+        this->emitter.cmpByteImmediate(
+            RBX, (cond >> 1) == 0 ? Z : (cond >> 1) == 1 ? C
+                                     : (cond >> 1) == 2 ? N
+                                                        : V,
+            0);
+        cc = CC_NE;
+        break;
+      case 0b100:
+        this->emitter.memoryOp(OP_MOV_LOAD8, RAX, RBX, NO_INDEX, C);
+        this->emitter.memoryOp(OP_CMP_LOAD8, RAX, RBX, NO_INDEX, Z);
+        cc = CC_A;
+        break;
+      case 0b101:
+        this->emitter.memoryOp(OP_MOV_LOAD8, RAX, RBX, NO_INDEX, N);
+        this->emitter.memoryOp(OP_CMP_LOAD8, RAX, RBX, NO_INDEX, V);
+        cc = CC_E;
+        break;
+      case 0b110:
+        this->emitter.memoryOp(OP_MOV_LOAD8, RAX, RBX, NO_INDEX, N);
+        this->emitter.memoryOp(OP_XOR_LOAD8, RAX, RBX, NO_INDEX, V);
+        this->emitter.memoryOp(OP_OR_LOAD8, RAX, RBX, NO_INDEX, Z);
+        cc = CC_E;
+        break;
+      }
+    }
+    if (cond & 1) {
+      cc ^= 1;
+    }
+    taken = this->emitter.jump(cc);
+    this->emitExit(index + 1, this->addresses[index + 1]);
+    this->emitter.bind(taken);
+  }
+  if (target == this->block->address &&
+      index + 1 == this->block->instructions.size()) {
+    this->materializeFlags(ALL_FLAGS);
+    vector<size_t> leave;
+    this->emitter.immediateOp(EXT_CMP, RBP, JIT_LOOP_ITERATIONS - 1);
+    leave.push_back(this->emitter.jump(CC_AE));
+    this->emitter.cmpByteImmediate(
+        RBX, this->offsetOf(&this->cpu->interruptsUpdated), 0);
+    leave.push_back(this->emitter.jump(CC_NE));
+    // Stores may have invalidated the block
+    this->emitter.movImmediate64(RAX, (uint64_t)&this->block->valid);
+    this->emitter.cmpByteImmediate(RAX, 0, 0);
+    leave.push_back(this->emitter.jump(CC_E));
+    this->emitter.immediateOp(EXT_ADD, RBP, 1);
+    this->emitter.jumpBack(this->loopHead);
+    for (size_t jump : leave) {
+      this->emitter.bind(jump);
+    }
+  }
+  this->emitExit(index + 1, target);
+}
+
+void BlockCompiler::emitInstruction(number index) {
+  const Instruction &instr = this->block->instructions[index];
+  const number address = this->addresses[index];
+  const int Rd = hostRegister(instr.Rd);
+  const int Rn = hostRegister(instr.Rn);
+  const int Rm = hostRegister(instr.Rm);
+  X86Emitter &e = this->emitter;
+  switch (this->operations[index]) {
+  case JIT_ADCS:
+    this->clobberFlags(index);
+    // CF = C
+    e.memoryOp(OP_MOV_LOAD8, RCX, RBX, NO_INDEX, this->flagOffset(FLAG_C));
+    e.byte(0x80);
+    e.byte(0xc1);
+    e.byte(0xff);
+    e.registerOp(OP_ADC, Rm, Rd);
+    this->setHostFlags(ALL_FLAGS, false);
+    break;
+  case JIT_SBCS:
+    this->clobberFlags(index);
+    // CF = !C
+    e.cmpByteImmediate(RBX, this->flagOffset(FLAG_C), 1);
+    e.registerOp(OP_SBB, Rm, Rd);
+    this->setHostFlags(ALL_FLAGS, true);
+    break;
+  case JIT_ADD_REGISTER_SP_IMMEDIATE:
+    e.memoryOp(OP_MOV_LOAD, RAX, RBX, NO_INDEX, this->registerOffset(13));
+    e.memoryOp(OP_LEA, Rd, RAX, NO_INDEX, instr.imm << 2);
+    break;
+  case JIT_ADD_SP_IMMEDIATE:
+  case JIT_SUB_SP_IMMEDIATE: {
+    const int32_t imm32 = instr.imm << 2;
+    e.memoryOp(OP_MOV_LOAD, RAX, RBX, NO_INDEX, this->registerOffset(13));
+    e.memoryOp(OP_LEA, RAX, RAX, NO_INDEX,
+               this->operations[index] == JIT_ADD_SP_IMMEDIATE ? imm32
+                                                               : -imm32);
+    e.memoryOp(OP_MOV_STORE, RAX, RBX, NO_INDEX, this->registerOffset(13));
+    break;
+  }
+  case JIT_ADDS_ENCODING_T1:
+  case JIT_ADDS_ENCODING_T2:
+  case JIT_SUBS_ENCODING_T1:
+  case JIT_SUBS_ENCODING_T2: {
+    const JIT_OPERATION operation = this->operations[index];
+    const bool isAdd = operation == JIT_ADDS_ENCODING_T1 ||
+                       operation == JIT_ADDS_ENCODING_T2;
+    const bool isT1 = operation == JIT_ADDS_ENCODING_T1 ||
+                      operation == JIT_SUBS_ENCODING_T1;
+    if (isT1 && Rd != Rn) {
+      e.registerOp(OP_MOV_STORE, Rn, Rd);
+    }
+    this->clobberFlags(index);
+    e.immediateOp(isAdd ? EXT_ADD : EXT_SUB, Rd, instr.imm);
+    this->setHostFlags(ALL_FLAGS, !isAdd);
+    break;
+  }
+  case JIT_ADDS_REGISTER:
+  case JIT_SUBS_REGISTER: {
+    const bool isAdd = this->operations[index] == JIT_ADDS_REGISTER;
+    e.registerOp(OP_MOV_STORE, Rn, RAX);
+    this->clobberFlags(index);
+    e.registerOp(isAdd ? OP_ADD : OP_SUB, Rm, RAX);
+    e.registerOp(OP_MOV_STORE, RAX, Rd);
+    this->setHostFlags(ALL_FLAGS, !isAdd);
+    break;
+  }
+  case JIT_ADD_REGISTER:
+    // No flags, so lea instead of add
+    this->loadGuest(RAX, instr.Rd, address);
+    this->loadGuest(RCX, instr.Rm, address);
+    e.memoryOp(OP_LEA, RAX, RAX, RCX, 0);
+    this->storeGuest(instr.Rd, RAX);
+    break;
+  case JIT_ADR:
+    e.movImmediate(Rd, (address & 0xfffffffc) + 4 + (instr.imm << 2));
+    break;
+  case JIT_ANDS:
+  case JIT_EORS:
+  case JIT_ORRS:
+    this->clobberFlags(index);
+    e.registerOp(this->operations[index] == JIT_ANDS   ? OP_AND
+                 : this->operations[index] == JIT_EORS ? OP_XOR
+                                                       : OP_OR,
+                 Rm, Rd);
+    this->setHostFlags(FLAG_N | FLAG_Z, false);
+    break;
+  case JIT_BICS:
+    e.registerOp(OP_MOV_STORE, Rm, RAX);
+    e.registerOp(0xf7, 2, RAX); // not eax
+    this->clobberFlags(index);
+    e.registerOp(OP_AND, RAX, Rd);
+    this->setHostFlags(FLAG_N | FLAG_Z, false);
+    break;
+  case JIT_MVNS:
+    e.registerOp(OP_MOV_STORE, Rm, Rd);
+    e.registerOp(0xf7, 2, Rd); // not
+    this->clobberFlags(index);
+    e.registerOp(OP_TEST, Rd, Rd);
+    this->setHostFlags(FLAG_N | FLAG_Z, false);
+    break;
+  case JIT_TST:
+    this->clobberFlags(index);
+    e.registerOp(OP_TEST, Rm, Rn);
+    this->setHostFlags(FLAG_N | FLAG_Z, false);
+    break;
+  case JIT_MULS:
+    this->clobberFlags(index);
+    e.registerOp(OP_IMUL, Rd, Rn);
+    e.registerOp(OP_TEST, Rd, Rd);
+    this->setHostFlags(FLAG_N | FLAG_Z, false);
+    break;
+  case JIT_MOVS:
+    // The flags are known at compile time, mov leaves EFLAGS alone
+    e.movImmediate(Rd, instr.imm);
+    this->hostFlags &= ~(FLAG_N | FLAG_Z);
+    if (this->liveFlags[index] & FLAG_N) {
+      e.movByteImmediate(RBX, this->flagOffset(FLAG_N), 0);
+    }
+    if (this->liveFlags[index] & FLAG_Z) {
+      e.movByteImmediate(RBX, this->flagOffset(FLAG_Z), instr.imm == 0);
+    }
+    break;
+  case JIT_MOV:
+    this->loadGuest(RAX, instr.Rm, address);
+    this->storeGuest(instr.Rd, RAX);
+    break;
+  case JIT_CMP_IMMEDIATE:
+    this->clobberFlags(index);
+    e.immediateOp(EXT_CMP, Rn, instr.imm);
+    this->setHostFlags(ALL_FLAGS, true);
+    break;
+  case JIT_CMP_REGISTER:
+    this->clobberFlags(index);
+    e.registerOp(OP_CMP, Rm, Rn);
+    this->setHostFlags(ALL_FLAGS, true);
+    break;
+  case JIT_CMP_REGISTER_T2:
+    this->loadGuest(RAX, instr.Rn, address);
+    this->loadGuest(RCX, instr.Rm, address);
+    this->clobberFlags(index);
+    e.registerOp(OP_CMP, RCX, RAX);
+    this->setHostFlags(ALL_FLAGS, true);
+    break;
+  case JIT_RSBS:
+    this->clobberFlags(index);
+    e.registerOp(OP_XOR, RAX, RAX);
+    e.registerOp(OP_SUB, Rn, RAX);
+    e.registerOp(OP_MOV_STORE, RAX, Rd);
+    this->setHostFlags(ALL_FLAGS, true);
+    break;
+  case JIT_LSLS_IMMEDIATE:
+  case JIT_LSRS_IMMEDIATE:
+  case JIT_ASRS_IMMEDIATE:
+    if (Rd != Rm) {
+      e.registerOp(OP_MOV_STORE, Rm, Rd);
+    }
+    this->clobberFlags(index);
+    if (instr.imm == 0) {
+      // LSLS #0 is MOVS and keeps the carry
+      e.registerOp(OP_TEST, Rd, Rd);
+      this->setHostFlags(FLAG_N | FLAG_Z, false);
+    } else {
+      const JIT_OPERATION operation = this->operations[index];
+      e.shiftImmediate(operation == JIT_LSLS_IMMEDIATE   ? 4
+                       : operation == JIT_LSRS_IMMEDIATE ? 5
+                                                         : 7,
+                       Rd, instr.imm);
+      this->setHostFlags(FLAG_N | FLAG_Z | FLAG_C, false);
+    }
+    break;
+  case JIT_REV:
+    e.registerOp(OP_MOV_STORE, Rm, Rd);
+    e.rex(false, 0, 0, Rd);
+    e.byte(0x0f);
+    e.byte(0xc8 + (Rd & 7));
+    break;
+  case JIT_SXTB:
+    e.registerOp(OP_MOVSX8, Rd, Rm);
+    break;
+  case JIT_UXTB:
+    e.registerOp(OP_MOVZX8, Rd, Rm);
+    break;
+  case JIT_UXTH:
+    e.registerOp(OP_MOVZX16, Rd, Rm);
+    break;
+  case JIT_LDR_IMMEDIATE:
+  case JIT_LDRB_IMMEDIATE:
+  case JIT_LDRH_IMMEDIATE:
+  case JIT_LDR_REGISTER:
+  case JIT_LDRB_REGISTER:
+  case JIT_LDRH_REGISTER:
+  case JIT_LDRSB:
+  case JIT_LDRSH:
+  case JIT_LDR_SP_IMMEDIATE:
+  case JIT_LDR_LITERAL:
+  case JIT_STR_IMMEDIATE:
+  case JIT_STRB_IMMEDIATE:
+  case JIT_STRH_IMMEDIATE:
+  case JIT_STR_REGISTER:
+  case JIT_STRB_REGISTER:
+  case JIT_STRH_REGISTER:
+  case JIT_STR_SP_IMMEDIATE: {
+    const JIT_OPERATION operation = this->operations[index];
+    number accessSize = 4;
+    bool isStore = false;
+    bool isSigned = false;
+    switch (operation) {
+    case JIT_LDR_IMMEDIATE:
+    case JIT_STR_IMMEDIATE:
+      e.memoryOp(OP_LEA, RSI, Rn, NO_INDEX, instr.imm << 2);
+      break;
+    case JIT_LDRB_IMMEDIATE:
+    case JIT_STRB_IMMEDIATE:
+      e.memoryOp(OP_LEA, RSI, Rn, NO_INDEX, instr.imm);
+      accessSize = 1;
+      break;
+    case JIT_LDRH_IMMEDIATE:
+    case JIT_STRH_IMMEDIATE:
+      e.memoryOp(OP_LEA, RSI, Rn, NO_INDEX, instr.imm << 1);
+      accessSize = 2;
+      break;
+    case JIT_LDR_SP_IMMEDIATE:
+    case JIT_STR_SP_IMMEDIATE:
+      e.memoryOp(OP_MOV_LOAD, RSI, RBX, NO_INDEX, this->registerOffset(13));
+      e.memoryOp(OP_LEA, RSI, RSI, NO_INDEX, instr.imm << 2);
+      break;
+    case JIT_LDR_LITERAL:
+      e.movImmediate(RSI, ((address + 4) & 0xfffffffc) + (instr.imm << 2));
+      break;
+    default:
+      e.memoryOp(OP_LEA, RSI, Rn, Rm, 0);
+      accessSize = operation == JIT_LDRB_REGISTER ||
+                           operation == JIT_STRB_REGISTER ||
+                           operation == JIT_LDRSB
+                       ? 1
+                   : operation == JIT_LDRH_REGISTER ||
+                           operation == JIT_STRH_REGISTER ||
+                           operation == JIT_LDRSH
+                       ? 2
+                       : 4;
+      isSigned = operation == JIT_LDRSB || operation == JIT_LDRSH;
+      break;
+    }
+    isStore = operation == JIT_STR_IMMEDIATE ||
+              operation == JIT_STRB_IMMEDIATE ||
+              operation == JIT_STRH_IMMEDIATE ||
+              operation == JIT_STR_REGISTER ||
+              operation == JIT_STRB_REGISTER ||
+              operation == JIT_STRH_REGISTER ||
+              operation == JIT_STR_SP_IMMEDIATE;
+    this->clobberFlags(index);
+    if (isStore) {
+      e.registerOp(OP_MOV_STORE, Rd, RDX);
+      this->emitStore(index, accessSize);
+    } else {
+      this->emitLoad(index, accessSize, isSigned);
+      e.registerOp(OP_MOV_STORE, RAX, Rd);
+    }
+    break;
+  }
+  case JIT_B:
+  case JIT_B_CONDITIONAL:
+    this->emitBranch(index, address + 4 + (int32_t)instr.imm,
+                     this->operations[index] == JIT_B_CONDITIONAL);
+    break;
+  case JIT_BL:
+    e.memoryOp(0xc7, 0, RBX, NO_INDEX, this->registerOffset(14));
+    e.dword((address + 4) | 0x1);
+    this->emitBranch(index, address + 4 + (int32_t)instr.imm, false);
+    break;
+  case JIT_UNSUPPORTED:
+    break;
+  }
+}
+
+bool BlockCompiler::compile() {
+  this->analyze();
+  if (this->count == 0) {
+    return false;
+  }
+  X86Emitter &e = this->emitter;
+  for (int reg : {RBX, RBP, R12, R13, R14, R15}) {
+    e.push(reg);
+  }
+  // Keeps the stack 16-byte aligned for the calls
+  e.rex(true, 0, 0, RSP);
+  e.byte(0x83);
+  e.byte(0xec);
+  e.byte(8);
+  e.registerOp(OP_MOV_STORE, RDI, RBX, true);
+  e.registerOp(OP_XOR, RBP, RBP);
+  this->loadRegisters(this->usedRegisters);
+  this->loopHead = e.code.size();
+  for (number index = 0; index < this->count; index++) {
+    this->emitInstruction(index);
+  }
+  const JIT_OPERATION last = this->operations[this->count - 1];
+  if (last != JIT_B && last != JIT_B_CONDITIONAL && last != JIT_BL) {
+    this->emitExit(this->count, this->addresses[this->count]);
+  }
+  return true;
+}
+
+JitCompiler::~JitCompiler() {
+  if (this->code != NULL) {
+    munmap(this->code, JIT_CODE_SIZE);
+  }
+}
+
+NativeBlock JitCompiler::compile(CortexM0Core *cpu, Block *block,
+                                 const vector<JIT_OPERATION> &operations) {
+  if (this->code == NULL) {
+    void *memory = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+      return NULL;
+    }
+    this->code = (uint8_t *)memory;
+  }
+  BlockCompiler compiler(cpu, block, operations);
+  if (!compiler.compile()) {
+    return NULL;
+  }
+  const vector<uint8_t> &code = compiler.code();
+  if (this->codeUsed + code.size() > JIT_CODE_SIZE) {
+    return NULL;
+  }
+  uint8_t *native = this->code + this->codeUsed;
+  memcpy(native, code.data(), code.size());
+  this->codeUsed += code.size();
+  return (NativeBlock)native;
+}
+
+#endif
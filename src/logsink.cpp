@@ -0,0 +1,131 @@
+#include "logsink.h"
+#include <iomanip>
+#include <sstream>
+
+LogSink::~LogSink() {
+  if (!this->started) {
+    return;
+  }
+  {
+    lock_guard<mutex> lock(this->wakeMutex);
+    this->stopping = true;
+  }
+  this->wake.notify_one();
+  this->logger.join();
+}
+
+number LogSink::registerPeripheral(const string &name) {
+  lock_guard<mutex> lock(this->drainMutex);
+  this->names.push_back(name);
+  return this->names.size() - 1;
+}
+
+void LogSink::log(number peripheral, number offset, number value, bool write,
+                  number core, number cycles) {
+  const LogRecord record = {cycles, (uint32_t)offset, (uint32_t)value,
+                            (uint16_t)peripheral, write};
+  if (!this->queues[core].write(&record, 1)) {
+    this->dropped.fetch_add(1, memory_order_relaxed);
+  }
+  if (!this->started.load(memory_order_acquire) &&
+      !this->started.exchange(true)) {
+    this->logger = thread(&LogSink::run, this);
+  }
+}
+
+void LogSink::run() {
+  unique_lock<mutex> lock(this->wakeMutex);
+  while (!this->stopping) {
+    lock.unlock();
+    this->drain();
+    lock.lock();
+    this->wake.wait_for(lock, chrono::milliseconds(10),
+                        [this]() { return this->stopping; });
+  }
+  lock.unlock();
+  this->drain();
+}
+
+void LogSink::drain() {
+  lock_guard<mutex> lock(this->drainMutex);
+  ostringstream lines;
+  LogRecord records[256];
+  for (auto &queue : this->queues) {
+    number count;
+    while ((count = queue.read(records, 256))) {
+      for (number i = 0; i < count; i++) {
+        this->print(lines, records[i]);
+      }
+    }
+  }
+  const string text = lines.str();
+  if (!text.empty()) {
+    this->output->write(text.data(), text.size());
+    this->output->flush();
+  }
+}
+
+void LogSink::print(ostream &lines, const LogRecord &record) {
+  RegisterStats &stats = this->registers[{record.peripheral, record.offset}];
+  if (record.write) {
+    stats.writes++;
+  } else {
+    stats.reads++;
+  }
+  stats.lastValue = record.value;
+  if (stats.printed >= LOG_LINES_PER_REGISTER) {
+    return;
+  }
+  const auto now = chrono::steady_clock::now();
+  if (now - this->secondStart >= chrono::seconds(1)) {
+    if (this->suppressed) {
+      lines << this->suppressed << " more accesses weren't printed" << endl;
+    }
+    this->secondStart = now;
+    this->linesThisSecond = 0;
+    this->suppressed = 0;
+  }
+  if (this->linesThisSecond >= LOG_LINES_PER_SECOND) {
+    this->suppressed++;
+    return;
+  }
+  this->linesThisSecond++;
+  stats.printed++;
+  const string &name = this->names[record.peripheral];
+  lines << "Unimplemented peripheral " << name
+        << (record.write ? " write to 0x" : " read from 0x") << hex
+        << record.offset;
+  if (record.write) {
+    lines << ": 0x" << record.value;
+  }
+  lines << dec << " at cycle " << record.cycles;
+  if (stats.printed == LOG_LINES_PER_REGISTER) {
+    lines << " (only counting the next ones)";
+  }
+  lines << endl;
+}
+
+void LogSink::flush() { this->drain(); }
+
+void LogSink::printSummary(ostream &summary) {
+  this->drain();
+  lock_guard<mutex> lock(this->drainMutex);
+  if (this->registers.empty()) {
+    return;
+  }
+  summary << "Unimplemented registers accessed:" << endl;
+  summary << left << setw(26) << "  peripheral" << setw(10) << "offset"
+          << right << setw(10) << "reads" << setw(10) << "writes"
+          << "  last value" << endl;
+  for (const auto &[key, stats] : this->registers) {
+    summary << "  " << left << setw(24) << this->names[key.first] << "0x"
+            << setw(8) << hex << key.second << right << dec << setw(10)
+            << stats.reads << setw(10) << stats.writes << "  0x" << hex
+            << stats.lastValue << dec << endl;
+  }
+  const number dropped = this->dropped.load(memory_order_relaxed);
+  if (dropped) {
+    summary << "  and " << dropped << " accesses the log queue had no room for"
+            << endl;
+  }
+}
@@ -1,6 +1,9 @@
 #include "bootrom.h"
 #include "intelhex.h"
 #include "rp2040.h"
+#include "uartbridge.h"
+#include "waveform.h"
+#include <csignal>
 #include <cstring>
 #include <fstream>
 #include <iostream>
@@ -18,6 +21,12 @@ string readHexFile(const string &path) {
                 std::istreambuf_iterator<char>());
 }
 
+RP2040 *mcu = NULL;
+
+// Ctrl-C stops the emulation, so that the output and the recordings are
+// complete
+void stopEmulation(int signal) { mcu->stop(); }
+
 int main(int argc, char *argv[]) {
   cout << "=-=-=-=-=-=-=-=-=-=-=-=" << endl;
   cout << "RP2040 Emulator v" << VERSION << endl;
@@ -29,16 +38,61 @@ int main(int argc, char *argv[]) {
   }
   string filename(argv[1]);
   string hexFile = readHexFile(filename);
-  RP2040 *mcu = new RP2040();
+  mcu = new RP2040();
   mcu->loadBootrom(bootromB1, BOOT_ROM_B1_SIZE);
   loadHex(hexFile, mcu->flash, 0x10000000);
 
-  mcu->uart[0]->onByte = [](number value) -> void {
-    cout << "UART sent: " << (char)(value) << endl;
+  // One write and flush per line, rather than per byte
+  mcu->uart[0]->onTransmit = [](const uint8_t *data, number size) -> void {
+    cout.write((const char *)data, size);
+    cout.flush();
   };
 
-  mcu->setPC(0x10000000);
+  // RP2040_WAVEFORM records the pin changes to a file, for rp2040-wave2vcd,
+  // rather than printing them
+  WaveformRecorder *waveform = NULL;
+  if (getenv("RP2040_WAVEFORM") != NULL) {
+    waveform = new WaveformRecorder(mcu, getenv("RP2040_WAVEFORM"));
+  } else {
+    // One write per batch of pin changes
+    mcu->ioBank0->subscribe([](const PinChange *changes, number count) {
+      ostringstream output;
+      for (number i = 0; i < count; i++) {
+        for (number pin = 0; pin < GPIO_PINS; pin++) {
+          if (changes[i].changed & (1 << pin)) {
+            const bool high = changes[i].values & (1 << pin);
+            output << "GPIO " << pin << " set to " << (high ? "HIGH" : "LOW")
+                   << endl;
+          }
+        }
+      }
+      cout << output.str() << flush;
+    });
+  }
+
+  // RP2040_UART0 and RP2040_UART1 connect the UARTs to a pseudo-terminal
+  // ("pty") or a Unix domain socket ("unix:<path>")
+  UARTBridge *bridges[2] = {NULL, NULL};
+  for (number i = 0; i < 2; i++) {
+    const char *target = getenv(i == 0 ? "RP2040_UART0" : "RP2040_UART1");
+    if (target != NULL) {
+      bridges[i] = new UARTBridge(mcu, mcu->uart[i], target);
+      cerr << "UART" << i << " is on " << bridges[i]->path << endl;
+    }
+  }
+
+  mcu->core0.setPC(0x10000000);
+  mcu->threaded = getenv("RP2040_THREADS") != NULL;
+  signal(SIGINT, stopEmulation);
+  signal(SIGTERM, stopEmulation);
   mcu->execute();
+  delete waveform;
+  mcu->ioBank0->flush();
+  for (number i = 0; i < 2; i++) {
+    mcu->uart[i]->flush();
+    delete bridges[i];
+  }
+  mcu->logSink.printSummary(cerr);
 
   return EXIT_SUCCESS;
 }
\ No newline at end of file
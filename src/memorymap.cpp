@@ -0,0 +1,38 @@
+#include "memorymap.h"
+#include <cstdlib>
+#include <stdexcept>
+
+MemoryMap::MemoryMap() {
+  this->pages = (MemoryPage *)calloc(MEMORY_PAGES, sizeof(MemoryPage));
+}
+
+MemoryMap::~MemoryMap() { free(this->pages); }
+
+void MemoryMap::mapMemory(number address, number size, uint8_t *memory,
+                          bool writable) {
+  for (number offset = 0; offset < size; offset += MEMORY_PAGE_SIZE) {
+    MemoryPage &page = this->pages[(address + offset) >> MEMORY_PAGE_SHIFT];
+    page = {memory + offset, writable ? memory + offset : NULL, NULL, NULL,
+            0, false};
+  }
+}
+
+void MemoryMap::mapPeripheral(const PeripheralRegion &region,
+                              Peripheral *peripheral,
+                              const PeripheralHandlers *handlers) {
+  if (((region.base | region.size) & MEMORY_PAGE_MASK) || !region.size ||
+      region.base + region.size > (number)MEMORY_PAGES << MEMORY_PAGE_SHIFT) {
+    throw new runtime_error("Peripheral region isn't a range of pages");
+  }
+  for (number offset = 0; offset < region.size; offset += MEMORY_PAGE_SIZE) {
+    MemoryPage &page = this->pages[(region.base + offset) >> MEMORY_PAGE_SHIFT];
+    if (page.read != NULL) {
+      throw new runtime_error("Peripheral region overlaps memory");
+    }
+  }
+  for (number offset = 0; offset < region.size; offset += MEMORY_PAGE_SIZE) {
+    MemoryPage &page = this->pages[(region.base + offset) >> MEMORY_PAGE_SHIFT];
+    page = {NULL, NULL, peripheral, handlers, (uint32_t)offset,
+            region.threadSafe};
+  }
+}
@@ -0,0 +1,95 @@
+#include "nvic.h"
+#include <bit>
+
+void NVIC::updateSystemPriorities() {
+  for (number priority = 0; priority < INTERRUPT_PRIORITIES_SIZE; priority++) {
+    this->systemPriorities[priority] = 0;
+  }
+  for (number exception : {EXC_SVCALL, EXC_PENDSV, EXC_SYSTICK}) {
+    const number priority = this->exceptionPriority(exception);
+    this->systemPriorities[priority] |= (number)1 << exception;
+  }
+  this->activePriority = this->exceptionPriority(this->activeException);
+}
+
+void NVIC::setSHPR2(number value) {
+  this->SHPR2 = value;
+  this->updateSystemPriorities();
+}
+
+void NVIC::setSHPR3(number value) {
+  this->SHPR3 = value;
+  this->updateSystemPriorities();
+}
+
+number NVIC::getInterruptPriority(number irq) {
+  for (number priority = 0; priority < INTERRUPT_PRIORITIES_SIZE; priority++) {
+    if (this->interruptPriorities[priority] & (1 << irq)) {
+      return priority;
+    }
+  }
+  return LOWEST_PRIORITY;
+}
+
+void NVIC::setInterruptPriority(number irq, number priority) {
+  for (number level = 0; level < INTERRUPT_PRIORITIES_SIZE; level++) {
+    this->interruptPriorities[level] &= ~(1 << irq);
+  }
+  this->interruptPriorities[priority] |= 1 << irq;
+  this->activePriority = this->exceptionPriority(this->activeException);
+}
+
+number NVIC::exceptionPriority(number exception) {
+  switch (exception) {
+  case EXC_RESET:
+  case EXC_NMI:
+  case EXC_HARDFAULT:
+    return 0;
+  case EXC_SVCALL:
+    return (uint32_t)this->SHPR2 >> 30;
+  case EXC_PENDSV:
+    return (this->SHPR3 >> 22) & 0x3;
+  case EXC_SYSTICK:
+    return (uint32_t)this->SHPR3 >> 30;
+  default:
+    if (exception < 16) {
+      return LOWEST_PRIORITY;
+    }
+    return this->getInterruptPriority(exception - 16);
+  }
+}
+
+number NVIC::takeException(number executionPriority) {
+  const number pending =
+      ((number)(uint32_t)(this->pendingInterrupts & this->enabledInterrupts)
+       << 16) |
+      ((number)this->pendingSVCall << EXC_SVCALL) |
+      ((number)this->pendingPendSV << EXC_PENDSV) |
+      ((number)this->pendingSysTick << EXC_SYSTICK);
+  if (!pending) {
+    return 0;
+  }
+  for (number priority = 0; priority < executionPriority; priority++) {
+    const number ready =
+        pending &
+        (((number)(uint32_t)this->interruptPriorities[priority] << 16) |
+         this->systemPriorities[priority]);
+    if (ready) {
+      // At the same priority, the lowest exception number goes first
+      const number exception = countr_zero(ready);
+      switch (exception) {
+      case EXC_SVCALL:
+        this->pendingSVCall = false;
+        break;
+      case EXC_PENDSV:
+        this->pendingPendSV = false;
+        break;
+      case EXC_SYSTICK:
+        this->pendingSysTick = false;
+        break;
+      }
+      return exception;
+    }
+  }
+  return 0;
+}
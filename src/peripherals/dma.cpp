@@ -0,0 +1,500 @@
+#include "peripherals/dma.h"
+#include "rp2040.h"
+#include "utils/dataview.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+// The registers of each alias of a channel, the last one triggering it
+enum DMARegister { READ_ADDR, WRITE_ADDR, TRANS_COUNT, CTRL };
+static const DMARegister aliasRegisters[4][4] = {
+    {READ_ADDR, WRITE_ADDR, TRANS_COUNT, CTRL},
+    {CTRL, READ_ADDR, WRITE_ADDR, TRANS_COUNT},
+    {CTRL, TRANS_COUNT, READ_ADDR, WRITE_ADDR},
+    {CTRL, WRITE_ADDR, TRANS_COUNT, READ_ADDR},
+};
+
+static number dataSize(number ctrl) {
+  return min<number>(1 << ((ctrl >> DMA_CTRL_DATA_SIZE_SHIFT) & 0x3), 4);
+}
+
+// Masks of the address bits that wrap for the reads and the writes
+static number ringMask(number ctrl, bool write) {
+  const number size = (ctrl >> DMA_CTRL_RING_SIZE_SHIFT) & 0xf;
+  if (!size || (bool)(ctrl & DMA_CTRL_RING_SEL) != write) {
+    return 0xffffffff;
+  }
+  return (1 << size) - 1;
+}
+
+static number addAddress(number address, number bytes, number mask) {
+  return (address & ~mask) | ((address + bytes) & mask);
+}
+
+static number swapBytes(number value, number size) {
+  if (size == 2) {
+    return ((value & 0xff) << 8) | ((value >> 8) & 0xff);
+  }
+  if (size == 4) {
+    return __builtin_bswap32(value);
+  }
+  return value;
+}
+
+// Cycles after the start a pacing timer makes its `count`th request at
+static number timerRequestCycles(number timer, number count) {
+  const number x = timer >> 16;
+  return (count * (timer & 0xffff) + x - 1) / x;
+}
+
+void RPDMA::trigger(number channel) {
+  DMAChannel &ch = this->channels[channel];
+  if (!(ch.ctrl & DMA_CTRL_EN) || ch.busy) {
+    return;
+  }
+  const number cycles = this->rp2040->currentCore()->cycles;
+  ch.busy = true;
+  ch.remaining = ch.transCount;
+  ch.transferred = 0;
+  ch.startCycles = cycles;
+  ch.busyUntil = cycles;
+  this->run(channel);
+}
+
+void RPDMA::abort(number channel) {
+  DMAChannel &ch = this->channels[channel];
+  if (ch.event) {
+    this->rp2040->cancelEvent(ch.event);
+    ch.event = 0;
+  }
+  ch.busy = false;
+  ch.remaining = 0;
+}
+
+void RPDMA::run(number channel) {
+  DMAChannel &ch = this->channels[channel];
+  const number cycles = this->rp2040->currentCore()->cycles;
+  const number timer = this->pacingTimer(ch);
+  if (ch.event) {
+    this->rp2040->cancelEvent(ch.event);
+    ch.event = 0;
+  }
+  while (ch.remaining) {
+    const number count = min(this->requests(channel, cycles), ch.remaining);
+    if (!count) {
+      break;
+    }
+    if (!this->copyMemory(ch, count)) {
+      for (number i = 0; i < count; i++) {
+        this->transfer(ch);
+      }
+    }
+    // A pacing timer made its requests at earlier cycles than this one
+    const number requested =
+        timer ? ch.startCycles +
+                    timerRequestCycles(timer, ch.transferred + count)
+              : cycles;
+    ch.remaining -= count;
+    ch.transferred += count;
+    ch.busyUntil = max(ch.busyUntil + count, requested + 1);
+  }
+  if (!ch.busy) {
+    // Aborted by one of its own transfers
+    return;
+  }
+  number delay;
+  if (!ch.remaining) {
+    delay = ch.busyUntil > cycles ? ch.busyUntil - cycles : 0;
+  } else if (timer) {
+    delay = ch.startCycles + timerRequestCycles(timer, ch.transferred + 1) -
+            cycles;
+  } else {
+    delay = DMA_POLL_CYCLES;
+  }
+  ch.event = this->rp2040->schedule(delay, [this, channel]() {
+    this->channels[channel].event = 0;
+    if (this->channels[channel].remaining) {
+      this->run(channel);
+    } else {
+      this->complete(channel);
+    }
+  });
+}
+
+void RPDMA::complete(number channel) {
+  DMAChannel &ch = this->channels[channel];
+  ch.busy = false;
+  if (!(ch.ctrl & DMA_CTRL_IRQ_QUIET)) {
+    this->intr |= 1 << channel;
+    this->updateInterrupts();
+  }
+  const number chainTo = (ch.ctrl >> DMA_CTRL_CHAIN_TO_SHIFT) & 0xf;
+  if (chainTo != channel && chainTo < DMA_CHANNELS) {
+    this->trigger(chainTo);
+  }
+}
+
+// The X/Y fraction of the pacing timer of a channel, or 0 if none paces it
+number RPDMA::pacingTimer(const DMAChannel &ch) {
+  const number treq = (ch.ctrl >> DMA_CTRL_TREQ_SEL_SHIFT) & 0x3f;
+  if (treq < TREQ_TIMER0 || treq == TREQ_PERMANENT) {
+    return 0;
+  }
+  const number timer = this->timers[treq - TREQ_TIMER0];
+  return (timer >> 16) && (timer & 0xffff) ? timer : 0;
+}
+
+number RPDMA::requests(number channel, number cycles) {
+  const DMAChannel &ch = this->channels[channel];
+  const number treq = (ch.ctrl >> DMA_CTRL_TREQ_SEL_SHIFT) & 0x3f;
+  if (treq == TREQ_PERMANENT) {
+    return ch.remaining;
+  }
+  if (treq >= TREQ_TIMER0) {
+    // X/Y requests per cycle
+    const number timer = this->pacingTimer(ch);
+    if (!timer) {
+      return 0;
+    }
+    const number allowed =
+        (cycles - ch.startCycles) * (timer >> 16) / (timer & 0xffff);
+    return allowed > ch.transferred ? allowed - ch.transferred : 0;
+  }
+  if (treq <= DREQ_PIO1_RX3) {
+    return this->rp2040->pio[treq / 8]->dreq(treq % 8);
+  }
+  if (treq >= DREQ_UART0_TX && treq <= DREQ_UART1_RX) {
+    const number uart = (treq - DREQ_UART0_TX) / 2;
+    return this->rp2040->uart[uart]->dreq(treq % 2 == 0);
+  }
+  return 1;
+}
+
+// The host memory of [address, address + size) if it is all in SRAM, or
+// for reads in one of the aliases of the flash
+uint8_t *RPDMA::hostMemory(number address, number size, bool write) {
+  if (address >= RAM_START_ADDRESS &&
+      address + size <= RAM_START_ADDRESS + SRAM_SIZE) {
+    return this->rp2040->sram + (address - RAM_START_ADDRESS);
+  }
+  if (!write && address >= FLASH_START_ADDRESS &&
+      address < FLASH_END_ADDRESS) {
+    const number offset = (address - FLASH_START_ADDRESS) % FLASH_SIZE;
+    if (offset + size <= FLASH_SIZE) {
+      return this->rp2040->flash + offset;
+    }
+  }
+  return NULL;
+}
+
+// Does `count` transfers between SRAM and flash directly on their host
+// memory, a span at a time between the wraps of the ring. Returns false if
+// either side isn't plain memory.
+bool RPDMA::copyMemory(DMAChannel &ch, number count) {
+  const number size = dataSize(ch.ctrl);
+  const bool incrRead = ch.ctrl & DMA_CTRL_INCR_READ;
+  const bool incrWrite = ch.ctrl & DMA_CTRL_INCR_WRITE;
+  const bool bswap = ch.ctrl & DMA_CTRL_BSWAP;
+  const number readMask = ringMask(ch.ctrl, false);
+  const number writeMask = ringMask(ch.ctrl, true);
+  if (readMask < size - 1 || writeMask < size - 1) {
+    return false;
+  }
+  // The addresses the transfers go through, all within the ring if any
+  auto span = [count, size](number address, bool increment, number mask) {
+    const number start = mask == 0xffffffff ? address : address & ~mask;
+    const number bytes = !increment ? size
+                         : mask == 0xffffffff ? count * size
+                                              : mask + 1;
+    return make_pair(start, bytes);
+  };
+  const auto [readStart, readBytes] = span(ch.readAddr, incrRead, readMask);
+  const auto [writeStart, writeBytes] =
+      span(ch.writeAddr, incrWrite, writeMask);
+  if (!this->hostMemory(readStart, readBytes, false) ||
+      !this->hostMemory(writeStart, writeBytes, true)) {
+    return false;
+  }
+  while (count) {
+    // Transfers until the next wrap of either address
+    number n = count;
+    if (incrRead && readMask != 0xffffffff) {
+      n = min(n, (readMask + 1 - (ch.readAddr & readMask)) / size);
+    }
+    if (incrWrite && writeMask != 0xffffffff) {
+      n = min(n, (writeMask + 1 - (ch.writeAddr & writeMask)) / size);
+    }
+    n = max<number>(n, 1);
+    const uint8_t *source = this->hostMemory(ch.readAddr, size, false);
+    uint8_t *destination = this->hostMemory(ch.writeAddr, size, true);
+    if (incrRead && incrWrite && !bswap) {
+      memmove(destination, source, n * size);
+    } else if (!incrRead && incrWrite && !bswap && size == 1) {
+      memset(destination, *source, n);
+    } else {
+      // A fill of a wider value, byte swaps, or writes to a single address
+      // where only the last value stays
+      const number first = incrWrite ? 0 : n - 1;
+      for (number i = first; i < n; i++) {
+        const uint8_t *from = source + (incrRead ? i * size : 0);
+        uint8_t *to = destination + (incrWrite ? i * size : 0);
+        number value = size == 4   ? loadLittleEndian<uint32_t>(from)
+                       : size == 2 ? loadLittleEndian<uint16_t>(from)
+                                   : *from;
+        if (bswap) {
+          value = swapBytes(value, size);
+        }
+        if (size == 4) {
+          storeLittleEndian<uint32_t>(to, value);
+        } else if (size == 2) {
+          storeLittleEndian<uint16_t>(to, value);
+        } else {
+          *to = value;
+        }
+      }
+    }
+    if (incrRead) {
+      ch.readAddr = addAddress(ch.readAddr, n * size, readMask);
+    }
+    if (incrWrite) {
+      ch.writeAddr = addAddress(ch.writeAddr, n * size, writeMask);
+    }
+    count -= n;
+  }
+  return true;
+}
+
+// Does one transfer through the peripherals
+void RPDMA::transfer(DMAChannel &ch) {
+  const number size = dataSize(ch.ctrl);
+  number value = this->readBus(ch.readAddr, size);
+  if (ch.ctrl & DMA_CTRL_BSWAP) {
+    value = swapBytes(value, size);
+  }
+  this->writeBus(ch.writeAddr, size, value);
+  if (ch.ctrl & DMA_CTRL_INCR_READ) {
+    ch.readAddr = addAddress(ch.readAddr, size, ringMask(ch.ctrl, false));
+  }
+  if (ch.ctrl & DMA_CTRL_INCR_WRITE) {
+    ch.writeAddr = addAddress(ch.writeAddr, size, ringMask(ch.ctrl, true));
+  }
+}
+
+// The DMA runs with the peripherals locked, so it accesses them directly
+// rather than through the bus, and the SIO without taking the lock again
+number RPDMA::readBus(number address, number size) {
+  address &= ~(size - 1);
+  const MemoryPage &page = this->rp2040->memoryMap.lookup(address);
+  const number offset = address & MEMORY_PAGE_MASK;
+  if (page.read != NULL) {
+    return size == 4   ? loadLittleEndian<uint32_t>(page.read + offset)
+           : size == 2 ? loadLittleEndian<uint16_t>(page.read + offset)
+                       : page.read[offset];
+  }
+  if (page.peripheral == this->rp2040->sio) {
+    return readLanes(this->rp2040->sio->readUint32Locked(offset & ~0x3),
+                     offset, size);
+  }
+  if (page.peripheral != NULL) {
+    const PeripheralHandlers *handlers = page.handlers;
+    const number peripheralOffset = page.peripheralOffset + offset;
+    return size == 4 ? handlers->readUint32(page.peripheral, peripheralOffset)
+           : size == 2
+               ? handlers->readUint16(page.peripheral, peripheralOffset)
+               : handlers->readUint8(page.peripheral, peripheralOffset);
+  }
+  return 0;
+}
+
+void RPDMA::writeBus(number address, number size, number value) {
+  address &= ~(size - 1);
+  const MemoryPage &page = this->rp2040->memoryMap.lookup(address);
+  const number offset = address & MEMORY_PAGE_MASK;
+  if (page.write != NULL) {
+    if (size == 4) {
+      storeLittleEndian<uint32_t>(page.write + offset, value);
+    } else if (size == 2) {
+      storeLittleEndian<uint16_t>(page.write + offset, value);
+    } else {
+      page.write[offset] = value;
+    }
+  } else if (page.peripheral == this->rp2040->sio) {
+    this->rp2040->sio->writeUint32Locked(
+        offset & ~0x3, size == 4 ? value : replicateLanes(value, size));
+  } else if (page.peripheral != NULL) {
+    const number peripheralOffset = page.peripheralOffset + offset;
+    if (size == 4) {
+      page.handlers->writeUint32(page.peripheral, peripheralOffset, value);
+    } else if (size == 2) {
+      page.handlers->writeUint16(page.peripheral, peripheralOffset, value);
+    } else {
+      page.handlers->writeUint8(page.peripheral, peripheralOffset, value);
+    }
+  }
+}
+
+void RPDMA::updateInterrupts() {
+  for (number n = 0; n < 2; n++) {
+    const bool pending = (this->intr | this->intf[n]) & this->inte[n];
+    for (CortexM0Core *core : this->rp2040->cores) {
+      core->setInterrupt(DMA_IRQ_0 + n, pending);
+    }
+  }
+}
+
+number RPDMA::readChannel(number offset) {
+  const DMAChannel &ch = this->channels[offset / DMA_CHANNEL_STRIDE];
+  const number alias = (offset % DMA_CHANNEL_STRIDE) / DMA_ALIAS_STRIDE;
+  switch (aliasRegisters[alias][(offset % DMA_ALIAS_STRIDE) / 4]) {
+  case READ_ADDR:
+    return ch.readAddr;
+  case WRITE_ADDR:
+    return ch.writeAddr;
+  case TRANS_COUNT: {
+    if (!ch.busy) {
+      return ch.remaining;
+    }
+    // The transfers done in bulk are still going on
+    const number cycles = this->rp2040->currentCore()->cycles;
+    const number pending = ch.busyUntil > cycles ? ch.busyUntil - cycles : 0;
+    return min(ch.remaining + pending, ch.transCount);
+  }
+  default:
+    return ch.ctrl | (ch.busy ? DMA_CTRL_BUSY : 0);
+  }
+}
+
+void RPDMA::writeChannel(number offset, number alias, number value) {
+  const number channel = offset / DMA_CHANNEL_STRIDE;
+  DMAChannel &ch = this->channels[channel];
+  const number index = (offset % DMA_ALIAS_STRIDE) / 4;
+  const DMARegister reg =
+      aliasRegisters[(offset % DMA_CHANNEL_STRIDE) / DMA_ALIAS_STRIDE][index];
+  switch (reg) {
+  case READ_ADDR:
+    ch.readAddr = atomicWriteValue(alias, ch.readAddr, value) & 0xffffffff;
+    break;
+  case WRITE_ADDR:
+    ch.writeAddr = atomicWriteValue(alias, ch.writeAddr, value) & 0xffffffff;
+    break;
+  case TRANS_COUNT:
+    ch.transCount = atomicWriteValue(alias, ch.transCount, value) & 0xffffffff;
+    break;
+  case CTRL:
+    ch.ctrl = atomicWriteValue(alias, ch.ctrl, value) & 0x00ffffff;
+    break;
+  }
+  if (index == 3) {
+    // Writing zero is a null trigger, which only raises the interrupt of
+    // a channel that is quiet otherwise
+    if (value) {
+      this->trigger(channel);
+    } else if (ch.ctrl & DMA_CTRL_IRQ_QUIET) {
+      this->intr |= 1 << channel;
+      this->updateInterrupts();
+    }
+  }
+}
+
+number RPDMA::readUint32(number offset) {
+  if (offset < DMA_CHANNELS * DMA_CHANNEL_STRIDE) {
+    return this->readChannel(offset);
+  }
+  if (offset >= DMA_DBG_CTDREQ &&
+      offset < DMA_DBG_CTDREQ + DMA_CHANNELS * DMA_CHANNEL_STRIDE) {
+    const DMAChannel &ch =
+        this->channels[(offset - DMA_DBG_CTDREQ) / DMA_CHANNEL_STRIDE];
+    if (offset % DMA_CHANNEL_STRIDE == DMA_DBG_TCR - DMA_DBG_CTDREQ) {
+      return ch.transCount;
+    }
+    return 0;
+  }
+  if (offset >= DMA_TIMER0 && offset < DMA_TIMER0 + 4 * DMA_TIMERS) {
+    return this->timers[(offset - DMA_TIMER0) / 4];
+  }
+  switch (offset) {
+  case DMA_INTR:
+    return this->intr;
+  case DMA_INTE0:
+    return this->inte[0];
+  case DMA_INTF0:
+    return this->intf[0];
+  case DMA_INTS0:
+    return (this->intr | this->intf[0]) & this->inte[0];
+  case DMA_INTE1:
+    return this->inte[1];
+  case DMA_INTF1:
+    return this->intf[1];
+  case DMA_INTS1:
+    return (this->intr | this->intf[1]) & this->inte[1];
+  case DMA_MULTI_CHAN_TRIGGER:
+  case DMA_FIFO_LEVELS:
+  case DMA_CHAN_ABORT:
+    return 0;
+  case DMA_SNIFF_CTRL:
+    return this->sniffCtrl;
+  case DMA_SNIFF_DATA:
+    return this->sniffData;
+  case DMA_N_CHANNELS:
+    return DMA_CHANNELS;
+  }
+  return LoggingPeripheral::readUint32(offset);
+}
+
+void RPDMA::writeUint32(number offset, number value) {
+  const number alias = offset & ATOMIC_ALIAS_MASK;
+  offset &= ~ATOMIC_ALIAS_MASK;
+  if (offset < DMA_CHANNELS * DMA_CHANNEL_STRIDE) {
+    this->writeChannel(offset, alias, value);
+    return;
+  }
+  if (offset >= DMA_TIMER0 && offset < DMA_TIMER0 + 4 * DMA_TIMERS) {
+    number &timer = this->timers[(offset - DMA_TIMER0) / 4];
+    timer = atomicWriteValue(alias, timer, value) & 0xffffffff;
+    return;
+  }
+  switch (offset) {
+  case DMA_INTR:
+  case DMA_INTS0:
+  case DMA_INTS1:
+    // Writing 1 clears an interrupt
+    this->intr &= ~value;
+    break;
+  case DMA_INTE0:
+    this->inte[0] = atomicWriteValue(alias, this->inte[0], value) & 0xffff;
+    break;
+  case DMA_INTF0:
+    this->intf[0] = atomicWriteValue(alias, this->intf[0], value) & 0xffff;
+    break;
+  case DMA_INTE1:
+    this->inte[1] = atomicWriteValue(alias, this->inte[1], value) & 0xffff;
+    break;
+  case DMA_INTF1:
+    this->intf[1] = atomicWriteValue(alias, this->intf[1], value) & 0xffff;
+    break;
+  case DMA_MULTI_CHAN_TRIGGER:
+    for (number channel = 0; channel < DMA_CHANNELS; channel++) {
+      if ((value >> channel) & 1) {
+        this->trigger(channel);
+      }
+    }
+    return;
+  case DMA_CHAN_ABORT:
+    for (number channel = 0; channel < DMA_CHANNELS; channel++) {
+      if ((value >> channel) & 1) {
+        this->abort(channel);
+      }
+    }
+    return;
+  case DMA_SNIFF_CTRL:
+    this->sniffCtrl = atomicWriteValue(alias, this->sniffCtrl, value);
+    return;
+  case DMA_SNIFF_DATA:
+    this->sniffData = atomicWriteValue(alias, this->sniffData, value);
+    return;
+  default:
+    LoggingPeripheral::writeUint32(offset | alias, value);
+    return;
+  }
+  this->updateInterrupts();
+}
@@ -0,0 +1,264 @@
+#include "peripherals/iobank0.h"
+#include "rp2040.h"
+
+void GPIOOverride::set(number pin, number mode) {
+  const uint32_t bit = 1 << pin;
+  // Normal, invert, drive low and drive high
+  this->invert = mode == 1 ? this->invert | bit : this->invert & ~bit;
+  this->force = mode >= 2 ? this->force | bit : this->force & ~bit;
+  this->high = mode == 3 ? this->high | bit : this->high & ~bit;
+}
+
+// The bits of `mask` for the 8 pins of an interrupt register, each moved to
+// the lowest bit of the pin's 4 bits
+static number spreadPins(uint32_t mask, number reg) {
+  number result = 0;
+  for (number i = 0; i < 8; i++) {
+    result |= (number)((mask >> (reg * 8 + i)) & 1) << (i * 4);
+  }
+  return result;
+}
+
+RPIOBank0::RPIOBank0(RP2040 *rp2040, string name)
+    : LoggingPeripheral(rp2040, name) {
+  for (number pin = 0; pin < GPIO_PINS; pin++) {
+    this->ctrl[pin] = GPIO_FUNC_NULL;
+  }
+}
+
+void RPIOBank0::updateCtrl(number pin) {
+  const number ctrl = this->ctrl[pin];
+  const number function = ctrl & GPIO_CTRL_FUNCSEL_MASK;
+  for (number i = 0; i < GPIO_FUNCTIONS; i++) {
+    if (i == function) {
+      this->functionPins[i] |= 1 << pin;
+    } else {
+      this->functionPins[i] &= ~(1 << pin);
+    }
+  }
+  this->outOverride.set(pin, (ctrl >> GPIO_CTRL_OUTOVER_SHIFT) & 0x3);
+  this->oeOverride.set(pin, (ctrl >> GPIO_CTRL_OEOVER_SHIFT) & 0x3);
+  this->inOverride.set(pin, (ctrl >> GPIO_CTRL_INOVER_SHIFT) & 0x3);
+  this->irqOverride.set(pin, (ctrl >> GPIO_CTRL_IRQOVER_SHIFT) & 0x3);
+}
+
+void RPIOBank0::updatePins(number cycles) {
+  uint32_t out = 0;
+  uint32_t oe = 0;
+  for (number i = 0; i < GPIO_FUNCTIONS; i++) {
+    out |= this->functionOut[i] & this->functionPins[i];
+    oe |= this->functionOE[i] & this->functionPins[i];
+  }
+  this->outputs = this->outOverride.apply(out);
+  this->outputEnables = this->oeOverride.apply(oe);
+  const uint32_t pads = ((this->outputs & this->outputEnables) |
+                         (this->externalInputs & ~this->outputEnables)) &
+                        GPIO_PINS_MASK;
+  this->inputs = this->inOverride.apply(pads) & GPIO_PINS_MASK;
+  const uint32_t irqInputs = this->irqOverride.apply(this->inputs) &
+                             GPIO_PINS_MASK;
+  if (pads != this->pads) {
+    const uint32_t changed = pads ^ this->pads;
+    this->pads = pads;
+    this->recordChange(cycles, changed);
+  }
+  if (irqInputs != this->irqInputs) {
+    this->edgesHigh |= irqInputs & ~this->irqInputs;
+    this->edgesLow |= this->irqInputs & ~irqInputs;
+    this->irqInputs = irqInputs;
+    this->updateInterrupts();
+  }
+}
+
+void RPIOBank0::recordChange(number cycles, uint32_t changed) {
+  if (this->subscribers.empty()) {
+    return;
+  }
+  if (this->changes.full()) {
+    this->flush();
+  }
+  // PIO reports its changes when it catches up, so they may come after
+  // later ones of SIO: keep the records in order
+  this->lastChangeCycles = max(this->lastChangeCycles, cycles);
+  this->changes.push({this->lastChangeCycles, this->pads, changed});
+  if (!this->flushEvent) {
+    this->flushEvent = this->rp2040->schedule(this->flushDelay, [this]() {
+      this->flushEvent = 0;
+      this->flush();
+    });
+  }
+}
+
+void RPIOBank0::setFunctionOutputs(number function, uint32_t out,
+                                   uint32_t oe, number cycles) {
+  this->functionOut[function] = out;
+  this->functionOE[function] = oe;
+  this->updatePins(cycles);
+}
+
+void RPIOBank0::setInputs(uint32_t values) {
+  this->externalInputs = values;
+  this->updatePins(this->rp2040->currentCore()->cycles);
+}
+
+number RPIOBank0::subscribe(
+    function<void(const PinChange *, number)> subscriber) {
+  const number id = this->nextSubscriberId++;
+  this->subscribers.push_back({id, subscriber});
+  return id;
+}
+
+void RPIOBank0::unsubscribe(number id) {
+  for (auto it = this->subscribers.begin(); it != this->subscribers.end();
+       it++) {
+    if (it->first == id) {
+      this->subscribers.erase(it);
+      return;
+    }
+  }
+}
+
+void RPIOBank0::flush() {
+  if (this->flushEvent) {
+    this->rp2040->cancelEvent(this->flushEvent);
+    this->flushEvent = 0;
+  }
+  this->changes.drain([this](const PinChange *changes, number count) {
+    for (auto &[id, subscriber] : this->subscribers) {
+      subscriber(changes, count);
+    }
+  });
+}
+
+// The pins with a pending interrupt event, indexed like the bits of each
+// pin in the interrupt registers
+uint32_t RPIOBank0::events(number event) {
+  switch (event) {
+  case 0:
+    return ~this->irqInputs & GPIO_PINS_MASK;
+  case 1:
+    return this->irqInputs;
+  case 2:
+    return this->edgesLow;
+  default:
+    return this->edgesHigh;
+  }
+}
+
+void RPIOBank0::updateEnabledEvents(number proc) {
+  for (number event = 0; event < 4; event++) {
+    uint32_t pins = 0;
+    for (number pin = 0; pin < GPIO_PINS; pin++) {
+      if ((this->inte[proc][pin / 8] >> ((pin % 8) * 4 + event)) & 1) {
+        pins |= 1 << pin;
+      }
+    }
+    this->enabledEvents[proc][event] = pins;
+  }
+}
+
+number RPIOBank0::readIntr(number reg, number proc) {
+  number intr = 0;
+  for (number event = 0; event < 4; event++) {
+    intr |= spreadPins(this->events(event), reg) << event;
+  }
+  return proc < 3 ? intr | this->intf[proc][reg] : intr;
+}
+
+void RPIOBank0::updateInterrupts() {
+  for (number proc = 0; proc < 2; proc++) {
+    bool pending = false;
+    for (number event = 0; event < 4 && !pending; event++) {
+      pending = this->events(event) & this->enabledEvents[proc][event];
+    }
+    for (number reg = 0; reg < 4 && !pending; reg++) {
+      pending = this->intf[proc][reg] & this->inte[proc][reg];
+    }
+    this->rp2040->cores[proc]->setInterrupt(IO_IRQ_BANK0, pending);
+  }
+}
+
+number RPIOBank0::readUint32(number offset) {
+  if (offset < IO_BANK0_INTR0) {
+    const number pin = offset / 8;
+    if (offset & IO_BANK0_GPIO_CTRL) {
+      return this->ctrl[pin];
+    }
+    const uint32_t bit = 1 << pin;
+    const number proc = this->rp2040->currentCore()->id;
+    const number ints =
+        this->readIntr(pin / 8, proc) & this->inte[proc][pin / 8];
+    return (this->outputs & bit ? GPIO_STATUS_OUTTOPAD : 0) |
+           (this->outputEnables & bit ? GPIO_STATUS_OETOPAD : 0) |
+           (this->pads & bit ? GPIO_STATUS_INFROMPAD : 0) |
+           ((ints >> ((pin % 8) * 4)) & 0xf ? GPIO_STATUS_IRQTOPROC : 0);
+  }
+  if (offset < IO_BANK0_PROC0_INTE0) {
+    return this->readIntr((offset - IO_BANK0_INTR0) / 4, 3);
+  }
+  if (offset < IO_BANK0_INT_END) {
+    const number proc = (offset - IO_BANK0_PROC0_INTE0) / IO_BANK0_INT_STRIDE;
+    const number index = (offset - IO_BANK0_PROC0_INTE0) % IO_BANK0_INT_STRIDE;
+    const number reg = (index % 0x10) / 4;
+    switch (index / 0x10) {
+    case 0:
+      return this->inte[proc][reg];
+    case 1:
+      return this->intf[proc][reg];
+    default:
+      return this->readIntr(reg, proc) & this->inte[proc][reg];
+    }
+  }
+  return LoggingPeripheral::readUint32(offset);
+}
+
+void RPIOBank0::writeUint32(number offset, number value) {
+  const number alias = offset & ATOMIC_ALIAS_MASK;
+  offset &= ~ATOMIC_ALIAS_MASK;
+  if (offset < IO_BANK0_INTR0) {
+    const number pin = offset / 8;
+    if (offset & IO_BANK0_GPIO_CTRL) {
+      this->ctrl[pin] =
+          atomicWriteValue(alias, this->ctrl[pin], value) & 0x3003331f;
+      this->updateCtrl(pin);
+      this->updatePins(this->rp2040->currentCore()->cycles);
+    }
+    return;
+  }
+  if (offset < IO_BANK0_PROC0_INTE0) {
+    // Writing 1 clears a latched edge
+    const number reg = (offset - IO_BANK0_INTR0) / 4;
+    for (number i = 0; i < 8; i++) {
+      const uint32_t bit = 1 << (reg * 8 + i);
+      if (value & (GPIO_IRQ_EDGE_LOW << (i * 4))) {
+        this->edgesLow &= ~bit;
+      }
+      if (value & (GPIO_IRQ_EDGE_HIGH << (i * 4))) {
+        this->edgesHigh &= ~bit;
+      }
+    }
+    this->updateInterrupts();
+    return;
+  }
+  if (offset < IO_BANK0_INT_END) {
+    const number proc = (offset - IO_BANK0_PROC0_INTE0) / IO_BANK0_INT_STRIDE;
+    const number index = (offset - IO_BANK0_PROC0_INTE0) % IO_BANK0_INT_STRIDE;
+    const number reg = (index % 0x10) / 4;
+    switch (index / 0x10) {
+    case 0:
+      this->inte[proc][reg] =
+          atomicWriteValue(alias, this->inte[proc][reg], value);
+      if (proc < 2) {
+        this->updateEnabledEvents(proc);
+      }
+      break;
+    case 1:
+      this->intf[proc][reg] =
+          atomicWriteValue(alias, this->intf[proc][reg], value);
+      break;
+    }
+    this->updateInterrupts();
+    return;
+  }
+  LoggingPeripheral::writeUint32(offset | alias, value);
+}
@@ -1,26 +1,50 @@
 #include "peripherals/peripheral.h"
 #include "rp2040.h"
-#include <iostream>
+
+number atomicWriteValue(number offset, number current, number value) {
+  switch (offset & ATOMIC_ALIAS_MASK) {
+  case ATOMIC_XOR_OFFSET:
+    return current ^ value;
+  case ATOMIC_SET_OFFSET:
+    return current | value;
+  case ATOMIC_CLEAR_OFFSET:
+    return current & ~value;
+  default:
+    return value;
+  }
+}
+
+number Peripheral::readUint16(number offset) {
+  return readLanes(this->readUint32(offset & ~0x3), offset, 2);
+}
+
+number Peripheral::readUint8(number offset) {
+  return readLanes(this->readUint32(offset & ~0x3), offset, 1);
+}
+
+void Peripheral::writeUint16(number offset, number value) {
+  this->writeUint32(offset & ~0x3, replicateLanes(value, 2));
+}
+
+void Peripheral::writeUint8(number offset, number value) {
+  this->writeUint32(offset & ~0x3, replicateLanes(value, 1));
+}
 
 LoggingPeripheral::LoggingPeripheral(RP2040 *rp2040, string name) {
   this->rp2040 = rp2040;
   this->name = name;
+  this->logId = rp2040->logSink.registerPeripheral(name);
 }
 
 number LoggingPeripheral::readUint32(number offset) {
-  cout << "Unimplemented peripheral " << this->name << " read from 0x" << hex
-       << offset << endl;
-  if (offset > 0x1000) {
-    cout << "Unimplemented read from peripheral in the atomic operation region"
-         << endl;
-  }
+  const CortexM0Core *core = this->rp2040->currentCore();
+  this->rp2040->logSink.log(this->logId, offset, 0, false, core->id,
+                            core->cycles);
   return 0xffffffff;
 }
 
 void LoggingPeripheral::writeUint32(number offset, number value) {
-  cout << "Unimplemented peripheral " << this->name << " write to 0x" << hex
-       << offset << ": 0x" << hex << value << endl;
-  if (offset > 0x1000) {
-    cout << "Unimplemented atomic-write to peripheral " << this->name << endl;
-  }
+  const CortexM0Core *core = this->rp2040->currentCore();
+  this->rp2040->logSink.log(this->logId, offset, value, true, core->id,
+                            core->cycles);
 }
@@ -0,0 +1,838 @@
+#include "peripherals/pio.h"
+#include "rp2040.h"
+#include <algorithm>
+
+// The pins from `base` on, wrapping around after pin 31, moved to the
+// lowest bits
+static uint32_t rotateRight(uint32_t values, number base) {
+  return base ? (values >> base) | (values << (32 - base)) : values;
+}
+
+static uint32_t reverseBits(uint32_t value) {
+  uint32_t result = 0;
+  for (number i = 0; i < 32; i++) {
+    result = (result << 1) | ((value >> i) & 1);
+  }
+  return result;
+}
+
+static number threshold(number value) { return value ? value : 32; }
+
+void PIOStateMachine::decodeAll() {
+  for (number i = 0; i < PIO_INSTRUCTIONS; i++) {
+    this->decoded[i] = this->decode(this->pio->instructions[i]);
+  }
+}
+
+PIOInstruction PIOStateMachine::decode(uint16_t opcode) {
+  PIOInstruction instr = {};
+  const uint8_t arguments = opcode & 0xff;
+  instr.target = (arguments >> 5) & 0x7;
+  instr.operand = arguments & 0x1f;
+  // The delay/side-set field: the side-set bits, including the enable bit
+  // when side-set is optional, then the delay in the bits left over
+  const number sideSetBits =
+      (this->pinctrl >> PIO_PINCTRL_SIDESET_COUNT_SHIFT) & 0x7;
+  const number delayBits = 5 - min<number>(sideSetBits, 5);
+  const number field = (opcode >> 8) & 0x1f;
+  instr.delay = field & ((1 << delayBits) - 1);
+  if (sideSetBits) {
+    const uint8_t value = field >> delayBits;
+    if (this->execctrl & PIO_EXECCTRL_SIDE_EN) {
+      instr.sideSet = field & 0x10;
+      instr.sideSetValue = value & ((1 << (sideSetBits - 1)) - 1);
+    } else {
+      instr.sideSet = true;
+      instr.sideSetValue = value;
+    }
+  }
+  switch (opcode >> 13) {
+  case 0:
+    instr.opcode = PIO_JMP;
+    break;
+  case 1:
+    instr.opcode = PIO_WAIT;
+    instr.flags = arguments >> 7;
+    instr.target &= 0x3;
+    break;
+  case 2:
+    instr.opcode = PIO_IN;
+    break;
+  case 3:
+    instr.opcode = PIO_OUT;
+    break;
+  case 4:
+    instr.opcode = arguments & 0x80 ? PIO_PULL : PIO_PUSH;
+    instr.flags = (arguments >> 6) & 1;
+    instr.block = arguments & 0x20;
+    break;
+  case 5:
+    instr.opcode = PIO_MOV;
+    instr.flags = (arguments >> 3) & 0x3;
+    instr.operand = arguments & 0x7;
+    break;
+  case 6:
+    instr.opcode = PIO_IRQ_SET;
+    // Clear, then wait
+    instr.flags = (arguments >> 5) & 0x3;
+    break;
+  default:
+    instr.opcode = PIO_SET;
+    break;
+  }
+  // IRQ indexes with the REL bit add the state machine's index to their
+  // two lowest bits
+  if (instr.opcode == PIO_IRQ_SET ||
+      (instr.opcode == PIO_WAIT && instr.target == 2)) {
+    const uint8_t irq = instr.operand;
+    instr.operand = irq & 0x10 ? (irq & 0x4) | ((irq + this->index) & 0x3)
+                               : irq & 0x7;
+  }
+  return instr;
+}
+
+void PIOStateMachine::setClockDivider(number value) {
+  this->clkdiv = value & 0xffffff00;
+  const number integer = value >> 16;
+  this->period = (integer ? integer : 0x10000) * 256 + ((value >> 8) & 0xff);
+}
+
+void PIOStateMachine::exec(uint16_t opcode) {
+  this->pendingExec = true;
+  this->execInstruction = opcode;
+  this->execDecoded = this->decode(opcode);
+}
+
+number PIOStateMachine::txDepth() {
+  if (this->shiftctrl & PIO_SHIFTCTRL_FJOIN_RX) {
+    return 0;
+  }
+  return this->shiftctrl & PIO_SHIFTCTRL_FJOIN_TX ? 2 * PIO_FIFO_DEPTH
+                                                  : PIO_FIFO_DEPTH;
+}
+
+number PIOStateMachine::rxDepth() {
+  if (this->shiftctrl & PIO_SHIFTCTRL_FJOIN_TX) {
+    return 0;
+  }
+  return this->shiftctrl & PIO_SHIFTCTRL_FJOIN_RX ? 2 * PIO_FIFO_DEPTH
+                                                  : PIO_FIFO_DEPTH;
+}
+
+void PIOStateMachine::restart() {
+  this->isrCount = 0;
+  this->osrCount = 32;
+  this->pendingExec = false;
+  this->irqWaiting = false;
+  this->stalled = false;
+  this->waitingForPin = false;
+}
+
+number PIOStateMachine::pushThreshold() {
+  return threshold((this->shiftctrl >> PIO_SHIFTCTRL_PUSH_THRESH_SHIFT) &
+                   0x1f);
+}
+
+number PIOStateMachine::pullThreshold() {
+  return threshold((this->shiftctrl >> PIO_SHIFTCTRL_PULL_THRESH_SHIFT) &
+                   0x1f);
+}
+
+void PIOStateMachine::advance() {
+  const uint32_t wrapTop =
+      (this->execctrl >> PIO_EXECCTRL_WRAP_TOP_SHIFT) & 0x1f;
+  if (this->pc == wrapTop) {
+    this->pc = (this->execctrl >> PIO_EXECCTRL_WRAP_BOTTOM_SHIFT) & 0x1f;
+  } else {
+    this->pc = (this->pc + 1) % PIO_INSTRUCTIONS;
+  }
+}
+
+uint32_t PIOStateMachine::readPins() {
+  return rotateRight(this->pio->readInputs(),
+                     (this->pinctrl >> PIO_PINCTRL_IN_BASE_SHIFT) & 0x1f);
+}
+
+void PIOStateMachine::writePins(number base, number count, uint32_t values) {
+  uint32_t pins = this->pio->pinValues;
+  for (number i = 0; i < count; i++) {
+    const uint32_t bit = 1 << ((base + i) % 32);
+    pins = (values >> i) & 1 ? pins | bit : pins & ~bit;
+  }
+  if (pins != this->pio->pinValues) {
+    this->pio->pinValues = pins;
+    this->pio->updatePins(this->time);
+  }
+}
+
+void PIOStateMachine::writePinDirs(number base, number count,
+                                   uint32_t values) {
+  uint32_t dirs = this->pio->pinDirs;
+  for (number i = 0; i < count; i++) {
+    const uint32_t bit = 1 << ((base + i) % 32);
+    dirs = (values >> i) & 1 ? dirs | bit : dirs & ~bit;
+  }
+  if (dirs != this->pio->pinDirs) {
+    this->pio->pinDirs = dirs;
+    this->pio->updatePins(this->time);
+  }
+}
+
+// The sources of IN and MOV
+uint32_t PIOStateMachine::readSource(number source) {
+  switch (source) {
+  case 0:
+    return this->readPins();
+  case 1:
+    return this->x;
+  case 2:
+    return this->y;
+  case 5: {
+    // STATUS: all ones while the selected FIFO is below STATUS_N
+    const number level = this->execctrl & PIO_EXECCTRL_STATUS_SEL
+                             ? this->rxFifo.size()
+                             : this->txFifo.size();
+    return level < (this->execctrl & 0xf) ? 0xffffffff : 0;
+  }
+  case 6:
+    return this->isr;
+  case 7:
+    return this->osr;
+  default:
+    return 0;
+  }
+}
+
+void PIOStateMachine::shiftIn(uint32_t value, number count) {
+  const uint32_t data = count < 32 ? value & ((1u << count) - 1) : value;
+  if (count == 32) {
+    this->isr = data;
+  } else if (this->shiftctrl & PIO_SHIFTCTRL_IN_SHIFTDIR) {
+    this->isr = (this->isr >> count) | (data << (32 - count));
+  } else {
+    this->isr = (this->isr << count) | data;
+  }
+  this->isrCount = min<number>(this->isrCount + count, 32);
+}
+
+uint32_t PIOStateMachine::shiftOut(number count) {
+  uint32_t data;
+  if (count == 32) {
+    data = this->osr;
+    this->osr = 0;
+  } else if (this->shiftctrl & PIO_SHIFTCTRL_OUT_SHIFTDIR) {
+    data = this->osr & ((1u << count) - 1);
+    this->osr >>= count;
+  } else {
+    data = this->osr >> (32 - count);
+    this->osr <<= count;
+  }
+  this->osrCount = min<number>(this->osrCount + count, 32);
+  return data;
+}
+
+bool PIOStateMachine::step() {
+  const bool fromExec = this->pendingExec;
+  const PIOInstruction instr =
+      fromExec ? this->execDecoded : this->decoded[this->pc];
+  // Side-set happens as the instruction issues, even if it stalls
+  if (instr.sideSet) {
+    const number bits =
+        ((this->pinctrl >> PIO_PINCTRL_SIDESET_COUNT_SHIFT) & 0x7) -
+        (this->execctrl & PIO_EXECCTRL_SIDE_EN ? 1 : 0);
+    const number base = (this->pinctrl >> PIO_PINCTRL_SIDESET_BASE_SHIFT) &
+                        0x1f;
+    if (this->execctrl & PIO_EXECCTRL_SIDE_PINDIR) {
+      this->writePinDirs(base, bits, instr.sideSetValue);
+    } else {
+      this->writePins(base, bits, instr.sideSetValue);
+    }
+  }
+  this->pendingExec = false;
+  this->waitingForPin = false;
+  const PIOResult result = this->execute(instr);
+  switch (result) {
+  case PIO_STALL:
+    this->pendingExec = fromExec;
+    return false;
+  case PIO_RETRY:
+    this->pendingExec = fromExec;
+    this->time += this->period;
+    return true;
+  case PIO_NEXT:
+    // The instructions from EXEC leave the program counter alone
+    if (!fromExec) {
+      this->advance();
+    }
+    break;
+  case PIO_JUMPED:
+    break;
+  }
+  // An OUT or MOV to EXEC runs its instruction on the next cycle, ignoring
+  // its own delay
+  if (this->pendingExec) {
+    this->time += this->period;
+  } else {
+    this->time += this->period * (1 + instr.delay);
+  }
+  return true;
+}
+
+PIOResult PIOStateMachine::execute(const PIOInstruction &instr) {
+  const number pinctrl = this->pinctrl;
+  const number outBase = pinctrl & 0x1f;
+  const number outCount = (pinctrl >> PIO_PINCTRL_OUT_COUNT_SHIFT) & 0x3f;
+  const number setBase = (pinctrl >> PIO_PINCTRL_SET_BASE_SHIFT) & 0x1f;
+  const number setCount = (pinctrl >> PIO_PINCTRL_SET_COUNT_SHIFT) & 0x7;
+  const bool autopull = this->shiftctrl & PIO_SHIFTCTRL_AUTOPULL;
+  const bool autopush = this->shiftctrl & PIO_SHIFTCTRL_AUTOPUSH;
+  switch (instr.opcode) {
+  case PIO_JMP: {
+    bool condition;
+    switch (instr.target) {
+    case 0:
+      condition = true;
+      break;
+    case 1:
+      condition = !this->x;
+      break;
+    case 2:
+      condition = this->x--;
+      break;
+    case 3:
+      condition = !this->y;
+      break;
+    case 4:
+      condition = this->y--;
+      break;
+    case 5:
+      condition = this->x != this->y;
+      break;
+    case 6: {
+      const number pin =
+          (this->execctrl >> PIO_EXECCTRL_JMP_PIN_SHIFT) & 0x1f;
+      condition = (this->pio->readInputs() >> pin) & 1;
+      break;
+    }
+    default:
+      condition = this->osrCount < this->pullThreshold();
+      break;
+    }
+    if (!condition) {
+      return PIO_NEXT;
+    }
+    this->pc = instr.operand;
+    return PIO_JUMPED;
+  }
+  case PIO_WAIT: {
+    bool level;
+    switch (instr.target) {
+    case 0:
+      level = (this->pio->readInputs() >> instr.operand) & 1;
+      break;
+    case 1:
+      level = (this->readPins() >> instr.operand) & 1;
+      break;
+    default:
+      level = (this->pio->irqFlags >> instr.operand) & 1;
+      break;
+    }
+    if (level != (bool)instr.flags) {
+      this->waitingForPin = instr.target < 2;
+      return PIO_STALL;
+    }
+    // Waiting for an IRQ flag to be set clears it
+    if (instr.target == 2 && instr.flags) {
+      this->pio->irqFlags &= ~(1 << instr.operand);
+      this->pio->sharedStateChanged = true;
+    }
+    return PIO_NEXT;
+  }
+  case PIO_IN: {
+    const number count = threshold(instr.operand);
+    if (autopush && this->isrCount + count >= this->pushThreshold() &&
+        this->rxFifo.size() >= this->rxDepth()) {
+      this->pio->setDebugFlag(PIO_FDEBUG_RXSTALL_SHIFT, this->index);
+      return PIO_STALL;
+    }
+    this->shiftIn(this->readSource(instr.target), count);
+    if (autopush && this->isrCount >= this->pushThreshold()) {
+      this->rxFifo.push(this->isr);
+      this->isr = 0;
+      this->isrCount = 0;
+    }
+    return PIO_NEXT;
+  }
+  case PIO_OUT: {
+    if (autopull && this->osrCount >= this->pullThreshold()) {
+      if (this->txFifo.empty()) {
+        this->pio->setDebugFlag(PIO_FDEBUG_TXSTALL_SHIFT, this->index);
+        return PIO_STALL;
+      }
+      this->txFifo.pop(this->osr);
+      this->osrCount = 0;
+    }
+    const number count = threshold(instr.operand);
+    const uint32_t value = this->shiftOut(count);
+    switch (instr.target) {
+    case 0:
+      this->writePins(outBase, outCount, value);
+      break;
+    case 1:
+      this->x = value;
+      break;
+    case 2:
+      this->y = value;
+      break;
+    case 4:
+      this->writePinDirs(outBase, outCount, value);
+      break;
+    case 5:
+      this->pc = value & 0x1f;
+      return PIO_JUMPED;
+    case 6:
+      this->isr = value;
+      this->isrCount = count;
+      break;
+    case 7:
+      this->exec(value);
+      break;
+    }
+    return PIO_NEXT;
+  }
+  case PIO_PUSH:
+    if (instr.flags && this->isrCount < this->pushThreshold()) {
+      return PIO_NEXT;
+    }
+    if (this->rxFifo.size() >= this->rxDepth()) {
+      if (instr.block) {
+        this->pio->setDebugFlag(PIO_FDEBUG_RXSTALL_SHIFT, this->index);
+        return PIO_STALL;
+      }
+    } else {
+      this->rxFifo.push(this->isr);
+    }
+    this->isr = 0;
+    this->isrCount = 0;
+    return PIO_NEXT;
+  case PIO_PULL:
+    // With autopull, PULL does nothing while the OSR is full
+    if ((instr.flags || autopull) &&
+        this->osrCount < this->pullThreshold()) {
+      return PIO_NEXT;
+    }
+    if (this->txFifo.empty()) {
+      if (instr.block) {
+        this->pio->setDebugFlag(PIO_FDEBUG_TXSTALL_SHIFT, this->index);
+        return PIO_STALL;
+      }
+      this->osr = this->x;
+    } else {
+      this->txFifo.pop(this->osr);
+    }
+    this->osrCount = 0;
+    return PIO_NEXT;
+  case PIO_MOV: {
+    uint32_t value = this->readSource(instr.operand);
+    if (instr.flags == 1) {
+      value = ~value;
+    } else if (instr.flags == 2) {
+      value = reverseBits(value);
+    }
+    switch (instr.target) {
+    case 0:
+      this->writePins(outBase, outCount, value);
+      break;
+    case 1:
+      this->x = value;
+      break;
+    case 2:
+      this->y = value;
+      break;
+    case 4:
+      this->exec(value);
+      break;
+    case 5:
+      this->pc = value & 0x1f;
+      return PIO_JUMPED;
+    case 6:
+      this->isr = value;
+      this->isrCount = 0;
+      break;
+    case 7:
+      this->osr = value;
+      this->osrCount = 0;
+      break;
+    }
+    return PIO_NEXT;
+  }
+  case PIO_IRQ_SET: {
+    const number bit = 1 << instr.operand;
+    if (instr.flags & 0x2) {
+      this->pio->irqFlags &= ~bit;
+      this->pio->sharedStateChanged = true;
+      return PIO_NEXT;
+    }
+    if (this->irqWaiting) {
+      if (this->pio->irqFlags & bit) {
+        return PIO_STALL;
+      }
+      this->irqWaiting = false;
+      return PIO_NEXT;
+    }
+    this->pio->irqFlags |= bit;
+    this->pio->sharedStateChanged = true;
+    if (instr.flags & 0x1) {
+      this->irqWaiting = true;
+      return PIO_RETRY;
+    }
+    return PIO_NEXT;
+  }
+  case PIO_SET:
+    switch (instr.target) {
+    case 0:
+      this->writePins(setBase, setCount, instr.operand);
+      break;
+    case 1:
+      this->x = instr.operand;
+      break;
+    case 2:
+      this->y = instr.operand;
+      break;
+    case 4:
+      this->writePinDirs(setBase, setCount, instr.operand);
+      break;
+    }
+    return PIO_NEXT;
+  }
+  return PIO_NEXT;
+}
+
+RPPIO::RPPIO(RP2040 *rp2040, string name, number index)
+    : LoggingPeripheral(rp2040, name) {
+  this->index = index;
+  for (number i = 0; i < PIO_SM_COUNT; i++) {
+    this->sm[i].pio = this;
+    this->sm[i].index = i;
+    this->sm[i].decodeAll();
+  }
+}
+
+uint32_t RPPIO::readInputs() { return this->rp2040->ioBank0->getInputs(); }
+
+void RPPIO::updatePins(number time) {
+  this->sharedStateChanged = true;
+  this->rp2040->ioBank0->setFunctionOutputs(GPIO_FUNC_PIO0 + this->index,
+                                            this->pinValues, this->pinDirs,
+                                            time >> 8);
+}
+
+void RPPIO::runUntil(number cycles) {
+  const number target = cycles << 8;
+  bool stepped = false;
+  for (PIOStateMachine &sm : this->sm) {
+    if (sm.waitingForPin) {
+      sm.stalled = false;
+    }
+  }
+  // Runs the earliest instruction of all the state machines, so that they
+  // see each other's IRQ flags and pins in order
+  while (true) {
+    PIOStateMachine *next = NULL;
+    for (PIOStateMachine &sm : this->sm) {
+      if (sm.enabled && !sm.stalled && sm.time < target &&
+          (!next || sm.time < next->time)) {
+        next = &sm;
+      }
+    }
+    if (!next) {
+      break;
+    }
+    const number time = next->time;
+    this->sharedStateChanged = false;
+    if (!next->step()) {
+      next->stalled = true;
+      continue;
+    }
+    stepped = true;
+    if (this->sharedStateChanged) {
+      for (PIOStateMachine &sm : this->sm) {
+        if (sm.stalled) {
+          sm.stalled = false;
+          sm.time = max(sm.time, time);
+        }
+      }
+    }
+  }
+  // The stalled and disabled state machines stood still until the target
+  for (PIOStateMachine &sm : this->sm) {
+    if (sm.stalled || !sm.enabled) {
+      sm.time = max(sm.time, target);
+    }
+  }
+  if (stepped) {
+    this->updateInterrupts();
+  }
+}
+
+void RPPIO::run() {
+  this->runUntil(this->rp2040->currentCore()->cycles);
+  this->scheduleRun();
+}
+
+bool RPPIO::dreq(number request) {
+  this->run();
+  PIOStateMachine &sm = this->sm[request % PIO_SM_COUNT];
+  if (request < PIO_SM_COUNT) {
+    return sm.txFifo.size() < sm.txDepth();
+  }
+  return !sm.rxFifo.empty();
+}
+
+void RPPIO::scheduleRun() {
+  if (this->runEvent) {
+    return;
+  }
+  // The state machines stalled on a FIFO or an IRQ flag wait for the cores
+  for (PIOStateMachine &sm : this->sm) {
+    if (sm.enabled && (!sm.stalled || sm.waitingForPin)) {
+      this->runEvent = this->rp2040->schedule(PIO_QUANTUM_CYCLES, [this]() {
+        this->runEvent = 0;
+        this->run();
+      });
+      return;
+    }
+  }
+}
+
+void RPPIO::wake() {
+  for (PIOStateMachine &sm : this->sm) {
+    sm.stalled = false;
+  }
+  this->updateInterrupts();
+  this->scheduleRun();
+}
+
+number RPPIO::readIntr() {
+  number intr = (this->irqFlags & 0xf) << 8;
+  for (number i = 0; i < PIO_SM_COUNT; i++) {
+    if (!this->sm[i].rxFifo.empty()) {
+      intr |= 1 << i;
+    }
+    if (this->sm[i].txFifo.size() < this->sm[i].txDepth()) {
+      intr |= 1 << (4 + i);
+    }
+  }
+  return intr;
+}
+
+void RPPIO::updateInterrupts() {
+  const number intr = this->readIntr();
+  for (number n = 0; n < 2; n++) {
+    const bool pending = (intr | this->intf[n]) & this->inte[n];
+    for (CortexM0Core *core : this->rp2040->cores) {
+      core->setInterrupt(PIO0_IRQ_0 + this->index * 2 + n, pending);
+    }
+  }
+}
+
+number RPPIO::readCtrl() {
+  number ctrl = 0;
+  for (number i = 0; i < PIO_SM_COUNT; i++) {
+    ctrl |= (number)this->sm[i].enabled << i;
+  }
+  return ctrl;
+}
+
+number RPPIO::readFifoStatus() {
+  number fstat = 0;
+  for (number i = 0; i < PIO_SM_COUNT; i++) {
+    PIOStateMachine &sm = this->sm[i];
+    fstat |= (number)(sm.rxFifo.size() >= sm.rxDepth())
+             << (PIO_FSTAT_RXFULL_SHIFT + i);
+    fstat |= (number)sm.rxFifo.empty() << (PIO_FSTAT_RXEMPTY_SHIFT + i);
+    fstat |= (number)(sm.txFifo.size() >= sm.txDepth())
+             << (PIO_FSTAT_TXFULL_SHIFT + i);
+    fstat |= (number)sm.txFifo.empty() << (PIO_FSTAT_TXEMPTY_SHIFT + i);
+  }
+  return fstat;
+}
+
+number RPPIO::readFifoLevels() {
+  number flevel = 0;
+  for (number i = 0; i < PIO_SM_COUNT; i++) {
+    flevel |= (this->sm[i].txFifo.size() | this->sm[i].rxFifo.size() << 4)
+              << (i * 8);
+  }
+  return flevel;
+}
+
+number RPPIO::readUint32(number offset) {
+  this->run();
+  if (offset >= PIO_SM0_CLKDIV && offset < PIO_INTR) {
+    PIOStateMachine &sm = this->sm[(offset - PIO_SM0_CLKDIV) / PIO_SM_STRIDE];
+    switch ((offset - PIO_SM0_CLKDIV) % PIO_SM_STRIDE) {
+    case 0:
+      return sm.clkdiv;
+    case PIO_SM_EXECCTRL:
+      return sm.execctrl | (sm.stalled ? PIO_EXECCTRL_EXEC_STALLED : 0);
+    case PIO_SM_SHIFTCTRL:
+      return sm.shiftctrl;
+    case PIO_SM_ADDR:
+      return sm.pc;
+    case PIO_SM_INSTR:
+      return sm.pendingExec ? sm.execInstruction
+                            : this->instructions[sm.pc];
+    case PIO_SM_PINCTRL:
+      return sm.pinctrl;
+    }
+  }
+  if (offset >= PIO_RXF0 && offset < PIO_IRQ) {
+    PIOStateMachine &sm = this->sm[(offset - PIO_RXF0) / 4];
+    uint32_t value = 0;
+    if (!sm.rxFifo.pop(value)) {
+      this->setDebugFlag(PIO_FDEBUG_RXUNDER_SHIFT, sm.index);
+    }
+    this->wake();
+    return value;
+  }
+  switch (offset) {
+  case PIO_CTRL:
+    return this->readCtrl();
+  case PIO_FSTAT:
+    return this->readFifoStatus();
+  case PIO_FDEBUG:
+    return this->fdebug;
+  case PIO_FLEVEL:
+    return this->readFifoLevels();
+  case PIO_IRQ:
+    return this->irqFlags;
+  case PIO_INPUT_SYNC_BYPASS:
+    return this->inputSyncBypass;
+  case PIO_DBG_PADOUT:
+    return this->pinValues;
+  case PIO_DBG_PADOE:
+    return this->pinDirs;
+  case PIO_DBG_CFGINFO:
+    return (PIO_INSTRUCTIONS << 16) | (PIO_SM_COUNT << 8) | PIO_FIFO_DEPTH;
+  case PIO_INTR:
+    return this->readIntr();
+  case PIO_IRQ0_INTE:
+    return this->inte[0];
+  case PIO_IRQ0_INTF:
+    return this->intf[0];
+  case PIO_IRQ0_INTS:
+    return (this->readIntr() | this->intf[0]) & this->inte[0];
+  case PIO_IRQ1_INTE:
+    return this->inte[1];
+  case PIO_IRQ1_INTF:
+    return this->intf[1];
+  case PIO_IRQ1_INTS:
+    return (this->readIntr() | this->intf[1]) & this->inte[1];
+  }
+  return LoggingPeripheral::readUint32(offset);
+}
+
+void RPPIO::writeUint32(number offset, number value) {
+  const number alias = offset & ATOMIC_ALIAS_MASK;
+  offset &= ~ATOMIC_ALIAS_MASK;
+  this->run();
+  if (offset >= PIO_SM0_CLKDIV && offset < PIO_INTR) {
+    PIOStateMachine &sm = this->sm[(offset - PIO_SM0_CLKDIV) / PIO_SM_STRIDE];
+    switch ((offset - PIO_SM0_CLKDIV) % PIO_SM_STRIDE) {
+    case 0:
+      sm.setClockDivider(atomicWriteValue(alias, sm.clkdiv, value));
+      break;
+    case PIO_SM_EXECCTRL:
+      sm.execctrl =
+          atomicWriteValue(alias, sm.execctrl, value) & 0x7fffff9f;
+      sm.decodeAll();
+      break;
+    case PIO_SM_SHIFTCTRL: {
+      const number joins = PIO_SHIFTCTRL_FJOIN_RX | PIO_SHIFTCTRL_FJOIN_TX;
+      const number shiftctrl =
+          atomicWriteValue(alias, sm.shiftctrl, value) & 0xffff0000;
+      // Joining or splitting the FIFOs empties them
+      if ((shiftctrl ^ sm.shiftctrl) & joins) {
+        sm.txFifo.clear();
+        sm.rxFifo.clear();
+      }
+      sm.shiftctrl = shiftctrl;
+      break;
+    }
+    case PIO_SM_INSTR:
+      sm.exec(value);
+      // A state machine that is disabled runs it right away
+      if (!sm.enabled) {
+        sm.step();
+      }
+      break;
+    case PIO_SM_PINCTRL:
+      sm.pinctrl = atomicWriteValue(alias, sm.pinctrl, value);
+      sm.decodeAll();
+      break;
+    }
+    this->wake();
+    return;
+  }
+  if (offset >= PIO_TXF0 && offset < PIO_RXF0) {
+    PIOStateMachine &sm = this->sm[(offset - PIO_TXF0) / 4];
+    if (sm.txFifo.size() >= sm.txDepth()) {
+      this->setDebugFlag(PIO_FDEBUG_TXOVER_SHIFT, sm.index);
+    } else {
+      sm.txFifo.push(value);
+    }
+    this->wake();
+    return;
+  }
+  if (offset >= PIO_INSTR_MEM0 && offset <= PIO_INSTR_MEM31) {
+    const number address = (offset - PIO_INSTR_MEM0) / 4;
+    this->instructions[address] = value;
+    for (PIOStateMachine &sm : this->sm) {
+      sm.decoded[address] = sm.decode(value);
+    }
+    return;
+  }
+  switch (offset) {
+  case PIO_CTRL: {
+    const number ctrl = atomicWriteValue(alias, this->readCtrl(), value);
+    for (number i = 0; i < PIO_SM_COUNT; i++) {
+      this->sm[i].enabled = (ctrl >> i) & 1;
+      if ((ctrl >> (PIO_CTRL_SM_RESTART_SHIFT + i)) & 1) {
+        this->sm[i].restart();
+      }
+    }
+    break;
+  }
+  case PIO_FDEBUG:
+    // Writing 1 clears a flag
+    this->fdebug &= ~value;
+    return;
+  case PIO_IRQ:
+    this->irqFlags &= ~value;
+    break;
+  case PIO_IRQ_FORCE:
+    this->irqFlags |= value & 0xff;
+    break;
+  case PIO_INPUT_SYNC_BYPASS:
+    this->inputSyncBypass =
+        atomicWriteValue(alias, this->inputSyncBypass, value);
+    return;
+  case PIO_IRQ0_INTE:
+    this->inte[0] = atomicWriteValue(alias, this->inte[0], value) & 0xfff;
+    break;
+  case PIO_IRQ0_INTF:
+    this->intf[0] = atomicWriteValue(alias, this->intf[0], value) & 0xfff;
+    break;
+  case PIO_IRQ1_INTE:
+    this->inte[1] = atomicWriteValue(alias, this->inte[1], value) & 0xfff;
+    break;
+  case PIO_IRQ1_INTF:
+    this->intf[1] = atomicWriteValue(alias, this->intf[1], value) & 0xfff;
+    break;
+  default:
+    LoggingPeripheral::writeUint32(offset | alias, value);
+    return;
+  }
+  this->wake();
+}
@@ -0,0 +1,121 @@
+#include "peripherals/ppb.h"
+#include "rp2040.h"
+#include <iostream>
+
+number RPPPB::readInterruptPriorities(number regIndex) {
+  NVIC &nvic = this->rp2040->currentCore()->nvic;
+  number result = 0;
+  for (number byteIndex = 0; byteIndex < 4; byteIndex++) {
+    const number priority = nvic.getInterruptPriority(regIndex * 4 + byteIndex);
+    result |= priority << (8 * byteIndex + 6);
+  }
+  return result;
+}
+
+void RPPPB::writeInterruptPriorities(number regIndex, number value) {
+  CortexM0Core *core = this->rp2040->currentCore();
+  for (number byteIndex = 0; byteIndex < 4; byteIndex++) {
+    core->nvic.setInterruptPriority(regIndex * 4 + byteIndex,
+                                    (value >> (8 * byteIndex + 6)) & 0x3);
+  }
+  core->interruptsUpdated = true;
+}
+
+number RPPPB::readUint32(number offset) {
+  CortexM0Core *core = this->rp2040->currentCore();
+  if (offset >= OFFSET_NVIC_IPRn[0] && offset <= OFFSET_NVIC_IPRn[7]) {
+    return this->readInterruptPriorities((offset - OFFSET_NVIC_IPRn[0]) / 4);
+  }
+  switch (offset) {
+  case OFFSET_ICSR:
+    return (core->nvic.pendingPendSV ? ICSR_PENDSVSET : 0) |
+           (core->nvic.pendingSysTick ? ICSR_PENDSTSET : 0) |
+           (core->nvic.pendingInterrupts ? ICSR_ISRPENDING : 0) | core->IPSR;
+
+  case OFFSET_VTOR:
+    return core->VTOR;
+
+  case OFFSET_SCR:
+    return core->SCR;
+
+  case OFFSET_NVIC_ISPR:
+  case OFFSET_NVIC_ICPR:
+    return core->nvic.pendingInterrupts;
+
+  case OFFSET_NVIC_ISER:
+  case OFFSET_NVIC_ICER:
+    return core->nvic.enabledInterrupts;
+
+  case OFFSET_SHPR2:
+    return core->nvic.getSHPR2();
+
+  case OFFSET_SHPR3:
+    return core->nvic.getSHPR3();
+  }
+  cout << "Read from invalid memory address "
+       << "0x" << hex << PPB_BASE + offset << endl;
+  return 0xffffffff;
+}
+
+void RPPPB::writeUint32(number offset, number value) {
+  CortexM0Core *core = this->rp2040->currentCore();
+  if (offset >= OFFSET_NVIC_IPRn[0] && offset <= OFFSET_NVIC_IPRn[7]) {
+    this->writeInterruptPriorities((offset - OFFSET_NVIC_IPRn[0]) / 4, value);
+    return;
+  }
+  switch (offset) {
+  case OFFSET_ICSR:
+    if (value & ICSR_PENDSVSET) {
+      core->nvic.pendingPendSV = true;
+    } else if (value & ICSR_PENDSVCLR) {
+      core->nvic.pendingPendSV = false;
+    }
+    if (value & ICSR_PENDSTSET) {
+      core->nvic.pendingSysTick = true;
+    } else if (value & ICSR_PENDSTCLR) {
+      core->nvic.pendingSysTick = false;
+    }
+    core->interruptsUpdated = true;
+    break;
+
+  case OFFSET_VTOR:
+    core->VTOR = value;
+    break;
+
+  case OFFSET_SCR:
+    core->SCR = value;
+    break;
+
+  case OFFSET_NVIC_ISPR:
+    core->nvic.pendingInterrupts |= value;
+    core->interruptsUpdated = true;
+    break;
+
+  case OFFSET_NVIC_ICPR:
+    core->nvic.pendingInterrupts &= ~value;
+    break;
+
+  case OFFSET_NVIC_ISER:
+    core->nvic.enabledInterrupts |= value;
+    core->interruptsUpdated = true;
+    break;
+
+  case OFFSET_NVIC_ICER:
+    core->nvic.enabledInterrupts &= ~value;
+    break;
+
+  case OFFSET_SHPR2:
+    core->nvic.setSHPR2(value);
+    core->interruptsUpdated = true;
+    break;
+
+  case OFFSET_SHPR3:
+    core->nvic.setSHPR3(value);
+    core->interruptsUpdated = true;
+    break;
+
+  default:
+    cerr << "Write to undefined address: 0x" << hex << PPB_BASE + offset
+         << endl;
+  }
+}
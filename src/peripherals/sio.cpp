@@ -0,0 +1,139 @@
+#include "peripherals/sio.h"
+#include "rp2040.h"
+
+number RPSIO::readFifoStatus(number core) {
+  return (this->fifo[core].empty() ? 0 : SIO_FIFO_ST_VLD) |
+         (this->fifo[1 - core].full() ? 0 : SIO_FIFO_ST_RDY) |
+         this->fifoErrors[core];
+}
+
+bool RPSIO::fifoInterrupt(number core) {
+  return !this->fifo[core].empty() || this->fifoErrors[core];
+}
+
+void RPSIO::updateFifoInterrupt(number core) {
+  // On their own threads, one core may push while the other pops: repeat
+  // until the level set matches the FIFO
+  bool level;
+  do {
+    level = this->fifoInterrupt(core);
+    this->rp2040->cores[core]->setInterrupt(SIO_IRQ_PROC0 + core, level);
+  } while (level != this->fifoInterrupt(core));
+}
+
+void RPSIO::writeGPIO(number offset, number value) {
+  value &= GPIO_PINS_MASK;
+  switch (offset) {
+  case SIO_GPIO_OUT_OFFSET:
+    this->gpioOut = value;
+    break;
+  case SIO_GPIO_OUT_SET_OFFSET:
+    this->gpioOut |= value;
+    break;
+  case SIO_GPIO_OUT_CLR_OFFSET:
+    this->gpioOut &= ~value;
+    break;
+  case SIO_GPIO_OUT_XOR_OFFSET:
+    this->gpioOut ^= value;
+    break;
+  case SIO_GPIO_OE_OFFSET:
+    this->gpioOE = value;
+    break;
+  case SIO_GPIO_OE_SET_OFFSET:
+    this->gpioOE |= value;
+    break;
+  case SIO_GPIO_OE_CLR_OFFSET:
+    this->gpioOE &= ~value;
+    break;
+  case SIO_GPIO_OE_XOR_OFFSET:
+    this->gpioOE ^= value;
+    break;
+  }
+  this->rp2040->ioBank0->setFunctionOutputs(
+      GPIO_FUNC_SIO, this->gpioOut, this->gpioOE,
+      this->rp2040->currentCore()->cycles);
+}
+
+number RPSIO::readUint32(number offset) {
+  unique_lock<mutex> lock;
+  if (offset == SIO_GPIO_IN_OFFSET) {
+    lock = this->rp2040->lockPeripherals();
+  }
+  return this->readUint32Locked(offset);
+}
+
+number RPSIO::readUint32Locked(number offset) {
+  const number core = this->rp2040->currentCore()->id;
+  if (offset >= SIO_SPINLOCK0_OFFSET && offset <= SIO_SPINLOCK31_OFFSET) {
+    // Reading claims the lock, returning 0 if it was already taken
+    const uint32_t lock = 1 << ((offset - SIO_SPINLOCK0_OFFSET) / 4);
+    return this->spinlocks.fetch_or(lock) & lock ? 0 : lock;
+  }
+  switch (offset) {
+  case SIO_CPUID_OFFSET:
+    return core;
+
+  case SIO_FIFO_ST_OFFSET:
+    return this->readFifoStatus(core);
+
+  case SIO_FIFO_RD_OFFSET: {
+    uint32_t value = 0;
+    if (!this->fifo[core].pop(value)) {
+      this->fifoErrors[core] |= SIO_FIFO_ST_ROE;
+    }
+    this->updateFifoInterrupt(core);
+    return value;
+  }
+
+  case SIO_SPINLOCK_ST_OFFSET:
+    return this->spinlocks;
+
+  case SIO_GPIO_IN_OFFSET:
+    return this->rp2040->ioBank0->getInputs();
+
+  case SIO_GPIO_OUT_OFFSET:
+    return this->gpioOut;
+
+  case SIO_GPIO_OE_OFFSET:
+    return this->gpioOE;
+  }
+  return LoggingPeripheral::readUint32(offset);
+}
+
+void RPSIO::writeUint32(number offset, number value) {
+  unique_lock<mutex> lock;
+  if (offset >= SIO_GPIO_OUT_OFFSET && offset <= SIO_GPIO_OE_XOR_OFFSET) {
+    lock = this->rp2040->lockPeripherals();
+  }
+  this->writeUint32Locked(offset, value);
+}
+
+void RPSIO::writeUint32Locked(number offset, number value) {
+  const number core = this->rp2040->currentCore()->id;
+  if (offset >= SIO_SPINLOCK0_OFFSET && offset <= SIO_SPINLOCK31_OFFSET) {
+    this->spinlocks.fetch_and(~(1 << ((offset - SIO_SPINLOCK0_OFFSET) / 4)));
+    return;
+  }
+  switch (offset) {
+  case SIO_FIFO_ST_OFFSET:
+    // Any write clears the sticky error flags
+    this->fifoErrors[core] = 0;
+    this->updateFifoInterrupt(core);
+    return;
+
+  case SIO_FIFO_WR_OFFSET:
+    if (this->fifo[1 - core].push(value)) {
+      this->updateFifoInterrupt(1 - core);
+    } else {
+      this->fifoErrors[core] |= SIO_FIFO_ST_WOF;
+      this->updateFifoInterrupt(core);
+    }
+    return;
+  }
+
+  if (offset >= SIO_GPIO_OUT_OFFSET && offset <= SIO_GPIO_OE_XOR_OFFSET) {
+    this->writeGPIO(offset, value);
+    return;
+  }
+  // Writes to the other SIO registers are ignored for now
+}
@@ -0,0 +1,28 @@
+#include "peripherals/ssi.h"
+#include "rp2040.h"
+
+number RPSSI::readUint32(number offset) {
+  switch (offset) {
+  case SSI_SR_OFFSET:
+    return SSI_SR_TFE_BITS;
+
+  case SSI_DR0_OFFSET:
+    return this->dr0;
+  }
+  return LoggingPeripheral::readUint32(offset);
+}
+
+void RPSSI::writeUint32(number offset, number value) {
+  const number CMD_READ_STATUS = 0x05;
+  switch (offset) {
+  case SSI_DR0_OFFSET:
+    if (value == CMD_READ_STATUS) {
+      // tell stage2 that we completed a write
+      this->dr0 = 0;
+    }
+    break;
+
+  default:
+    LoggingPeripheral::writeUint32(offset, value);
+  }
+}
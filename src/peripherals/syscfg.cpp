@@ -4,7 +4,10 @@
 number RP2040SysCfg::readUint32(number offset) {
   switch (offset) {
   case PROC0_NMI_MASK:
-    return this->rp2040->interruptNMIMask;
+    return this->rp2040->core0.nvic.interruptNMIMask;
+
+  case PROC1_NMI_MASK:
+    return this->rp2040->core1.nvic.interruptNMIMask;
   }
   return LoggingPeripheral::readUint32(offset);
 }
@@ -12,7 +15,11 @@ number RP2040SysCfg::readUint32(number offset) {
 void RP2040SysCfg::writeUint32(number offset, number value) {
   switch (offset) {
   case PROC0_NMI_MASK:
-    this->rp2040->interruptNMIMask = value;
+    this->rp2040->core0.nvic.interruptNMIMask = value;
+    break;
+
+  case PROC1_NMI_MASK:
+    this->rp2040->core1.nvic.interruptNMIMask = value;
     break;
 
   default:
@@ -1,32 +1,182 @@
 #include "peripherals/timer.h"
 #include "rp2040.h"
-#include "utils/time.h"
-#include <cmath>
 #include <iostream>
 
-number RPTimer::readUint32(number offset) {
-  const number time = getCurrentMicroseconds();
+number RPTimer::currentTick() {
+  return this->rp2040->currentCore()->cycles / TIMER_TICK_CYCLES;
+}
+
+number RPTimer::readTime() {
+  const number tick = this->currentTick();
+  // The clock of the other core may still be behind the last write
+  if (this->paused || tick < this->baseTick) {
+    return this->time;
+  }
+  return this->time + (tick - this->baseTick);
+}
 
+void RPTimer::writeTime(number time) {
+  this->time = time;
+  this->baseTick = this->currentTick();
+  for (number alarm = 0; alarm < TIMER_ALARMS; alarm++) {
+    this->scheduleAlarm(alarm);
+  }
+}
+
+void RPTimer::setPaused(bool paused) {
+  if (paused == this->paused) {
+    return;
+  }
+  this->time = this->readTime();
+  this->baseTick = this->currentTick();
+  this->paused = paused;
+  // Paused alarms wait for the counter to move again
+  for (number alarm = 0; alarm < TIMER_ALARMS; alarm++) {
+    this->scheduleAlarm(alarm);
+  }
+}
+
+// (Re)schedules an armed alarm for the tick the low word of the counter
+// next matches it, which is right away when it already does
+void RPTimer::scheduleAlarm(number alarm) {
+  this->cancelAlarm(alarm);
+  if (!(this->armed & (1 << alarm)) || this->paused) {
+    return;
+  }
+  const number cycles = this->rp2040->currentCore()->cycles;
+  const number ticks =
+      (uint32_t)(this->alarms[alarm] - (uint32_t)this->readTime());
+  const number delay =
+      ticks ? (this->currentTick() + ticks) * TIMER_TICK_CYCLES - cycles : 0;
+  this->alarmEvents[alarm] = this->rp2040->schedule(
+      delay, [this, alarm]() { this->fireAlarm(alarm); });
+}
+
+void RPTimer::cancelAlarm(number alarm) {
+  if (this->alarmEvents[alarm]) {
+    this->rp2040->cancelEvent(this->alarmEvents[alarm]);
+    this->alarmEvents[alarm] = 0;
+  }
+}
+
+void RPTimer::fireAlarm(number alarm) {
+  this->alarmEvents[alarm] = 0;
+  this->armed &= ~(1 << alarm);
+  this->intr |= 1 << alarm;
+  this->updateInterrupts();
+}
+
+void RPTimer::updateInterrupts() {
+  const number ints = (this->intr | this->intf) & this->inte;
+  for (number alarm = 0; alarm < TIMER_ALARMS; alarm++) {
+    for (CortexM0Core *core : this->rp2040->cores) {
+      core->setInterrupt(TIMER_IRQ_0 + alarm, ints & (1 << alarm));
+    }
+  }
+}
+
+number RPTimer::readUint32(number offset) {
   switch (offset) {
   case TIMEHR:
     return this->latchedTimeHigh;
 
-  case TIMELR:
-    this->latchedTimeHigh = floor((uint32_t)time / 2 * 32);
-    return (uint32_t)time >> 0;
+  case TIMELR: {
+    // Latches the high word, so that TIMEHR reads the same time
+    const number time = this->readTime();
+    this->latchedTimeHigh = time >> 32;
+    return (uint32_t)time;
+  }
 
   case TIMERAWH:
-    return floor((uint32_t)time / 2 * 32);
+    return this->readTime() >> 32;
 
   case TIMERAWL:
-    return (uint32_t)time >> 0;
+    return (uint32_t)this->readTime();
+
+  case ARMED:
+    return this->armed;
+
+  case DBGPAUSE:
+    return this->dbgPause;
+
+  case PAUSE:
+    return this->paused;
+
+  case INTR:
+    return this->intr;
+
+  case INTE:
+    return this->inte;
+
+  case INTF:
+    return this->intf;
+
+  case INTS:
+    return (this->intr | this->intf) & this->inte;
+  }
+  if (offset >= ALARM0 && offset <= ALARM3) {
+    return this->alarms[(offset - ALARM0) / 4];
   }
   return LoggingPeripheral::readUint32(offset);
 }
 
 void RPTimer::writeUint32(number offset, number value) {
+  // Writes through the atomic aliases update PAUSE and the interrupt
+  // registers, the other registers take them as plain writes
+  const number alias = offset & ATOMIC_ALIAS_MASK;
+  offset &= ~ATOMIC_ALIAS_MASK;
   switch (offset) {
+  case TIMELW:
+    this->latchedTimeLow = (uint32_t)value;
+    break;
+
+  case TIMEHW:
+    // Takes effect together with the low word written before it
+    this->writeTime((value << 32) | this->latchedTimeLow);
+    break;
+
+  case ARMED:
+    // Writing a 1 disarms the alarm
+    for (number alarm = 0; alarm < TIMER_ALARMS; alarm++) {
+      if (value & (1 << alarm)) {
+        this->armed &= ~(1 << alarm);
+        this->cancelAlarm(alarm);
+      }
+    }
+    break;
+
+  case DBGPAUSE:
+    this->dbgPause = value;
+    break;
+
+  case PAUSE:
+    this->setPaused(atomicWriteValue(alias, this->paused, value) & 1);
+    break;
+
+  case INTR:
+    // Write 1 to clear
+    this->intr &= ~value;
+    this->updateInterrupts();
+    break;
+
+  case INTE:
+    this->inte = atomicWriteValue(alias, this->inte, value) & 0xf;
+    this->updateInterrupts();
+    break;
+
+  case INTF:
+    this->intf = atomicWriteValue(alias, this->intf, value) & 0xf;
+    this->updateInterrupts();
+    break;
+
   default:
-    LoggingPeripheral::writeUint32(offset, value);
+    if (offset >= ALARM0 && offset <= ALARM3) {
+      const number alarm = (offset - ALARM0) / 4;
+      this->alarms[alarm] = value;
+      this->armed |= 1 << alarm;
+      this->scheduleAlarm(alarm);
+      break;
+    }
+    LoggingPeripheral::writeUint32(offset | alias, value);
   }
 }
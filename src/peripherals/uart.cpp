@@ -2,21 +2,185 @@
 #include "rp2040.h"
 #include <iostream>
 
+// FIFO levels selected by the fields of UARTIFLS, from 1/8 to 7/8 full
+static const number fifoLevels[8] = {4, 8, 16, 24, 28, 28, 28, 28};
+
+number RPUART::fifoDepth() {
+  return this->lcrH & UARTLCR_H_FEN ? UART_FIFO_DEPTH : 1;
+}
+
+number RPUART::rxTriggerLevel() {
+  return this->lcrH & UARTLCR_H_FEN ? fifoLevels[(this->ifls >> 3) & 0x7] : 1;
+}
+
+bool RPUART::enabled(number direction) {
+  return (this->cr & UARTCR_UARTEN) && (this->cr & direction);
+}
+
+number RPUART::rawInterrupts() {
+  const bool rxLevel = this->rxFifo.size() >= this->rxTriggerLevel();
+  return this->ris | UART_TXI | (rxLevel ? UART_RXI : 0);
+}
+
+void RPUART::transmit(uint8_t value) {
+  if (this->hostBuffer.full()) {
+    this->flush();
+  }
+  this->hostBuffer.push(value);
+  if ((this->lineBuffered && value == '\n') ||
+      this->hostBuffer.size() >= this->batchSize) {
+    this->flush();
+  } else if (!this->flushEvent) {
+    this->flushEvent = this->rp2040->schedule(this->flushDelay, [this]() {
+      this->flushEvent = 0;
+      this->flush();
+    });
+  }
+}
+
+void RPUART::flush() {
+  if (this->flushEvent) {
+    this->rp2040->cancelEvent(this->flushEvent);
+    this->flushEvent = 0;
+  }
+  if (!this->onTransmit) {
+    this->hostBuffer.clear();
+    return;
+  }
+  this->hostBuffer.drain([this](const uint8_t *data, number size) {
+    this->onTransmit(data, size);
+  });
+}
+
+bool RPUART::dreq(bool transmit) {
+  if (transmit) {
+    return this->dmacr & UARTDMACR_TXDMAE;
+  }
+  return (this->dmacr & UARTDMACR_RXDMAE) && !this->rxFifo.empty();
+}
+
+number RPUART::receive(const uint8_t *data, number size) {
+  if (!this->enabled(UARTCR_RXE)) {
+    return 0;
+  }
+  number count = 0;
+  while (count < size && this->rxFifo.size() < this->fifoDepth()) {
+    this->rxFifo.push(data[count++]);
+  }
+  // The host hands the bytes over at once, and the line then goes idle
+  if (!this->rxFifo.empty()) {
+    this->ris |= UART_RTI;
+  }
+  this->updateInterrupt();
+  return count;
+}
+
+void RPUART::updateInterrupt() {
+  const bool value = this->rawInterrupts() & this->imsc;
+  for (CortexM0Core *core : this->rp2040->cores) {
+    core->setInterrupt(this->irq, value);
+  }
+}
+
 number RPUART::readUint32(number offset) {
   switch (offset) {
-  case UARTFR:
+  case UARTDR: {
+    uint8_t value = 0;
+    this->rxFifo.pop(value);
+    if (this->rxFifo.empty()) {
+      this->ris &= ~UART_RTI;
+    }
+    this->updateInterrupt();
+    return value;
+  }
+
+  case UARTRSR:
     return 0;
+
+  case UARTFR:
+    return UARTFR_TXFE | (this->rxFifo.empty() ? UARTFR_RXFE : 0) |
+           (this->rxFifo.size() >= this->fifoDepth() ? UARTFR_RXFF : 0);
+
+  case UARTIBRD:
+    return this->ibrd;
+
+  case UARTFBRD:
+    return this->fbrd;
+
+  case UARTLCR_H:
+    return this->lcrH;
+
+  case UARTCR:
+    return this->cr;
+
+  case UARTIFLS:
+    return this->ifls;
+
+  case UARTIMSC:
+    return this->imsc;
+
+  case UARTRIS:
+    return this->rawInterrupts();
+
+  case UARTMIS:
+    return this->rawInterrupts() & this->imsc;
+
+  case UARTDMACR:
+    return this->dmacr;
   }
   return LoggingPeripheral::readUint32(offset);
 }
 
 void RPUART::writeUint32(number offset, number value) {
+  const number alias = offset & ATOMIC_ALIAS_MASK;
+  offset &= ~ATOMIC_ALIAS_MASK;
   switch (offset) {
   case UARTDR:
-    this->onByte(value & 0xff);
+    if (this->enabled(UARTCR_TXE)) {
+      this->transmit(value & 0xff);
+    }
+    break;
+
+  case UARTRSR:
+    break;
+
+  case UARTIBRD:
+    this->ibrd = atomicWriteValue(alias, this->ibrd, value) & 0xffff;
+    break;
+
+  case UARTFBRD:
+    this->fbrd = atomicWriteValue(alias, this->fbrd, value) & 0x3f;
+    break;
+
+  case UARTLCR_H:
+    this->lcrH = atomicWriteValue(alias, this->lcrH, value) & 0xff;
+    this->updateInterrupt();
+    break;
+
+  case UARTCR:
+    this->cr = atomicWriteValue(alias, this->cr, value) & 0xff87;
+    break;
+
+  case UARTIFLS:
+    this->ifls = atomicWriteValue(alias, this->ifls, value) & 0x3f;
+    this->updateInterrupt();
+    break;
+
+  case UARTIMSC:
+    this->imsc = atomicWriteValue(alias, this->imsc, value) & 0x7ff;
+    this->updateInterrupt();
+    break;
+
+  case UARTICR:
+    this->ris &= ~value;
+    this->updateInterrupt();
+    break;
+
+  case UARTDMACR:
+    this->dmacr = atomicWriteValue(alias, this->dmacr, value) & 0x7;
     break;
 
   default:
-    LoggingPeripheral::writeUint32(offset, value);
+    LoggingPeripheral::writeUint32(offset | alias, value);
   }
 }
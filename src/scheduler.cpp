@@ -0,0 +1,44 @@
+#include "scheduler.h"
+#include <algorithm>
+
+// The comparison the heap is ordered by: the event that runs first is the
+// one that compares greatest
+bool Scheduler::runsLater(const Event &a, const Event &b) {
+  return a.deadline > b.deadline || (a.deadline == b.deadline && a.id > b.id);
+}
+
+void Scheduler::updateNextDeadline() {
+  this->nextDeadline =
+      this->events.empty() ? NO_DEADLINE : this->events.front().deadline;
+}
+
+number Scheduler::schedule(number deadline, function<void()> callback) {
+  const number id = this->nextId++;
+  this->events.push_back({deadline, id, callback});
+  push_heap(this->events.begin(), this->events.end(), runsLater);
+  this->updateNextDeadline();
+  return id;
+}
+
+void Scheduler::cancel(number id) {
+  // There are only ever a few events, a linear search is fine
+  for (number i = 0; i < this->events.size(); i++) {
+    if (this->events[i].id == id) {
+      this->events.erase(this->events.begin() + i);
+      make_heap(this->events.begin(), this->events.end(), runsLater);
+      this->updateNextDeadline();
+      return;
+    }
+  }
+}
+
+void Scheduler::runDueEvents(number cycles) {
+  while (!this->events.empty() && this->events.front().deadline <= cycles) {
+    pop_heap(this->events.begin(), this->events.end(), runsLater);
+    // Taken off the heap first, as the callback may schedule or cancel
+    const function<void()> callback = this->events.back().callback;
+    this->events.pop_back();
+    this->updateNextDeadline();
+    callback();
+  }
+}
@@ -0,0 +1,203 @@
+#include "uartbridge.h"
+#include "rp2040.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <unistd.h>
+
+UARTBridge::UARTBridge(RP2040 *rp2040, RPUART *uart, const string &target) {
+  this->rp2040 = rp2040;
+  this->uart = uart;
+  try {
+    if (target == "pty") {
+      this->openPty();
+    } else if (target.rfind("unix:", 0) == 0) {
+      this->openSocket(target.substr(5));
+    } else {
+      throw new runtime_error("Unknown UART bridge " + target);
+    }
+    this->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (this->wakeFd < 0) {
+      throw new runtime_error("Could not create the UART bridge eventfd");
+    }
+  } catch (...) {
+    this->closeFds();
+    throw;
+  }
+  this->uart->onTransmit = [this](const uint8_t *data, number size) {
+    this->transmit(data, size);
+  };
+  this->schedulePoll();
+  this->ioThread = thread(&UARTBridge::runIO, this);
+}
+
+// The I/O thread sends what is left in txQueue before it exits
+UARTBridge::~UARTBridge() {
+  this->stopping = true;
+  this->wake();
+  this->ioThread.join();
+  this->rp2040->cancelEvent(this->pollEvent);
+  this->uart->onTransmit = nullptr;
+  this->closeFds();
+}
+
+void UARTBridge::closeFds() {
+  for (int fd : {this->fd, this->listenFd, this->slaveFd, this->wakeFd}) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+  if (!this->socketPath.empty()) {
+    unlink(this->socketPath.c_str());
+  }
+}
+
+void UARTBridge::openPty() {
+  this->fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (this->fd < 0 || grantpt(this->fd) || unlockpt(this->fd)) {
+    throw new runtime_error("Could not open a pseudo-terminal");
+  }
+  this->path = ptsname(this->fd);
+  this->slaveFd = ::open(this->path.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+  // Raw bytes, without echo or line editing
+  termios attributes;
+  if (this->slaveFd < 0 || tcgetattr(this->slaveFd, &attributes)) {
+    throw new runtime_error("Could not open " + this->path);
+  }
+  cfmakeraw(&attributes);
+  tcsetattr(this->slaveFd, TCSANOW, &attributes);
+}
+
+void UARTBridge::openSocket(const string &path) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    throw new runtime_error("UART socket path is too long: " + path);
+  }
+  strcpy(address.sun_path, path.c_str());
+  this->listenFd =
+      socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  unlink(path.c_str());
+  if (this->listenFd < 0 ||
+      bind(this->listenFd, (sockaddr *)&address, sizeof(address)) ||
+      listen(this->listenFd, 1)) {
+    throw new runtime_error("Could not listen on " + path + ": " +
+                            strerror(errno));
+  }
+  this->path = path;
+  this->socketPath = path;
+}
+
+void UARTBridge::schedulePoll() {
+  this->pollEvent =
+      this->rp2040->schedule(UART_BRIDGE_POLL_CYCLES, [this]() {
+        this->pollReceived();
+        this->schedulePoll();
+      });
+}
+
+// Runs on the emulation side, as the consumer of rxQueue
+void UARTBridge::pollReceived() {
+  if (this->rxPendingStart == this->rxPendingEnd) {
+    this->rxPendingStart = 0;
+    this->rxPendingEnd = this->rxQueue.read(this->rxPending, UART_FIFO_DEPTH);
+  }
+  if (this->rxPendingStart < this->rxPendingEnd) {
+    this->rxPendingStart +=
+        this->uart->receive(this->rxPending + this->rxPendingStart,
+                            this->rxPendingEnd - this->rxPendingStart);
+  }
+}
+
+// Runs on the emulation side, as the producer of txQueue
+void UARTBridge::transmit(const uint8_t *data, number size) {
+  const number written = this->txQueue.write(data, size);
+  this->droppedBytes += size - written;
+  if (written) {
+    this->wake();
+  }
+}
+
+void UARTBridge::wake() {
+  const uint64_t one = 1;
+  if (write(this->wakeFd, &one, sizeof(one)) < 0) {
+    // The counter is already set, the thread will wake up anyway
+  }
+}
+
+void UARTBridge::runIO() {
+  uint8_t buffer[4096];
+  number txStart = 0;
+  number txEnd = 0;
+  while (true) {
+    // Read before the queue, which holds all the firmware sent by then
+    const bool stopping = this->stopping;
+    if (txStart == txEnd) {
+      txStart = 0;
+      txEnd = this->txQueue.read(buffer, sizeof(buffer));
+    }
+    const bool connected = this->fd >= 0;
+    if (stopping && (txStart == txEnd || !connected)) {
+      break;
+    }
+    const bool rxRoom = this->rxQueue.size() < UART_BRIDGE_QUEUE_SIZE;
+    pollfd fds[2] = {{this->wakeFd, POLLIN, 0},
+                     {connected ? this->fd : this->listenFd, 0, 0}};
+    if (!stopping && (!connected || rxRoom)) {
+      fds[1].events |= POLLIN;
+    }
+    if (connected && txStart < txEnd) {
+      fds[1].events |= POLLOUT;
+    }
+    // Without room for what the host sends, check again in a while
+    const int timeout =
+        stopping ? UART_BRIDGE_DRAIN_TIMEOUT : rxRoom ? -1 : 1;
+    const int ready = poll(fds, 2, timeout);
+    if ((ready < 0 && errno != EINTR) || (ready == 0 && stopping)) {
+      break;
+    }
+    if (fds[0].revents & POLLIN) {
+      uint64_t count;
+      if (read(this->wakeFd, &count, sizeof(count)) < 0) {
+        // Drained by an earlier read
+      }
+    }
+    if (!connected) {
+      if (fds[1].revents & POLLIN) {
+        this->fd = accept4(this->listenFd, NULL, NULL,
+                           SOCK_NONBLOCK | SOCK_CLOEXEC);
+      } else {
+        // Nobody to send to
+        txStart = txEnd;
+      }
+      continue;
+    }
+    if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+      uint8_t received[4096];
+      const number room = UART_BRIDGE_QUEUE_SIZE - this->rxQueue.size();
+      const ssize_t count =
+          read(this->fd, received, min(room, (number)sizeof(received)));
+      if (count > 0) {
+        this->rxQueue.write(received, count);
+      } else if (this->listenFd >= 0 &&
+                 (count == 0 || (errno != EAGAIN && errno != EINTR))) {
+        // The client went away, wait for the next one
+        close(this->fd);
+        this->fd = -1;
+        continue;
+      }
+    }
+    if (fds[1].revents & POLLOUT) {
+      const ssize_t count = write(this->fd, buffer + txStart, txEnd - txStart);
+      if (count > 0) {
+        txStart += count;
+      }
+    }
+  }
+}
@@ -0,0 +1,145 @@
+#include "waveform.h"
+#include "rp2040.h"
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+static void writeVarint(vector<uint8_t> &buffer, number value) {
+  while (value >= 0x80) {
+    buffer.push_back((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  buffer.push_back(value);
+}
+
+static number readVarint(istream &input) {
+  number value = 0;
+  for (number shift = 0; shift < 64; shift += 7) {
+    const int byte = input.get();
+    if (byte == EOF) {
+      throw new runtime_error("Truncated waveform");
+    }
+    value |= (number)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return value;
+    }
+  }
+  throw new runtime_error("Invalid number in waveform");
+}
+
+WaveformRecorder::WaveformRecorder(RP2040 *rp2040, const string &path)
+    : output(path, ios::binary) {
+  if (!this->output.is_open()) {
+    throw new runtime_error("Could not create the waveform " + path);
+  }
+  this->rp2040 = rp2040;
+  this->lastCycles = rp2040->currentCore()->cycles;
+  this->chunk.insert(this->chunk.end(), WAVEFORM_MAGIC,
+                     WAVEFORM_MAGIC + sizeof(WAVEFORM_MAGIC));
+  writeVarint(this->chunk, CLK_SYS_FREQUENCY);
+  writeVarint(this->chunk, this->lastCycles);
+  writeVarint(this->chunk, rp2040->ioBank0->getPins());
+  this->subscription = rp2040->ioBank0->subscribe(
+      [this](const PinChange *changes, number count) {
+        this->record(changes, count);
+      });
+  this->writer = thread(&WaveformRecorder::write, this);
+}
+
+WaveformRecorder::~WaveformRecorder() {
+  this->rp2040->ioBank0->flush();
+  this->rp2040->ioBank0->unsubscribe(this->subscription);
+  this->handOver();
+  {
+    lock_guard<mutex> lock(this->pendingMutex);
+    this->stopping = true;
+  }
+  this->pendingReady.notify_one();
+  this->writer.join();
+}
+
+void WaveformRecorder::record(const PinChange *changes, number count) {
+  for (number i = 0; i < count; i++) {
+    const PinChange &change = changes[i];
+    const number delta = change.cycles - this->lastCycles;
+    this->lastCycles = change.cycles;
+    // Most changes are a single pin toggling
+    const bool singlePin = (change.changed & (change.changed - 1)) == 0;
+    writeVarint(this->chunk, (delta << 1) | singlePin);
+    if (singlePin) {
+      this->chunk.push_back(countr_zero(change.changed));
+    } else {
+      writeVarint(this->chunk, change.changed);
+    }
+  }
+  if (this->chunk.size() >= WAVEFORM_CHUNK_SIZE) {
+    this->handOver();
+  }
+}
+
+void WaveformRecorder::handOver() {
+  {
+    lock_guard<mutex> lock(this->pendingMutex);
+    this->pending.insert(this->pending.end(), this->chunk.begin(),
+                         this->chunk.end());
+  }
+  this->chunk.clear();
+  this->pendingReady.notify_one();
+}
+
+void WaveformRecorder::write() {
+  vector<uint8_t> data;
+  bool done = false;
+  while (!done) {
+    {
+      unique_lock<mutex> lock(this->pendingMutex);
+      this->pendingReady.wait(lock, [this]() {
+        return this->stopping || !this->pending.empty();
+      });
+      data.swap(this->pending);
+      done = this->stopping;
+    }
+    this->output.write((const char *)data.data(), data.size());
+    data.clear();
+  }
+  this->output.flush();
+}
+
+void convertWaveformToVCD(istream &input, ostream &output) {
+  char magic[sizeof(WAVEFORM_MAGIC)];
+  if (!input.read(magic, sizeof(magic)) ||
+      memcmp(magic, WAVEFORM_MAGIC, sizeof(magic))) {
+    throw new runtime_error("Not a waveform recording");
+  }
+  const number frequency = readVarint(input);
+  number cycles = readVarint(input);
+  uint32_t pins = readVarint(input);
+  auto nanoseconds = [frequency](number cycles) -> number {
+    return (unsigned __int128)cycles * 1000000000 / frequency;
+  };
+  // Pin n is the wire whose identifier is the character '!' + n
+  output << "$timescale 1 ns $end\n$scope module rp2040 $end\n";
+  for (number pin = 0; pin < GPIO_PINS; pin++) {
+    output << "$var wire 1 " << (char)('!' + pin) << " gpio" << pin
+           << " $end\n";
+  }
+  output << "$upscope $end\n$enddefinitions $end\n";
+  output << "#" << nanoseconds(cycles) << "\n$dumpvars\n";
+  for (number pin = 0; pin < GPIO_PINS; pin++) {
+    output << ((pins >> pin) & 1) << (char)('!' + pin) << "\n";
+  }
+  output << "$end\n";
+  while (input.peek() != EOF) {
+    const number header = readVarint(input);
+    const uint32_t changed =
+        header & 1 ? (uint32_t)1 << input.get() : readVarint(input);
+    cycles += header >> 1;
+    pins ^= changed;
+    output << "#" << nanoseconds(cycles) << "\n";
+    for (number pin = 0; pin < GPIO_PINS; pin++) {
+      if (changed & (1 << pin)) {
+        output << ((pins >> pin) & 1) << (char)('!' + pin) << "\n";
+      }
+    }
+  }
+}
@@ -1,6 +1,11 @@
 #include "rp2040.h"
+#include "uartbridge.h"
+#include "waveform.h"
 #include "utils/assembler.h"
 #include "gtest/gtest.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 #define R0 0
 #define R1 1
@@ -23,43 +28,831 @@ TEST(boot_rom_initialize, RP2040) {
   RP2040 *rp2040 = new RP2040();
   const uint32_t bootrom[2] = {0x20041f00, 0xee};
   rp2040->loadBootrom(bootrom, 2);
-  EXPECT_EQ(rp2040->getSP(), 0x20041f00);
-  EXPECT_EQ(rp2040->getPC(), 0xEE);
+  EXPECT_EQ(rp2040->core0.getSP(), 0x20041f00);
+  EXPECT_EQ(rp2040->core0.getPC(), 0xEE);
+}
+
+// should read and write the flash through its XIP aliases
+TEST(flash_xip_aliases, readUint32) {
+  RP2040 *rp2040 = new RP2040();
+  rp2040->writeUint32(0x10000100, 0x12345678);
+  EXPECT_EQ(rp2040->readUint32(0x11000100), 0x12345678);
+  EXPECT_EQ(rp2040->readUint32(0x13000100), 0x12345678);
+  rp2040->writeUint32(0x12000104, 0x9abcdef0);
+  EXPECT_EQ(rp2040->readUint32(0x10000104), 0x9abcdef0);
+}
+
+// should store bytes and halfwords without touching the rest of the word
+TEST(sub_word_access, writeUint8) {
+  RP2040 *rp2040 = new RP2040();
+  rp2040->writeUint32(0x20000100, 0x12345678);
+  rp2040->writeUint8(0x20000101, 0xab);
+  rp2040->writeUint16(0x20000102, 0xcdef);
+  EXPECT_EQ(rp2040->readUint32(0x20000100), 0xcdefab78);
+  EXPECT_EQ(rp2040->readUint8(0x20000103), 0xcd);
+  EXPECT_EQ(rp2040->readUint16(0x20000100), 0xab78);
+  rp2040->writeUint32(0x10000100, 0x12345678);
+  rp2040->writeUint8(0x10000102, 0xab);
+  EXPECT_EQ(rp2040->readUint32(0x10000100), 0x12ab5678);
+}
+
+class CountingPeripheral : public Peripheral {
+public:
+  number reads = 0;
+  number lastWrite = 0;
+
+  number readUint32(number offset) {
+    this->reads++;
+    return 0;
+  }
+
+  void writeUint32(number offset, number value) { this->lastWrite = value; }
+};
+
+// should replicate narrow peripheral writes without reading the register
+TEST(sub_word_peripheral_write, writeUint8) {
+  RP2040 *rp2040 = new RP2040();
+  CountingPeripheral peripheral;
+  rp2040->memoryMap.mapPeripheral({0x40070000, 0x1000}, &peripheral);
+  rp2040->writeUint8(0x40070001, 0x5a);
+  EXPECT_EQ(peripheral.lastWrite, 0x5a5a5a5a);
+  rp2040->writeUint16(0x40070002, 0x1234);
+  EXPECT_EQ(peripheral.lastWrite, 0x12341234);
+  EXPECT_EQ(peripheral.reads, 0);
+}
+
+class BytePeripheral final : public Peripheral {
+public:
+  number lastOffset = 0;
+  number lastWrite = 0;
+
+  number readUint32(number offset) { return 0x44332211; }
+  number readUint8(number offset) { return offset; }
+  void writeUint32(number offset, number value) {}
+  void writeUint8(number offset, number value) {
+    this->lastOffset = offset;
+    this->lastWrite = value;
+  }
+};
+
+// should give the byte accesses to a peripheral that decodes them itself
+TEST(peripheral_region_widths, mapPeripheral) {
+  RP2040 *rp2040 = new RP2040();
+  BytePeripheral peripheral;
+  rp2040->memoryMap.mapPeripheral({0x4003c000, 0x2000, BUS_WIDTH_8},
+                                  &peripheral);
+  rp2040->writeUint8(0x4003d003, 0x5a);
+  EXPECT_EQ(peripheral.lastOffset, 0x1003);
+  EXPECT_EQ(peripheral.lastWrite, 0x5a);
+  EXPECT_EQ(rp2040->readUint8(0x4003c002), 2);
+  EXPECT_EQ(rp2040->readUint16(0x4003c002), 0x4433);
+  // The rest of the 16 KiB SPI0 block is still unimplemented
+  EXPECT_EQ(rp2040->readUint32(0x4003e000), 0xffffffff);
+}
+
+// should refuse regions that aren't pages or that overlap memory
+TEST(peripheral_region_invalid, mapPeripheral) {
+  RP2040 *rp2040 = new RP2040();
+  BytePeripheral peripheral;
+  EXPECT_THROW(
+      rp2040->memoryMap.mapPeripheral({0x40070010, 0x1000}, &peripheral),
+      runtime_error *);
+  EXPECT_THROW(
+      rp2040->memoryMap.mapPeripheral({RAM_START_ADDRESS, 0x1000},
+                                      &peripheral),
+      runtime_error *);
+}
+
+// should give each core its own CPUID
+TEST(sio_cpuid, dualCore) {
+  RP2040 *rp2040 = new RP2040();
+  rp2040->flash16[0] = opcodeLDRreg(R1, R0, R2);
+  for (CortexM0Core *core : rp2040->cores) {
+    core->setPC(0x10000000);
+    core->registers[R0] = SIO_START_ADDRESS;
+    core->registers[R1] = 0xff;
+    core->registers[R2] = 0;
+    core->executeInstruction();
+  }
+  EXPECT_EQ(rp2040->core0.registers[R1], 0);
+  EXPECT_EQ(rp2040->core1.registers[R1], 1);
+}
+
+// should pass words from one core to the other through the SIO FIFOs
+TEST(sio_fifo, dualCore) {
+  RP2040 *rp2040 = new RP2040();
+  const number FIFO_ST = SIO_START_ADDRESS + SIO_FIFO_ST_OFFSET;
+  const number FIFO_WR = SIO_START_ADDRESS + SIO_FIFO_WR_OFFSET;
+  const number FIFO_RD = SIO_START_ADDRESS + SIO_FIFO_RD_OFFSET;
+  rp2040->setCurrentCore(&rp2040->core0);
+  EXPECT_EQ(rp2040->readUint32(FIFO_ST), SIO_FIFO_ST_RDY);
+  rp2040->writeUint32(FIFO_WR, 0x1234);
+  EXPECT_EQ(rp2040->core1.nvic.pendingInterrupts, 1 << SIO_IRQ_PROC1);
+  rp2040->setCurrentCore(&rp2040->core1);
+  EXPECT_EQ(rp2040->readUint32(FIFO_ST), SIO_FIFO_ST_VLD | SIO_FIFO_ST_RDY);
+  EXPECT_EQ(rp2040->readUint32(FIFO_RD), 0x1234);
+  EXPECT_EQ(rp2040->core1.nvic.pendingInterrupts, 0);
+  // Reading the empty FIFO sets ROE until FIFO_ST is written
+  rp2040->readUint32(FIFO_RD);
+  EXPECT_EQ(rp2040->readUint32(FIFO_ST), SIO_FIFO_ST_RDY | SIO_FIFO_ST_ROE);
+  rp2040->writeUint32(FIFO_ST, 0);
+  EXPECT_EQ(rp2040->readUint32(FIFO_ST), SIO_FIFO_ST_RDY);
+}
+
+// should claim a spinlock on the first read and release it on a write
+TEST(sio_spinlock, dualCore) {
+  RP2040 *rp2040 = new RP2040();
+  const number SPINLOCK5 = SIO_START_ADDRESS + SIO_SPINLOCK0_OFFSET + 5 * 4;
+  EXPECT_EQ(rp2040->readUint32(SPINLOCK5), 1 << 5);
+  EXPECT_EQ(rp2040->readUint32(SPINLOCK5), 0);
+  EXPECT_EQ(rp2040->readUint32(SIO_START_ADDRESS + SIO_SPINLOCK_ST_OFFSET),
+            1 << 5);
+  rp2040->writeUint32(SPINLOCK5, 0);
+  EXPECT_EQ(rp2040->readUint32(SPINLOCK5), 1 << 5);
+}
+
+// should wake a core waiting in WFE when the other one executes SEV
+TEST(execute_sev_instruction, dualCore) {
+  RP2040 *rp2040 = new RP2040();
+  rp2040->flash16[0] = 0xbf20; // wfe
+  rp2040->flash16[1] = 0xbf40; // sev
+  rp2040->core1.setPC(0x10000000);
+  rp2040->core1.executeInstruction();
+  EXPECT_TRUE(rp2040->core1.waiting);
+  rp2040->core0.setPC(0x10000002);
+  rp2040->core0.executeInstruction();
+  EXPECT_FALSE(rp2040->core1.waiting);
+  // The event is consumed by the next WFE
+  rp2040->core1.setPC(0x10000000);
+  rp2040->core1.executeInstruction();
+  EXPECT_FALSE(rp2040->core1.waiting);
+}
+
+// should skip the time both cores sleep through to the next scheduled event
+TEST(execute_wfi_fast_forward, dualCore) {
+  RP2040 *rp2040 = new RP2040();
+  rp2040->flash16[0] = 0xbf30;    // wfi
+  rp2040->flash16[1] = 0xbe00;    // bkpt 0
+  rp2040->flash16[0x80] = 0xbf20; // wfe
+  rp2040->flash16[0x81] = 0xe7fd; // b.n 0x10000100
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core1.setPC(0x10000100);
+  // An hour of simulated time
+  const number hour = 3600 * CLK_SYS_FREQUENCY;
+  rp2040->schedule(hour, [&]() { rp2040->core0.setInterrupt(0, true); });
+  rp2040->execute();
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000004);
+  EXPECT_GE(rp2040->core0.cycles, hour);
+  EXPECT_LT(rp2040->core0.cycles, hour + 1000);
+  EXPECT_TRUE(rp2040->core1.waiting);
+}
+
+// should return once a scheduled event stops both sleeping cores
+TEST(execute_stop_event, dualCore) {
+  RP2040 *rp2040 = new RP2040();
+  rp2040->flash16[0] = 0xbf20; // wfe
+  rp2040->flash16[1] = 0xe7fd; // b.n 0x10000000
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core1.setPC(0x10000000);
+  rp2040->schedule(1000000, [&]() { rp2040->stop(); });
+  rp2040->execute();
+  EXPECT_GE(rp2040->core0.cycles, 1000000);
+  EXPECT_LT(rp2040->core0.cycles, 1001000);
+}
+
+// should start core 1 through the launch protocol of the bootrom, the way
+// multicore_launch_core1() does from core 0
+TEST(core1_launch, dualCore) {
+  RP2040 *rp2040 = new RP2040();
+  rp2040->loadBootrom(bootromB1, BOOT_ROM_B1_SIZE);
+  rp2040->sramView->setUint16(0x100, opcodeMOVS(R0, 42));
+  rp2040->sramView->setUint16(0x102, 0xe7fe); // b.n .
+  const uint32_t commands[] = {0, 0, 1, 0x20000000, 0x20041000, 0x20000101};
+  for (uint32_t command : commands) {
+    for (number i = 0; i < 1000; i++) {
+      rp2040->core1.executeBlock();
+    }
+    rp2040->setCurrentCore(&rp2040->core0);
+    // A 0 restarts the sequence, dropping replies still in the FIFO
+    while (command == 0 &&
+           rp2040->readUint32(SIO_START_ADDRESS + SIO_FIFO_ST_OFFSET) &
+               SIO_FIFO_ST_VLD) {
+      rp2040->readUint32(SIO_START_ADDRESS + SIO_FIFO_RD_OFFSET);
+    }
+    rp2040->writeUint32(SIO_START_ADDRESS + SIO_FIFO_WR_OFFSET, command);
+    rp2040->core0.sendEvent();
+    for (number i = 0; i < 1000; i++) {
+      rp2040->core1.executeBlock();
+    }
+    rp2040->setCurrentCore(&rp2040->core0);
+    EXPECT_EQ(rp2040->readUint32(SIO_START_ADDRESS + SIO_FIFO_RD_OFFSET),
+              command);
+  }
+  for (number i = 0; i < 1000; i++) {
+    rp2040->core1.executeBlock();
+  }
+  EXPECT_EQ(rp2040->core1.registers[R0], 42);
+  EXPECT_EQ(rp2040->core1.getSP(), 0x20041000);
+  EXPECT_EQ(rp2040->core1.VTOR, 0x20000000);
+}
+
+// should run each core on its own thread and pass a word between them
+// through the SIO FIFO
+TEST(execute_threaded, dualCore) {
+  RP2040 *rp2040 = new RP2040();
+  rp2040->flash16[0] = 0x6d30; // ldr r0, [r6, #0x50]
+  rp2040->flash16[1] = opcodeLSRS(R0, R0, 1);
+  rp2040->flash16[2] = 0xd3fc; // bcc.n 0x10000000
+  rp2040->flash16[3] = 0x6db0; // ldr r0, [r6, #0x58]
+  rp2040->flash16[4] = 0xbe00; // bkpt 0
+  rp2040->flash16[0x80] = opcodeMOVS(R0, 42);
+  rp2040->flash16[0x81] = opcodeSTR(R0, R6, SIO_FIFO_WR_OFFSET);
+  rp2040->flash16[0x82] = 0xe7fe; // b.n .
+  for (CortexM0Core *core : rp2040->cores) {
+    core->registers[R6] = SIO_START_ADDRESS;
+  }
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core1.setPC(0x10000100);
+  rp2040->quantum = 100;
+  rp2040->threaded = true;
+  EXPECT_GT(rp2040->execute(), 0);
+  EXPECT_EQ(rp2040->core0.registers[R0], 42);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x1000000a);
+}
+
+// should run scheduled events in the order of their deadlines
+TEST(scheduler_events, scheduler) {
+  Scheduler scheduler;
+  vector<number> events;
+  scheduler.schedule(20, [&]() { events.push_back(2); });
+  scheduler.schedule(10, [&]() { events.push_back(1); });
+  const number id = scheduler.schedule(10, [&]() { events.push_back(3); });
+  scheduler.cancel(id);
+  EXPECT_EQ(scheduler.getNextDeadline(), 10);
+  scheduler.runDueEvents(9);
+  EXPECT_TRUE(events.empty());
+  scheduler.runDueEvents(20);
+  EXPECT_EQ(events, (vector<number>{1, 2}));
+  EXPECT_EQ(scheduler.getNextDeadline(), NO_DEADLINE);
+}
+
+// should count simulated time with the instructions of core 0
+TEST(scheduler_timer, scheduler) {
+  RP2040 *rp2040 = new RP2040();
+  rp2040->core0.setPC(0x10000000);
+  rp2040->flash16[0] = 0xe7fe; // b.n .
+  bool ran = false;
+  rp2040->schedule(1000, [&]() { ran = true; });
+  while (rp2040->core0.cycles < 1000) {
+    EXPECT_FALSE(ran);
+    rp2040->core0.executeBlock();
+  }
+  EXPECT_TRUE(ran);
+  EXPECT_EQ(rp2040->readUint32(0x40054000 + TIMERAWL),
+            rp2040->core0.cycles / 125);
+}
+
+// should latch the high word of the timer when reading TIMELR, and stop
+// counting while paused
+TEST(timer_registers, timer) {
+  const number TIMER = 0x40054000;
+  RP2040 *rp2040 = new RP2040();
+  rp2040->writeUint32(TIMER + TIMELW, 0xfffffffe);
+  rp2040->writeUint32(TIMER + TIMEHW, 1);
+  rp2040->core0.cycles += 3 * TIMER_TICK_CYCLES;
+  EXPECT_EQ(rp2040->readUint32(TIMER + TIMELR), 1);
+  rp2040->core0.cycles += 10 * TIMER_TICK_CYCLES;
+  EXPECT_EQ(rp2040->readUint32(TIMER + TIMEHR), 2);
+  rp2040->writeUint32(TIMER + ATOMIC_SET_OFFSET + PAUSE, 1);
+  rp2040->core0.cycles += 10 * TIMER_TICK_CYCLES;
+  EXPECT_EQ(rp2040->readUint32(TIMER + TIMERAWL), 11);
+  rp2040->writeUint32(TIMER + ATOMIC_CLEAR_OFFSET + PAUSE, 1);
+  rp2040->core0.cycles += 10 * TIMER_TICK_CYCLES;
+  EXPECT_EQ(rp2040->readUint32(TIMER + TIMERAWL), 21);
+}
+
+// should read the timer of its own cores while another RP2040 runs
+TEST(timer_two_instances, timer) {
+  const number TIMER = 0x40054000;
+  RP2040 *a = new RP2040();
+  a->core0.cycles = 1000 * TIMER_TICK_CYCLES;
+  RP2040 *b = new RP2040();
+  b->flash16[0] = opcodeMOVS(R0, 0);
+  b->core1.setPC(0x10000000);
+  b->core1.executeInstruction();
+  EXPECT_EQ(a->readUint32(TIMER + TIMERAWL), 1000);
+  delete b;
+  EXPECT_EQ(a->readUint32(TIMER + TIMERAWL), 1000);
+}
+
+// should wake a sleeping core with the interrupt of an alarm, without
+// running the cores while it waits
+TEST(timer_alarm, timer) {
+  const number TIMER = 0x40054000;
+  const number ALARM_HANDLER = 0x10000200;
+  RP2040 *rp2040 = new RP2040();
+  rp2040->flash16[0] = 0xbf30;    // wfi
+  rp2040->flash16[1] = 0xbe00;    // bkpt 0
+  rp2040->flash16[0x80] = 0xbf20; // wfe
+  rp2040->flash16[0x81] = 0xe7fd; // b.n 0x10000100
+  // The handler acknowledges the interrupt through INTR
+  rp2040->writeUint16(ALARM_HANDLER, opcodeSTR(R1, R2, 0));
+  rp2040->writeUint16(ALARM_HANDLER + 2, opcodeBX(LR));
+  rp2040->writeUint32(0x10001000 + 16 * 4, ALARM_HANDLER | 1);
+  rp2040->writeUint32(VTOR, 0x10001000);
+  rp2040->writeUint32(0xe000e100, 1 << TIMER_IRQ_0);
+  rp2040->core0.setSP(0x20004000);
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core0.registers[R1] = ALARM_0;
+  rp2040->core0.registers[R2] = TIMER + INTR;
+  rp2040->core1.setPC(0x10000100);
+  rp2040->writeUint32(TIMER + INTE, ALARM_0);
+  rp2040->writeUint32(TIMER + ALARM0, 1000000);
+  EXPECT_EQ(rp2040->readUint32(TIMER + ARMED), ALARM_0);
+  EXPECT_LT(rp2040->execute(), 100);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000004);
+  EXPECT_EQ(rp2040->readUint32(TIMER + TIMERAWL), 1000000);
+  EXPECT_EQ(rp2040->readUint32(TIMER + ARMED), 0);
+  EXPECT_EQ(rp2040->readUint32(TIMER + INTR), 0);
+}
+
+// should deliver what the firmware sends in batches, ending each line or
+// once the flush delay passed
+TEST(uart_transmit, uart) {
+  const number UART0 = 0x40034000;
+  RP2040 *rp2040 = new RP2040();
+  vector<string> batches;
+  rp2040->uart[0]->onTransmit = [&](const uint8_t *data, number size) {
+    batches.push_back(string((const char *)data, size));
+  };
+  rp2040->writeUint32(UART0 + UARTCR, UARTCR_UARTEN | UARTCR_TXE);
+  for (char c : string("hi\nok")) {
+    rp2040->writeUint32(UART0 + UARTDR, c);
+  }
+  EXPECT_EQ(batches, (vector<string>{"hi\n"}));
+  EXPECT_EQ(rp2040->readUint32(UART0 + UARTFR), UARTFR_TXFE | UARTFR_RXFE);
+  rp2040->core0.advanceCycles(rp2040->uart[0]->flushDelay);
+  EXPECT_EQ(batches, (vector<string>{"hi\n", "ok"}));
+}
+
+// should fill the RX FIFO from the host and raise the RX interrupt until
+// the firmware read it
+TEST(uart_receive, uart) {
+  const number UART0 = 0x40034000;
+  RP2040 *rp2040 = new RP2040();
+  rp2040->writeUint32(UART0 + UARTLCR_H, UARTLCR_H_FEN);
+  rp2040->writeUint32(UART0 + UARTCR, UARTCR_UARTEN | UARTCR_RXE);
+  rp2040->writeUint32(UART0 + UARTIMSC, UART_RXI | UART_RTI);
+  string data(40, 'x');
+  EXPECT_EQ(rp2040->uart[0]->receive((const uint8_t *)data.data(), 40),
+            UART_FIFO_DEPTH);
+  EXPECT_EQ(rp2040->readUint32(UART0 + UARTFR), UARTFR_TXFE | UARTFR_RXFF);
+  EXPECT_TRUE(rp2040->core0.nvic.pendingInterrupts & (1 << UART0_IRQ));
+  for (number i = 0; i < UART_FIFO_DEPTH; i++) {
+    EXPECT_EQ(rp2040->readUint32(UART0 + UARTDR), 'x');
+  }
+  EXPECT_EQ(rp2040->readUint32(UART0 + UARTFR), UARTFR_TXFE | UARTFR_RXFE);
+  EXPECT_FALSE(rp2040->core0.nvic.pendingInterrupts & (1 << UART0_IRQ));
+}
+
+// should pass bytes both ways between a UART and a Unix socket client
+TEST(uart_bridge_socket, uart) {
+  const number UART0 = 0x40034000;
+  const string path = "/tmp/rp2040_test_" + to_string(getpid()) + ".sock";
+  RP2040 *rp2040 = new RP2040();
+  rp2040->writeUint32(UART0 + UARTCR, UARTCR_UARTEN | UARTCR_TXE | UARTCR_RXE);
+  UARTBridge *bridge = new UARTBridge(rp2040, rp2040->uart[0], "unix:" + path);
+  const int client = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path.c_str());
+  ASSERT_EQ(connect(client, (sockaddr *)&address, sizeof(address)), 0);
+  ASSERT_EQ(write(client, "ping", 4), 4);
+  string received;
+  for (number i = 0; i < 1000 && received.size() < 4; i++) {
+    rp2040->core0.advanceCycles(UART_BRIDGE_POLL_CYCLES);
+    while (!(rp2040->readUint32(UART0 + UARTFR) & UARTFR_RXFE)) {
+      received += (char)rp2040->readUint32(UART0 + UARTDR);
+    }
+    usleep(1000);
+  }
+  EXPECT_EQ(received, "ping");
+  for (char c : string("pong\n")) {
+    rp2040->writeUint32(UART0 + UARTDR, c);
+  }
+  char sent[5];
+  EXPECT_EQ(recv(client, sent, 5, MSG_WAITALL), 5);
+  EXPECT_EQ(string(sent, 5), "pong\n");
+  // What the firmware sent last still reaches the client
+  rp2040->uart[0]->lineBuffered = false;
+  for (number i = 0; i < 16000; i++) {
+    rp2040->writeUint32(UART0 + UARTDR, 'a' + i % 26);
+  }
+  rp2040->uart[0]->flush();
+  delete bridge;
+  string tail(16000, 0);
+  EXPECT_EQ(recv(client, tail.data(), 16000, MSG_WAITALL), 16000);
+  EXPECT_EQ(tail.substr(0, 3), "abc");
+  close(client);
+}
+
+// should drive the pins given to SIO and report their changes in batches,
+// with the time they happened at
+TEST(gpio_sio_outputs, gpio) {
+  const number IO_BANK0 = 0x40014000;
+  RP2040 *rp2040 = new RP2040();
+  vector<PinChange> changes;
+  rp2040->ioBank0->subscribe([&](const PinChange *batch, number count) {
+    changes.insert(changes.end(), batch, batch + count);
+  });
+  rp2040->writeUint32(IO_BANK0 + 25 * 8 + IO_BANK0_GPIO_CTRL, GPIO_FUNC_SIO);
+  rp2040->writeUint32(SIO_START_ADDRESS + SIO_GPIO_OUT_SET_OFFSET, 1 << 25);
+  EXPECT_EQ(rp2040->ioBank0->getPins(), 0);
+  rp2040->writeUint32(SIO_START_ADDRESS + SIO_GPIO_OE_SET_OFFSET, 1 << 25);
+  rp2040->core0.cycles = 100;
+  rp2040->writeUint32(SIO_START_ADDRESS + SIO_GPIO_OUT_XOR_OFFSET, 1 << 25);
+  EXPECT_EQ(rp2040->readUint32(SIO_START_ADDRESS + SIO_GPIO_IN_OFFSET), 0);
+  EXPECT_TRUE(changes.empty());
+  rp2040->core0.advanceCycles(rp2040->ioBank0->flushDelay);
+  ASSERT_EQ(changes.size(), 2);
+  EXPECT_EQ(changes[0].cycles, 0);
+  EXPECT_EQ(changes[0].values, 1 << 25);
+  EXPECT_EQ(changes[1].cycles, 100);
+  EXPECT_EQ(changes[1].values, 0);
+  EXPECT_EQ(changes[1].changed, 1 << 25);
+}
+
+// should latch the edges of an input and raise IO_IRQ_BANK0 on the core
+// that enabled them, until the edge is acknowledged
+TEST(gpio_edge_interrupt, gpio) {
+  const number IO_BANK0 = 0x40014000;
+  const number INTR0 = IO_BANK0 + IO_BANK0_INTR0;
+  RP2040 *rp2040 = new RP2040();
+  // GPIO 2 rising edge, set through the atomic alias like the SDK does
+  rp2040->writeUint32(IO_BANK0 + ATOMIC_SET_OFFSET + IO_BANK0_PROC0_INTE0,
+                      GPIO_IRQ_EDGE_HIGH << 8);
+  EXPECT_EQ(rp2040->readUint32(INTR0), 0x11111111);
+  rp2040->ioBank0->setInputs(1 << 2);
+  // Level high and edge high
+  EXPECT_EQ(rp2040->readUint32(INTR0), 0x11111a11);
+  EXPECT_EQ(rp2040->readUint32(IO_BANK0 + IO_BANK0_PROC0_INTS0),
+            GPIO_IRQ_EDGE_HIGH << 8);
+  EXPECT_TRUE(rp2040->core0.nvic.pendingInterrupts & (1 << IO_IRQ_BANK0));
+  EXPECT_FALSE(rp2040->core1.nvic.pendingInterrupts & (1 << IO_IRQ_BANK0));
+  rp2040->writeUint32(INTR0, GPIO_IRQ_EDGE_HIGH << 8);
+  EXPECT_FALSE(rp2040->core0.nvic.pendingInterrupts & (1 << IO_IRQ_BANK0));
+}
+
+// should run a PIO program at the clock divider's rate, driving a pin from
+// the words written to the TX FIFO
+TEST(pio_out_pins, pio) {
+  const number IO_BANK0 = 0x40014000;
+  const number SM0 = PIO0_BASE + PIO_SM0_CLKDIV;
+  RP2040 *rp2040 = new RP2040();
+  vector<PinChange> changes;
+  rp2040->ioBank0->subscribe([&](const PinChange *batch, number count) {
+    changes.insert(changes.end(), batch, batch + count);
+  });
+  rp2040->writeUint32(IO_BANK0 + 2 * 8 + IO_BANK0_GPIO_CTRL, GPIO_FUNC_PIO0);
+  // pull block; out pins, 1, wrapping back to the pull
+  rp2040->writeUint32(PIO0_BASE + PIO_INSTR_MEM0, 0x80a0);
+  rp2040->writeUint32(PIO0_BASE + PIO_INSTR_MEM0 + 4, 0x6001);
+  rp2040->writeUint32(SM0 + PIO_SM_EXECCTRL,
+                      1 << PIO_EXECCTRL_WRAP_TOP_SHIFT);
+  // OUT and SET to GPIO 2, 4 cycles per instruction
+  rp2040->writeUint32(SM0 + PIO_SM_PINCTRL,
+                      (1 << PIO_PINCTRL_SET_COUNT_SHIFT) |
+                          (1 << PIO_PINCTRL_OUT_COUNT_SHIFT) |
+                          (2 << PIO_PINCTRL_SET_BASE_SHIFT) | 2);
+  rp2040->writeUint32(SM0, 4 << 16);
+  // set pindirs, 1
+  rp2040->writeUint32(SM0 + PIO_SM_INSTR, 0xe081);
+  EXPECT_EQ(rp2040->readUint32(PIO0_BASE + PIO_DBG_PADOE), 1 << 2);
+  rp2040->writeUint32(PIO0_BASE + ATOMIC_SET_OFFSET + PIO_CTRL, 1);
+  rp2040->core0.cycles = 100;
+  rp2040->writeUint32(PIO0_BASE + PIO_TXF0, 1);
+  // The state machine runs on its own until it stalls
+  rp2040->core0.advanceCycles(PIO_QUANTUM_CYCLES);
+  EXPECT_EQ(rp2040->ioBank0->getPins(), 1 << 2);
+  EXPECT_EQ(rp2040->readUint32(SM0 + PIO_SM_ADDR), 0);
+  EXPECT_TRUE(rp2040->readUint32(SM0 + PIO_SM_EXECCTRL) &
+              PIO_EXECCTRL_EXEC_STALLED);
+  EXPECT_EQ(rp2040->readUint32(PIO0_BASE + PIO_FDEBUG),
+            1 << PIO_FDEBUG_TXSTALL_SHIFT);
+  const number cycles = rp2040->core0.cycles;
+  rp2040->writeUint32(PIO0_BASE + PIO_TXF0, 0);
+  rp2040->core0.advanceCycles(rp2040->ioBank0->flushDelay);
+  ASSERT_EQ(changes.size(), 2);
+  EXPECT_EQ(changes[0].cycles, 104);
+  EXPECT_EQ(changes[1].cycles, cycles + 4);
+  EXPECT_EQ(changes[1].values, 0);
+}
+
+// should autopush to the RX FIFO until it is full, raising the interrupt
+// enabled for it
+TEST(pio_autopush, pio) {
+  const number SM0 = PIO0_BASE + PIO_SM0_CLKDIV;
+  RP2040 *rp2040 = new RP2040();
+  // set x, 5; in x, 32 in a loop
+  rp2040->writeUint32(PIO0_BASE + PIO_INSTR_MEM0, 0xe025);
+  rp2040->writeUint32(PIO0_BASE + PIO_INSTR_MEM0 + 4, 0x4020);
+  rp2040->writeUint32(SM0 + PIO_SM_EXECCTRL,
+                      (1 << PIO_EXECCTRL_WRAP_TOP_SHIFT) |
+                          (1 << PIO_EXECCTRL_WRAP_BOTTOM_SHIFT));
+  rp2040->writeUint32(SM0 + PIO_SM_SHIFTCTRL, PIO_SHIFTCTRL_AUTOPUSH);
+  rp2040->writeUint32(PIO0_BASE + PIO_IRQ0_INTE, 1);
+  rp2040->writeUint32(PIO0_BASE + PIO_CTRL, 1);
+  EXPECT_FALSE(rp2040->core0.nvic.pendingInterrupts & (1 << PIO0_IRQ_0));
+  rp2040->core0.cycles = 20;
+  EXPECT_EQ(rp2040->readUint32(PIO0_BASE + PIO_FLEVEL), 0x40);
+  EXPECT_EQ(rp2040->readUint32(PIO0_BASE + PIO_FSTAT) & 0x0f0f, 0x0e01);
+  EXPECT_EQ(rp2040->readUint32(PIO0_BASE + PIO_FDEBUG),
+            1 << PIO_FDEBUG_RXSTALL_SHIFT);
+  EXPECT_TRUE(rp2040->core0.nvic.pendingInterrupts & (1 << PIO0_IRQ_0));
+  EXPECT_TRUE(rp2040->core1.nvic.pendingInterrupts & (1 << PIO0_IRQ_0));
+  EXPECT_EQ(rp2040->readUint32(PIO0_BASE + PIO_RXF0), 5);
+  // Reading made room for one more
+  rp2040->core0.cycles = 30;
+  EXPECT_EQ(rp2040->readUint32(PIO0_BASE + PIO_FLEVEL), 0x40);
+}
+
+// should wrap a program loaded at the top of the instruction memory, like
+// the SDK loads them
+TEST(pio_wrap_top, pio) {
+  const number SM0 = PIO0_BASE + PIO_SM0_CLKDIV;
+  RP2040 *rp2040 = new RP2040();
+  // set x, 5; in x, 32 in a loop at 28 and 29
+  rp2040->writeUint32(PIO0_BASE + PIO_INSTR_MEM0 + 28 * 4, 0xe025);
+  rp2040->writeUint32(PIO0_BASE + PIO_INSTR_MEM0 + 29 * 4, 0x4020);
+  const number execctrl = (29 << PIO_EXECCTRL_WRAP_TOP_SHIFT) |
+                          (28 << PIO_EXECCTRL_WRAP_BOTTOM_SHIFT);
+  rp2040->writeUint32(SM0 + PIO_SM_EXECCTRL, execctrl);
+  EXPECT_EQ(rp2040->readUint32(SM0 + PIO_SM_EXECCTRL), execctrl);
+  rp2040->writeUint32(SM0 + PIO_SM_SHIFTCTRL, PIO_SHIFTCTRL_AUTOPUSH);
+  // jmp 28
+  rp2040->writeUint32(SM0 + PIO_SM_INSTR, 0x001c);
+  rp2040->writeUint32(PIO0_BASE + PIO_CTRL, 1);
+  rp2040->core0.cycles = 20;
+  // Past 29 it would run into the jmp 0 of the empty instruction memory
+  EXPECT_EQ(rp2040->readUint32(PIO0_BASE + PIO_FLEVEL), 0x40);
+  EXPECT_EQ(rp2040->readUint32(SM0 + PIO_SM_ADDR), 29);
+}
+
+// should copy between SRAM and flash at once, staying busy for a cycle per
+// transfer before it raises its interrupt and triggers the channel it
+// chains to
+TEST(dma_memory_copy, dma) {
+  const number CH1 = DMA_BASE + DMA_CHANNEL_STRIDE;
+  RP2040 *rp2040 = new RP2040();
+  for (number i = 0; i < 64; i++) {
+    rp2040->flash[i] = i;
+  }
+  rp2040->sram[0x100] = 0xa5;
+  rp2040->writeUint32(DMA_BASE + DMA_INTE0, 0x3);
+  // Channel 1 fills 16 bytes with the byte at 0x20000100
+  rp2040->writeUint32(CH1, RAM_START_ADDRESS + 0x100);
+  rp2040->writeUint32(CH1 + 4, RAM_START_ADDRESS + 0x200);
+  rp2040->writeUint32(CH1 + 8, 16);
+  rp2040->writeUint32(CH1 + 0x10,
+                      DMA_CTRL_EN | DMA_CTRL_INCR_WRITE |
+                          (TREQ_PERMANENT << DMA_CTRL_TREQ_SEL_SHIFT) |
+                          (1 << DMA_CTRL_CHAIN_TO_SHIFT));
+  // Channel 0 copies 16 words of flash and chains to channel 1
+  rp2040->writeUint32(DMA_BASE, FLASH_START_ADDRESS);
+  rp2040->writeUint32(DMA_BASE + 4, RAM_START_ADDRESS);
+  rp2040->writeUint32(DMA_BASE + 8, 16);
+  rp2040->writeUint32(DMA_BASE + 0xc,
+                      DMA_CTRL_EN | (2 << DMA_CTRL_DATA_SIZE_SHIFT) |
+                          DMA_CTRL_INCR_READ | DMA_CTRL_INCR_WRITE |
+                          (TREQ_PERMANENT << DMA_CTRL_TREQ_SEL_SHIFT) |
+                          (1 << DMA_CTRL_CHAIN_TO_SHIFT));
+  EXPECT_EQ(memcmp(rp2040->sram, rp2040->flash, 64), 0);
+  EXPECT_TRUE(rp2040->readUint32(DMA_BASE + 0xc) & DMA_CTRL_BUSY);
+  rp2040->core0.advanceCycles(10);
+  EXPECT_EQ(rp2040->readUint32(DMA_BASE + 8), 6);
+  EXPECT_EQ(rp2040->readUint32(DMA_BASE + 4), RAM_START_ADDRESS + 64);
+  EXPECT_FALSE(rp2040->core0.nvic.pendingInterrupts & (1 << DMA_IRQ_0));
+  rp2040->core0.advanceCycles(6);
+  EXPECT_FALSE(rp2040->readUint32(DMA_BASE + 0xc) & DMA_CTRL_BUSY);
+  EXPECT_EQ(rp2040->readUint32(DMA_BASE + DMA_INTR), 0x1);
+  EXPECT_TRUE(rp2040->core0.nvic.pendingInterrupts & (1 << DMA_IRQ_0));
+  EXPECT_EQ(rp2040->sram[0x200], 0xa5);
+  EXPECT_EQ(rp2040->sram[0x20f], 0xa5);
+  EXPECT_EQ(rp2040->sram[0x210], 0);
+  rp2040->core0.advanceCycles(16);
+  EXPECT_EQ(rp2040->readUint32(DMA_BASE + DMA_INTS0), 0x3);
+  rp2040->writeUint32(DMA_BASE + DMA_INTS0, 0x3);
+  EXPECT_FALSE(rp2040->core0.nvic.pendingInterrupts & (1 << DMA_IRQ_0));
+}
+
+// should pace the transfers to a UART on its DREQ, wrapping the reads in a
+// ring
+TEST(dma_uart_ring, dma) {
+  const number UART0 = 0x40034000;
+  RP2040 *rp2040 = new RP2040();
+  string output;
+  rp2040->uart[0]->lineBuffered = false;
+  rp2040->uart[0]->onTransmit = [&](const uint8_t *data, number size) {
+    output.append((const char *)data, size);
+  };
+  rp2040->writeUint32(UART0 + UARTCR,
+                      UARTCR_UARTEN | UARTCR_TXE | UARTCR_RXE);
+  memcpy(rp2040->sram, "abcd", 4);
+  rp2040->writeUint32(DMA_BASE, RAM_START_ADDRESS);
+  rp2040->writeUint32(DMA_BASE + 4, UART0 + UARTDR);
+  rp2040->writeUint32(DMA_BASE + 8, 10);
+  rp2040->writeUint32(DMA_BASE + 0xc,
+                      DMA_CTRL_EN | DMA_CTRL_INCR_READ |
+                          (2 << DMA_CTRL_RING_SIZE_SHIFT) |
+                          (DREQ_UART0_TX << DMA_CTRL_TREQ_SEL_SHIFT));
+  // Waits for the UART to request the data
+  EXPECT_EQ(rp2040->readUint32(DMA_BASE + 8), 10);
+  rp2040->writeUint32(UART0 + UARTDMACR, UARTDMACR_TXDMAE);
+  rp2040->core0.advanceCycles(DMA_POLL_CYCLES);
+  rp2040->uart[0]->flush();
+  EXPECT_EQ(output, "abcdabcdab");
+  EXPECT_EQ(rp2040->readUint32(DMA_BASE), RAM_START_ADDRESS + 2);
+}
+
+// should let a pacing timer allow X/Y transfers per cycle
+TEST(dma_timer_pacing, dma) {
+  RP2040 *rp2040 = new RP2040();
+  // One transfer every 10 cycles
+  rp2040->writeUint32(DMA_BASE + DMA_TIMER0, (1 << 16) | 10);
+  rp2040->writeUint32(DMA_BASE, RAM_START_ADDRESS);
+  rp2040->writeUint32(DMA_BASE + 4, RAM_START_ADDRESS + 0x100);
+  rp2040->writeUint32(DMA_BASE + 8, 3);
+  rp2040->writeUint32(DMA_BASE + 0xc,
+                      DMA_CTRL_EN | DMA_CTRL_INCR_READ | DMA_CTRL_INCR_WRITE |
+                          (TREQ_TIMER0 << DMA_CTRL_TREQ_SEL_SHIFT));
+  rp2040->core0.advanceCycles(25);
+  EXPECT_EQ(rp2040->readUint32(DMA_BASE + 8), 1);
+  rp2040->core0.advanceCycles(4);
+  EXPECT_TRUE(rp2040->readUint32(DMA_BASE + 0xc) & DMA_CTRL_BUSY);
+  rp2040->core0.advanceCycles(2);
+  EXPECT_FALSE(rp2040->readUint32(DMA_BASE + 0xc) & DMA_CTRL_BUSY);
+}
+
+// should transfer to and from the SIO GPIO registers while the cores run on
+// their own threads
+TEST(dma_sio_threaded, dma) {
+  const number CH1 = DMA_BASE + DMA_CHANNEL_STRIDE;
+  RP2040 *rp2040 = new RP2040();
+  rp2040->flash16[0] = opcodeSTR(R1, R0, 0xc);
+  rp2040->flash16[1] = 0x6c82; // ldr r2, [r0, #0x48]
+  rp2040->flash16[2] = 0x2a00; // cmp r2, #0
+  rp2040->flash16[3] = 0xd1fc; // bne.n 0x10000002
+  rp2040->flash16[4] = 0xbe00; // bkpt 0
+  rp2040->flash16[0x80] = 0xe7fe; // b.n .
+  rp2040->sram[0x100] = 0x5;
+  // Channel 0 sets GPIO_OUT and chains to channel 1, which reads GPIO_IN
+  rp2040->writeUint32(DMA_BASE, RAM_START_ADDRESS + 0x100);
+  rp2040->writeUint32(DMA_BASE + 4, SIO_START_ADDRESS + SIO_GPIO_OUT_OFFSET);
+  rp2040->writeUint32(DMA_BASE + 8, 1);
+  rp2040->writeUint32(CH1, SIO_START_ADDRESS + SIO_GPIO_IN_OFFSET);
+  rp2040->writeUint32(CH1 + 4, RAM_START_ADDRESS + 0x200);
+  rp2040->writeUint32(CH1 + 8, 1);
+  rp2040->writeUint32(CH1 + 0x10,
+                      DMA_CTRL_EN | (2 << DMA_CTRL_DATA_SIZE_SHIFT) |
+                          (TREQ_PERMANENT << DMA_CTRL_TREQ_SEL_SHIFT) |
+                          (1 << DMA_CTRL_CHAIN_TO_SHIFT));
+  rp2040->core0.registers[R0] = DMA_BASE;
+  rp2040->core0.registers[R1] = DMA_CTRL_EN | (2 << DMA_CTRL_DATA_SIZE_SHIFT) |
+                                (TREQ_PERMANENT << DMA_CTRL_TREQ_SEL_SHIFT) |
+                                (1 << DMA_CTRL_CHAIN_TO_SHIFT);
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core1.setPC(0x10000100);
+  rp2040->quantum = 100;
+  rp2040->threaded = true;
+  EXPECT_GT(rp2040->execute(), 0);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x1000000a);
+  EXPECT_EQ(rp2040->readUint32(SIO_START_ADDRESS + SIO_GPIO_OUT_OFFSET), 0x5);
+}
+
+// should print a few accesses of each unimplemented register and count all
+TEST(log_sink, logging) {
+  RP2040 *rp2040 = new RP2040();
+  ostringstream log;
+  rp2040->logSink.output = &log;
+  for (int i = 0; i < 6; i++) {
+    rp2040->readUint32(0x4006c000);
+  }
+  rp2040->writeUint32(0x4006c004, 0x55);
+  rp2040->logSink.flush();
+  EXPECT_EQ(log.str(),
+            "Unimplemented peripheral TBMAN_BASE read from 0x0 at cycle 0\n"
+            "Unimplemented peripheral TBMAN_BASE read from 0x0 at cycle 0\n"
+            "Unimplemented peripheral TBMAN_BASE read from 0x0 at cycle 0\n"
+            "Unimplemented peripheral TBMAN_BASE read from 0x0 at cycle 0"
+            " (only counting the next ones)\n"
+            "Unimplemented peripheral TBMAN_BASE write to 0x4: 0x55"
+            " at cycle 0\n");
+  ostringstream summary;
+  rp2040->logSink.printSummary(summary);
+  EXPECT_NE(summary.str().find("  TBMAN_BASE              0x0                6"
+                               "         0  0x0\n"),
+            string::npos);
+  EXPECT_NE(summary.str().find("  TBMAN_BASE              0x4                0"
+                               "         1  0x55\n"),
+            string::npos);
+}
+
+// should record the pin changes to a file that converts to a VCD
+TEST(waveform_vcd, gpio) {
+  const number IO_BANK0 = 0x40014000;
+  const string path = "/tmp/rp2040_test_" + to_string(getpid()) + ".wave";
+  RP2040 *rp2040 = new RP2040();
+  for (number pin : {0, 1}) {
+    rp2040->writeUint32(IO_BANK0 + pin * 8 + IO_BANK0_GPIO_CTRL,
+                        GPIO_FUNC_SIO);
+  }
+  rp2040->writeUint32(SIO_START_ADDRESS + SIO_GPIO_OE_SET_OFFSET, 0x3);
+  WaveformRecorder *recorder = new WaveformRecorder(rp2040, path);
+  rp2040->core0.cycles = 125;
+  rp2040->writeUint32(SIO_START_ADDRESS + SIO_GPIO_OUT_SET_OFFSET, 0x1);
+  rp2040->core0.cycles = 250;
+  rp2040->writeUint32(SIO_START_ADDRESS + SIO_GPIO_OUT_XOR_OFFSET, 0x3);
+  delete recorder;
+  ifstream input(path, ios::binary);
+  ostringstream vcd;
+  convertWaveformToVCD(input, vcd);
+  unlink(path.c_str());
+  EXPECT_NE(vcd.str().find("$var wire 1 \" gpio1 $end\n"), string::npos);
+  EXPECT_NE(vcd.str().find("$end\n#1000\n1!\n#2000\n0!\n1\"\n"),
+            string::npos);
+}
+
+// should count the Cortex-M0+ cycles of each instruction
+TEST(cycles_instructions, scheduler) {
+  for (bool blocks : {false, true}) {
+    RP2040 *rp2040 = new RP2040();
+    rp2040->core0.setPC(0x10000000);
+    rp2040->core0.registers[R1] = RAM_START_ADDRESS;
+    rp2040->flash16[0] = opcodeMOVS(R0, 1);
+    rp2040->flash16[1] = opcodeLDMIA(R1, (1 << R2) | (1 << R3));
+    rp2040->flash16[2] = 0xd100; // bne.n 0x10000008
+    uint32_t *flash32 = (uint32_t *)rp2040->flash;
+    flash32[2] = opcodeBL(0x10);
+    while (rp2040->core0.getPC() != 0x1000001c) {
+      if (blocks) {
+        rp2040->core0.executeBlock();
+      } else {
+        rp2040->core0.executeInstruction();
+      }
+    }
+    EXPECT_EQ(rp2040->core0.cycles, 1 + 3 + 2 + 3);
+  }
+}
+
+// should run the events due during the entry to an exception handler
+TEST(cycles_exception_entry, scheduler) {
+  RP2040 *rp2040 = new RP2040();
+  rp2040->writeUint32(VTOR, RAM_START_ADDRESS);
+  rp2040->writeUint32(RAM_START_ADDRESS + 16 * 4, 0x10000101);
+  rp2040->writeUint32(PPB_BASE + OFFSET_NVIC_ISER, 1);
+  rp2040->flash16[0x80] = opcodeMOVS(R0, 1);
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core0.setInterrupt(0, true);
+  number eventCycles = 0;
+  rp2040->schedule(5, [&]() { eventCycles = rp2040->core0.cycles; });
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000102);
+  EXPECT_EQ(eventCycles, EXCEPTION_ENTRY_CYCLES);
 }
 
 // should execute a `pop pc, {r4, r5, r6}` instruction
 TEST(execute_pop_instruction, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
-  rp2040->setSP(RAM_START_ADDRESS + 0xf0);
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core0.setSP(RAM_START_ADDRESS + 0xf0);
   rp2040->flash16[0] = opcodePOP(true, (1 << R4) | (1 << R5) | (1 << R6));
   rp2040->sram[0xf0] = 0x40;
   rp2040->sram[0xf4] = 0x50;
   rp2040->sram[0xf8] = 0x60;
   rp2040->sram[0xfc] = 0x42;
-  rp2040->executeInstruction();
+  rp2040->core0.executeInstruction();
   // assert that the values of r4, r5, r6, lr were pushed into the stack
-  EXPECT_EQ(rp2040->registers[R4], 0x40);
-  EXPECT_EQ(rp2040->registers[R5], 0x50);
-  EXPECT_EQ(rp2040->registers[R6], 0x60);
-  EXPECT_EQ(rp2040->getPC(), 0x42);
+  EXPECT_EQ(rp2040->core0.registers[R4], 0x40);
+  EXPECT_EQ(rp2040->core0.registers[R5], 0x50);
+  EXPECT_EQ(rp2040->core0.registers[R6], 0x60);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x42);
 }
 
 // should execute a `push {r4, r5, r6, lr}` instruction
 TEST(execute_push_instruction, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
-  rp2040->setSP(RAM_START_ADDRESS + 0x100);
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core0.setSP(RAM_START_ADDRESS + 0x100);
   rp2040->flash16[0] = 0xB570; // push {r4, r5, r6, lr}
   EXPECT_EQ(rp2040->flash[0], 0x70);
   EXPECT_EQ(rp2040->flash[1], 0xB5);
-  rp2040->registers[R4] = 0x40;
-  rp2040->registers[R5] = 0x50;
-  rp2040->registers[R6] = 0x60;
-  rp2040->setLR(0x42);
-  rp2040->executeInstruction();
+  rp2040->core0.registers[R4] = 0x40;
+  rp2040->core0.registers[R5] = 0x50;
+  rp2040->core0.registers[R6] = 0x60;
+  rp2040->core0.setLR(0x42);
+  rp2040->core0.executeInstruction();
   // assert that the values of r4, r5, r6, lr were pushed into the stack
-  EXPECT_EQ(rp2040->getSP(), RAM_START_ADDRESS + 0xF0);
+  EXPECT_EQ(rp2040->core0.getSP(), RAM_START_ADDRESS + 0xF0);
   EXPECT_EQ(rp2040->sram[0xF0], 0x40);
   EXPECT_EQ(rp2040->sram[0xF4], 0x50);
   EXPECT_EQ(rp2040->sram[0xF8], 0x60);
@@ -69,481 +862,495 @@ TEST(execute_push_instruction, executeInstruction) {
 // should execute a `mrs r0, ipsr` instruction
 TEST(execute_mrs_instruction, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flashView->setUint32(0, opcodeMRS(R0, 5)); // 5 === ipsr
-  rp2040->registers[R0] = 55;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R0], 0);
-  EXPECT_EQ(rp2040->getPC(), 0x10000004);
+  rp2040->core0.registers[R0] = 55;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R0], 0);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000004);
+}
+
+// should read the flags of a preceding `subs r1, #1` with `mrs r0, apsr`
+TEST(execute_mrs_instruction_apsr, executeInstruction) {
+  RP2040 *rp2040 = new RP2040();
+  rp2040->core0.setPC(0x10000000);
+  rp2040->flash16[0] = opcodeSUBS2(R1, 1);
+  rp2040->flashView->setUint32(2, opcodeMRS(R0, 0)); // 0 === apsr
+  rp2040->core0.registers[R1] = 0x80000000;
+  rp2040->core0.executeInstruction();
+  rp2040->core0.executeInstruction();
+  // N and Z clear, C and V set
+  EXPECT_EQ(rp2040->core0.registers[R0], 0x30000000);
+  EXPECT_EQ(rp2040->core0.registers[R1], 0x7fffffff);
 }
 
 // should execute a `msr ipsr, r0` instruction
 TEST(execute_msr_instruction, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flashView->setUint32(0, opcodeMSR(8, R0)); // 5 === ipsr
-  rp2040->registers[0] = 0x1234;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->getSP(), 0x1234);
-  EXPECT_EQ(rp2040->getPC(), 0x10000004);
+  rp2040->core0.registers[0] = 0x1234;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.getSP(), 0x1234);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000004);
 }
 
 // should execute a `movs r5, #128` instruction
 TEST(execute_mov_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeMOVS(R5, 128);
   EXPECT_EQ(rp2040->flash[0], 0x80);
   EXPECT_EQ(rp2040->flash[1], 0x25);
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R5], 128);
-  EXPECT_EQ(rp2040->getPC(), 0x10000002);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R5], 128);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000002);
 }
 
 // should execute a `lsrs r1, r1, #1` instruction
 TEST(execute_lsrs_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeLSRS(R1, R1, 1);
-  rp2040->registers[R1] = 0b10;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R1], 0b1);
-  EXPECT_EQ(rp2040->getPC(), 0x10000002);
-  EXPECT_EQ(rp2040->C, false);
+  rp2040->core0.registers[R1] = 0b10;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R1], 0b1);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000002);
+  EXPECT_EQ(rp2040->core0.C, false);
 }
 
 // should execute a `lsrs r1, r1, 0` instruction
 TEST(execute_lsrs_instruction_2, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeLSRS(R1, R1, 0);
-  rp2040->registers[R1] = 0xffffffff;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R1], 0);
-  EXPECT_EQ(rp2040->getPC(), 0x10000002);
-  EXPECT_EQ(rp2040->C, true);
+  rp2040->core0.registers[R1] = 0xffffffff;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R1], 0);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000002);
+  EXPECT_EQ(rp2040->core0.C, true);
 }
 
 // should execute a `lsrs r5, r0` instruction
 TEST(execute_lsrs_instruction_3, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeLSRSreg(R5, R0);
-  rp2040->registers[R5] = 0xff00000f;
-  rp2040->registers[R0] = 0xff003302; // Shift amount: 02
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R5], 0x3fc00003);
-  EXPECT_EQ(rp2040->getPC(), 0x10000002);
-  EXPECT_EQ(rp2040->C, true);
+  rp2040->core0.registers[R5] = 0xff00000f;
+  rp2040->core0.registers[R0] = 0xff003302; // Shift amount: 02
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R5], 0x3fc00003);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000002);
+  EXPECT_EQ(rp2040->core0.C, true);
 }
 
 // should execute a `movs r6, r5` instruction
 TEST(execute_mov_instruction_2, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = 0x002E; // movs r6, r5
-  rp2040->registers[R5] = 0x50;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R6], 0x50);
+  rp2040->core0.registers[R5] = 0x50;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R6], 0x50);
 }
 
 // should execute an `eors r1, r3` instruction
 TEST(execute_eors_instruction, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeEORS(R1, R3);
-  rp2040->registers[R1] = 0xf0f0f0f0;
-  rp2040->registers[R3] = 0x08ff3007;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R1], 0xf80fc0f7);
-  EXPECT_EQ(rp2040->N, true);
-  EXPECT_EQ(rp2040->Z, false);
+  rp2040->core0.registers[R1] = 0xf0f0f0f0;
+  rp2040->core0.registers[R3] = 0x08ff3007;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R1], 0xf80fc0f7);
+  EXPECT_EQ(rp2040->core0.N, true);
+  EXPECT_EQ(rp2040->core0.Z, false);
 }
 
 // should execute a `mov r3, r8` instruction
 TEST(execute_mov_instruction_3, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeMOV(R3, R8);
-  rp2040->registers[R8] = 55;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R3], 55);
+  rp2040->core0.registers[R8] = 55;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R3], 55);
 }
 
 // should execute a `mov r3, pc` instruction
 TEST(execute_mov_instruction_4, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeMOV(R3, PC);
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R3], 0x10000004);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R3], 0x10000004);
 }
 
 // should execute a `muls r0, r2` instruction
 TEST(execute_muls_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeMULS(R0, R2);
-  rp2040->registers[R0] = 5;
-  rp2040->registers[R2] = 1000000;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R2], 5000000);
-  EXPECT_EQ(rp2040->N, false);
-  EXPECT_EQ(rp2040->Z, false);
+  rp2040->core0.registers[R0] = 5;
+  rp2040->core0.registers[R2] = 1000000;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R2], 5000000);
+  EXPECT_EQ(rp2040->core0.N, false);
+  EXPECT_EQ(rp2040->core0.Z, false);
 }
 
 // should execute a `muls r0, r2` instruction and
 // set the Z flag when the result is zero
 TEST(execute_muls_instruction_2, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeMULS(R0, R2);
-  rp2040->registers[R0] = 0;
-  rp2040->registers[R2] = 1000000;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R2], 0);
-  EXPECT_EQ(rp2040->N, false);
-  EXPECT_EQ(rp2040->Z, true);
+  rp2040->core0.registers[R0] = 0;
+  rp2040->core0.registers[R2] = 1000000;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R2], 0);
+  EXPECT_EQ(rp2040->core0.N, false);
+  EXPECT_EQ(rp2040->core0.Z, true);
 }
 
 // should execute a `muls r0, r2` instruction and
 // set the N flag when the result is negative
 TEST(execute_muls_instruction_3, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeMULS(R0, R2);
-  rp2040->registers[R0] = -1;
-  rp2040->registers[R2] = 1000000;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R2], (uint32_t)-1000000 >> 0);
-  EXPECT_EQ(rp2040->N, true);
-  EXPECT_EQ(rp2040->Z, false);
+  rp2040->core0.registers[R0] = -1;
+  rp2040->core0.registers[R2] = 1000000;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R2], (uint32_t)-1000000 >> 0);
+  EXPECT_EQ(rp2040->core0.N, true);
+  EXPECT_EQ(rp2040->core0.Z, false);
 }
 
 // should execute a muls instruction with
 // large 32-bit numbers and produce the correct result
 TEST(execute_muls_instruction_4, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeMULS(R0, R2);
-  rp2040->registers[R0] = 2654435769;
-  rp2040->registers[R2] = 340573321;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R2], 1);
+  rp2040->core0.registers[R0] = 2654435769;
+  rp2040->core0.registers[R2] = 340573321;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R2], 1);
 }
 
 // should execute a `mvns r4, r3` instruction
 TEST(execute_mvns_instruction, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeMVNS(R4, R3);
-  rp2040->registers[R3] = 0x11115555;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R4], 0xeeeeaaaa);
-  EXPECT_EQ(rp2040->Z, false);
-  EXPECT_EQ(rp2040->N, true);
+  rp2040->core0.registers[R3] = 0x11115555;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R4], 0xeeeeaaaa);
+  EXPECT_EQ(rp2040->core0.Z, false);
+  EXPECT_EQ(rp2040->core0.N, true);
 }
 
 // should execute `orrs r5, r0` instruction
 TEST(execute_orrs_instruction, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeORRS(R5, R0);
-  rp2040->registers[R5] = 0xf00f0000;
-  rp2040->registers[R0] = 0xf000ffff;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R5], 0xf00fffff);
-  EXPECT_EQ(rp2040->N, true);
-  EXPECT_EQ(rp2040->Z, false);
+  rp2040->core0.registers[R5] = 0xf00f0000;
+  rp2040->core0.registers[R0] = 0xf000ffff;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R5], 0xf00fffff);
+  EXPECT_EQ(rp2040->core0.N, true);
+  EXPECT_EQ(rp2040->core0.Z, false);
 }
 
 // should execute a `ldmia r0!, {r1, r2}` instruction
 TEST(execute_ldmia_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeLDMIA(R0, (1 << R1) | (1 << R2));
-  rp2040->registers[R0] = 0x20000000;
+  rp2040->core0.registers[R0] = 0x20000000;
   uint32_t *sram32 = (uint32_t *)rp2040->sram;
   sram32[0] = 0xf00df00d;
   sram32[1] = 0x4242;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->getPC(), 0x10000002);
-  EXPECT_EQ(rp2040->registers[R0], 0x20000008);
-  EXPECT_EQ(rp2040->registers[R1], 0xf00df00d);
-  EXPECT_EQ(rp2040->registers[R2], 0x4242);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000002);
+  EXPECT_EQ(rp2040->core0.registers[R0], 0x20000008);
+  EXPECT_EQ(rp2040->core0.registers[R1], 0xf00df00d);
+  EXPECT_EQ(rp2040->core0.registers[R2], 0x4242);
 }
 
 // should execute a `ldmia r5!, {r5}` instruction
 // without writing back the address to r5
 TEST(execute_ldmia_instruction_2, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeLDMIA(R5, 1 << R5);
-  rp2040->registers[R5] = 0x20000000;
+  rp2040->core0.registers[R5] = 0x20000000;
   uint32_t *sram32 = (uint32_t *)rp2040->sram;
   sram32[0] = 0xf00df00d;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->getPC(), 0x10000002);
-  EXPECT_EQ(rp2040->registers[R5], 0xf00df00d);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000002);
+  EXPECT_EQ(rp2040->core0.registers[R5], 0xf00df00d);
 }
 
 // should execute an `ldr r0, [pc, #148]` instruction
 TEST(execute_ldr_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = 0x4825; // ldr r0, [pc, #148]
   rp2040->flash[152] = 0x42;
   memset(&rp2040->flash[153], 0x00, sizeof(uint32_t));
-  rp2040->executeInstruction();
-  rp2040->registers[R5] = 0x50;
-  EXPECT_EQ(rp2040->registers[R0], 0x42);
-  EXPECT_EQ(rp2040->getPC(), 0x10000002);
+  rp2040->core0.executeInstruction();
+  rp2040->core0.registers[R5] = 0x50;
+  EXPECT_EQ(rp2040->core0.registers[R0], 0x42);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000002);
 }
 
 // should execute an `ldr r3, [r2, #24]` instruction
 TEST(execute_ldr_instruction_2, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = 0x6993; // ldr r3, [r2, #24]
-  rp2040->registers[R2] = 0x20000000;
+  rp2040->core0.registers[R2] = 0x20000000;
   rp2040->sram[24] = 0x55;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R3], 0x55);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R3], 0x55);
 }
 
 // should execute an `ldr r3, [r5, r6]` instruction
 TEST(execute_ldr_instruction_3, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeLDRreg(R3, R5, R6);
-  rp2040->registers[R5] = 0x20000000;
-  rp2040->registers[R6] = 0x8;
+  rp2040->core0.registers[R5] = 0x20000000;
+  rp2040->core0.registers[R6] = 0x8;
   rp2040->sram[8] = 0x11;
   rp2040->sram[9] = 0x42;
   rp2040->sram[10] = 0x55;
   rp2040->sram[11] = 0xff;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R3], 0xff554211);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R3], 0xff554211);
 }
 
 // should execute an `ldr r3, [sp, #12]` instruction
 TEST(execute_ldr_instruction_4, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
-  rp2040->setSP(0x20000000);
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core0.setSP(0x20000000);
   rp2040->flash16[0] = opcodeLDRsp(R3, 12);
   rp2040->sram[12] = 0x55;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R3], 0x55);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R3], 0x55);
 }
 
 // should execute an `ldrb r4, [r2, 5]` instruction
 TEST(execute_ldrb_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeLDRB(R4, R2, 5);
-  rp2040->registers[R2] = 0x20000000;
+  rp2040->core0.registers[R2] = 0x20000000;
   rp2040->sram[5] = 0x66;
   rp2040->sram[6] = 0x77;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R4], 0x66);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R4], 0x66);
 }
 
 // should execute an `ldrb r3, [r5, r6]` instruction
 TEST(execute_ldrb_instruction_2, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeLDRBreg(R3, R5, R6);
-  rp2040->registers[R5] = 0x20000000;
-  rp2040->registers[R6] = 0x8;
+  rp2040->core0.registers[R5] = 0x20000000;
+  rp2040->core0.registers[R6] = 0x8;
   rp2040->sram[8] = 0x11;
   rp2040->sram[9] = 0x42;
   rp2040->sram[10] = 0x55;
   rp2040->sram[11] = 0xff;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R3], 0x11);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R3], 0x11);
 }
 
 // should execute an `ldrh r3, [r7, #4]` instruction
 TEST(execute_ldrh_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeLDRH(R3, R7, 4);
-  rp2040->registers[R7] = 0x20000000;
+  rp2040->core0.registers[R7] = 0x20000000;
   rp2040->sram[4] = 0x66;
   rp2040->sram[5] = 0x77;
   rp2040->sram[6] = 0xff;
   rp2040->sram[7] = 0xff;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R3], 0x7766);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R3], 0x7766);
 }
 
 // should execute an `ldrh r3, [r7, #6]` instruction
 TEST(execute_ldrh_instruction_2, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeLDRH(R3, R7, 6);
-  rp2040->registers[R7] = 0x20000000;
+  rp2040->core0.registers[R7] = 0x20000000;
   rp2040->sram[4] = 0x66;
   rp2040->sram[5] = 0x77;
   rp2040->sram[6] = 0x44;
   rp2040->sram[7] = 0x33;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R3], 0x3344);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R3], 0x3344);
 }
 
 // should execute an `ldrh r3, [r5, r6]` instruction
 TEST(execute_ldrh_instruction_3, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeLDRHreg(R3, R5, R6);
-  rp2040->registers[R5] = 0x20000000;
-  rp2040->registers[R6] = 0x8;
+  rp2040->core0.registers[R5] = 0x20000000;
+  rp2040->core0.registers[R6] = 0x8;
   rp2040->sram[8] = 0x11;
   rp2040->sram[9] = 0x42;
   rp2040->sram[10] = 0x55;
   rp2040->sram[11] = 0xff;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R3], 0x4211);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R3], 0x4211);
 }
 
 // should execute an `ldrsb r5, [r3, r5]` instruction
 TEST(execute_ldrsb_instruction, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeLDRSB(R5, R3, R5);
-  rp2040->registers[R3] = 0x20000000;
-  rp2040->registers[R5] = 6;
+  rp2040->core0.registers[R3] = 0x20000000;
+  rp2040->core0.registers[R5] = 6;
   rp2040->sram[6] = 0x85;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R5], 0xffffff85);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R5], 0xffffff85);
 }
 
 // should execute an `ldrsh r5, [r3, r5]` instruction
 TEST(execute_ldrsh_instruction, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeLDRSH(R5, R3, R5);
-  rp2040->registers[R3] = 0x20000000;
-  rp2040->registers[R5] = 0x6;
+  rp2040->core0.registers[R3] = 0x20000000;
+  rp2040->core0.registers[R5] = 0x6;
   rp2040->sram[6] = 0x55;
   rp2040->sram[7] = 0xF0;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R5], 0xfffff055);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R5], 0xfffff055);
 }
 
 // should execute a `udf 1` instruction
 TEST(execute_udf_instruction, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = 0xde01; // udf 1
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->getPC(), 0x10000002);
-  EXPECT_EQ(rp2040->getBreakCount(), 1);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000002);
+  EXPECT_EQ(rp2040->core0.getBreakCount(), 1);
 }
 
 // should execute a `lsls r5, r5, #18` instruction
 TEST(execute_lsls_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = 0x04AD; // lsls r5, r5, #18
-  rp2040->registers[R5] = 0b00000000000000000011;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R5], 0b11000000000000000000);
-  EXPECT_EQ(rp2040->getPC(), 0x10000002);
-  EXPECT_EQ(rp2040->C, false);
+  rp2040->core0.registers[R5] = 0b00000000000000000011;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R5], 0b11000000000000000000);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000002);
+  EXPECT_EQ(rp2040->core0.C, false);
 }
 
 // should execute a `lsls r5, r0` instruction
 TEST(execute_lsls_instruction_2, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeLSLSreg(R5, R0);
-  rp2040->registers[R5] = 0b00000000000000000011;
-  rp2040->registers[R0] = 0xff003302; // bottom byte: 02
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R5], 0b00000000000000001100);
-  EXPECT_EQ(rp2040->getPC(), 0x10000002);
-  EXPECT_EQ(rp2040->C, false);
+  rp2040->core0.registers[R5] = 0b00000000000000000011;
+  rp2040->core0.registers[R0] = 0xff003302; // bottom byte: 02
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R5], 0b00000000000000001100);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000002);
+  EXPECT_EQ(rp2040->core0.C, false);
 }
 
 // should execute a `lsls r5, r5, #18` instruction with carry
 TEST(execute_lsls_instruction_with_carry, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = 0x04AD; // lsls r5, r5, #18
-  rp2040->registers[R5] = 0x00004001;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R5], 0x40000);
-  EXPECT_EQ(rp2040->C, true);
+  rp2040->core0.registers[R5] = 0x00004001;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R5], 0x40000);
+  EXPECT_EQ(rp2040->core0.C, true);
 }
 
 // should execute a `rev r3, r1` instruction
 TEST(execute_rev_instruction, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeREV(R2, R3);
-  rp2040->registers[R3] = 0x11223344;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R2], 0x44332211);
+  rp2040->core0.registers[R3] = 0x11223344;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R2], 0x44332211);
 }
 
 // should execute a `rsbs r0, r3` instruction
 TEST(execute_rsbs_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeRSBS(R0, R3);
-  rp2040->registers[R3] = 100;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R0] | 0, -100);
-  EXPECT_EQ(rp2040->N, true);
-  EXPECT_EQ(rp2040->Z, false);
-  EXPECT_EQ(rp2040->C, false);
-  EXPECT_EQ(rp2040->V, false);
+  rp2040->core0.registers[R3] = 100;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R0] | 0, -100);
+  EXPECT_EQ(rp2040->core0.N, true);
+  EXPECT_EQ(rp2040->core0.Z, false);
+  EXPECT_EQ(rp2040->core0.C, false);
+  EXPECT_EQ(rp2040->core0.V, false);
 }
 
 // should execute a `rsbs r0, r3` instruction
 TEST(execute_rsbs_instruction_2, executeInstruction) {
   // This instruction is also called `negs`
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeRSBS(R0, R3);
-  rp2040->registers[R3] = 0;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R0] | 0, 0);
-  EXPECT_EQ(rp2040->N, false);
-  EXPECT_EQ(rp2040->Z, true);
-  EXPECT_EQ(rp2040->C, true);
-  EXPECT_EQ(rp2040->V, false);
+  rp2040->core0.registers[R3] = 0;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R0] | 0, 0);
+  EXPECT_EQ(rp2040->core0.N, false);
+  EXPECT_EQ(rp2040->core0.Z, true);
+  EXPECT_EQ(rp2040->core0.C, true);
+  EXPECT_EQ(rp2040->core0.V, false);
 }
 
 // should execute a `sbcs r0, r3` instruction
 TEST(execute_sbcs_instruction, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeSBCS(R0, R3);
-  rp2040->registers[R0] = 100;
-  rp2040->registers[R3] = 55;
-  rp2040->C = false;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R0], 44);
-  EXPECT_EQ(rp2040->N, false);
-  EXPECT_EQ(rp2040->Z, false);
-  EXPECT_EQ(rp2040->C, true);
-  EXPECT_EQ(rp2040->V, false);
+  rp2040->core0.registers[R0] = 100;
+  rp2040->core0.registers[R3] = 55;
+  rp2040->core0.C = false;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R0], 44);
+  EXPECT_EQ(rp2040->core0.N, false);
+  EXPECT_EQ(rp2040->core0.Z, false);
+  EXPECT_EQ(rp2040->core0.C, true);
+  EXPECT_EQ(rp2040->core0.V, false);
 }
 
 // should execute a `sdmia r0!, {r1, r2}` instruction
 TEST(execute_sdmia_instruction, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeSTMIA(R0, (1 << R1) | (1 << R2));
-  rp2040->registers[R0] = 0x20000000;
-  rp2040->registers[R1] = 0xf00df00d;
-  rp2040->registers[R2] = 0x4242;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->getPC(), 0x10000002);
-  EXPECT_EQ(rp2040->registers[R0], 0x20000008);
+  rp2040->core0.registers[R0] = 0x20000000;
+  rp2040->core0.registers[R1] = 0xf00df00d;
+  rp2040->core0.registers[R2] = 0x4242;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000002);
+  EXPECT_EQ(rp2040->core0.registers[R0], 0x20000008);
   uint32_t *sram32 = (uint32_t *)rp2040->sram;
   EXPECT_EQ(sram32[0], 0xf00df00d);
   EXPECT_EQ(sram32[1], 0x4242);
@@ -552,40 +1359,40 @@ TEST(execute_sdmia_instruction, executeInstruction) {
 // should execute a `str r6, [r4, #20]` instruction
 TEST(execute_str_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeSTR(R6, R4, 20);
-  rp2040->registers[R4] = RAM_START_ADDRESS + 0x20;
-  rp2040->registers[R6] = 0xF00D;
-  rp2040->executeInstruction();
+  rp2040->core0.registers[R4] = RAM_START_ADDRESS + 0x20;
+  rp2040->core0.registers[R6] = 0xF00D;
+  rp2040->core0.executeInstruction();
   uint32_t value;
   memcpy(&value, &(rp2040->sram[0x20 + 20]), sizeof(uint32_t));
   EXPECT_EQ(value, 0xF00D);
-  EXPECT_EQ(rp2040->getPC(), 0x10000002);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000002);
 }
 
 // should execute a `str r6, [r4, r5]` instruction
 TEST(execute_str_instruction_2, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeSTRreg(R6, R4, R5);
-  rp2040->registers[R4] = RAM_START_ADDRESS + 0x20;
-  rp2040->registers[R5] = 20;
-  rp2040->registers[R6] = 0xF00D;
-  rp2040->executeInstruction();
+  rp2040->core0.registers[R4] = RAM_START_ADDRESS + 0x20;
+  rp2040->core0.registers[R5] = 20;
+  rp2040->core0.registers[R6] = 0xF00D;
+  rp2040->core0.executeInstruction();
   uint32_t value;
   memcpy(&value, &(rp2040->sram[0x20 + 20]), sizeof(uint32_t));
   EXPECT_EQ(value, 0xF00D);
-  EXPECT_EQ(rp2040->getPC(), 0x10000002);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000002);
 }
 
 // should execute an `str r3, [sp, #12]` instruction
 TEST(execute_str_instruction_3, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
-  rp2040->setSP(0x20000000);
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core0.setSP(0x20000000);
   rp2040->flash16[0] = opcodeSTRsp(R3, 12);
-  rp2040->registers[R3] = 0xaa55;
-  rp2040->executeInstruction();
+  rp2040->core0.registers[R3] = 0xaa55;
+  rp2040->core0.executeInstruction();
   EXPECT_EQ(rp2040->sram[12], 0x55);
   EXPECT_EQ(rp2040->sram[13], 0xaa);
 }
@@ -593,619 +1400,619 @@ TEST(execute_str_instruction_3, executeInstruction) {
 // should execute `bl 0x34` instruction
 TEST(execute_bl_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   uint32_t *flash32 = (uint32_t *)rp2040->flash;
   flash32[0] = opcodeBL(0x34);
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->getPC(), 0x10000038);
-  EXPECT_EQ(rp2040->getLR(), 0x10000005);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000038);
+  EXPECT_EQ(rp2040->core0.getLR(), 0x10000005);
 }
 
 // should execute `bl -0x10` instruction
 TEST(execute_bl_instruction_2, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   uint32_t *flash32 = (uint32_t *)rp2040->flash;
   flash32[0] = opcodeBL(-0x10);
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->getPC(), 0x10000004 - 0x10);
-  EXPECT_EQ(rp2040->getLR(), 0x10000005);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000004 - 0x10);
+  EXPECT_EQ(rp2040->core0.getLR(), 0x10000005);
 }
 
 // should execute `bl -3242` instruction
 TEST(execute_bl_instruction_3, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   uint32_t *flash32 = (uint32_t *)rp2040->flash;
   flash32[0] = opcodeBL(-3242);
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->getPC(), 0x10000004 - 3242);
-  EXPECT_EQ(rp2040->getLR(), 0x10000005);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000004 - 3242);
+  EXPECT_EQ(rp2040->core0.getLR(), 0x10000005);
 }
 
 // should execute `blx r3` instruction
 TEST(execute_blx_instruction, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
-  rp2040->registers[R3] = 0x10000201;
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core0.registers[R3] = 0x10000201;
   uint32_t *flash32 = (uint32_t *)rp2040->flash;
   flash32[0] = opcodeBLX(R3);
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->getPC(), 0x10000200);
-  EXPECT_EQ(rp2040->getLR(), 0x10000003);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000200);
+  EXPECT_EQ(rp2040->core0.getLR(), 0x10000003);
 }
 
 // should execute a `b.n .-20` instruction
 TEST(execute_bn_instruction, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000 + 0x9 * 0x2);
+  rp2040->core0.setPC(0x10000000 + 0x9 * 0x2);
   rp2040->flash16[9] = 0xe7f6; // b.n .-20
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->getPC(), 0x10000002);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000002);
 }
 
 // should execute a `bne.n .-6` instruction
 TEST(execute_bnen_instruction, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000 + 0x9 * 0x2);
-  rp2040->Z = false;
+  rp2040->core0.setPC(0x10000000 + 0x9 * 0x2);
+  rp2040->core0.Z = false;
   rp2040->flash16[9] = 0xD1FC; // bne.n .-6
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->getPC(), 0x1000000E);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.getPC(), 0x1000000E);
 }
 
 // should execute `bx lr` instruction
 TEST(execute_bx_instruction, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
-  rp2040->setLR(0x10000200);
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core0.setLR(0x10000200);
   uint32_t *flash32 = (uint32_t *)rp2040->flash;
   flash32[0] = opcodeBX(LR);
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->getPC(), 0x10000200);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000200);
 }
 
 // should execute an `cmp r5, #66` instruction
 TEST(execute_cmp_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = 0x2D42; // cmp r5, #66
-  rp2040->registers[R5] = 60;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->N, true);
-  EXPECT_EQ(rp2040->Z, false);
-  EXPECT_EQ(rp2040->C, false);
-  EXPECT_EQ(rp2040->V, false);
+  rp2040->core0.registers[R5] = 60;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.N, true);
+  EXPECT_EQ(rp2040->core0.Z, false);
+  EXPECT_EQ(rp2040->core0.C, false);
+  EXPECT_EQ(rp2040->core0.V, false);
 }
 
 // should execute an `cmp r5, r0` instruction
 TEST(execute_cmp_instruction_2, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = 0x4285; // cmp r5, r0
-  rp2040->registers[R5] = 60;
-  rp2040->registers[R0] = 56;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->N, false);
-  EXPECT_EQ(rp2040->Z, false);
-  EXPECT_EQ(rp2040->C, true);
-  EXPECT_EQ(rp2040->V, false);
+  rp2040->core0.registers[R5] = 60;
+  rp2040->core0.registers[R0] = 56;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.N, false);
+  EXPECT_EQ(rp2040->core0.Z, false);
+  EXPECT_EQ(rp2040->core0.C, true);
+  EXPECT_EQ(rp2040->core0.V, false);
 }
 
 // should execute an `cmp ip, r6` instruction
 TEST(execute_cmp_instruction_3, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = 0x45b4; // cmp ip (r12), r6
-  rp2040->registers[IP] = 60;
-  rp2040->registers[R6] = 56;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->N, false);
-  EXPECT_EQ(rp2040->Z, false);
-  EXPECT_EQ(rp2040->C, true);
-  EXPECT_EQ(rp2040->V, false);
+  rp2040->core0.registers[IP] = 60;
+  rp2040->core0.registers[R6] = 56;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.N, false);
+  EXPECT_EQ(rp2040->core0.Z, false);
+  EXPECT_EQ(rp2040->core0.C, true);
+  EXPECT_EQ(rp2040->core0.V, false);
 }
 
 // should execute a `subs r5, #10` instruction
 TEST(execute_subs_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeSUBS2(R5, 10);
-  rp2040->registers[R5] = 100;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R5], 90);
-  EXPECT_EQ(rp2040->N, false);
-  EXPECT_EQ(rp2040->Z, false);
-  EXPECT_EQ(rp2040->C, true);
-  EXPECT_EQ(rp2040->V, false);
+  rp2040->core0.registers[R5] = 100;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R5], 90);
+  EXPECT_EQ(rp2040->core0.N, false);
+  EXPECT_EQ(rp2040->core0.Z, false);
+  EXPECT_EQ(rp2040->core0.C, true);
+  EXPECT_EQ(rp2040->core0.V, false);
 }
 
 // should execute a `subs r1, #1` instruction with overflow
 TEST(execute_subs_instruction_2, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeSUBS2(R1, 1);
-  rp2040->registers[R1] = -0x80000000;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R1], 0x7fffffff);
-  EXPECT_EQ(rp2040->N, false);
-  EXPECT_EQ(rp2040->Z, false);
-  EXPECT_EQ(rp2040->C, true);
-  EXPECT_EQ(rp2040->V, true);
+  rp2040->core0.registers[R1] = -0x80000000;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R1], 0x7fffffff);
+  EXPECT_EQ(rp2040->core0.N, false);
+  EXPECT_EQ(rp2040->core0.Z, false);
+  EXPECT_EQ(rp2040->core0.C, true);
+  EXPECT_EQ(rp2040->core0.V, true);
 }
 
 // should execute a `strb r6, [r4, #20]` instruction
 TEST(execute_strb_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->sram[0x20] = 0xF2;
   rp2040->sram[0x21] = 0xF3;
   rp2040->sram[0x22] = 0xF4;
   rp2040->sram[0x23] = 0xF5;
   rp2040->flash16[0] = opcodeSTRB(R6, R4, 0x1);
-  rp2040->registers[R4] = RAM_START_ADDRESS + 0x20;
-  rp2040->registers[R6] = 0xf055;
-  rp2040->executeInstruction();
+  rp2040->core0.registers[R4] = RAM_START_ADDRESS + 0x20;
+  rp2040->core0.registers[R6] = 0xf055;
+  rp2040->core0.executeInstruction();
   // assert that the 2nd byte (at 0x21) changed to 0x55
   EXPECT_EQ(rp2040->sram[0x20], 0xF2);
   EXPECT_EQ(rp2040->sram[0x21], 0x55);
   EXPECT_EQ(rp2040->sram[0x22], 0xF4);
   EXPECT_EQ(rp2040->sram[0x23], 0xF5);
-  EXPECT_EQ(rp2040->getPC(), 0x10000002);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000002);
 }
 
 // should execute a `strb r6, [r4, r5]` instruction
 TEST(execute_strb_instruction_2, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->sram[0x20] = 0xF2;
   rp2040->sram[0x21] = 0xF3;
   rp2040->sram[0x22] = 0xF4;
   rp2040->sram[0x23] = 0xF5;
   rp2040->flash16[0] = opcodeSTRBreg(R6, R4, R5);
-  rp2040->registers[R4] = RAM_START_ADDRESS + 0x20;
-  rp2040->registers[R5] = 0x1;
-  rp2040->registers[R6] = 0xf055;
-  rp2040->executeInstruction();
+  rp2040->core0.registers[R4] = RAM_START_ADDRESS + 0x20;
+  rp2040->core0.registers[R5] = 0x1;
+  rp2040->core0.registers[R6] = 0xf055;
+  rp2040->core0.executeInstruction();
   // assert that the 2nd byte (at 0x21) changed to 0x55
   EXPECT_EQ(rp2040->sram[0x20], 0xF2);
   EXPECT_EQ(rp2040->sram[0x21], 0x55);
   EXPECT_EQ(rp2040->sram[0x22], 0xF4);
   EXPECT_EQ(rp2040->sram[0x23], 0xF5);
-  EXPECT_EQ(rp2040->getPC(), 0x10000002);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000002);
 }
 
 // should execute a `strh r6, [r4, #20]` instruction
 TEST(execute_strh_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->sram[0x20] = 0xF2;
   rp2040->sram[0x21] = 0xF3;
   rp2040->sram[0x22] = 0xF4;
   rp2040->sram[0x23] = 0xF5;
   rp2040->flash16[0] = opcodeSTRH(R6, R4, 0x2);
-  rp2040->registers[R4] = RAM_START_ADDRESS + 0x20;
-  rp2040->registers[R6] = 0x6655;
-  rp2040->executeInstruction();
+  rp2040->core0.registers[R4] = RAM_START_ADDRESS + 0x20;
+  rp2040->core0.registers[R6] = 0x6655;
+  rp2040->core0.executeInstruction();
   // assert that the 3rd/4th byte (at 0x22) changed to 0x6655
   EXPECT_EQ(rp2040->sram[0x20], 0xF2);
   EXPECT_EQ(rp2040->sram[0x21], 0xF3);
   EXPECT_EQ(rp2040->sram[0x22], 0x55);
   EXPECT_EQ(rp2040->sram[0x23], 0x66);
-  EXPECT_EQ(rp2040->getPC(), 0x10000002);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000002);
 }
 
 // should execute a `strh r6, [r4, r1]` instruction
 TEST(execute_strh_instruction_2, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->sram[0x20] = 0xF2;
   rp2040->sram[0x21] = 0xF3;
   rp2040->sram[0x22] = 0xF4;
   rp2040->sram[0x23] = 0xF5;
   rp2040->flash16[0] = opcodeSTRHreg(R6, R4, R1);
-  rp2040->registers[R4] = RAM_START_ADDRESS + 0x20;
-  rp2040->registers[R1] = 0x2;
-  rp2040->registers[R6] = 0x6655;
-  rp2040->executeInstruction();
+  rp2040->core0.registers[R4] = RAM_START_ADDRESS + 0x20;
+  rp2040->core0.registers[R1] = 0x2;
+  rp2040->core0.registers[R6] = 0x6655;
+  rp2040->core0.executeInstruction();
   // assert that the 3rd/4th byte (at 0x22) changed to 0x6655
   EXPECT_EQ(rp2040->sram[0x20], 0xF2);
   EXPECT_EQ(rp2040->sram[0x21], 0xF3);
   EXPECT_EQ(rp2040->sram[0x22], 0x55);
   EXPECT_EQ(rp2040->sram[0x23], 0x66);
-  EXPECT_EQ(rp2040->getPC(), 0x10000002);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000002);
 }
 
 // should execute a `sub sp, 0x10` instruction
 TEST(execute_subs_instruction_3, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
-  rp2040->setSP(0x10000040);
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core0.setSP(0x10000040);
   rp2040->flash16[0] = opcodeSUBsp(0x10);
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->getSP(), 0x10000030);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.getSP(), 0x10000030);
 }
 
 // should execute a `subs r5, r3, 5` instruction
 TEST(execute_subs_instruction_4, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeSUBS1(R5, R3, 5);
-  rp2040->registers[R3] = 0;
-  rp2040->executeInstruction();
-  EXPECT_EQ((int)rp2040->registers[R5] | 0, -5);
-  EXPECT_EQ(rp2040->N, true);
-  EXPECT_EQ(rp2040->Z, false);
-  EXPECT_EQ(rp2040->C, false);
-  EXPECT_EQ(rp2040->V, false);
+  rp2040->core0.registers[R3] = 0;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ((int)rp2040->core0.registers[R5] | 0, -5);
+  EXPECT_EQ(rp2040->core0.N, true);
+  EXPECT_EQ(rp2040->core0.Z, false);
+  EXPECT_EQ(rp2040->core0.C, false);
+  EXPECT_EQ(rp2040->core0.V, false);
 }
 
 // should execute a `subs r5, r3, r2` instruction
 TEST(execute_subs_instruction_5, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeSUBSreg(R5, R3, R2);
-  rp2040->registers[R3] = 6;
-  rp2040->registers[R2] = 5;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R5], 1);
-  EXPECT_EQ(rp2040->N, false);
-  EXPECT_EQ(rp2040->Z, false);
-  EXPECT_EQ(rp2040->C, true);
-  EXPECT_EQ(rp2040->V, false);
+  rp2040->core0.registers[R3] = 6;
+  rp2040->core0.registers[R2] = 5;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R5], 1);
+  EXPECT_EQ(rp2040->core0.N, false);
+  EXPECT_EQ(rp2040->core0.Z, false);
+  EXPECT_EQ(rp2040->core0.C, true);
+  EXPECT_EQ(rp2040->core0.V, false);
 }
 
 // should raise an SVCALL exception when `svc` instruction runs
 TEST(execute_svc_instruction, executeInstruction) {
   const number SVCALL_HANDLER = 0x10002000;
   RP2040 *rp2040 = new RP2040();
-  rp2040->setSP(0x20004000);
-  rp2040->setPC(0x10004000);
+  rp2040->core0.setSP(0x20004000);
+  rp2040->core0.setPC(0x10004000);
   rp2040->writeUint16(0x10004000, opcodeSVC(10));
-  rp2040->registers[R0] = 0x44;
+  rp2040->core0.registers[R0] = 0x44;
   rp2040->writeUint32(VTOR, 0x10040000);
   rp2040->writeUint32(0x10040000 + EXC_SVCALL * 4, SVCALL_HANDLER);
   rp2040->writeUint16(SVCALL_HANDLER, opcodeMOVS(R0, 0x55));
 
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->pendingSVCall, true);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.nvic.pendingSVCall, true);
 
-  rp2040->executeInstruction(); // SVCall handler should run here
-  EXPECT_EQ(rp2040->pendingSVCall, false);
-  EXPECT_EQ(rp2040->getPC(), SVCALL_HANDLER + 2);
-  EXPECT_EQ(rp2040->registers[R0], 0x55);
+  rp2040->core0.executeInstruction(); // SVCall handler should run here
+  EXPECT_EQ(rp2040->core0.nvic.pendingSVCall, false);
+  EXPECT_EQ(rp2040->core0.getPC(), SVCALL_HANDLER + 2);
+  EXPECT_EQ(rp2040->core0.registers[R0], 0x55);
 }
 
 // should execute a `sxtb r2, r2` instruction with sign bit 1
 TEST(execute_sxtb_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeSXTB(R2, R2);
-  rp2040->registers[R2] = 0x22446688;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R2], 0xffffff88);
+  rp2040->core0.registers[R2] = 0x22446688;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R2], 0xffffff88);
 }
 
 // should execute a `sxtb r2, r2` instruction with sign bit 0
 TEST(execute_sxtb_instruction_2, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeSXTB(R2, R2);
-  rp2040->registers[R2] = 0x12345678;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R2], 0x78);
+  rp2040->core0.registers[R2] = 0x12345678;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R2], 0x78);
 }
 
 // should execute an `tst r1, r3` instruction when the result is negative
 TEST(execute_tst_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = 0x4219; // tst r1, r3
-  rp2040->registers[R1] = 0xF0000000;
-  rp2040->registers[R3] = 0xF0004000;
+  rp2040->core0.registers[R1] = 0xF0000000;
+  rp2040->core0.registers[R3] = 0xF0004000;
   rp2040->sram[24] = 0x55;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->N, true);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.N, true);
 }
 
 // should execute an `tst r1, r3` instruction when the registers are equal
 TEST(execute_tst_instruction_2, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = 0x4219; // tst r1, r3
-  rp2040->registers[R1] = 0x00;
-  rp2040->registers[R3] = 0x37;
+  rp2040->core0.registers[R1] = 0x00;
+  rp2040->core0.registers[R3] = 0x37;
   rp2040->sram[24] = 0x55;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->Z, true);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.Z, true);
 }
 
 // should execute `adcs r5, r4` instruction
 TEST(execute_adcs_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeADCS(R5, R4);
-  rp2040->registers[R4] = 55;
-  rp2040->registers[R5] = 66;
-  rp2040->C = true;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R5], 122);
-  EXPECT_EQ(rp2040->N, false);
-  EXPECT_EQ(rp2040->Z, false);
-  EXPECT_EQ(rp2040->C, false);
-  EXPECT_EQ(rp2040->V, false);
+  rp2040->core0.registers[R4] = 55;
+  rp2040->core0.registers[R5] = 66;
+  rp2040->core0.C = true;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R5], 122);
+  EXPECT_EQ(rp2040->core0.N, false);
+  EXPECT_EQ(rp2040->core0.Z, false);
+  EXPECT_EQ(rp2040->core0.C, false);
+  EXPECT_EQ(rp2040->core0.V, false);
 }
 
 // should execute `adcs r5, r4` instruction
 TEST(execute_adcs_instruction_2, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeADCS(R5, R4);
-  rp2040->registers[R4] = 0x7FFFFFFF; // Max signed INT32
-  rp2040->registers[R5] = 0;
-  rp2040->C = true;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R5], 0x80000000);
-  EXPECT_EQ(rp2040->N, true);
-  EXPECT_EQ(rp2040->Z, false);
-  EXPECT_EQ(rp2040->C, false);
-  EXPECT_EQ(rp2040->V, true);
+  rp2040->core0.registers[R4] = 0x7FFFFFFF; // Max signed INT32
+  rp2040->core0.registers[R5] = 0;
+  rp2040->core0.C = true;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R5], 0x80000000);
+  EXPECT_EQ(rp2040->core0.N, true);
+  EXPECT_EQ(rp2040->core0.Z, false);
+  EXPECT_EQ(rp2040->core0.C, false);
+  EXPECT_EQ(rp2040->core0.V, true);
 }
 
 // should execute a `add sp, 0x10` instruction
 TEST(execute_add_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
-  rp2040->setSP(0x10000040);
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core0.setSP(0x10000040);
   rp2040->flash16[0] = opcodeADDsp2(0x10);
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->getSP(), 0x10000050);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.getSP(), 0x10000050);
 }
 
 // should execute `add r1, ip` instruction
 TEST(execute_add_instruction_2, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeADDreg(R1, IP);
-  rp2040->registers[R1] = 66;
-  rp2040->registers[IP] = 44;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R1], 110);
-  EXPECT_EQ(rp2040->N, false);
-  EXPECT_EQ(rp2040->Z, false);
-  EXPECT_EQ(rp2040->C, false);
-  EXPECT_EQ(rp2040->V, false);
+  rp2040->core0.registers[R1] = 66;
+  rp2040->core0.registers[IP] = 44;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R1], 110);
+  EXPECT_EQ(rp2040->core0.N, false);
+  EXPECT_EQ(rp2040->core0.Z, false);
+  EXPECT_EQ(rp2040->core0.C, false);
+  EXPECT_EQ(rp2040->core0.V, false);
 }
 
 // should execute `add sp, r8` instruction and not update the flags
 TEST(execute_add_instruction_3, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
-  rp2040->setSP(0x20030000);
-  rp2040->Z = true;
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core0.setSP(0x20030000);
+  rp2040->core0.Z = true;
   rp2040->flash16[0] = opcodeADDreg(SP, R8);
-  rp2040->registers[R8] = 0x11;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->getSP(), 0x20030011);
-  EXPECT_EQ(rp2040->Z, true); // assert it didn't update the flags
+  rp2040->core0.registers[R8] = 0x11;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.getSP(), 0x20030011);
+  EXPECT_EQ(rp2040->core0.Z, true); // assert it didn't update the flags
 }
 
 // should execute `add pc, r8` instruction
 TEST(execute_add_instruction_4, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeADDreg(PC, R8);
-  rp2040->registers[R8] = 0x11;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->getPC(), 0x10000014);
+  rp2040->core0.registers[R8] = 0x11;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000014);
 }
 
 // should execute a `add r1, sp, #4` instruction
 TEST(execute_add_instruction_5, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
-  rp2040->setSP(0x55);
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core0.setSP(0x55);
   rp2040->flash16[0] = opcodeADDspPlusImm(R1, 0x10);
-  rp2040->registers[R1] = 0;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->getSP(), 0x55);
-  EXPECT_EQ(rp2040->registers[R1], 0x65);
+  rp2040->core0.registers[R1] = 0;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.getSP(), 0x55);
+  EXPECT_EQ(rp2040->core0.registers[R1], 0x65);
 }
 
 // should execute `adds r1, #1` instruction
 TEST(execute_adds_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeADDS2(R1, 1);
-  rp2040->registers[R1] = 0xFFFFFFFF;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R1], 0);
-  EXPECT_EQ(rp2040->N, false);
-  EXPECT_EQ(rp2040->Z, true);
-  EXPECT_EQ(rp2040->C, true);
-  EXPECT_EQ(rp2040->V, false);
+  rp2040->core0.registers[R1] = 0xFFFFFFFF;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R1], 0);
+  EXPECT_EQ(rp2040->core0.N, false);
+  EXPECT_EQ(rp2040->core0.Z, true);
+  EXPECT_EQ(rp2040->core0.C, true);
+  EXPECT_EQ(rp2040->core0.V, false);
 }
 
 // should execute `adds r1, #1` instruction and
 // set the overflow flag correctly
 TEST(execute_adds_instruction_2, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeADDS2(R1, 1);
-  rp2040->registers[R1] = 0x7FFFFFFF;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R1], 0x80000000);
-  EXPECT_EQ(rp2040->N, true);
-  EXPECT_EQ(rp2040->Z, false);
-  EXPECT_EQ(rp2040->C, false);
-  EXPECT_EQ(rp2040->V, true);
+  rp2040->core0.registers[R1] = 0x7FFFFFFF;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R1], 0x80000000);
+  EXPECT_EQ(rp2040->core0.N, true);
+  EXPECT_EQ(rp2040->core0.Z, false);
+  EXPECT_EQ(rp2040->core0.C, false);
+  EXPECT_EQ(rp2040->core0.V, true);
 }
 
 // should execute `adds r1, r2, #3` instruction
 TEST(execute_adds_instruction_3, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeADDS1(R1, R2, 3);
-  rp2040->registers[R2] = 2;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R1], 5);
-  EXPECT_EQ(rp2040->N, false);
-  EXPECT_EQ(rp2040->Z, false);
-  EXPECT_EQ(rp2040->C, false);
-  EXPECT_EQ(rp2040->V, false);
+  rp2040->core0.registers[R2] = 2;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R1], 5);
+  EXPECT_EQ(rp2040->core0.N, false);
+  EXPECT_EQ(rp2040->core0.Z, false);
+  EXPECT_EQ(rp2040->core0.C, false);
+  EXPECT_EQ(rp2040->core0.V, false);
 }
 
 // should execute `adds r1, r2, r7` instruction
 TEST(execute_adds_instruction_4, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeADDSreg(R1, R2, R7);
-  rp2040->registers[R2] = 2;
-  rp2040->registers[R7] = 27;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R1], 29);
-  EXPECT_EQ(rp2040->N, false);
-  EXPECT_EQ(rp2040->Z, false);
-  EXPECT_EQ(rp2040->C, false);
-  EXPECT_EQ(rp2040->V, false);
+  rp2040->core0.registers[R2] = 2;
+  rp2040->core0.registers[R7] = 27;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R1], 29);
+  EXPECT_EQ(rp2040->core0.N, false);
+  EXPECT_EQ(rp2040->core0.Z, false);
+  EXPECT_EQ(rp2040->core0.C, false);
+  EXPECT_EQ(rp2040->core0.V, false);
 }
 
 // should execute `adr r4, #0x50` instruction and
 // set the overflow flag correctly
 TEST(execute_adr_instruction, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeADR(R4, 0x50);
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R4], 0x10000054);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R4], 0x10000054);
 }
 
 // should execute `ands r5, r0` instruction
 TEST(execute_ands_instruction, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeANDS(R5, R0);
-  rp2040->registers[R5] = 0xffff0000;
-  rp2040->registers[R0] = 0xf00fffff;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R5], 0xf00f0000);
-  EXPECT_EQ(rp2040->N, true);
-  EXPECT_EQ(rp2040->Z, false);
+  rp2040->core0.registers[R5] = 0xffff0000;
+  rp2040->core0.registers[R0] = 0xf00fffff;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R5], 0xf00f0000);
+  EXPECT_EQ(rp2040->core0.N, true);
+  EXPECT_EQ(rp2040->core0.Z, false);
 }
 
 // should execute an `asrs r3, r2, #31` instruction
 TEST(execute_asrs_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeASRS(R3, R2, 31);
-  rp2040->registers[R2] = 0x80000000;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R3], 0xffffffff);
-  EXPECT_EQ(rp2040->getPC(), 0x10000002);
-  EXPECT_EQ(rp2040->N, true);
-  EXPECT_EQ(rp2040->Z, false);
-  EXPECT_EQ(rp2040->C, false);
+  rp2040->core0.registers[R2] = 0x80000000;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R3], 0xffffffff);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000002);
+  EXPECT_EQ(rp2040->core0.N, true);
+  EXPECT_EQ(rp2040->core0.Z, false);
+  EXPECT_EQ(rp2040->core0.C, false);
 }
 
 // should execute an `asrs r3, r4` instruction
 TEST(execute_asrs_instruction_2, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeASRSreg(R3, R4);
-  rp2040->registers[R3] = 0x80000040;
-  rp2040->registers[R4] = 0xff500007;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R3], 0xff000000);
-  EXPECT_EQ(rp2040->getPC(), 0x10000002);
-  EXPECT_EQ(rp2040->N, true);
-  EXPECT_EQ(rp2040->Z, false);
-  EXPECT_EQ(rp2040->C, true);
+  rp2040->core0.registers[R3] = 0x80000040;
+  rp2040->core0.registers[R4] = 0xff500007;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R3], 0xff000000);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10000002);
+  EXPECT_EQ(rp2040->core0.N, true);
+  EXPECT_EQ(rp2040->core0.Z, false);
+  EXPECT_EQ(rp2040->core0.C, true);
 }
 
 // should execute `bics r0, r3` correctly
 TEST(execute_bics_instruction_1, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
-  rp2040->registers[R0] = 0xff;
-  rp2040->registers[R3] = 0x0f;
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core0.registers[R0] = 0xff;
+  rp2040->core0.registers[R3] = 0x0f;
   rp2040->flash16[0] = opcodeBICS(R0, R3);
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R0], 0xF0);
-  EXPECT_EQ(rp2040->N, false);
-  EXPECT_EQ(rp2040->Z, false);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R0], 0xF0);
+  EXPECT_EQ(rp2040->core0.N, false);
+  EXPECT_EQ(rp2040->core0.Z, false);
 }
 
 // should execute `bics r0, r3` instruction
 // and set the negative flag correctly
 TEST(execute_bics_instruction_2, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
-  rp2040->registers[R0] = 0xffffffff;
-  rp2040->registers[R3] = 0x0000ffff;
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core0.registers[R0] = 0xffffffff;
+  rp2040->core0.registers[R3] = 0x0000ffff;
   rp2040->flash16[0] = opcodeBICS(R0, R3);
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R0], 0xffff0000);
-  EXPECT_EQ(rp2040->N, true);
-  EXPECT_EQ(rp2040->Z, false);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R0], 0xffff0000);
+  EXPECT_EQ(rp2040->core0.N, true);
+  EXPECT_EQ(rp2040->core0.Z, false);
 }
 
 // should execute an `uxtb r5, r3` instruction
 TEST(execute_uxtb_instruction, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeUXTB(R5, R3);
-  rp2040->registers[R3] = 0x12345678;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R5], 0x78);
+  rp2040->core0.registers[R3] = 0x12345678;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R5], 0x78);
 }
 
 // should execute an `uxth r3, r1` instruction
 TEST(execute_uxth_instruction, executeInstruction) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->setPC(0x10000000);
+  rp2040->core0.setPC(0x10000000);
   rp2040->flash16[0] = opcodeUXTH(R3, R1);
-  rp2040->registers[R1] = 0x12345678;
-  rp2040->executeInstruction();
-  EXPECT_EQ(rp2040->registers[R3], 0x5678);
+  rp2040->core0.registers[R1] = 0x12345678;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R3], 0x5678);
 }
 
 // writing to NVIC_ISPR should set the corresponding pending interrupt bits
 TEST(nvic_ispr, nvicRegisters) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->pendingInterrupts = 0x1;
+  rp2040->core0.nvic.pendingInterrupts = 0x1;
   rp2040->writeUint32(0xe000e200, 0x10);
-  EXPECT_EQ(rp2040->pendingInterrupts, 0x11);
+  EXPECT_EQ(rp2040->core0.nvic.pendingInterrupts, 0x11);
 }
 
 // writing to NVIC_ICPR should clear corresponding pending interrupt bits
 TEST(nvic_icpr, nvicRegisters) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->pendingInterrupts = 0xff;
+  rp2040->core0.nvic.pendingInterrupts = 0xff;
   rp2040->writeUint32(0xe000e280, 0x10);
-  EXPECT_EQ(rp2040->pendingInterrupts, 0xef);
+  EXPECT_EQ(rp2040->core0.nvic.pendingInterrupts, 0xef);
 }
 
 // writing to NVIC_ISER should set the corresponding enabled interrupt bits
 TEST(nvic_iser, nvicRegisters) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->pendingInterrupts = 0x1;
+  rp2040->core0.nvic.enabledInterrupts = 0x1;
   rp2040->writeUint32(0xe000e100, 0x10);
-  EXPECT_EQ(rp2040->pendingInterrupts, 0x11);
+  EXPECT_EQ(rp2040->core0.nvic.enabledInterrupts, 0x11);
 }
 
 // writing to NVIC_ICER should clear corresponding enabled interrupt bits
 TEST(nvic_icer, nvicRegisters) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->pendingInterrupts = 0x1;
+  rp2040->core0.nvic.enabledInterrupts = 0xff;
   rp2040->writeUint32(0xe000e180, 0x10);
-  EXPECT_EQ(rp2040->pendingInterrupts, 0xef);
+  EXPECT_EQ(rp2040->core0.nvic.enabledInterrupts, 0xef);
 }
 
 // reading from NVIC_ISER/NVIC_ICER should return
 // the current enabled interrupt bits
 TEST(nvic_iser_icer, nvicRegisters) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->pendingInterrupts = 0x1;
+  rp2040->core0.nvic.enabledInterrupts = 0x1;
   EXPECT_EQ(rp2040->readUint32(0xe000e100), 0x1);
   EXPECT_EQ(rp2040->readUint32(0xe000e180), 0x1);
 }
@@ -1214,7 +2021,7 @@ TEST(nvic_iser_icer, nvicRegisters) {
 // the current enabled interrupt bits
 TEST(nvic_iser_icpr, nvicRegisters) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->pendingInterrupts = 0x2;
+  rp2040->core0.nvic.pendingInterrupts = 0x2;
   EXPECT_EQ(rp2040->readUint32(0xe000e200), 0x2);
   EXPECT_EQ(rp2040->readUint32(0xe000e280), 0x2);
 }
@@ -1224,22 +2031,75 @@ TEST(nvic_ipr3, nvicRegisters) {
   RP2040 *rp2040 = new RP2040();
   // Set the priority of interrupt number 14 to 2
   rp2040->writeUint32(0xe000e40c, 0x00800000);
-  EXPECT_EQ((int)rp2040->interruptPriorities[0], ~(1 << 14));
-  EXPECT_EQ(rp2040->interruptPriorities[1], 0);
-  EXPECT_EQ(rp2040->interruptPriorities[2], 1 << 14);
-  EXPECT_EQ(rp2040->interruptPriorities[3], 0);
+  EXPECT_EQ((int)rp2040->core0.nvic.interruptPriorities[0], ~(1 << 14));
+  EXPECT_EQ(rp2040->core0.nvic.interruptPriorities[1], 0);
+  EXPECT_EQ(rp2040->core0.nvic.interruptPriorities[2], 1 << 14);
+  EXPECT_EQ(rp2040->core0.nvic.interruptPriorities[3], 0);
   EXPECT_EQ(rp2040->readUint32(0xe000e40c), 0x00800000);
 }
 
 // should return the correct interrupt priorities when reading from NVIC_IPR5
 TEST(nvic_ipr5, nvicRegisters) {
   RP2040 *rp2040 = new RP2040();
-  rp2040->interruptPriorities[0] = 0;
-  rp2040->interruptPriorities[1] = 0x001fffff; // interrupts 0 ... 20
-  rp2040->interruptPriorities[2] = 0x00200000; // interrupt 21
-  rp2040->interruptPriorities[3] = 0xffc00000; // interrupt 22 ... 31
+  NVIC &nvic = rp2040->core0.nvic;
+  nvic.interruptPriorities[0] = 0;
+  nvic.interruptPriorities[1] = 0x001fffff; // interrupts 0 ... 20
+  nvic.interruptPriorities[2] = 0x00200000; // interrupt 21
+  nvic.interruptPriorities[3] = 0xffc00000; // interrupt 22 ... 31
   // Set the priority of interrupt number 14 to 2
-  EXPECT_EQ(rp2040->readUint32(0xe000e414), (int)0xc0c08040);
+  EXPECT_EQ(rp2040->readUint32(0xe000e414), 0xc0c08040);
+}
+
+// should set and clear the PendSV and SysTick pending bits through ICSR
+TEST(nvic_icsr, nvicRegisters) {
+  RP2040 *rp2040 = new RP2040();
+  rp2040->writeUint32(0xe000ed04, ICSR_PENDSVSET | ICSR_PENDSTSET);
+  EXPECT_TRUE(rp2040->core0.nvic.pendingPendSV);
+  EXPECT_TRUE(rp2040->core0.nvic.pendingSysTick);
+  rp2040->writeUint32(0xe000ed04, ICSR_PENDSVCLR);
+  EXPECT_EQ(rp2040->readUint32(0xe000ed04), ICSR_PENDSTSET);
+}
+
+// should stack the registers in SRAM and read the vector from the table
+// VTOR points to when the exception is taken
+TEST(exception_vtor, exceptionEntry_and_exceptionReturn) {
+  RP2040 *rp2040 = new RP2040();
+  rp2040->core0.setSP(0x20004000);
+  rp2040->core0.registers[R0] = 0x44;
+  rp2040->writeUint32(0x10000000 + EXC_SVCALL * 4, 0x10001000);
+  rp2040->writeUint32(0x20000000 + EXC_SVCALL * 4, 0x10002000);
+  rp2040->writeUint32(VTOR, 0x10000000);
+  rp2040->core0.exceptionEntry(EXC_SVCALL);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10001000);
+  EXPECT_EQ(rp2040->readUint32(0x20004000 - 0x20), 0x44);
+  rp2040->core0.registers[R0] = 0x55;
+  rp2040->core0.exceptionReturn(0xfffffff9);
+  EXPECT_EQ(rp2040->core0.registers[R0], 0x44);
+  EXPECT_EQ(rp2040->core0.getSP(), 0x20004000);
+  rp2040->writeUint32(VTOR, 0x20000000);
+  rp2040->core0.exceptionEntry(EXC_SVCALL);
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10002000);
+}
+
+// should take the pending exception of the highest priority first, and the
+// lowest exception number among those of the same priority
+TEST(exception_priority, exceptionEntry_and_exceptionReturn) {
+  RP2040 *rp2040 = new RP2040();
+  rp2040->core0.setSP(0x20004000);
+  rp2040->core0.setPC(0x10004000);
+  // PendSV at priority 3, SysTick and interrupt 1 at priority 1
+  rp2040->writeUint32(0xe000ed20, 0x40c00000);
+  rp2040->writeUint32(0xe000e400, 0x00004000);
+  rp2040->writeUint32(0xe000e100, 1 << 1);
+  rp2040->writeUint32(0xe000e200, 1 << 1);
+  rp2040->writeUint32(0xe000ed04, ICSR_PENDSVSET | ICSR_PENDSTSET);
+  rp2040->core0.checkForInterrupts();
+  EXPECT_EQ(rp2040->core0.IPSR, EXC_SYSTICK);
+  EXPECT_FALSE(rp2040->core0.nvic.pendingSysTick);
+  // Neither preempts SysTick
+  rp2040->core0.checkForInterrupts();
+  EXPECT_EQ(rp2040->core0.IPSR, EXC_SYSTICK);
+  EXPECT_TRUE(rp2040->core0.nvic.pendingPendSV);
 }
 
 // should return the correct interrupt priorities when reading from NVIC_IPR5
@@ -1248,23 +2108,154 @@ TEST(exception_handler, exceptionEntry_and_exceptionReturn) {
   const number INT1_HANDLER = 0x10000100;
   const number EXC_INT1 = 16 + 1;
   RP2040 *rp2040 = new RP2040();
-  rp2040->setSP(0x20004000);
-  rp2040->setPC(0x10004000);
-  rp2040->registers[R0] = 0x44;
-  rp2040->pendingInterrupts = INT1;
-  rp2040->enabledInterrupts = INT1;
-  rp2040->interruptsUpdated = true;
+  rp2040->core0.setSP(0x20004000);
+  rp2040->core0.setPC(0x10004000);
+  rp2040->core0.registers[R0] = 0x44;
+  rp2040->core0.nvic.pendingInterrupts = INT1;
+  rp2040->core0.nvic.enabledInterrupts = INT1;
+  rp2040->core0.interruptsUpdated = true;
   rp2040->writeUint32(VTOR, 0x10000000);
   rp2040->writeUint32(0x10000000 + EXC_INT1 * 4, INT1_HANDLER);
   rp2040->writeUint16(INT1_HANDLER, opcodeMOVS(R0, 0x55));
   rp2040->writeUint16(INT1_HANDLER + 2, opcodeBX(LR));
   // Exception handler should start at this point.
-  rp2040->executeInstruction(); // MOVS r0, 0x55
-  EXPECT_EQ(rp2040->IPSR, EXC_INT1);
-  EXPECT_EQ(rp2040->getPC(), INT1_HANDLER + 2);
-  EXPECT_EQ(rp2040->registers[R0], 0x55);
-  rp2040->executeInstruction(); // BX lr
-  EXPECT_EQ(rp2040->getPC(), 0x10004000);
-  EXPECT_EQ(rp2040->registers[R0], 0x44);
-  EXPECT_EQ(rp2040->IPSR, 0);
-}
\ No newline at end of file
+  rp2040->core0.executeInstruction(); // MOVS r0, 0x55
+  EXPECT_EQ(rp2040->core0.IPSR, EXC_INT1);
+  EXPECT_EQ(rp2040->core0.getPC(), INT1_HANDLER + 2);
+  EXPECT_EQ(rp2040->core0.registers[R0], 0x55);
+  rp2040->core0.executeInstruction(); // BX lr
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10004000);
+  EXPECT_EQ(rp2040->core0.registers[R0], 0x44);
+  EXPECT_EQ(rp2040->core0.IPSR, 0);
+}
+
+// should unstack the exception frame above the registers popped with the
+// EXC_RETURN value
+TEST(exception_return_pop, exceptionEntry_and_exceptionReturn) {
+  const number INT1_HANDLER = 0x10000100;
+  RP2040 *rp2040 = new RP2040();
+  rp2040->core0.setSP(0x20004000);
+  rp2040->core0.setPC(0x10004000);
+  rp2040->core0.registers[R4] = 0x44;
+  rp2040->writeUint32(VTOR, 0x10000000);
+  rp2040->writeUint32(0x10000000 + 17 * 4, INT1_HANDLER | 1);
+  rp2040->writeUint16(INT1_HANDLER, 0xb510); // push {r4, lr}
+  rp2040->writeUint16(INT1_HANDLER + 2, opcodeMOVS(R4, 0x55));
+  rp2040->writeUint16(INT1_HANDLER + 4, opcodePOP(true, 1 << R4));
+  rp2040->core0.exceptionEntry(17);
+  for (number i = 0; i < 3; i++) {
+    rp2040->core0.executeInstruction();
+  }
+  EXPECT_EQ(rp2040->core0.getPC(), 0x10004000);
+  EXPECT_EQ(rp2040->core0.getSP(), 0x20004000);
+  EXPECT_EQ(rp2040->core0.registers[R4], 0x44);
+  EXPECT_EQ(rp2040->core0.IPSR, 0);
+}
+
+// should execute an `lsls r5, r0` instruction shifting by 32
+TEST(execute_lsls_instruction_32, executeInstruction) {
+  RP2040 *rp2040 = new RP2040();
+  rp2040->core0.setPC(0x10000000);
+  rp2040->flash16[0] = opcodeLSLSreg(R5, R0);
+  rp2040->core0.registers[R5] = 0x00000001;
+  rp2040->core0.registers[R0] = 32;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R5], 0);
+  EXPECT_EQ(rp2040->core0.Z, true);
+  EXPECT_EQ(rp2040->core0.C, true);
+}
+
+// should not update the flags when executing an `add r1, ip` instruction
+TEST(execute_add_high_register_flags, executeInstruction) {
+  RP2040 *rp2040 = new RP2040();
+  rp2040->core0.setPC(0x10000000);
+  rp2040->flash16[0] = opcodeADDreg(R1, IP);
+  rp2040->core0.registers[R1] = 0xffffffff;
+  rp2040->core0.registers[IP] = 1;
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R1], 0);
+  EXPECT_EQ(rp2040->core0.Z, false);
+  EXPECT_EQ(rp2040->core0.C, false);
+}
+
+// should run the new instruction after the bus rewrites cached flash code
+TEST(flash_code_rewrite, executeBlock) {
+  RP2040 *rp2040 = new RP2040();
+  rp2040->flash16[0] = opcodeMOVS(R0, 1);
+  rp2040->flash16[1] = 0xe7fd; // b.n 0x10000000
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R0], 1);
+  rp2040->writeUint16(0x10000000, opcodeMOVS(R0, 2));
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R0], 2);
+
+  // Enough runs for the block to be compiled
+  for (number i = 0; i < 100; i++) {
+    rp2040->core0.executeBlock();
+  }
+  EXPECT_EQ(rp2040->core0.registers[R0], 2);
+  rp2040->writeUint16(0x10000000, opcodeMOVS(R0, 3));
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core0.executeBlock();
+  EXPECT_EQ(rp2040->core0.registers[R0], 3);
+  rp2040->core0.setPC(0x10000000);
+  rp2040->core0.executeInstruction();
+  EXPECT_EQ(rp2040->core0.registers[R0], 3);
+}
+
+// should let a timer busy-wait take the same cycles stepped and in blocks
+TEST(block_timer_busy_wait, executeBlock) {
+  number cycles[2];
+  for (number blocks = 0; blocks < 2; blocks++) {
+    RP2040 *rp2040 = new RP2040();
+    rp2040->core0.setPC(0x10000000);
+    rp2040->flash16[0] = opcodeLDRreg(R1, R0, R4);
+    rp2040->flash16[1] = opcodeSUBSreg(R1, R1, R2);
+    rp2040->flash16[2] = 0x4299; // cmp r1, r3
+    rp2040->flash16[3] = 0xd3fb; // bcc.n 0x10000000
+    rp2040->flash16[4] = opcodeMOVS(R5, 1);
+    rp2040->core0.registers[R0] = 0x40054000;
+    rp2040->core0.registers[R2] = 0;
+    rp2040->core0.registers[R3] = 1000;
+    rp2040->core0.registers[R4] = TIMERAWL;
+    while (rp2040->core0.getPC() != 0x10000008) {
+      if (blocks) {
+        rp2040->core0.executeBlock();
+      } else {
+        rp2040->core0.executeInstruction();
+      }
+    }
+    cycles[blocks] = rp2040->core0.cycles;
+  }
+  EXPECT_GE(cycles[0], 125000);
+  EXPECT_LT(cycles[0], 125010);
+  EXPECT_EQ(cycles[1], cycles[0]);
+}
+
+#ifdef RP2040_JIT
+// a hot loop should be compiled and give the same result as the interpreter
+TEST(jit_hot_loop, executeBlock) {
+  RP2040 *rp2040 = new RP2040();
+  rp2040->core0.setPC(0x10000000);
+  rp2040->flash16[0] = opcodeADDS2(R0, 3);
+  rp2040->flash16[1] = opcodeSTR(R0, R2, 0);
+  rp2040->flash16[2] = opcodeSUBS2(R1, 1);
+  rp2040->flash16[3] = 0xd1fb; // bne.n 0x10000000
+  rp2040->flash16[4] = opcodeMOVS(R3, 1);
+  rp2040->core0.registers[R1] = 10000;
+  rp2040->core0.registers[R2] = 0x20000000;
+  while (rp2040->core0.getPC() != 0x10000008) {
+    rp2040->core0.executeBlock();
+  }
+  EXPECT_EQ(rp2040->core0.registers[R0], 30000);
+  EXPECT_EQ(rp2040->core0.registers[R1], 0);
+  EXPECT_EQ(rp2040->readUint32(0x20000000), 30000);
+  EXPECT_EQ(rp2040->core0.Z, true);
+  // The last bne.n falls through
+  EXPECT_EQ(rp2040->core0.cycles, 10000 * (1 + 2 + 1 + 2) - 1);
+  EXPECT_EQ(rp2040->core0.blockCache.stats.compiledBlocks, 1);
+  EXPECT_GT(rp2040->core0.blockCache.stats.nativeInstructions, 30000);
+}
+#endif
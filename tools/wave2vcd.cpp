@@ -0,0 +1,24 @@
+#include "waveform.h"
+#include <fstream>
+#include <iostream>
+
+// Converts a recording of RP2040_WAVEFORM to a Value Change Dump
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    cerr << "[Usage] $ ./rp2040-wave2vcd ./blink.wave ./blink.vcd" << endl;
+    return EXIT_FAILURE;
+  }
+  ifstream input(argv[1], ios::binary);
+  if (!input.is_open()) {
+    cerr << "Could not open the file - '" << argv[1] << "'" << endl;
+    return EXIT_FAILURE;
+  }
+  ofstream output(argv[2]);
+  try {
+    convertWaveformToVCD(input, output);
+  } catch (runtime_error *error) {
+    cerr << error->what() << endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}